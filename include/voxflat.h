@@ -10,8 +10,14 @@ extern "C" {
 /**
  * @brief Opaque struct representing an opened MagicaVoxel vox file.
  *
- * Allocated by @ref vxf_open_file, @ref vxf_open_stream or @ref vxf_open_memory.
+ * Allocated by @ref vxf_open_file, @ref vxf_open_stream, @ref vxf_open_memory, @ref vxf_open_fd, @ref vxf_open_io
+ * (or their `_ex` variants) or @ref vxf_open_async.
  * Has to be freed by calling @ref vxf_close.
+ *
+ * Functions that take a `const VxfFile *`, such as @ref vxf_calculate_bounds, only query the scene and can be
+ * called from several threads at the same time; the others must not run concurrently with any other call on the
+ * same instance. Separate instances, and the results of the `vxf_build_` functions, can be used from different
+ * threads.
  */
 typedef struct VxfFile VxfFile;
 
@@ -29,12 +35,120 @@ typedef enum {
     VXF_ERROR_INVALID_SCENE = 7,        /**< Invalid scene graph. */
     VXF_ERROR_OUT_OF_MEMORY = 8,        /**< Out of memory or size overflow. */
     VXF_ERROR_INVALID_ARGUMENT = 9,     /**< Invalid argument provided. */
+    VXF_ERROR_WOULD_BLOCK = 10,         /**< More input is needed, see @ref vxf_open_async, or a read budget has been
+                                             used up before a voxel could be returned. */
+    VXF_ERROR_KEY_RANGE = 11,           /**< Voxel positions do not fit into the 21 bits per axis of keys, see
+                                             @ref VxfKeyFormat. */
 } VxfError;
 
+/**
+ * @brief Memory allocation callbacks.
+ *
+ * Can be passed via @ref VxfOpenOptions to control where a VxfFile instance and its data are allocated.
+ * The parsed scene of a file is stored in only a few large allocations whose sizes are determined by a
+ * scan over the chunk headers, so the callbacks are well suited for arena or bump allocators.
+ */
+typedef struct VxfAllocator {
+    /** Allocates `size` bytes, suitably aligned for any type. Returns NULL on failure. */
+    void *(*alloc)(void *user_data, size_t size);
+    /** Frees memory returned by `alloc`; `size` is the size passed to `alloc`. May do nothing for arenas. */
+    void (*free)(void *user_data, void *ptr, size_t size);
+    /** Passed to the callbacks. */
+    void *user_data;
+} VxfAllocator;
+
+/**
+ * @brief Order in which the voxels of the model instances of a scene are read.
+ */
+typedef enum {
+    /** Order of the scene graph (default). */
+    VXF_READ_ORDER_SCENE = 0,
+    /**
+     * Order of the model data in the file, with all instances of a model read consecutively. Results in
+     * sequential reads of the source; use @ref vxf_read to get the instance ids in scene graph order.
+     */
+    VXF_READ_ORDER_FILE = 1,
+} VxfReadOrder;
+
+/**
+ * @brief Additional options for the `vxf_open_*_ex` functions.
+ *
+ * Should be zero-initialized before setting individual fields, so that options added in the future
+ * keep their default values.
+ */
+typedef struct VxfOpenOptions {
+    /** Allocator for all memory used by the VxfFile instance, or NULL to use `malloc` and `free`. */
+    const VxfAllocator *allocator;
+    /**
+     * Number of upcoming model instances for which prefetch hints are issued while reading voxels, so that
+     * their data can be loaded in the background; 0 (the default) disables prefetching. Hints are issued with
+     * `posix_fadvise` for files and streams where available, and via the `prefetch` callback of @ref VxfIo.
+     */
+    unsigned prefetch_distance;
+    /** Order in which the voxels of the model instances are read. */
+    VxfReadOrder read_order;
+    /**
+     * Path of a scene cache file, or NULL. Only used for files opened with @ref vxf_open_file_ex or
+     * @ref vxf_open_fd. If the cache was created from a file of the same size and modification time, and with the
+     * same last 64 KiB, where the scene chunks are stored, the parsed scene structure is loaded from it instead of
+     * parsing the file and checked like a parsed one; otherwise the file is parsed and the cache is (re)written.
+     * The cache also holds the instance table, voxel count and bounds of the first frame without filters and node
+     * selection. It is memory-mapped, and as long as that scene is selected, @ref vxf_count_voxels and
+     * @ref vxf_calculate_bounds return the stored values and reading uses the instance table from the mapping.
+     * Voxel data is not cached and still read from the file. Cache files are specific to the library build and
+     * platform; write errors are ignored.
+     */
+    const char *cache_filename;
+    /**
+     * Nonzero to hash the voxel data of each model while opening, which reads the whole file, so that
+     * @ref vxf_diff_scenes can detect all changed models.
+     */
+    int fingerprint_models;
+    /**
+     * Handle of an earlier version of the file, e.g. before it was saved again, or NULL. The first voxels of each
+     * model are hashed while opening, see @ref vxf_diff_scenes. If both handles have @ref fingerprint_models set,
+     * models whose chunk offset, voxel count and first 64 voxels are unchanged take their fingerprint from it
+     * instead of being hashed again, so that only changed models are read completely; edits further into such
+     * models are not detected. Must not be closed before opening has finished.
+     */
+    const VxfFile *previous;
+} VxfOpenOptions;
+
+/**
+ * @brief I/O callbacks for reading from a custom source.
+ *
+ * Used with @ref vxf_open_io to read vox files from sources other than files and memory buffers,
+ * e.g. entries of pack files. Offsets are absolute positions in the source.
+ */
+typedef struct VxfIo {
+    /**
+     * Reads up to `size` bytes from the current position into `buffer` and advances the position.
+     * Returns the number of bytes read, which may be less than `size`, 0 at the end of input,
+     * or a negative value on error.
+     */
+    int64_t (*read)(void *ctx, void *buffer, size_t size);
+    /** Sets the current position to `offset`. Returns 0 on success, nonzero on error. */
+    int (*seek)(void *ctx, int64_t offset);
+    /** Returns the current position, or a negative value on error. */
+    int64_t (*tell)(void *ctx);
+    /**
+     * Optional, may be NULL. Returns a pointer to the next `size` bytes and advances the position, or NULL
+     * if the data is not directly accessible, in which case `read` is used instead. The returned data
+     * must remain valid until the next call of any callback.
+     */
+    const void *(*get_pointer)(void *ctx, size_t size);
+    /**
+     * Optional, may be NULL. Hint that `size` bytes at `offset` will be read soon, e.g. to start loading
+     * them asynchronously. Called only if @ref VxfOpenOptions::prefetch_distance is nonzero.
+     */
+    void (*prefetch)(void *ctx, int64_t offset, size_t size);
+} VxfIo;
+
 /**
  * @brief Opens a MagicaVoxel vox file from a filename.
  *
- * The file must be seekable and will be kept open until @ref vxf_close is called.
+ * The file must be seekable and will be kept open until @ref vxf_close is called. The file is read
+ * with positional reads through an internal buffer, which is not discarded when switching between models.
  *
  * @param[in] filename Path to the vox file.
  * @param[out] error Where to store the error code. May be NULL.
@@ -69,6 +183,124 @@ VxfFile *vxf_open_stream(FILE *stream, VxfError *error);
  */
 VxfFile *vxf_open_memory(size_t size, const char buffer[], VxfError *error);
 
+/**
+ * @brief Opens a MagicaVoxel vox file from a file descriptor.
+ *
+ * Reading starts at the current offset of the descriptor. The data is read with positional reads
+ * (`pread`, or `ReadFile` with an offset on Windows), so reads do not depend on the offset of the descriptor
+ * and several VxfFile instances may share a descriptor, also from different threads. On POSIX systems, the
+ * offset is not changed; on Windows, `ReadFile` also moves the file pointer, so the offset is undefined
+ * afterwards. The descriptor is not closed by @ref vxf_close.
+ *
+ * @param[in] fd File descriptor opened for reading.
+ * @param[in] options Options, or NULL for default options.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Pointer to a new VxfFile instance on success, NULL on failure.
+ */
+VxfFile *vxf_open_fd(int fd, const VxfOpenOptions *options, VxfError *error);
+
+/**
+ * @brief Opens a MagicaVoxel vox file from custom I/O callbacks.
+ *
+ * Reading starts at the current position of the source as returned by the `tell` callback.
+ * The source must remain accessible until @ref vxf_close is called.
+ *
+ * @param[in] io I/O callbacks. The struct is copied.
+ * @param[in] ctx Context pointer passed to the callbacks.
+ * @param[in] options Options, or NULL for default options.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Pointer to a new VxfFile instance on success, NULL on failure.
+ */
+VxfFile *vxf_open_io(const VxfIo *io, void *ctx, const VxfOpenOptions *options, VxfError *error);
+
+/**
+ * @brief Like @ref vxf_open_file, with additional options.
+ *
+ * @param[in] filename Path to the vox file.
+ * @param[in] options Options, or NULL for default options.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Pointer to a new VxfFile instance on success, NULL on failure.
+ */
+VxfFile *vxf_open_file_ex(const char *filename, const VxfOpenOptions *options, VxfError *error);
+
+/**
+ * @brief Like @ref vxf_open_stream, with additional options.
+ *
+ * @param[in] stream Stream to read from.
+ * @param[in] options Options, or NULL for default options.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Pointer to a new VxfFile instance on success, NULL on failure.
+ */
+VxfFile *vxf_open_stream_ex(FILE *stream, const VxfOpenOptions *options, VxfError *error);
+
+/**
+ * @brief Like @ref vxf_open_memory, with additional options.
+ *
+ * @param[in] size Size of the buffer.
+ * @param[in] buffer Memory buffer containing vox file data.
+ * @param[in] options Options, or NULL for default options.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Pointer to a new VxfFile instance on success, NULL on failure.
+ */
+VxfFile *vxf_open_memory_ex(size_t size, const char buffer[], const VxfOpenOptions *options, VxfError *error);
+
+/**
+ * @brief Creates a VxfFile instance that is fed with the bytes of a vox file by the caller, without blocking.
+ *
+ * Instead of reading from a source, the instance reports the byte range it needs next via
+ * @ref vxf_async_get_request: the file header, a chunk header, the content of a chunk, or a span of model data.
+ * The caller reads the range with any I/O mechanism, e.g. in an event loop, and passes the bytes to
+ * @ref vxf_async_feed, which continues opening the file as far as possible. Once opening has finished,
+ * @ref vxf_read and the functions based on it return 0 with @ref VXF_ERROR_WOULD_BLOCK when the voxels at
+ * the read position have not been fed yet; after feeding the requested range, the call is repeated. Until then,
+ * they fail with @ref VXF_ERROR_WOULD_BLOCK as well, or with the error that opening failed with.
+ *
+ * Chunks are processed completely or not at all, so model data is skipped while opening, and only the requested
+ * range is kept in memory. Until @ref vxf_async_feed has returned @ref VXF_SUCCESS, the scene functions fail with
+ * the same error as @ref vxf_read, or return an empty result, e.g. zero bounds from @ref vxf_calculate_bounds,
+ * and selecting frames or setting filters has no effect. Functions that read all voxels at once, such as
+ * @ref vxf_build_mesh, are not supported and fail with @ref VXF_ERROR_WOULD_BLOCK.
+ * @ref VxfOpenOptions::cache_filename and @ref VxfOpenOptions::prefetch_distance are ignored.
+ *
+ * @param[in] options Options, or NULL for default options.
+ * @param[out] error Where to store the error code, which is @ref VXF_ERROR_WOULD_BLOCK on success since
+ *                   the file header is needed. May be NULL.
+ *
+ * @return Pointer to a new VxfFile instance, NULL if the options are invalid or memory allocation fails.
+ */
+VxfFile *vxf_open_async(const VxfOpenOptions *options, VxfError *error);
+
+/**
+ * @brief Returns the byte range that an instance created by @ref vxf_open_async needs next.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[out] offset Position of the first byte in the file.
+ * @param[out] size Number of bytes, at least 1.
+ *
+ * @return Nonzero if bytes are needed, 0 otherwise.
+ */
+int vxf_async_get_request(const VxfFile *vf, uint64_t *offset, size_t *size);
+
+/**
+ * @brief Passes the bytes of the range returned by @ref vxf_async_get_request, and continues opening the file.
+ *
+ * The bytes are copied. Fewer bytes than requested mean that the file ends after them.
+ *
+ * @param[in] vf VxfFile instance created by @ref vxf_open_async.
+ * @param[in] data Bytes of the file from the requested offset on.
+ * @param[in] size Number of bytes, at most the requested size.
+ *
+ * @return @ref VXF_SUCCESS if the file has been opened, @ref VXF_ERROR_WOULD_BLOCK if more bytes are needed for
+ *         opening it, or another error code if opening has failed, in which case the instance can only be closed.
+ *         @ref VXF_ERROR_INVALID_ARGUMENT if no bytes were requested or the size is too large.
+ */
+VxfError vxf_async_feed(VxfFile *vf, const void *data, size_t size);
+
 /**
  * @brief Calculates the bounding box of the voxel data.
  *
@@ -79,7 +311,7 @@ VxfFile *vxf_open_memory(size_t size, const char buffer[], VxfError *error);
  * @param[out] xyz_min Minimum x, y, z coordinates of the bounding box.
  * @param[out] xyz_max Maximum x, y, z coordinates of the bounding box.
  */
-void vxf_calculate_bounds(const VxfFile* vf, int32_t xyz_min[3], int32_t xyz_max[3]);
+void vxf_calculate_bounds(const VxfFile *vf, int32_t xyz_min[3], int32_t xyz_max[3]);
 
 /**
  * @brief Counts the total number of voxels in the file.
@@ -90,7 +322,7 @@ void vxf_calculate_bounds(const VxfFile* vf, int32_t xyz_min[3], int32_t xyz_max
  * @param[in] vf VxfFile instance.
  * @return Total number of voxels.
  */
-uintmax_t vxf_count_voxels(const VxfFile* vf);
+uintmax_t vxf_count_voxels(const VxfFile *vf);
 
 /**
  * @brief Retrieves the color palette.
@@ -104,6 +336,170 @@ uintmax_t vxf_count_voxels(const VxfFile* vf);
  */
 void vxf_get_palette(const VxfFile *vf, uint8_t rgba_buf[256][4]);
 
+/**
+ * @brief Returns the number of animation frames of the scene.
+ *
+ * Shape and transform nodes can have keyframes; a keyframe applies until the next keyframe of the same node.
+ * The result is one more than the highest keyframe index, and 1 for scenes without animation.
+ *
+ * @param[in] vf VxfFile instance.
+ * @return Number of animation frames.
+ */
+uint32_t vxf_get_frame_count(const VxfFile *vf);
+
+/**
+ * @brief Selects the animation frame used by all following operations.
+ *
+ * Frame 0 is selected when a file is opened. The file is not parsed again. Reading restarts at the first voxel,
+ * and the results of functions like @ref vxf_calculate_bounds and @ref vxf_build_mesh change accordingly.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] frame Animation frame. Frames after the last keyframe keep the state of the last keyframe.
+ */
+void vxf_select_frame(VxfFile *vf, uint32_t frame);
+
+/**
+ * @brief Determines the model instances that differ between two animation frames.
+ *
+ * An instance differs if it has a different model or transform. Visibility is not animated, so both frames
+ * have the same instances, identified by the instance ids reported by @ref vxf_read. Does not change the selected
+ * frame or the read position.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] frame_a First animation frame.
+ * @param[in] frame_b Second animation frame.
+ * @param[in] max_count Capacity of `instance_ids`.
+ * @param[out] instance_ids Buffer for the ids of differing instances in ascending order.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Total number of differing instances, which may be larger than `max_count`; 0 if an error has occurred.
+ */
+size_t vxf_diff_frames(VxfFile *vf, uint32_t frame_a, uint32_t frame_b, size_t max_count, uint32_t instance_ids[],
+    VxfError *error);
+
+/**
+ * @brief Kind of a change reported by @ref vxf_diff_scenes.
+ */
+typedef enum {
+    VXF_INSTANCE_ADDED = 1,         /**< Only in the new scene. */
+    VXF_INSTANCE_REMOVED = 2,       /**< Only in the old scene. */
+    VXF_INSTANCE_MODIFIED = 3,      /**< Different model data or transform. */
+    VXF_INSTANCE_RENUMBERED = 4,    /**< Unchanged, but with a different instance id. */
+} VxfInstanceChangeType;
+
+/**
+ * @brief Change of a model instance between two versions of a scene.
+ */
+typedef struct VxfInstanceChange {
+    VxfInstanceChangeType type;
+    uint32_t old_instance_id;       /**< Instance id in the old scene, or UINT32_MAX for added instances. */
+    uint32_t new_instance_id;       /**< Instance id in the new scene, or UINT32_MAX for removed instances. */
+} VxfInstanceChange;
+
+/**
+ * @brief Determines the model instances that differ between two versions of a scene, e.g. after a file was saved.
+ *
+ * If both instances were opened with @ref VxfOpenOptions::fingerprint_models, changed models are detected by a hash
+ * of their voxel data; otherwise they are compared by chunk offset, size and voxel count, which misses edits that
+ * keep the size of a model. Models of instances opened with fingerprints or @ref VxfOpenOptions::previous are also
+ * compared by a hash of their first voxels. The instances of the selected frame, filter and node
+ * selection are compared. Instance ids are reported in scene graph order, as by @ref vxf_read. Instances are
+ * matched by the ids of the scene graph nodes on their path, so that reordered nodes are reported as renumbered;
+ * unchanged instances whose nodes were given new ids are matched by their model and transform. Does not change the
+ * read position.
+ *
+ * @param[in] old_vf VxfFile instance of the old version.
+ * @param[in] new_vf VxfFile instance of the new version.
+ * @param[in] max_count Capacity of `changes`.
+ * @param[out] changes Buffer for the changes; modified and added instances in ascending order of their new ids,
+ *                     followed by removed instances in ascending order of their old ids and renumbered instances
+ *                     in ascending order of their new ids.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Total number of changes, which may be larger than `max_count`; 0 if an error has occurred.
+ */
+size_t vxf_diff_scenes(const VxfFile *old_vf, const VxfFile *new_vf, size_t max_count, VxfInstanceChange changes[],
+    VxfError *error);
+
+/**
+ * @brief Selects which parts of the scene are returned, see @ref vxf_set_filter.
+ *
+ * Should be zero-initialized before setting individual fields; the zero-initialized filter returns all visible
+ * voxels.
+ */
+typedef struct VxfFilter {
+    const uint32_t *include_layers; /**< IDs of the layers to include, or NULL to include all layers. */
+    size_t include_layer_count;     /**< Number of entries in `include_layers`. */
+    const uint32_t *exclude_layers; /**< IDs of the layers to exclude, or NULL. */
+    size_t exclude_layer_count;     /**< Number of entries in `exclude_layers`. */
+    const uint64_t *color_mask;     /**< 256-bit mask of the color indices to include, with color index i at bit
+                                         i % 64 of entry i / 64, or NULL to include all colors. */
+    int show_hidden;                /**< Nonzero to include nodes and layers marked as hidden. */
+} VxfFilter;
+
+/**
+ * @brief Sets a filter for all following operations.
+ *
+ * Layer filters and the visibility override apply to the scene graph: subtrees below transform nodes of
+ * excluded layers are skipped without reading their models, and they are left out by @ref vxf_calculate_bounds,
+ * @ref vxf_count_voxels and @ref vxf_diff_frames. Transform nodes without a layer are not affected by layer
+ * filters. Layer IDs that do not exist in the file are ignored.
+ *
+ * The color mask is applied while decoding voxels, so that other voxels are never transformed or copied. It
+ * also applies to @ref vxf_build_mesh and @ref vxf_build_lod, but not to @ref vxf_count_voxels. Exposed faces
+ * (see @ref VxfReadBuffers) are still determined from all voxels of a model.
+ *
+ * Reading restarts at the first voxel. The arrays of the filter are copied and need not be kept.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] filter Filter, or NULL to return all visible voxels again.
+ */
+void vxf_set_filter(VxfFile *vf, const VxfFilter *filter);
+
+/**
+ * @brief Finds scene graph nodes by their name.
+ *
+ * Group, transform and shape nodes can be named in MagicaVoxel via the `_name` attribute; names need not be
+ * unique. The names are indexed when the file is opened, so lookups are fast even for large scenes.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] name Name to search for; case-sensitive.
+ * @param[in] max_count Capacity of `node_ids`.
+ * @param[out] node_ids Buffer for the IDs of the matching nodes in ascending order. May be NULL if `max_count` is 0.
+ *
+ * @return Total number of matching nodes, which may be larger than `max_count`.
+ */
+size_t vxf_find_nodes(const VxfFile *vf, const char *name, size_t max_count, uint32_t node_ids[]);
+
+/**
+ * @brief Returns the name of a scene graph node.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] node_id ID of the node.
+ *
+ * @return Name of the node, valid until the file is closed; NULL if the node has no name or does not exist.
+ */
+const char *vxf_get_node_name(const VxfFile *vf, uint32_t node_id);
+
+/**
+ * @brief Restricts all following operations to the subtree below a scene graph node.
+ *
+ * Voxels of the subtree are returned at their position in the whole scene, i.e. with the transforms of the parent
+ * nodes applied. If the node is reachable via several paths, the first one in traversal order is used; if it is
+ * only reachable via hidden or filtered nodes, the subtree is empty. Only the models of the subtree are read, and
+ * @ref vxf_calculate_bounds, @ref vxf_count_voxels, @ref vxf_build_mesh and @ref vxf_build_lod also only take the
+ * subtree into account. Instance ids are numbered within the subtree.
+ *
+ * The root node, which has the lowest node ID (usually 0), is selected when a file is opened. Reading restarts at
+ * the first voxel.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] node_id ID of the node, e.g. found with @ref vxf_find_nodes.
+ * @param[out] error Where to store the error code; @ref VXF_ERROR_INVALID_ARGUMENT if there is no node with that
+ *                   ID, in which case the selection is unchanged. May be NULL.
+ */
+void vxf_select_node(VxfFile *vf, uint32_t node_id, VxfError *error);
+
 /**
  * @brief Reads voxel positions and RGBA colors.
  *
@@ -144,6 +540,593 @@ size_t vxf_read_xyz_rgba(VxfFile *vf, size_t max_count, int32_t xyz_buf[][3], ui
  */
 size_t vxf_read_xyz_coloridx(VxfFile *vf, size_t max_count, int32_t xyz_buf[][3], uint8_t coloridx_buf[], VxfError *error);
 
+/**
+ * @brief Color formats for the `color` buffer of @ref VxfReadBuffers.
+ *
+ * Colors are converted from the palette with a lookup table that is computed once per VxfFile instance.
+ */
+typedef enum {
+    /** `uint32_t` per voxel with the bytes R, G, B, A in memory order (same as @ref vxf_read_xyz_rgba). */
+    VXF_COLOR_FORMAT_RGBA8 = 0,
+    /** `uint32_t` per voxel with the bytes B, G, R, A in memory order. */
+    VXF_COLOR_FORMAT_BGRA8 = 1,
+    /** `uint16_t` per voxel with 5 bits red (most significant), 6 bits green and 5 bits blue. */
+    VXF_COLOR_FORMAT_RGB565 = 2,
+    /** `float[4]` per voxel with linear RGB values converted from sRGB and alpha, in the range 0 to 1. */
+    VXF_COLOR_FORMAT_RGBA_F32_LINEAR = 3,
+    /** `uint32_t` per voxel taken from @ref VxfReadBuffers::color_remap, indexed by color index. */
+    VXF_COLOR_FORMAT_REMAP_U32 = 4,
+} VxfColorFormat;
+
+/**
+ * @brief Formats for the `keys` buffer of @ref VxfReadBuffers.
+ *
+ * Keys hold the voxel position relative to the minimum returned by @ref vxf_calculate_bounds, with 21 bits per
+ * axis. Use @ref vxf_decode_key to convert them back to coordinates. Reading keys fails with
+ * @ref VXF_ERROR_KEY_RANGE if the bounds are larger than 2^21 on any axis, or when a voxel outside of the size of
+ * its model would be out of that range, so that distinct positions never share a key. In the latter case,
+ * @ref vxf_read keeps failing until reading restarts, e.g. after @ref vxf_set_filter.
+ */
+typedef enum {
+    /** x in bits 0-20, y in bits 21-41, z in bits 42-62. */
+    VXF_KEY_FORMAT_PACKED = 0,
+    /** Bits of x, y and z interleaved (Morton code), so that sorted keys are in Z-order. */
+    VXF_KEY_FORMAT_MORTON = 1,
+} VxfKeyFormat;
+
+/**
+ * @brief Flags for the faces of a voxel in global coordinates, used in the `face_mask` buffer of @ref VxfReadBuffers.
+ *
+ * A face is exposed if the neighboring voxel in that direction does not belong to the same model. Voxels of other
+ * model instances are not taken into account.
+ */
+typedef enum {
+    VXF_FACE_NEG_X = 1 << 0,
+    VXF_FACE_POS_X = 1 << 1,
+    VXF_FACE_NEG_Y = 1 << 2,
+    VXF_FACE_POS_Y = 1 << 3,
+    VXF_FACE_NEG_Z = 1 << 4,
+    VXF_FACE_POS_Z = 1 << 5,
+} VxfFace;
+
+/**
+ * @brief Output buffers for @ref vxf_read.
+ *
+ * Buffers that are not needed can be NULL, but at least one must be provided.
+ * Should be zero-initialized before setting individual fields.
+ */
+typedef struct VxfReadBuffers {
+    size_t max_count;           /**< Maximum number of voxels to read, i.e. capacity of the buffers. */
+    int32_t (*xyz)[3];          /**< Buffer for voxel x, y, z coordinates, or NULL. */
+    uint8_t (*rgba)[4];         /**< Buffer for voxel RGBA colors, or NULL. */
+    uint8_t *coloridx;          /**< Buffer for voxel color indices, or NULL. */
+    void *color;                /**< Buffer for voxel colors in `color_format`, or NULL. */
+    VxfColorFormat color_format; /**< Format of the `color` buffer. */
+    const uint32_t *color_remap; /**< Table of 256 entries for @ref VXF_COLOR_FORMAT_REMAP_U32, e.g. indices into an application palette. */
+    uint64_t *keys;             /**< Buffer for voxel position keys in `key_format`, or NULL. */
+    VxfKeyFormat key_format;    /**< Format of the `keys` buffer. */
+    uint8_t *face_mask;         /**< Buffer for the exposed faces of each voxel as a combination of @ref VxfFace flags,
+                                     or NULL. Voxels outside of the size of their model have no exposed faces, as
+                                     they are left out of meshes. */
+    int surface_only;           /**< Nonzero to skip voxels that have no exposed faces, so that fewer voxels than
+                                     counted by @ref vxf_count_voxels are returned. */
+    uint64_t byte_budget;       /**< Nonzero to stop after reading about this many bytes of voxel data (4 per voxel),
+                                     for progressive loading in slices. Voxels skipped by `surface_only` or a color
+                                     filter count as well; if only such voxels fit into a budget, @ref vxf_read
+                                     returns 0 with @ref VXF_ERROR_WOULD_BLOCK and continues with the next call. */
+    uint32_t time_budget_us;    /**< Nonzero to stop after about this many microseconds, like `byte_budget`. */
+} VxfReadBuffers;
+
+/**
+ * @brief Reads voxels into the given buffers.
+ *
+ * Generalization of @ref vxf_read_xyz_rgba and @ref vxf_read_xyz_coloridx, which continue reading from the
+ * same position.
+ *
+ * If `instance_id` is not NULL, the returned voxels all belong to the same model instance, and its id is
+ * stored in `instance_id`. Instances are numbered from 0 in scene graph order, counting only visible instances,
+ * also if a different order was selected with @ref VxfOpenOptions::read_order.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] buffers Output buffers.
+ * @param[out] instance_id Where to store the instance id, or NULL to read voxels of several instances at once.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Number of voxels read into the buffers, which can be less than `max_count` or 0 if the
+ * end of the list of available voxels has been reached; 0 if an error has occurred.
+ */
+size_t vxf_read(VxfFile *vf, const VxfReadBuffers *buffers, uint32_t *instance_id, VxfError *error);
+
+/**
+ * @brief Returns the read position of @ref vxf_read, with the number of voxels consumed so far in the lower 48 bits.
+ *
+ * Voxels skipped by @ref VxfReadBuffers::surface_only or a color filter are counted, so the number is between 0
+ * and @ref vxf_count_voxels. Unless the position is 0, the upper 16 bits hold a hash of the instances being read and
+ * the color filter.
+ * The position can be stored and passed to @ref vxf_set_read_position to resume reading later, also on a new
+ * VxfFile instance of the same data.
+ *
+ * @param[in] vf VxfFile instance.
+ *
+ * @return Read position.
+ */
+uint64_t vxf_get_read_position(const VxfFile *vf);
+
+/**
+ * @brief Continues reading from a position returned by @ref vxf_get_read_position.
+ *
+ * The position refers to the voxels of the current frame, filter and node selection in the order selected with
+ * @ref VxfOpenOptions::read_order; a new instance must be set up the same way before the position is applied.
+ * Positions from other data or set-ups are detected by their hash in most cases. Changing any of them afterwards
+ * resets the read position. Clears the end-of-data state.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] position Read position, or 0 to restart reading. Fails with @ref VXF_ERROR_INVALID_ARGUMENT if the
+ *                     hash does not match or the number of voxels is greater than @ref vxf_count_voxels.
+ * @param[out] error Where to store the error code. May be NULL.
+ */
+void vxf_set_read_position(VxfFile *vf, uint64_t position, VxfError *error);
+
+/**
+ * @brief Converts a key read with @ref vxf_read back to coordinates.
+ *
+ * @param[in] key Voxel key.
+ * @param[in] format Format of the key.
+ * @param[in] origin Minimum coordinates returned by @ref vxf_calculate_bounds.
+ * @param[out] xyz Voxel x, y, z coordinates.
+ */
+void vxf_decode_key(uint64_t key, VxfKeyFormat format, const int32_t origin[3], int32_t xyz[3]);
+
+/**
+ * @brief Sorts keys in ascending order, together with an optional array of values.
+ *
+ * Uses a stable radix sort, so voxels with the same position stay in the order they were read. Morton keys
+ * are sorted into Z-order. Large arrays are split across `thread_count` threads if the library was built
+ * with thread support.
+ *
+ * @param[in,out] keys Keys to sort.
+ * @param[in,out] values Values to reorder along with the keys, e.g. colors, or NULL.
+ * @param[in] count Number of keys.
+ * @param[in] thread_count Maximum number of threads to use; 0 or 1 to sort in the calling thread.
+ * @param[in] allocator Allocator for temporary buffers, or NULL to use malloc/free.
+ * @param[out] error Where to store the error code. May be NULL.
+ */
+void vxf_sort_keys(uint64_t keys[], uint32_t values[], size_t count, unsigned thread_count,
+    const VxfAllocator *allocator, VxfError *error);
+
+/**
+ * @brief Options for @ref vxf_build_mesh.
+ *
+ * Should be zero-initialized before setting individual fields.
+ */
+typedef struct VxfMeshOptions {
+    int ambient_occlusion;      /**< Nonzero to compute ambient occlusion values per quad corner. */
+    unsigned thread_count;      /**< Maximum number of threads for meshing models in parallel; 0 or 1 to use only
+                                     the calling thread. With more threads, the allocator must be thread-safe. */
+} VxfMeshOptions;
+
+/**
+ * @brief A rectangle of merged voxel faces.
+ *
+ * The voxel at x, y, z is a cube from (x, y, z) to (x + 1, y + 1, z + 1).
+ */
+typedef struct VxfQuad {
+    int32_t xyz[4][3];          /**< Corner positions, counter-clockwise when looking at the front side. */
+    int8_t normal[3];           /**< Unit normal pointing away from the voxels. */
+    uint8_t coloridx;           /**< Color index of the voxels. */
+    uint8_t rgba[4];            /**< Color of the voxels. */
+    uint8_t ao[4];              /**< Ambient occlusion per corner, from 0 (occluded by two neighbors) to 3 (not
+                                     occluded); always 3 unless enabled in @ref VxfMeshOptions. */
+    uint32_t instance_id;       /**< Model instance of the voxels, numbered as in @ref vxf_read. */
+} VxfQuad;
+
+/**
+ * @brief Mesh created by @ref vxf_build_mesh.
+ */
+typedef struct VxfMesh {
+    size_t quad_count;          /**< Number of quads. */
+    VxfQuad *quads;             /**< Quads, grouped by instance. */
+} VxfMesh;
+
+/**
+ * @brief Creates a mesh of the visible voxel faces.
+ *
+ * Each model used in the scene is meshed once in model space: faces next to another voxel of the same model are
+ * left out, and adjacent faces with the same color (and ambient occlusion) are merged into rectangles. The model
+ * meshes are then transformed for each visible instance. Faces between voxels of different instances are not
+ * removed, and ambient occlusion also only takes the voxels of the same model into account.
+ *
+ * Does not change the read position of @ref vxf_read.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] options Mesh options, or NULL for the defaults.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return New mesh, to be freed with @ref vxf_free_mesh; NULL if an error has occurred.
+ */
+VxfMesh *vxf_build_mesh(VxfFile *vf, const VxfMeshOptions *options, VxfError *error);
+
+/**
+ * @brief Frees a mesh created by @ref vxf_build_mesh.
+ *
+ * Can be called after the VxfFile instance has been closed.
+ *
+ * @param[in] mesh Mesh to free, or NULL.
+ */
+void vxf_free_mesh(VxfMesh *mesh);
+
+/**
+ * @brief Opaque struct holding a level-of-detail pyramid created by @ref vxf_build_lod.
+ */
+typedef struct VxfLod VxfLod;
+
+/**
+ * @brief How the color of a coarser voxel is chosen from its occupied children.
+ */
+typedef enum {
+    /** Most frequent color index; ties are resolved in favor of the child read last. */
+    VXF_LOD_MODE_MAJORITY = 0,
+    /** Color index of the child read last. */
+    VXF_LOD_MODE_LAST = 1,
+} VxfLodMode;
+
+/**
+ * @brief Options for @ref vxf_build_lod.
+ *
+ * Should be zero-initialized before setting individual fields.
+ */
+typedef struct VxfLodOptions {
+    VxfLodMode mode;            /**< How colors of coarser voxels are chosen. */
+    unsigned max_levels;        /**< Maximum number of levels including the full resolution, or 0 to continue until
+                                     the coarsest level consists of a single voxel. */
+    unsigned thread_count;      /**< Maximum number of threads for sorting, see @ref vxf_sort_keys. */
+} VxfLodOptions;
+
+/**
+ * @brief Creates a level-of-detail pyramid of the visible voxels.
+ *
+ * Level 0 contains the voxels at full resolution, where a voxel replaces earlier voxels at the same position.
+ * A voxel at level n + 1 covers the 2x2x2 voxels of level n from (2x, 2y, 2z) to (2x + 1, 2y + 1, 2z + 1) and is
+ * present if any of them is. Thus a voxel at level n with coordinates x, y, z covers the full resolution voxels
+ * from (x, y, z) * 2^n to (x + 1, y + 1, z + 1) * 2^n - 1.
+ *
+ * Levels are added until a level consists of a single voxel. If the scene extends to both sides of a coordinate
+ * plane through 0, this is not possible, and the coarsest level has up to 2 voxels along each axis instead.
+ *
+ * All voxels are read into memory. Does not change the read position of @ref vxf_read. May fail with
+ * @ref VXF_ERROR_KEY_RANGE if the bounds are larger than 2^20 on any axis, or as described for @ref VxfKeyFormat.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] options LOD options, or NULL for the defaults.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return New VxfLod instance, to be freed with @ref vxf_free_lod; NULL if an error has occurred.
+ */
+VxfLod *vxf_build_lod(VxfFile *vf, const VxfLodOptions *options, VxfError *error);
+
+/**
+ * @brief Returns the number of levels of a pyramid, which is 0 if the scene has no voxels.
+ */
+unsigned vxf_lod_level_count(const VxfLod *lod);
+
+/**
+ * @brief Returns the number of voxels at a level of a pyramid.
+ */
+uintmax_t vxf_lod_count_voxels(const VxfLod *lod, unsigned level);
+
+/**
+ * @brief Reads voxel coordinates and color indices of a level, in the same way as @ref vxf_read_xyz_coloridx.
+ *
+ * Each level has its own read position. Voxels are returned in Morton (Z-) order.
+ *
+ * @param[in] lod VxfLod instance.
+ * @param[in] level Level, from 0 (full resolution) to @ref vxf_lod_level_count - 1.
+ * @param[in] max_count Maximum number of voxels to read.
+ * @param[out] xyz_buf Buffer for voxel x, y, z coordinates in units of the level.
+ * @param[out] coloridx_buf Buffer for voxel color indices.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return Number of voxels read into the buffers, 0 at the end of the level or if an error has occurred.
+ */
+size_t vxf_lod_read_xyz_coloridx(VxfLod *lod, unsigned level, size_t max_count, int32_t xyz_buf[][3],
+    uint8_t coloridx_buf[], VxfError *error);
+
+/**
+ * @brief Frees a pyramid created by @ref vxf_build_lod.
+ *
+ * Can be called after the VxfFile instance has been closed.
+ *
+ * @param[in] lod VxfLod instance to free, or NULL.
+ */
+void vxf_free_lod(VxfLod *lod);
+
+/**
+ * @brief Structure for querying the color at arbitrary positions, see @ref vxf_build_lookup.
+ */
+typedef struct VxfLookup VxfLookup;
+
+/**
+ * @brief Options for @ref vxf_build_lookup.
+ *
+ * Should be zero-initialized before setting individual fields.
+ */
+typedef struct VxfLookupOptions {
+    unsigned thread_count;      /**< Maximum number of threads for sorting, see @ref vxf_sort_keys. */
+} VxfLookupOptions;
+
+/**
+ * @brief Creates an immutable structure for point queries on the visible voxels.
+ *
+ * The voxels are stored in bricks of 8x8x8 voxels, each with a 512-bit occupancy mask and the color indices of
+ * its voxels; a hash table maps brick coordinates to bricks. A query thus touches the hash table, one cache line
+ * of occupancy bits and one color index. Where voxels overlap, the one read last is kept, as in @ref
+ * vxf_build_lod. The structure does not depend on the VxfFile instance and can be queried from several threads.
+ *
+ * All voxels are read into memory. Does not change the read position of @ref vxf_read. May fail with
+ * @ref VXF_ERROR_KEY_RANGE if the bounds are larger than 2^21 on any axis, or as described for @ref VxfKeyFormat.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] options Lookup options, or NULL for the defaults.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return New VxfLookup instance, to be freed with @ref vxf_free_lookup; NULL if an error has occurred.
+ */
+VxfLookup *vxf_build_lookup(VxfFile *vf, const VxfLookupOptions *options, VxfError *error);
+
+/**
+ * @brief Returns the color index of the voxel at a position.
+ *
+ * @param[in] lookup VxfLookup instance.
+ * @param[in] xyz Position in the coordinates returned by @ref vxf_read.
+ *
+ * @return Color index of the voxel, or 0 if there is no voxel at the position.
+ */
+uint8_t vxf_lookup_coloridx(const VxfLookup *lookup, const int32_t xyz[3]);
+
+/**
+ * @brief Returns the color indices of the voxels at several positions, like @ref vxf_lookup_coloridx.
+ *
+ * Faster than single queries, in particular if consecutive positions are close to each other.
+ *
+ * @param[in] lookup VxfLookup instance.
+ * @param[in] count Number of positions.
+ * @param[in] xyz Positions.
+ * @param[out] coloridx_buf Buffer for `count` color indices, 0 where there is no voxel.
+ */
+void vxf_lookup_coloridx_batch(const VxfLookup *lookup, size_t count, const int32_t xyz[][3],
+    uint8_t coloridx_buf[]);
+
+/**
+ * @brief Returns the number of bytes allocated for a lookup structure.
+ */
+size_t vxf_lookup_memory_usage(const VxfLookup *lookup);
+
+/**
+ * @brief Frees a lookup structure created by @ref vxf_build_lookup.
+ *
+ * Can be called after the VxfFile instance has been closed.
+ *
+ * @param[in] lookup VxfLookup instance to free, or NULL.
+ */
+void vxf_free_lookup(VxfLookup *lookup);
+
+/**
+ * @brief Options for @ref vxf_build_columns.
+ *
+ * Should be zero-initialized before setting individual fields.
+ */
+typedef struct VxfColumnsOptions {
+    unsigned thread_count;      /**< Maximum number of threads for sorting, see @ref vxf_sort_keys. */
+} VxfColumnsOptions;
+
+/**
+ * @brief Voxels with the same color index at consecutive z positions of a column.
+ */
+typedef struct VxfColumnRun {
+    int32_t z;                  /**< Position of the lowest voxel. */
+    uint16_t length;            /**< Number of voxels, at least 1. */
+    uint8_t coloridx;           /**< Color index of the voxels. */
+} VxfColumnRun;
+
+/**
+ * @brief The runs of voxels at an x, y position.
+ */
+typedef struct VxfColumn {
+    int32_t xy[2];              /**< Position of the column. */
+    uint32_t first_run;         /**< Index of the first run of the column in @ref VxfColumns.runs. */
+    uint32_t run_count;         /**< Number of runs, at least 1. */
+} VxfColumn;
+
+/**
+ * @brief Run-length encoded columns created by @ref vxf_build_columns.
+ */
+typedef struct VxfColumns {
+    size_t column_count;        /**< Number of columns. */
+    VxfColumn *columns;         /**< Columns that contain voxels, sorted by y and then x. */
+    size_t run_count;           /**< Number of runs. */
+    VxfColumnRun *runs;         /**< Runs of all columns in the order of the columns, each sorted by z. */
+} VxfColumns;
+
+/**
+ * @brief Creates a run-length encoding of the visible voxels as columns along z.
+ *
+ * Each column holds the runs of voxels at one x, y position; adjacent voxels with the same color index form a run,
+ * where runs of more than 65535 voxels are split. Where voxels overlap, the one read last is kept, as in @ref
+ * vxf_build_lookup. Runs are found once per model in model space and then placed for each visible instance, so the
+ * voxels are not sorted individually.
+ *
+ * Does not change the read position of @ref vxf_read. May fail with @ref VXF_ERROR_KEY_RANGE if the bounds are
+ * larger than 2^21 on any axis.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] options Column options, or NULL for the defaults.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return New columns, to be freed with @ref vxf_free_columns; NULL if an error has occurred.
+ */
+VxfColumns *vxf_build_columns(VxfFile *vf, const VxfColumnsOptions *options, VxfError *error);
+
+/**
+ * @brief Frees columns created by @ref vxf_build_columns.
+ *
+ * Can be called after the VxfFile instance has been closed.
+ *
+ * @param[in] columns Columns to free, or NULL.
+ */
+void vxf_free_columns(VxfColumns *columns);
+
+/**
+ * @brief Options for @ref vxf_build_components.
+ *
+ * Should be zero-initialized before setting individual fields.
+ */
+typedef struct VxfComponentsOptions {
+    unsigned connectivity;      /**< 6 to connect voxels that share a face, 26 to also connect voxels that share an
+                                     edge or a corner; 0 means 6. */
+    int separate_colors;        /**< Nonzero to only connect voxels with the same color index. */
+    unsigned thread_count;      /**< Maximum number of threads for sorting and labeling. */
+} VxfComponentsOptions;
+
+/**
+ * @brief A set of connected voxels.
+ */
+typedef struct VxfComponent {
+    int32_t min[3];             /**< Minimum coordinates of the voxels. */
+    int32_t max[3];             /**< Maximum coordinates of the voxels. */
+    uint32_t first_voxel;       /**< Index of the first voxel of the component in @ref VxfComponents.xyz. */
+    uint32_t voxel_count;       /**< Number of voxels, at least 1. */
+} VxfComponent;
+
+/**
+ * @brief Connected components created by @ref vxf_build_components.
+ */
+typedef struct VxfComponents {
+    size_t component_count;     /**< Number of components. */
+    VxfComponent *components;   /**< Components in the Morton order of their first voxels. */
+    size_t voxel_count;         /**< Number of voxels. */
+    int32_t (*xyz)[3];          /**< Positions of the voxels of all components in the order of the components,
+                                     each in Morton order. */
+    uint8_t *coloridx;          /**< Color index of each voxel. */
+} VxfComponents;
+
+/**
+ * @brief Splits the visible voxels into connected components, e.g. for the pieces of destructible objects.
+ *
+ * Where voxels overlap, the one read last is kept, as in @ref vxf_build_lookup. The voxels are stored in bricks of
+ * 8x8x8 positions and labeled with a union-find structure: with several threads, each labels a region of bricks in
+ * Morton order, and the pairs of adjacent voxels in different regions are joined afterwards. The result does not
+ * depend on the number of threads.
+ *
+ * All voxels are read into memory. Does not change the read position of @ref vxf_read. May fail with
+ * @ref VXF_ERROR_KEY_RANGE if the bounds are larger than 2^21 on any axis, or as described for @ref VxfKeyFormat.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] options Component options, or NULL for the defaults.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return New components, to be freed with @ref vxf_free_components; NULL if an error has occurred.
+ */
+VxfComponents *vxf_build_components(VxfFile *vf, const VxfComponentsOptions *options, VxfError *error);
+
+/**
+ * @brief Frees components created by @ref vxf_build_components.
+ *
+ * Can be called after the VxfFile instance has been closed.
+ *
+ * @param[in] components Components to free, or NULL.
+ */
+void vxf_free_components(VxfComponents *components);
+
+/**
+ * @brief Options for @ref vxf_build_boxes.
+ *
+ * Should be zero-initialized before setting individual fields.
+ */
+typedef struct VxfBoxesOptions {
+    int ignore_colors;          /**< Nonzero to merge voxels regardless of their color index, which results in fewer
+                                     boxes, e.g. for collision shapes; a box then has the color of its first voxel. */
+    unsigned thread_count;      /**< Maximum number of threads for decomposing models in parallel; 0 or 1 to use only
+                                     the calling thread. With more threads, the allocator must be thread-safe. */
+} VxfBoxesOptions;
+
+/**
+ * @brief An axis-aligned box of voxels.
+ */
+typedef struct VxfBox {
+    int32_t min[3];             /**< Position of the voxel at the minimum corner. */
+    int32_t max[3];             /**< Position of the voxel at the maximum corner. */
+    uint8_t coloridx;           /**< Color index of the voxels, see @ref VxfBoxesOptions::ignore_colors. */
+} VxfBox;
+
+/**
+ * @brief The boxes of a model.
+ */
+typedef struct VxfBoxModel {
+    uint32_t first_box;         /**< Index of the first box of the model in @ref VxfBoxes.boxes. */
+    uint32_t box_count;         /**< Number of boxes, 0 if the model is not used by a visible instance. */
+} VxfBoxModel;
+
+/**
+ * @brief A visible instance of a model, which places its boxes in the scene.
+ *
+ * A voxel at a model position p is at `rotation * p + translation` in the coordinates returned by @ref vxf_read.
+ */
+typedef struct VxfBoxInstance {
+    uint32_t instance_id;       /**< Model instance, numbered as in @ref vxf_read. */
+    uint32_t model;             /**< Index of the model in @ref VxfBoxes.models. */
+    int8_t rotation[3][3];      /**< Rotation matrix by rows, with one entry of 1 or -1 per row and column. */
+    int32_t translation[3];     /**< Translation. */
+} VxfBoxInstance;
+
+/**
+ * @brief Boxes created by @ref vxf_build_boxes.
+ */
+typedef struct VxfBoxes {
+    size_t model_count;         /**< Number of models of the file. */
+    VxfBoxModel *models;        /**< Models in the order of the file. */
+    size_t box_count;           /**< Number of boxes. */
+    VxfBox *boxes;              /**< Boxes in model space, grouped by model. */
+    size_t instance_count;      /**< Number of visible instances. */
+    VxfBoxInstance *instances;  /**< Visible instances in the order of @ref vxf_read. */
+} VxfBoxes;
+
+/**
+ * @brief Decomposes the visible voxels into axis-aligned boxes, e.g. for physics collision shapes.
+ *
+ * Each model used in the scene is decomposed once in model space: starting at the first voxel not covered yet, a
+ * box is extended along x, then y and then z as far as the voxels (of the same color) allow, which yields a small
+ * set of disjoint boxes. The boxes are instanced like the models: each visible instance refers to a model and its
+ * transform, which @ref vxf_transform_box applies. Where voxels of a model overlap, the one stored last is kept;
+ * boxes of different instances may overlap.
+ *
+ * Does not change the read position of @ref vxf_read.
+ *
+ * @param[in] vf VxfFile instance.
+ * @param[in] options Box options, or NULL for the defaults.
+ * @param[out] error Where to store the error code. May be NULL.
+ *
+ * @return New boxes, to be freed with @ref vxf_free_boxes; NULL if an error has occurred.
+ */
+VxfBoxes *vxf_build_boxes(VxfFile *vf, const VxfBoxesOptions *options, VxfError *error);
+
+/**
+ * @brief Places a box of a model in the scene.
+ *
+ * @param[in] instance Instance of the model.
+ * @param[in] box Box in model space.
+ * @param[out] result Box in the coordinates returned by @ref vxf_read. May be the same as `box`.
+ */
+void vxf_transform_box(const VxfBoxInstance *instance, const VxfBox *box, VxfBox *result);
+
+/**
+ * @brief Frees boxes created by @ref vxf_build_boxes.
+ *
+ * Can be called after the VxfFile instance has been closed.
+ *
+ * @param[in] boxes Boxes to free, or NULL.
+ */
+void vxf_free_boxes(VxfBoxes *boxes);
+
 /**
  * @brief Destroys a VxfFile instance.
  *
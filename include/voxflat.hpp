@@ -0,0 +1,248 @@
+#ifndef VOXFLAT_HPP
+#define VOXFLAT_HPP
+/**
+ * @file voxflat.hpp
+ * @brief Header-only C++20 wrapper for voxflat.h: a move-only file handle and typed batch reads into caller storage.
+ *
+ * Errors are reported through optional `VxfError` pointers as in the C API; no exceptions are thrown.
+ */
+#include <voxflat.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <utility>
+
+namespace voxflat {
+
+/**
+ * @brief Color output of a batch read.
+ */
+enum class ColorOutput {
+    none,   /**< Coordinates only. */
+    rgba,   /**< RGBA colors. */
+    index,  /**< Color indices. */
+};
+
+/**
+ * @brief Voxel record for reads into an array of structures (AoS).
+ */
+template <ColorOutput C> struct Voxel;
+
+template <> struct Voxel<ColorOutput::none> {
+    std::array<int32_t, 3> xyz;
+};
+
+template <> struct Voxel<ColorOutput::rgba> {
+    std::array<int32_t, 3> xyz;
+    std::array<uint8_t, 4> rgba;
+};
+
+template <> struct Voxel<ColorOutput::index> {
+    std::array<int32_t, 3> xyz;
+    uint8_t coloridx;
+};
+
+/**
+ * @brief Caller storage for reads into a structure of arrays (SoA).
+ *
+ * Only the spans for the selected color output are used; the capacity is the size of the smallest of them.
+ */
+template <ColorOutput C> struct Soa {
+    std::span<int32_t[3]> xyz;      /**< Voxel x, y, z coordinates. */
+    std::span<uint8_t[4]> rgba;     /**< RGBA colors, only for ColorOutput::rgba. */
+    std::span<uint8_t> coloridx;    /**< Color indices, only for ColorOutput::index. */
+
+    size_t capacity() const noexcept {
+        if constexpr (C == ColorOutput::rgba)
+            return std::min(xyz.size(), rgba.size());
+        else if constexpr (C == ColorOutput::index)
+            return std::min(xyz.size(), coloridx.size());
+        else
+            return xyz.size();
+    }
+
+    /** @brief Returns the first `count` entries of the used spans. */
+    Soa first(size_t count) const noexcept {
+        Soa result{xyz.first(count), {}, {}};
+        if constexpr (C == ColorOutput::rgba)
+            result.rgba = rgba.first(count);
+        if constexpr (C == ColorOutput::index)
+            result.coloridx = coloridx.first(count);
+        return result;
+    }
+};
+
+/**
+ * @brief Caller storage for reads into an array of structures (AoS).
+ */
+template <ColorOutput C> struct Aos {
+    std::span<Voxel<C>> voxels;
+
+    size_t capacity() const noexcept { return voxels.size(); }
+
+    /** @brief Returns the first `count` voxels. */
+    Aos first(size_t count) const noexcept { return Aos{voxels.first(count)}; }
+};
+
+/**
+ * @brief Reads up to `out.capacity()` voxels, continuing from the current read position.
+ *
+ * @return Number of voxels read, 0 at the end or if an error has occurred.
+ */
+template <ColorOutput C>
+size_t read(VxfFile *vf, const Soa<C> &out, VxfError *error = nullptr) noexcept {
+    VxfReadBuffers buffers{};
+    buffers.max_count = out.capacity();
+    buffers.xyz = out.xyz.data();
+    if constexpr (C == ColorOutput::rgba)
+        buffers.rgba = out.rgba.data();
+    if constexpr (C == ColorOutput::index)
+        buffers.coloridx = out.coloridx.data();
+    return vxf_read(vf, &buffers, nullptr, error);
+}
+
+/**
+ * @brief Reads up to `out.capacity()` voxels, continuing from the current read position.
+ *
+ * The C API is called several times for large storage. If a later call fails, the voxels of the earlier calls
+ * have already been consumed, so their number is returned together with the error.
+ *
+ * @return Number of voxels read, 0 at the end or if an error has occurred before any voxel was read.
+ */
+template <ColorOutput C>
+size_t read(VxfFile *vf, const Aos<C> &out, VxfError *error = nullptr) noexcept {
+    // the C API writes separate arrays, which are interleaved in chunks
+    constexpr size_t chunk = 256;
+    int32_t xyz[chunk][3];
+    [[maybe_unused]] uint8_t rgba[C == ColorOutput::rgba ? chunk : 1][4];
+    [[maybe_unused]] uint8_t coloridx[C == ColorOutput::index ? chunk : 1];
+    VxfError result = VXF_SUCCESS;
+    size_t total = 0;
+    while (total < out.voxels.size()) {
+        Soa<C> soa{std::span(xyz).first(std::min(chunk, out.voxels.size() - total)), {}, {}};
+        if constexpr (C == ColorOutput::rgba)
+            soa.rgba = rgba;
+        if constexpr (C == ColorOutput::index)
+            soa.coloridx = coloridx;
+        size_t n = read(vf, soa, &result);
+        for (size_t i = 0; i < n; i++) {
+            Voxel<C> &voxel = out.voxels[total + i];
+            std::copy_n(xyz[i], 3, voxel.xyz.begin());
+            if constexpr (C == ColorOutput::rgba)
+                std::copy_n(rgba[i], 4, voxel.rgba.begin());
+            if constexpr (C == ColorOutput::index)
+                voxel.coloridx = coloridx[i];
+        }
+        total += n;
+        if (n == 0)
+            break;
+    }
+    if (error) *error = result;
+    return total;
+}
+
+/**
+ * @brief Input range over consecutive batches read into the same caller storage.
+ *
+ * Each element is the storage truncated to the voxels of the batch, so iterating does not copy voxels. Reading
+ * the next batch overwrites the previous one. Iteration ends at the end of the voxels or at an error, which is
+ * available from error() afterwards.
+ */
+template <typename Storage> class BatchRange {
+public:
+    class iterator {
+    public:
+        using value_type = Storage;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() noexcept = default;
+        Storage operator*() const noexcept { return range_->storage_.first(range_->count_); }
+        iterator &operator++() noexcept { range_->next(); return *this; }
+        void operator++(int) noexcept { range_->next(); }
+        bool operator==(std::default_sentinel_t) const noexcept { return range_->count_ == 0; }
+
+    private:
+        friend class BatchRange;
+        explicit iterator(BatchRange *range) noexcept : range_(range) {}
+        BatchRange *range_ = nullptr;
+    };
+
+    BatchRange(VxfFile *vf, Storage storage) noexcept : vf_(vf), storage_(storage) {}
+
+    /** @brief Reads the first batch. */
+    iterator begin() noexcept { next(); return iterator(this); }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+    /** @brief Error of the last read. */
+    VxfError error() const noexcept { return error_; }
+
+private:
+    void next() noexcept { count_ = read(vf_, storage_, &error_); }
+
+    VxfFile *vf_;
+    Storage storage_;
+    size_t count_ = 0;
+    VxfError error_ = VXF_SUCCESS;
+};
+
+/**
+ * @brief Move-only owner of a VxfFile instance.
+ */
+class File {
+public:
+    File() noexcept = default;
+    /** @brief Takes ownership of an instance opened with the C API. */
+    explicit File(VxfFile *vf) noexcept : vf_(vf) {}
+    File(File &&other) noexcept : vf_(other.release()) {}
+    File &operator=(File &&other) noexcept {
+        if (this != &other)
+            reset(other.release());
+        return *this;
+    }
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+    ~File() { vxf_close(vf_); }
+
+    /** @brief See @ref vxf_open_file_ex; the result is empty if an error has occurred. */
+    static File open(const char *filename, VxfError *error = nullptr, const VxfOpenOptions *options = nullptr) noexcept {
+        return File(vxf_open_file_ex(filename, options, error));
+    }
+
+    /** @brief See @ref vxf_open_memory_ex; the data must be kept until the file is closed. */
+    static File open_memory(std::span<const char> data, VxfError *error = nullptr,
+                            const VxfOpenOptions *options = nullptr) noexcept {
+        return File(vxf_open_memory_ex(data.size(), data.data(), options, error));
+    }
+
+    explicit operator bool() const noexcept { return vf_ != nullptr; }
+    VxfFile *get() const noexcept { return vf_; }
+
+    /** @brief Releases ownership of the instance without closing it. */
+    VxfFile *release() noexcept { return std::exchange(vf_, nullptr); }
+
+    /** @brief Closes the current instance and takes ownership of another one. */
+    void reset(VxfFile *vf = nullptr) noexcept { vxf_close(std::exchange(vf_, vf)); }
+
+    uintmax_t count_voxels() const noexcept { return vxf_count_voxels(vf_); }
+
+    void calculate_bounds(int32_t xyz_min[3], int32_t xyz_max[3]) const noexcept {
+        vxf_calculate_bounds(vf_, xyz_min, xyz_max);
+    }
+
+    /** @brief Reads a batch, see voxflat::read. */
+    template <typename Storage>
+    size_t read(const Storage &out, VxfError *error = nullptr) noexcept { return voxflat::read(vf_, out, error); }
+
+    /** @brief Returns a range of batches read into `storage`, see BatchRange. */
+    template <typename Storage>
+    BatchRange<Storage> batches(const Storage &storage) noexcept { return BatchRange<Storage>(vf_, storage); }
+
+private:
+    VxfFile *vf_ = nullptr;
+};
+
+} // namespace voxflat
+
+#endif // VOXFLAT_HPP
@@ -0,0 +1,181 @@
+#include "boxes.h"
+#include "util.h"
+#include <string.h>
+
+#define MAX_MODEL_SIZE 256
+
+void boxes_scratch_free(struct boxes_scratch *scratch, const VxfAllocator *allocator) {
+    if (scratch->occupancy) {
+        allocator->free(allocator->user_data, scratch->occupancy,
+                        scratch->occupancy_capacity * sizeof *scratch->occupancy);
+    }
+    if (scratch->colors)
+        allocator->free(allocator->user_data, scratch->colors, scratch->grid_capacity);
+    *scratch = (struct boxes_scratch){0};
+}
+
+static bool scratch_reserve(struct boxes_scratch *scratch, const VxfAllocator *allocator, size_t words,
+                            size_t grid_size) {
+    if (words <= scratch->occupancy_capacity && grid_size <= scratch->grid_capacity)
+        return true;
+    words = MAX(words, scratch->occupancy_capacity);
+    grid_size = MAX(grid_size, scratch->grid_capacity);
+    boxes_scratch_free(scratch, allocator);
+    scratch->occupancy_capacity = words;
+    scratch->grid_capacity = grid_size;
+    scratch->occupancy = allocator->alloc(allocator->user_data, words * sizeof *scratch->occupancy);
+    scratch->colors = allocator->alloc(allocator->user_data, grid_size);
+    if (scratch->occupancy && scratch->colors)
+        return true;
+    boxes_scratch_free(scratch, allocator);
+    return false;
+}
+
+void boxes_output_free(struct boxes_output *out, const VxfAllocator *allocator) {
+    if (out->boxes)
+        allocator->free(allocator->user_data, out->boxes, out->capacity * sizeof *out->boxes);
+    *out = (struct boxes_output){0};
+}
+
+static bool append_box(struct boxes_output *out, const VxfAllocator *allocator, const VxfBox *box) {
+    if (out->count == out->capacity) {
+        size_t capacity = MAX(64, out->capacity * 2);
+        VxfBox *boxes = allocator->alloc(allocator->user_data, capacity * sizeof *boxes);
+        if (!boxes)
+            return false;
+        if (out->boxes) {
+            memcpy(boxes, out->boxes, out->count * sizeof *boxes);
+            allocator->free(allocator->user_data, out->boxes, out->capacity * sizeof *boxes);
+        }
+        out->boxes = boxes;
+        out->capacity = capacity;
+    }
+    out->boxes[out->count++] = *box;
+    return true;
+}
+
+// bits x to x + w - 1 of a row within word i
+static uint64_t range_mask(int x, int w, int i) {
+    int start = MAX(x - 64 * i, 0), end = MIN(x + w - 64 * i, 64);
+    if (start >= end)
+        return 0;
+    uint64_t high = end == 64 ? UINT64_MAX : (UINT64_C(1) << end) - 1;
+    return high & ~((UINT64_C(1) << start) - 1);
+}
+
+// the model with rows of occupancy bits along x
+struct box_grid {
+    int size[3];
+    int row_words;
+    uint64_t *occupancy;
+    const uint8_t *colors;
+    bool ignore_colors;
+};
+
+static uint64_t *grid_row(const struct box_grid *grid, int y, int z) {
+    return grid->occupancy + ((size_t)z * grid->size[1] + y) * grid->row_words;
+}
+
+static const uint8_t *grid_colors(const struct box_grid *grid, int y, int z) {
+    return grid->colors + ((size_t)z * grid->size[1] + y) * grid->size[0];
+}
+
+// true if the voxels x to x + w - 1 of a row are all present, and have the color index unless colors are ignored
+static bool span_filled(const struct box_grid *grid, int x, int w, int y, int z, uint8_t coloridx) {
+    const uint64_t *row = grid_row(grid, y, z);
+    for (int i = x / 64; i <= (x + w - 1) / 64; i++) {
+        uint64_t mask = range_mask(x, w, i);
+        if ((row[i] & mask) != mask)
+            return false;
+    }
+    if (grid->ignore_colors)
+        return true;
+    const uint8_t *colors = grid_colors(grid, y, z);
+    for (int i = x; i < x + w; i++) {
+        if (colors[i] != coloridx)
+            return false;
+    }
+    return true;
+}
+
+// number of voxels from x on in a row that could be part of the same box
+static int run_length(const struct box_grid *grid, int x, int y, int z, uint8_t coloridx) {
+    const uint64_t *row = grid_row(grid, y, z);
+    int end = x;
+    for (int i = x / 64; i < grid->row_words; i++) {
+        uint64_t gaps = ~row[i] & ~range_mask(0, x, i);
+        if (gaps) {
+            end = 64 * i + (int)lowest_bit(gaps);
+            break;
+        }
+        end = 64 * (i + 1);
+    }
+    end = MIN(end, grid->size[0]);
+    if (!grid->ignore_colors) {
+        const uint8_t *colors = grid_colors(grid, y, z);
+        for (int i = x + 1; i < end; i++) {
+            if (colors[i] != coloridx)
+                return i - x;
+        }
+    }
+    return end - x;
+}
+
+VxfError boxes_model(struct boxes_output *out, struct boxes_scratch *scratch, const VxfAllocator *allocator,
+                     const uint32_t model_size[3], const uint8_t (*xyzi)[4], size_t count, const uint64_t color_mask[4],
+                     bool ignore_colors) {
+    struct box_grid grid = {.ignore_colors = ignore_colors};
+    for (int i = 0; i < 3; i++)
+        grid.size[i] = (int)CLAMP(model_size[i], 1, MAX_MODEL_SIZE);
+    grid.row_words = (grid.size[0] + 63) / 64;
+    size_t rows = (size_t)grid.size[1] * grid.size[2];
+    if (!scratch_reserve(scratch, allocator, rows * grid.row_words, rows * grid.size[0]))
+        return VXF_ERROR_OUT_OF_MEMORY;
+    grid.occupancy = scratch->occupancy;
+    grid.colors = scratch->colors;
+
+    memset(grid.occupancy, 0, rows * grid.row_words * sizeof *grid.occupancy);
+    for (size_t i = 0; i < count; i++) {
+        int x = xyzi[i][0], y = xyzi[i][1], z = xyzi[i][2];
+        if (x >= grid.size[0] || y >= grid.size[1] || z >= grid.size[2])
+            continue;
+        if (color_mask && !(color_mask[xyzi[i][3] / 64] >> (xyzi[i][3] % 64) & 1))
+            continue;
+        grid_row(&grid, y, z)[x / 64] |= UINT64_C(1) << (x % 64);
+        scratch->colors[((size_t)z * grid.size[1] + y) * grid.size[0] + x] = xyzi[i][3];
+    }
+
+    // each box starts at the first voxel not covered yet, and is extended along x, then y, then z as far as possible;
+    // its voxels are then removed from the occupancy
+    for (int z = 0; z < grid.size[2]; z++) {
+        for (int y = 0; y < grid.size[1]; y++) {
+            uint64_t *row = grid_row(&grid, y, z);
+            for (int i = 0; i < grid.row_words; i++) {
+                while (row[i]) {
+                    int x = 64 * i + (int)lowest_bit(row[i]);
+                    uint8_t coloridx = grid_colors(&grid, y, z)[x];
+                    int w = run_length(&grid, x, y, z, coloridx), h = 1, d = 1;
+                    while (y + h < grid.size[1] && span_filled(&grid, x, w, y + h, z, coloridx))
+                        h++;
+                    for (bool filled = true; filled && z + d < grid.size[2]; d += filled) {
+                        for (int j = 0; j < h && filled; j++)
+                            filled = span_filled(&grid, x, w, y + j, z + d, coloridx);
+                    }
+                    for (int k = 0; k < d; k++) {
+                        for (int j = 0; j < h; j++) {
+                            uint64_t *r = grid_row(&grid, y + j, z + k);
+                            for (int word = x / 64; word <= (x + w - 1) / 64; word++)
+                                r[word] &= ~range_mask(x, w, word);
+                        }
+                    }
+                    VxfBox box = {
+                        .min = {x, y, z}, .max = {x + w - 1, y + h - 1, z + d - 1}, .coloridx = coloridx,
+                    };
+                    if (!append_box(out, allocator, &box))
+                        return VXF_ERROR_OUT_OF_MEMORY;
+                }
+            }
+        }
+    }
+    return VXF_SUCCESS;
+}
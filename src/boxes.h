@@ -0,0 +1,31 @@
+#ifndef VOXFLAT_BOXES_H
+#define VOXFLAT_BOXES_H
+// Greedy decomposition of single models into boxes in model space, independent of the file and scene structures.
+#include <voxflat.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// boxes of a model; allocated with the allocator passed to boxes_model
+struct boxes_output {
+    VxfBox *boxes;
+    size_t count, capacity;
+};
+
+// occupancy with rows of whole words along x, and colors of a model, grown as needed
+struct boxes_scratch {
+    uint64_t *occupancy;
+    uint8_t *colors;
+    size_t occupancy_capacity, grid_capacity;
+};
+
+void boxes_scratch_free(struct boxes_scratch *scratch, const VxfAllocator *allocator);
+
+// appends disjoint boxes that cover the voxels of a model to out; voxels outside of the model size or with a color
+// index not in color_mask (if not NULL) are ignored, and a voxel replaces earlier ones at the same position.
+// ignore_colors: boxes may contain voxels of different colors, and have the color index of their first voxel.
+VxfError boxes_model(struct boxes_output *out, struct boxes_scratch *scratch, const VxfAllocator *allocator,
+    const uint32_t model_size[3], const uint8_t (*xyzi)[4], size_t count, const uint64_t color_mask[4],
+    bool ignore_colors);
+void boxes_output_free(struct boxes_output *out, const VxfAllocator *allocator);
+
+#endif
@@ -0,0 +1,30 @@
+#include "bricks.h"
+#include <voxflat.h>
+
+void count_bricks(const uint64_t *keys, size_t count, size_t *brick_count, size_t *voxel_count,
+                  struct brick_table *table) {
+    *brick_count = 0, *voxel_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        *voxel_count += i == 0 || keys[i] != keys[i - 1];
+        *brick_count += i == 0 || !same_brick(keys[i], keys[i - 1]);
+    }
+    unsigned slot_bits = 1;
+    while (slot_bits < sizeof(size_t) * 8 - 1 && ((size_t)1 << slot_bits) / 2 < *brick_count)
+        slot_bits++;
+    *table = (struct brick_table){.slot_count = (size_t)1 << slot_bits, .slot_shift = 64 - slot_bits};
+}
+
+void brick_table_clear(struct brick_table *table) {
+    for (size_t i = 0; i < table->slot_count; i++)
+        table->slots[i] = (struct brick_slot){.key = EMPTY_SLOT};
+}
+
+void brick_table_insert(struct brick_table *table, uint64_t morton_key, uint32_t brick_idx) {
+    int32_t pos[3];
+    vxf_decode_key(morton_key, VXF_KEY_FORMAT_MORTON, (const int32_t[3]){0, 0, 0}, pos);
+    uint64_t key = brick_key((const uint32_t[3]){(uint32_t)pos[0], (uint32_t)pos[1], (uint32_t)pos[2]});
+    size_t slot = brick_slot_index(table, key);
+    while (table->slots[slot].key != EMPTY_SLOT)
+        slot = (slot + 1) & (table->slot_count - 1);
+    table->slots[slot] = (struct brick_slot){.key = key, .brick_idx = brick_idx};
+}
@@ -0,0 +1,70 @@
+#ifndef VOXFLAT_BRICKS_H
+#define VOXFLAT_BRICKS_H
+// Bricks of 8x8x8 positions of voxels sorted by Morton key and a hash table mapping brick coordinates to bricks,
+// shared by the lookup and the connected components. The bit order within a brick is left to the users.
+#include "util.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BRICK_BITS 3 // bricks of 8x8x8 voxels
+#define BRICK_AXIS_BITS (KEY_AXIS_BITS - BRICK_BITS)
+#define EMPTY_SLOT UINT64_MAX
+
+struct brick_slot {
+    uint64_t key; // brick coordinates from brick_key, or EMPTY_SLOT
+    uint32_t brick_idx;
+};
+
+// hash table of bricks with linear probing, at most half full; the slots are allocated by the user
+struct brick_table {
+    struct brick_slot *slots;
+    size_t slot_count;
+    unsigned slot_shift; // 64 - log2 of the number of slots
+};
+
+// rel: position relative to the origin, each within [0, 2^KEY_AXIS_BITS)
+static inline uint64_t brick_key(const uint32_t rel[3]) {
+    return (uint64_t)(rel[0] >> BRICK_BITS) | (uint64_t)(rel[1] >> BRICK_BITS) << BRICK_AXIS_BITS
+        | (uint64_t)(rel[2] >> BRICK_BITS) << 2 * BRICK_AXIS_BITS;
+}
+
+// Morton keys in the same brick are equal apart from the lowest 3 bits per axis
+static inline bool same_brick(uint64_t a, uint64_t b) {
+    return a >> 3 * BRICK_BITS == b >> 3 * BRICK_BITS;
+}
+
+static inline size_t brick_slot_index(const struct brick_table *table, uint64_t key) {
+    return (size_t)(key * UINT64_C(0x9e3779b97f4a7c15) >> table->slot_shift);
+}
+
+// returns the brick index, or UINT32_MAX if there is no brick with the key
+static inline uint32_t brick_table_find(const struct brick_table *table, uint64_t key) {
+    for (size_t slot = brick_slot_index(table, key);; slot = (slot + 1) & (table->slot_count - 1)) {
+        if (table->slots[slot].key == key)
+            return table->slots[slot].brick_idx;
+        if (table->slots[slot].key == EMPTY_SLOT)
+            return UINT32_MAX;
+    }
+}
+
+// counts the bricks and distinct positions of sorted Morton keys, and sets the number of slots of a table for them
+void count_bricks(const uint64_t *keys, size_t count, size_t *brick_count, size_t *voxel_count,
+    struct brick_table *table);
+
+// empties a table whose slots have been allocated
+void brick_table_clear(struct brick_table *table);
+
+// adds the brick that contains the voxel with a Morton key relative to the origin
+void brick_table_insert(struct brick_table *table, uint64_t morton_key, uint32_t brick_idx);
+
+// Of the voxels at the position of keys[*pos], returns the index of the one read last, which replaces the others,
+// and advances *pos past them. order: read order of each key.
+static inline size_t take_latest_voxel(const uint64_t *keys, const uint32_t *order, size_t count, size_t *pos) {
+    size_t latest = *pos;
+    for (size_t i = (*pos)++; *pos < count && keys[*pos] == keys[i]; (*pos)++)
+        latest = order[*pos] > order[latest] ? *pos : latest;
+    return latest;
+}
+
+#endif
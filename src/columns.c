@@ -0,0 +1,266 @@
+#include "columns.h"
+#include "util.h"
+#include <string.h>
+#include <assert.h>
+
+#define Z_MASK ((UINT64_C(1) << COLUMNS_AXIS_BITS) - 1)
+
+void columns_scratch_free(struct columns_scratch *scratch, const VxfAllocator *allocator) {
+    if (scratch->occupancy)
+        allocator->free(allocator->user_data, scratch->occupancy, (scratch->grid_capacity + 63) / 64 * sizeof *scratch->occupancy);
+    if (scratch->colors)
+        allocator->free(allocator->user_data, scratch->colors, scratch->grid_capacity);
+    *scratch = (struct columns_scratch){0};
+}
+
+static bool scratch_reserve(struct columns_scratch *scratch, const VxfAllocator *allocator, size_t grid_size) {
+    if (grid_size <= scratch->grid_capacity)
+        return true;
+    columns_scratch_free(scratch, allocator);
+    scratch->grid_capacity = grid_size;
+    scratch->occupancy = allocator->alloc(allocator->user_data, (grid_size + 63) / 64 * sizeof *scratch->occupancy);
+    scratch->colors = allocator->alloc(allocator->user_data, grid_size);
+    if (scratch->occupancy && scratch->colors)
+        return true;
+    columns_scratch_free(scratch, allocator);
+    return false;
+}
+
+void model_runs_free(struct model_runs *runs, const VxfAllocator *allocator) {
+    if (runs->runs)
+        allocator->free(allocator->user_data, runs->runs, runs->capacity * sizeof *runs->runs);
+    *runs = (struct model_runs){0};
+}
+
+static bool append_run(struct model_runs *out, const VxfAllocator *allocator, const struct model_run *run) {
+    if (out->count == out->capacity) {
+        size_t capacity = MAX(64, out->capacity * 2);
+        struct model_run *runs = allocator->alloc(allocator->user_data, capacity * sizeof *runs);
+        if (!runs)
+            return false;
+        if (out->runs) {
+            memcpy(runs, out->runs, out->count * sizeof *runs);
+            allocator->free(allocator->user_data, out->runs, out->capacity * sizeof *runs);
+        }
+        out->runs = runs;
+        out->capacity = capacity;
+    }
+    out->runs[out->count++] = *run;
+    return true;
+}
+
+VxfError columns_model_runs(struct model_runs out[3], struct columns_scratch *scratch, const VxfAllocator *allocator,
+                            const uint8_t (*xyzi)[4], size_t count, const uint64_t color_mask[4], unsigned axis_mask,
+                            int size[3]) {
+    size[0] = size[1] = size[2] = 1;
+    for (size_t i = 0; i < count; i++) {
+        for (int j = 0; j < 3; j++)
+            size[j] = MAX(size[j], xyzi[i][j] + 1);
+    }
+    size_t grid_size = (size_t)size[0] * size[1] * size[2];
+    if (!scratch_reserve(scratch, allocator, grid_size))
+        return VXF_ERROR_OUT_OF_MEMORY;
+
+    uint64_t *occupancy = scratch->occupancy;
+    uint8_t *colors = scratch->colors;
+    memset(occupancy, 0, (grid_size + 63) / 64 * sizeof *occupancy);
+    for (size_t i = 0; i < count; i++) {
+        if (color_mask && !(color_mask[xyzi[i][3] / 64] >> (xyzi[i][3] % 64) & 1))
+            continue;
+        size_t idx = ((size_t)xyzi[i][2] * size[1] + xyzi[i][1]) * size[0] + xyzi[i][0];
+        occupancy[idx / 64] |= UINT64_C(1) << (idx % 64);
+        colors[idx] = xyzi[i][3];
+    }
+
+    const size_t stride[3] = {1, (size_t)size[0], (size_t)size[0] * size[1]};
+    for (int d = 0; d < 3; d++) {
+        if (!(axis_mask >> d & 1))
+            continue;
+        int u = (d + 1) % 3, v = (d + 2) % 3;
+        for (int j = 0; j < size[v]; j++) {
+            for (int i = 0; i < size[u]; i++) {
+                size_t idx = i * stride[u] + j * stride[v];
+                struct model_run run = {.uv = {(uint8_t)i, (uint8_t)j}};
+                for (int k = 0; k <= size[d]; k++, idx += stride[d]) {
+                    bool filled = k < size[d] && occupancy[idx / 64] >> (idx % 64) & 1;
+                    if (run.length > 0 && (!filled || colors[idx] != run.coloridx)) {
+                        if (!append_run(&out[d], allocator, &run))
+                            return VXF_ERROR_OUT_OF_MEMORY;
+                        run.length = 0;
+                    }
+                    if (filled && run.length++ == 0) {
+                        run.start = (uint8_t)k;
+                        run.coloridx = colors[idx];
+                    }
+                }
+            }
+        }
+    }
+    return VXF_SUCCESS;
+}
+
+// max-heap of key positions by their order, i.e. the run placed last is on top
+struct run_heap {
+    uint32_t *items;
+    size_t count;
+    const uint32_t *order;
+};
+
+static void heap_push(struct run_heap *heap, uint32_t pos) {
+    size_t i = heap->count++;
+    for (; i > 0 && heap->order[heap->items[(i - 1) / 2]] < heap->order[pos]; i = (i - 1) / 2)
+        heap->items[i] = heap->items[(i - 1) / 2];
+    heap->items[i] = pos;
+}
+
+static void heap_pop(struct run_heap *heap) {
+    uint32_t last = heap->items[--heap->count];
+    size_t i = 0;
+    for (size_t child; (child = 2 * i + 1) < heap->count; i = child) {
+        if (child + 1 < heap->count && heap->order[heap->items[child + 1]] > heap->order[heap->items[child]])
+            child++;
+        if (heap->order[heap->items[child]] < heap->order[last])
+            break;
+        heap->items[i] = heap->items[child];
+    }
+    heap->items[i] = last;
+}
+
+// collects the runs of a column; voxels that continue the pending run are added to it
+struct column_writer {
+    VxfColumnRun *runs; // NULL to count the runs only
+    size_t count;
+    VxfColumnRun pending; // not written yet, empty if its length is 0
+};
+
+static void flush_run(struct column_writer *w) {
+    if (w->pending.length == 0)
+        return;
+    if (w->runs)
+        w->runs[w->count] = w->pending;
+    w->count++;
+    w->pending.length = 0;
+}
+
+static void add_voxels(struct column_writer *w, int32_t z, uint32_t length, uint8_t coloridx) {
+    VxfColumnRun *run = &w->pending;
+    while (length > 0) {
+        if (run->length == 0 || run->coloridx != coloridx || (int64_t)run->z + run->length != z
+                || run->length == UINT16_MAX) {
+            flush_run(w);
+            *run = (VxfColumnRun){.z = z, .coloridx = coloridx};
+        }
+        uint32_t n = MIN(length, (uint32_t)(UINT16_MAX - run->length));
+        run->length = (uint16_t)(run->length + n);
+        z += (int32_t)n, length -= n;
+    }
+}
+
+// adds the visible voxels of the runs with keys from begin to end, which are in the same column; where runs
+// overlap, the one with the highest order wins
+static void merge_column(struct column_writer *w, struct run_heap *heap, const uint64_t *keys, const uint32_t *order,
+                         const uint16_t *lengths, const uint8_t *colors, size_t begin, size_t end, int32_t origin_z) {
+    size_t next = begin;
+    uint32_t z = 0;
+    heap->count = 0;
+    while (next < end || heap->count > 0) {
+        if (heap->count == 0)
+            z = (uint32_t)(keys[next] & Z_MASK);
+        for (; next < end && (keys[next] & Z_MASK) <= z; next++)
+            heap_push(heap, (uint32_t)next);
+        // runs that have ended are only removed when they reach the top
+        while (heap->count > 0 && (keys[heap->items[0]] & Z_MASK) + lengths[order[heap->items[0]]] <= z)
+            heap_pop(heap);
+        if (heap->count == 0)
+            continue;
+        uint32_t top = heap->items[0];
+        uint32_t stop = (uint32_t)(keys[top] & Z_MASK) + lengths[order[top]];
+        if (next < end)
+            stop = MIN(stop, (uint32_t)(keys[next] & Z_MASK));
+        add_voxels(w, origin_z + (int32_t)z, stop - z, colors[order[top]]);
+        z = stop;
+    }
+    flush_run(w);
+}
+
+// the columns and their runs are a single allocation
+struct columns_allocation {
+    VxfColumns columns;
+    VxfAllocator allocator;
+    size_t size;
+};
+
+VxfColumns *columns_create(const VxfAllocator *allocator, const int32_t origin[3], const uint64_t *keys,
+                           const uint32_t *order, const uint16_t *lengths, const uint8_t *colors, size_t count,
+                           VxfError *error) {
+    assert(count <= UINT32_MAX);
+    size_t column_count = 0, max_column_size = 0;
+    for (size_t begin = 0, end; begin < count; begin = end) {
+        for (end = begin + 1; end < count && keys[end] >> COLUMNS_AXIS_BITS == keys[begin] >> COLUMNS_AXIS_BITS;)
+            end++;
+        column_count++;
+        max_column_size = MAX(max_column_size, end - begin);
+    }
+    struct run_heap heap = {.order = order};
+    struct columns_allocation *allocation = NULL;
+    VxfError result = VXF_SUCCESS;
+    if (max_column_size > 0 && !(heap.items = allocator->alloc(allocator->user_data, max_column_size * sizeof *heap.items))) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+
+    // the runs are counted in a first pass, and written in a second one
+    struct column_writer w = {0};
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            if (w.count > UINT32_MAX || w.count > (SIZE_MAX - sizeof *allocation - column_count * sizeof(VxfColumn))
+                                                  / sizeof(VxfColumnRun)) {
+                result = VXF_ERROR_OUT_OF_MEMORY;
+                goto cleanup;
+            }
+            size_t size = sizeof *allocation + column_count * sizeof(VxfColumn) + w.count * sizeof(VxfColumnRun);
+            if (!(allocation = allocator->alloc(allocator->user_data, size))) {
+                result = VXF_ERROR_OUT_OF_MEMORY;
+                goto cleanup;
+            }
+            VxfColumn *columns = (VxfColumn*)(allocation + 1);
+            *allocation = (struct columns_allocation){
+                .columns = {
+                    .column_count = column_count, .columns = columns,
+                    .run_count = w.count, .runs = (VxfColumnRun*)(columns + column_count),
+                },
+                .allocator = *allocator, .size = size,
+            };
+            w = (struct column_writer){.runs = allocation->columns.runs};
+        }
+        size_t column_idx = 0;
+        for (size_t begin = 0, end; begin < count; begin = end) {
+            for (end = begin + 1; end < count && keys[end] >> COLUMNS_AXIS_BITS == keys[begin] >> COLUMNS_AXIS_BITS;)
+                end++;
+            size_t first_run = w.count;
+            merge_column(&w, &heap, keys, order, lengths, colors, begin, end, origin[2]);
+            if (pass == 1) {
+                allocation->columns.columns[column_idx++] = (VxfColumn){
+                    .xy = {
+                        origin[0] + (int32_t)(keys[begin] >> COLUMNS_AXIS_BITS & Z_MASK),
+                        origin[1] + (int32_t)(keys[begin] >> 2 * COLUMNS_AXIS_BITS),
+                    },
+                    .first_run = (uint32_t)first_run, .run_count = (uint32_t)(w.count - first_run),
+                };
+            }
+        }
+    }
+
+cleanup:
+    if (heap.items)
+        allocator->free(allocator->user_data, heap.items, max_column_size * sizeof *heap.items);
+    if (error) *error = result;
+    return result ? NULL : &allocation->columns;
+}
+
+void vxf_free_columns(VxfColumns *columns) {
+    if (!columns) return;
+    struct columns_allocation *allocation = (struct columns_allocation*)columns;
+    VxfAllocator allocator = allocation->allocator;
+    allocator.free(allocator.user_data, allocation, allocation->size);
+}
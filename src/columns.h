@@ -0,0 +1,46 @@
+#ifndef VOXFLAT_COLUMNS_H
+#define VOXFLAT_COLUMNS_H
+// Run-length encoded columns, built from runs along an axis within single models, independent of the file and scene
+// structures.
+#include <voxflat.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define COLUMNS_AXIS_BITS 21 // per axis in the keys passed to columns_create
+
+// voxels with the same color index at consecutive positions along an axis of a model
+struct model_run {
+    uint8_t uv[2]; // position along the axes (axis + 1) % 3 and (axis + 2) % 3
+    uint8_t start; // position along the axis
+    uint8_t coloridx;
+    uint16_t length;
+};
+
+// runs of a model along an axis, grouped by uv; allocated with the allocator passed to columns_model_runs
+struct model_runs {
+    struct model_run *runs;
+    size_t count, capacity;
+};
+
+// occupancy and colors of a model, grown as needed
+struct columns_scratch {
+    uint64_t *occupancy;
+    uint8_t *colors;
+    size_t grid_capacity;
+};
+
+void columns_scratch_free(struct columns_scratch *scratch, const VxfAllocator *allocator);
+
+// appends the runs of a model along each axis in axis_mask (bit n for axis n) to out[axis]; voxels with a color index
+// not in color_mask (if not NULL) are ignored, and a voxel replaces earlier ones at the same position. Stores the
+// size of the model, which covers all of its voxels.
+VxfError columns_model_runs(struct model_runs out[3], struct columns_scratch *scratch, const VxfAllocator *allocator,
+    const uint8_t (*xyzi)[4], size_t count, const uint64_t color_mask[4], unsigned axis_mask, int size[3]);
+void model_runs_free(struct model_runs *runs, const VxfAllocator *allocator);
+
+// keys: (y << 2 * COLUMNS_AXIS_BITS) | (x << COLUMNS_AXIS_BITS) | z of the first voxel of each run relative to origin,
+// sorted; order: position of each key in the scene, where later runs replace earlier ones; lengths and colors: by order.
+VxfColumns *columns_create(const VxfAllocator *allocator, const int32_t origin[3], const uint64_t *keys,
+    const uint32_t *order, const uint16_t *lengths, const uint8_t *colors, size_t count, VxfError *error);
+
+#endif
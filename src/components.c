@@ -0,0 +1,283 @@
+#include "components.h"
+#include "bricks.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_VOXEL UINT32_MAX
+
+// occupancy of a brick with the lowest 9 bits of the Morton key as bit index, so that the distinct voxels of the
+// brick are in the order of their bits
+struct components_brick {
+    uint64_t occupancy[8];
+    uint32_t first; // index of the first voxel of the brick
+};
+
+// the lowest 9 bits of the Morton key of a position
+static unsigned brick_bit(const int32_t pos[3]) {
+    unsigned bit = 0;
+    for (int i = 0; i < 3; i++) {
+        unsigned v = (unsigned)pos[i] & 7;
+        bit |= ((v & 1) | (v & 2) << 2 | (v & 4) << 4) << i;
+    }
+    return bit;
+}
+
+void components_grid_free(struct components_grid *grid, const VxfAllocator *allocator) {
+    if (grid->keys)
+        allocator->free(allocator->user_data, grid->keys, grid->count * sizeof *grid->keys);
+    if (grid->colors)
+        allocator->free(allocator->user_data, grid->colors, grid->count);
+    if (grid->parent)
+        allocator->free(allocator->user_data, grid->parent, grid->count * sizeof *grid->parent);
+    if (grid->bricks)
+        allocator->free(allocator->user_data, grid->bricks, grid->brick_count * sizeof *grid->bricks);
+    if (grid->table.slots)
+        allocator->free(allocator->user_data, grid->table.slots, grid->table.slot_count * sizeof *grid->table.slots);
+    *grid = (struct components_grid){0};
+}
+
+VxfError components_grid_init(struct components_grid *grid, const VxfAllocator *allocator,
+                              const uint64_t *keys, const uint32_t *order, const uint8_t *colors, size_t count) {
+    size_t voxel_count, brick_count;
+    struct brick_table table;
+    count_bricks(keys, count, &brick_count, &voxel_count, &table);
+    *grid = (struct components_grid){.count = voxel_count, .brick_count = brick_count, .table = table};
+    if (voxel_count >= NO_VOXEL || table.slot_count > SIZE_MAX / sizeof *table.slots)
+        return VXF_ERROR_OUT_OF_MEMORY;
+    grid->keys = allocator->alloc(allocator->user_data, voxel_count * sizeof *grid->keys);
+    grid->colors = allocator->alloc(allocator->user_data, voxel_count);
+    grid->parent = allocator->alloc(allocator->user_data, voxel_count * sizeof *grid->parent);
+    grid->bricks = allocator->alloc(allocator->user_data, brick_count * sizeof *grid->bricks);
+    grid->table.slots = allocator->alloc(allocator->user_data, table.slot_count * sizeof *table.slots);
+    if (!grid->table.slots || (voxel_count > 0 && (!grid->keys || !grid->colors || !grid->parent || !grid->bricks))) {
+        components_grid_free(grid, allocator);
+        return VXF_ERROR_OUT_OF_MEMORY;
+    }
+    brick_table_clear(&grid->table);
+
+    size_t brick_idx = 0, n = 0;
+    for (size_t start = 0, end; start < count; start = end, brick_idx++) {
+        struct components_brick *brick = &grid->bricks[brick_idx];
+        *brick = (struct components_brick){.first = (uint32_t)n};
+        for (end = start; end < count && same_brick(keys[end], keys[start]); n++) {
+            size_t latest = take_latest_voxel(keys, order, count, &end);
+            unsigned bit = (unsigned)(keys[latest] & 511);
+            brick->occupancy[bit / 64] |= UINT64_C(1) << bit % 64;
+            grid->keys[n] = keys[latest];
+            grid->colors[n] = colors[order[latest]];
+        }
+        brick_table_insert(&grid->table, keys[start], (uint32_t)brick_idx);
+    }
+    return VXF_SUCCESS;
+}
+
+size_t components_region_start(const struct components_grid *grid, size_t i, size_t region_count) {
+    if (i >= region_count)
+        return grid->count;
+    // first brick that starts at or after an even share of the voxels
+    size_t target = (size_t)((uint64_t)grid->count * i / region_count), low = 0, high = grid->brick_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (grid->bricks[mid].first < target)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low < grid->brick_count ? grid->bricks[low].first : grid->count;
+}
+
+// the brick with the key, or NULL; the last brick found is tried first, since neighbors are mostly in the same one
+static const struct components_brick *find_brick(const struct components_grid *grid, uint64_t key,
+                                                 uint64_t *last_key, const struct components_brick **last_brick) {
+    if (key == *last_key)
+        return *last_brick;
+    uint32_t brick_idx = brick_table_find(&grid->table, key);
+    *last_key = key;
+    *last_brick = brick_idx != UINT32_MAX ? &grid->bricks[brick_idx] : NULL;
+    return *last_brick;
+}
+
+// index of the voxel at a position relative to the origin, or NO_VOXEL
+static uint32_t find_voxel(const struct components_grid *grid, const int32_t pos[3], uint64_t *last_key,
+                           const struct components_brick **last_brick) {
+    for (int i = 0; i < 3; i++) {
+        if (pos[i] < 0 || pos[i] >= INT32_C(1) << KEY_AXIS_BITS)
+            return NO_VOXEL;
+    }
+    const uint32_t rel[3] = {(uint32_t)pos[0], (uint32_t)pos[1], (uint32_t)pos[2]};
+    const struct components_brick *brick = find_brick(grid, brick_key(rel), last_key, last_brick);
+    if (!brick)
+        return NO_VOXEL;
+    unsigned bit = brick_bit(pos);
+    uint64_t word = brick->occupancy[bit / 64];
+    if (!(word >> bit % 64 & 1))
+        return NO_VOXEL;
+    uint32_t rank = brick->first + popcount64(word & ((UINT64_C(1) << bit % 64) - 1));
+    for (unsigned w = 0; w < bit / 64; w++)
+        rank += popcount64(brick->occupancy[w]);
+    return rank;
+}
+
+// root of a voxel, with path halving
+static uint32_t find_root(uint32_t *parent, uint32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// the lower root becomes the parent, so that parents are never higher than their children
+static void join(uint32_t *parent, uint32_t a, uint32_t b) {
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if (a < b)
+        parent[b] = a;
+    else if (b < a)
+        parent[a] = b;
+}
+
+// offsets to the neighbors that follow a voxel, so that each pair of neighbors is visited once
+static unsigned neighbor_offsets(unsigned connectivity, int offsets[13][3]) {
+    unsigned count = 0;
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                bool follows = dz > 0 || (dz == 0 && (dy > 0 || (dy == 0 && dx > 0)));
+                if (follows && (connectivity == 26 || abs(dx) + abs(dy) + abs(dz) == 1)) {
+                    offsets[count][0] = dx, offsets[count][1] = dy, offsets[count][2] = dz;
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+void component_edges_free(struct component_edges *edges, const VxfAllocator *allocator) {
+    if (edges->pairs)
+        allocator->free(allocator->user_data, edges->pairs, edges->capacity * sizeof *edges->pairs);
+    *edges = (struct component_edges){0};
+}
+
+static bool append_edge(struct component_edges *edges, const VxfAllocator *allocator, uint32_t a, uint32_t b) {
+    if (edges->count == edges->capacity) {
+        size_t capacity = MAX(64, edges->capacity * 2);
+        uint32_t (*pairs)[2] = allocator->alloc(allocator->user_data, capacity * sizeof *pairs);
+        if (!pairs)
+            return false;
+        if (edges->pairs) {
+            memcpy(pairs, edges->pairs, edges->count * sizeof *pairs);
+            allocator->free(allocator->user_data, edges->pairs, edges->capacity * sizeof *pairs);
+        }
+        edges->pairs = pairs;
+        edges->capacity = capacity;
+    }
+    edges->pairs[edges->count][0] = a;
+    edges->pairs[edges->count++][1] = b;
+    return true;
+}
+
+VxfError components_label_region(struct components_grid *grid, const VxfAllocator *allocator, size_t begin,
+                                 size_t end, unsigned connectivity, bool separate_colors,
+                                 struct component_edges *edges) {
+    int offsets[13][3];
+    unsigned offset_count = neighbor_offsets(connectivity, offsets);
+    uint32_t *parent = grid->parent;
+    for (size_t i = begin; i < end; i++)
+        parent[i] = (uint32_t)i;
+
+    uint64_t last_key = EMPTY_SLOT;
+    const struct components_brick *last_brick = NULL;
+    for (size_t i = begin; i < end; i++) {
+        int32_t pos[3];
+        vxf_decode_key(grid->keys[i], VXF_KEY_FORMAT_MORTON, (const int32_t[3]){0, 0, 0}, pos);
+        for (unsigned k = 0; k < offset_count; k++) {
+            int32_t neighbor[3] = {pos[0] + offsets[k][0], pos[1] + offsets[k][1], pos[2] + offsets[k][2]};
+            uint32_t j = find_voxel(grid, neighbor, &last_key, &last_brick);
+            if (j == NO_VOXEL || (separate_colors && grid->colors[j] != grid->colors[i]))
+                continue;
+            if (j >= begin && j < end)
+                join(parent, (uint32_t)i, j);
+            else if (!append_edge(edges, allocator, (uint32_t)i, j))
+                return VXF_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    return VXF_SUCCESS;
+}
+
+void components_join(struct components_grid *grid, const struct component_edges *edges) {
+    for (size_t i = 0; i < edges->count; i++)
+        join(grid->parent, edges->pairs[i][0], edges->pairs[i][1]);
+}
+
+// the components, their voxels and the color indices are a single allocation
+struct components_allocation {
+    VxfComponents components;
+    VxfAllocator allocator;
+    size_t size;
+};
+
+VxfComponents *components_create(const VxfAllocator *allocator, const int32_t origin[3],
+                                 struct components_grid *grid, VxfError *error) {
+    // each root is the first voxel of its component, and parents precede their children, so a single pass
+    // replaces the parents by component indices in the order of the first voxels
+    uint32_t *label = grid->parent;
+    size_t component_count = 0;
+    for (size_t i = 0; i < grid->count; i++)
+        label[i] = label[i] == i ? (uint32_t)component_count++ : label[label[i]];
+
+    struct components_allocation *allocation = NULL;
+    size_t size = sizeof *allocation;
+    if (component_count <= (SIZE_MAX - size) / sizeof(VxfComponent)
+            && grid->count <= (SIZE_MAX - size - component_count * sizeof(VxfComponent)) / (sizeof(int32_t[3]) + 1)) {
+        size += component_count * sizeof(VxfComponent) + grid->count * (sizeof(int32_t[3]) + 1);
+        allocation = allocator->alloc(allocator->user_data, size);
+    }
+    if (!allocation) {
+        if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    VxfComponent *components = (VxfComponent*)(allocation + 1);
+    int32_t (*xyz)[3] = (int32_t(*)[3])(components + component_count);
+    *allocation = (struct components_allocation){
+        .components = {
+            .component_count = component_count, .components = components,
+            .voxel_count = grid->count, .xyz = xyz, .coloridx = (uint8_t*)(xyz + grid->count),
+        },
+        .allocator = *allocator, .size = size,
+    };
+    for (size_t c = 0; c < component_count; c++) {
+        components[c] = (VxfComponent){
+            .min = {INT32_MAX, INT32_MAX, INT32_MAX}, .max = {INT32_MIN, INT32_MIN, INT32_MIN},
+        };
+    }
+    for (size_t i = 0; i < grid->count; i++)
+        components[label[i]].voxel_count++;
+    for (size_t c = 0, first = 0; c < component_count; c++) {
+        components[c].first_voxel = (uint32_t)first;
+        first += components[c].voxel_count;
+        components[c].voxel_count = 0;
+    }
+
+    // voxels are grouped by component, each group in Morton order
+    for (size_t i = 0; i < grid->count; i++) {
+        VxfComponent *component = &components[label[i]];
+        size_t pos = component->first_voxel + component->voxel_count++;
+        vxf_decode_key(grid->keys[i], VXF_KEY_FORMAT_MORTON, origin, xyz[pos]);
+        allocation->components.coloridx[pos] = grid->colors[i];
+        for (int j = 0; j < 3; j++) {
+            component->min[j] = component->min[j] < xyz[pos][j] ? component->min[j] : xyz[pos][j];
+            component->max[j] = component->max[j] > xyz[pos][j] ? component->max[j] : xyz[pos][j];
+        }
+    }
+    if (error) *error = VXF_SUCCESS;
+    return &allocation->components;
+}
+
+void vxf_free_components(VxfComponents *components) {
+    if (!components) return;
+    struct components_allocation *allocation = (struct components_allocation*)components;
+    VxfAllocator allocator = allocation->allocator;
+    allocator.free(allocator.user_data, allocation, allocation->size);
+}
@@ -0,0 +1,50 @@
+#ifndef VOXFLAT_COMPONENTS_H
+#define VOXFLAT_COMPONENTS_H
+// Connected components of voxels sorted by Morton key, independent of the file and scene structures.
+#include "bricks.h"
+#include <voxflat.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct components_brick;
+
+// the distinct voxels in bricks of 8x8x8 positions, and a union-find forest over them
+struct components_grid {
+    uint64_t *keys; // Morton keys of the distinct voxels, sorted
+    uint8_t *colors; // color index of each distinct voxel
+    uint32_t *parent; // index of the parent of each distinct voxel, which is never higher
+    size_t count, brick_count;
+    struct components_brick *bricks;
+    struct brick_table table; // of the bricks
+};
+
+// pairs of adjacent voxels in different regions
+struct component_edges {
+    uint32_t (*pairs)[2];
+    size_t count, capacity;
+};
+
+// keys: Morton keys relative to an origin, sorted; order: read order of each key; colors: color index by read order.
+// Where voxels overlap, the one read last is kept.
+VxfError components_grid_init(struct components_grid *grid, const VxfAllocator *allocator,
+    const uint64_t *keys, const uint32_t *order, const uint8_t *colors, size_t count);
+void components_grid_free(struct components_grid *grid, const VxfAllocator *allocator);
+
+// first voxel of region i of region_count, which starts at a brick; region_count ends at grid->count
+size_t components_region_start(const struct components_grid *grid, size_t i, size_t region_count);
+
+// joins the adjacent voxels with indices from begin to end, and appends pairs with a voxel outside of the region to
+// edges; regions of different calls can be labeled in parallel. connectivity: 6 or 26; separate_colors: only voxels
+// with the same color index are adjacent.
+VxfError components_label_region(struct components_grid *grid, const VxfAllocator *allocator, size_t begin,
+    size_t end, unsigned connectivity, bool separate_colors, struct component_edges *edges);
+void component_edges_free(struct component_edges *edges, const VxfAllocator *allocator);
+
+// joins the voxels of the pairs found by components_label_region
+void components_join(struct components_grid *grid, const struct component_edges *edges);
+
+// creates the output once all regions have been labeled and joined; replaces the parents by component indices
+VxfComponents *components_create(const VxfAllocator *allocator, const int32_t origin[3],
+    struct components_grid *grid, VxfError *error);
+
+#endif
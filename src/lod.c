@@ -0,0 +1,177 @@
+#include "lod.h"
+#include <string.h>
+#include <stdbool.h>
+
+struct lod_level {
+    uint64_t *keys; // Morton keys relative to origin >> level, sorted
+    uint8_t *colors;
+    size_t count;
+    size_t read_pos;
+};
+
+struct VxfLod {
+    VxfAllocator allocator;
+    int32_t origin[3];
+    unsigned level_count;
+    struct lod_level levels[LOD_MAX_LEVELS];
+};
+
+static bool alloc_level(VxfLod *lod, struct lod_level *level, size_t count) {
+    level->count = count;
+    if (count > SIZE_MAX / sizeof *level->keys)
+        return false;
+    level->keys = lod->allocator.alloc(lod->allocator.user_data, count * sizeof *level->keys);
+    level->colors = lod->allocator.alloc(lod->allocator.user_data, count);
+    return level->keys && level->colors;
+}
+
+static void free_level(VxfLod *lod, struct lod_level *level) {
+    if (level->keys)
+        lod->allocator.free(lod->allocator.user_data, level->keys, level->count * sizeof *level->keys);
+    if (level->colors)
+        lod->allocator.free(lod->allocator.user_data, level->colors, level->count);
+    *level = (struct lod_level){0};
+}
+
+void vxf_free_lod(VxfLod *lod) {
+    if (!lod) return;
+    for (unsigned i = 0; i < lod->level_count; i++)
+        free_level(lod, &lod->levels[i]);
+    VxfAllocator allocator = lod->allocator;
+    allocator.free(allocator.user_data, lod, sizeof *lod);
+}
+
+// picks the color for a group of children with the same parent; order is the read order (larger is more recent)
+static uint8_t choose_color(const uint8_t *colors, const uint32_t *order, size_t count, VxfLodMode mode) {
+    size_t best = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (order[i] > order[best])
+            best = i;
+    }
+    if (mode == VXF_LOD_MODE_LAST)
+        return colors[best];
+
+    // majority, ties broken by the most recent child; groups have at most 8 children
+    unsigned best_votes = 0;
+    uint32_t best_latest = 0;
+    for (size_t i = 0; i < count; i++) {
+        unsigned votes = 0;
+        uint32_t latest = 0;
+        for (size_t j = 0; j < count; j++) {
+            if (colors[j] == colors[i]) {
+                votes++;
+                latest = order[j] > latest ? order[j] : latest;
+            }
+        }
+        if (votes > best_votes || (votes == best_votes && latest > best_latest))
+            best = i, best_votes = votes, best_latest = latest;
+    }
+    return colors[best];
+}
+
+// groups the keys of the source level by key >> shift; returns the number of groups, also if dst is NULL
+static size_t merge_level(const uint64_t *keys, const uint8_t *colors, const uint32_t *order, size_t count,
+                          unsigned shift, VxfLodMode mode, struct lod_level *dst, uint32_t *dst_order) {
+    size_t groups = 0;
+    for (size_t start = 0, end; start < count; start = end) {
+        uint64_t parent = keys[start] >> shift;
+        uint32_t latest = order[start];
+        for (end = start + 1; end < count && keys[end] >> shift == parent; end++)
+            latest = order[end] > latest ? order[end] : latest;
+        if (dst) {
+            dst->keys[groups] = parent;
+            dst->colors[groups] = choose_color(colors + start, order + start, end - start, mode);
+            dst_order[groups] = latest;
+        }
+        groups++;
+    }
+    return groups;
+}
+
+VxfLod *lod_create(const VxfAllocator *allocator, const int32_t origin[3], unsigned top_level,
+                   const uint64_t *keys, const uint32_t *order, const uint8_t *colors, size_t count, const VxfLodOptions *options, VxfError *error) {
+    VxfLodMode mode = options ? options->mode : VXF_LOD_MODE_MAJORITY;
+    unsigned max_levels = options && options->max_levels > 0 ? options->max_levels : LOD_MAX_LEVELS;
+    if (max_levels > top_level + 1)
+        max_levels = top_level + 1;
+
+    VxfLod *lod = allocator->alloc(allocator->user_data, sizeof *lod);
+    uint32_t *orders[2] = {NULL, NULL};
+    uint8_t *sorted_colors = NULL;
+    VxfError result = VXF_ERROR_OUT_OF_MEMORY;
+    if (!lod)
+        goto cleanup;
+    *lod = (VxfLod){.allocator = *allocator};
+    memcpy(lod->origin, origin, sizeof lod->origin);
+    if (count == 0) {
+        result = VXF_SUCCESS;
+        goto cleanup;
+    }
+
+    // level 0: voxels at the same position are replaced by the one read last
+    sorted_colors = allocator->alloc(allocator->user_data, count);
+    for (size_t i = 0; i < 2; i++)
+        orders[i] = allocator->alloc(allocator->user_data, count * sizeof *orders[i]);
+    if (!sorted_colors || !orders[0] || !orders[1])
+        goto cleanup;
+    for (size_t i = 0; i < count; i++)
+        sorted_colors[i] = colors[order[i]];
+    lod->level_count = 1;
+    if (!alloc_level(lod, &lod->levels[0], merge_level(keys, sorted_colors, order, count, 0, mode, NULL, NULL)))
+        goto cleanup;
+    merge_level(keys, sorted_colors, order, count, 0, VXF_LOD_MODE_LAST, &lod->levels[0], orders[0]);
+
+    // coarser levels: the 8 children of a voxel have the same key apart from the lowest 3 bits
+    while (lod->level_count < max_levels && lod->levels[lod->level_count - 1].count > 1) {
+        const struct lod_level *src = &lod->levels[lod->level_count - 1];
+        const uint32_t *src_order = orders[(lod->level_count - 1) % 2];
+        struct lod_level *dst = &lod->levels[lod->level_count++];
+        if (!alloc_level(lod, dst, merge_level(src->keys, src->colors, src_order, src->count, 3, mode, NULL, NULL)))
+            goto cleanup;
+        merge_level(src->keys, src->colors, src_order, src->count, 3, mode, dst, orders[(lod->level_count - 1) % 2]);
+    }
+    result = VXF_SUCCESS;
+
+cleanup:
+    if (sorted_colors)
+        allocator->free(allocator->user_data, sorted_colors, count);
+    for (size_t i = 0; i < 2; i++) {
+        if (orders[i])
+            allocator->free(allocator->user_data, orders[i], count * sizeof *orders[i]);
+    }
+    if (error) *error = result;
+    if (result != VXF_SUCCESS) {
+        vxf_free_lod(lod);
+        return NULL;
+    }
+    return lod;
+}
+
+unsigned vxf_lod_level_count(const VxfLod *lod) {
+    return lod->level_count;
+}
+
+uintmax_t vxf_lod_count_voxels(const VxfLod *lod, unsigned level) {
+    return level < lod->level_count ? lod->levels[level].count : 0;
+}
+
+size_t vxf_lod_read_xyz_coloridx(VxfLod *lod, unsigned level, size_t max_count, int32_t xyz_buf[][3],
+                                 uint8_t coloridx_buf[], VxfError *error) {
+    if (!lod || level >= lod->level_count || ((!xyz_buf || !coloridx_buf) && max_count > 0)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+    struct lod_level *l = &lod->levels[level];
+    // origin is aligned to the coarsest level, so the division is exact
+    int32_t origin[3];
+    for (int i = 0; i < 3; i++)
+        origin[i] = lod->origin[i] / (INT32_C(1) << level);
+    size_t count = l->count - l->read_pos < max_count ? l->count - l->read_pos : max_count;
+    for (size_t i = 0; i < count; i++) {
+        vxf_decode_key(l->keys[l->read_pos + i], VXF_KEY_FORMAT_MORTON, origin, xyz_buf[i]);
+        coloridx_buf[i] = l->colors[l->read_pos + i];
+    }
+    l->read_pos += count;
+    if (error) *error = VXF_SUCCESS;
+    return count;
+}
@@ -0,0 +1,14 @@
+#ifndef VOXFLAT_LOD_H
+#define VOXFLAT_LOD_H
+// Level-of-detail pyramids built from voxels sorted by Morton key, independent of the file structures.
+#include <voxflat.h>
+#include <stddef.h>
+
+#define LOD_MAX_LEVELS 22 // keys have 21 bits per axis
+
+// keys: Morton keys relative to origin, sorted; order: read order of each key; colors: color index by read order.
+// origin must be a multiple of 2^top_level, the coarsest level that is built.
+VxfLod *lod_create(const VxfAllocator *allocator, const int32_t origin[3], unsigned top_level,
+    const uint64_t *keys, const uint32_t *order, const uint8_t *colors, size_t count, const VxfLodOptions *options, VxfError *error);
+
+#endif
@@ -0,0 +1,154 @@
+#include "lookup.h"
+#include "bricks.h"
+#include <string.h>
+#include <stdbool.h>
+#include <stdalign.h>
+
+#define CACHE_LINE 64
+
+// occupancy of a brick with bit x + 8 y + 64 z for the voxel at x, y, z within the brick; one cache line
+struct brick {
+    uint64_t occupancy[8];
+};
+
+struct VxfLookup {
+    VxfAllocator allocator;
+    size_t size; // of this allocation
+    int32_t origin[3];
+    struct brick *bricks; // aligned to cache lines
+    uint32_t *colors_start; // per brick, index in colors of its first voxel
+    struct brick_table table; // of the bricks
+    uint8_t *colors; // color indices of the voxels of each brick, in the order of their occupancy bits
+};
+
+static unsigned brick_bit(const uint32_t rel[3]) {
+    return (rel[0] & 7) | (rel[1] & 7) << 3 | (rel[2] & 7) << 6;
+}
+
+// reserves space for an array within the allocation; returns false on overflow
+static bool layout(size_t *total_size, size_t *offset, size_t count, size_t itemsize, size_t align) {
+    size_t start = (*total_size + align - 1) / align * align;
+    if (start < *total_size || count > (SIZE_MAX - start) / itemsize)
+        return false;
+    *offset = start;
+    *total_size = start + count * itemsize;
+    return true;
+}
+
+VxfLookup *lookup_create(const VxfAllocator *allocator, const int32_t origin[3],
+                         const uint64_t *keys, const uint32_t *order, const uint8_t *colors, size_t count, VxfError *error) {
+    size_t brick_count, voxel_count;
+    struct brick_table table;
+    count_bricks(keys, count, &brick_count, &voxel_count, &table);
+
+    // single allocation; offsets are relative to its start rounded up to a cache line
+    size_t size = sizeof(VxfLookup), bricks_offset, colors_start_offset, slots_offset, colors_offset;
+    VxfLookup *lookup = NULL;
+    if (layout(&size, &bricks_offset, brick_count, sizeof(struct brick), CACHE_LINE)
+            && layout(&size, &colors_start_offset, brick_count, sizeof(uint32_t), alignof(uint32_t))
+            && layout(&size, &slots_offset, table.slot_count, sizeof(struct brick_slot), alignof(struct brick_slot))
+            && layout(&size, &colors_offset, voxel_count, 1, 1)
+            && size <= SIZE_MAX - CACHE_LINE && brick_count <= UINT32_MAX)
+        lookup = allocator->alloc(allocator->user_data, size += CACHE_LINE - 1);
+    if (!lookup) {
+        if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    char *data = (char*)lookup;
+    size_t misalignment = (uintptr_t)data % CACHE_LINE;
+    char *aligned = misalignment ? data + CACHE_LINE - misalignment : data;
+    table.slots = (void*)(aligned + slots_offset);
+    *lookup = (VxfLookup){
+        .allocator = *allocator, .size = size,
+        .bricks = (void*)(aligned + bricks_offset),
+        .colors_start = (void*)(aligned + colors_start_offset),
+        .table = table,
+        .colors = (uint8_t*)(aligned + colors_offset),
+    };
+    memcpy(lookup->origin, origin, sizeof lookup->origin);
+    brick_table_clear(&lookup->table);
+
+    size_t brick_idx = 0, color_pos = 0;
+    for (size_t start = 0, end; start < count; start = end, brick_idx++) {
+        struct brick *brick = &lookup->bricks[brick_idx];
+        uint8_t brick_colors[512];
+        *brick = (struct brick){0};
+        for (end = start; end < count && same_brick(keys[end], keys[start]);) {
+            size_t latest = take_latest_voxel(keys, order, count, &end);
+            int32_t pos[3];
+            vxf_decode_key(keys[latest], VXF_KEY_FORMAT_MORTON, (const int32_t[3]){0, 0, 0}, pos);
+            unsigned bit = brick_bit((const uint32_t[3]){(uint32_t)pos[0], (uint32_t)pos[1], (uint32_t)pos[2]});
+            brick->occupancy[bit / 64] |= UINT64_C(1) << bit % 64;
+            brick_colors[bit] = colors[order[latest]];
+        }
+        brick_table_insert(&lookup->table, keys[start], (uint32_t)brick_idx);
+
+        lookup->colors_start[brick_idx] = (uint32_t)color_pos;
+        for (unsigned w = 0; w < 8; w++) {
+            for (uint64_t bits = brick->occupancy[w]; bits; bits &= bits - 1)
+                lookup->colors[color_pos++] = brick_colors[w * 64 + lowest_bit(bits)];
+        }
+    }
+    if (error) *error = VXF_SUCCESS;
+    return lookup;
+}
+
+void vxf_free_lookup(VxfLookup *lookup) {
+    if (!lookup) return;
+    VxfAllocator allocator = lookup->allocator;
+    allocator.free(allocator.user_data, lookup, lookup->size);
+}
+
+// returns false if the position is outside the range of the lookup
+static bool relative_position(const VxfLookup *lookup, const int32_t xyz[3], uint32_t rel[3]) {
+    for (int i = 0; i < 3; i++) {
+        int64_t value = (int64_t)xyz[i] - lookup->origin[i];
+        if (value < 0 || value >= INT64_C(1) << KEY_AXIS_BITS)
+            return false;
+        rel[i] = (uint32_t)value;
+    }
+    return true;
+}
+
+static uint8_t brick_color(const VxfLookup *lookup, uint32_t brick_idx, unsigned bit) {
+    const uint64_t *occupancy = lookup->bricks[brick_idx].occupancy;
+    uint64_t word = occupancy[bit / 64];
+    if (!(word >> bit % 64 & 1))
+        return 0;
+    size_t rank = lookup->colors_start[brick_idx] + popcount64(word & ((UINT64_C(1) << bit % 64) - 1));
+    for (unsigned w = 0; w < bit / 64; w++)
+        rank += popcount64(occupancy[w]);
+    return lookup->colors[rank];
+}
+
+uint8_t vxf_lookup_coloridx(const VxfLookup *lookup, const int32_t xyz[3]) {
+    uint32_t rel[3];
+    if (!relative_position(lookup, xyz, rel))
+        return 0;
+    uint32_t brick_idx = brick_table_find(&lookup->table, brick_key(rel));
+    return brick_idx != UINT32_MAX ? brick_color(lookup, brick_idx, brick_bit(rel)) : 0;
+}
+
+void vxf_lookup_coloridx_batch(const VxfLookup *lookup, size_t count, const int32_t xyz[][3],
+                               uint8_t coloridx_buf[]) {
+    // queries are often close to each other, so the brick of the previous query is tried first
+    uint64_t last_key = EMPTY_SLOT;
+    uint32_t last_brick_idx = UINT32_MAX;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t rel[3];
+        if (!relative_position(lookup, xyz[i], rel)) {
+            coloridx_buf[i] = 0;
+            continue;
+        }
+        uint64_t key = brick_key(rel);
+        if (key != last_key) {
+            last_key = key;
+            last_brick_idx = brick_table_find(&lookup->table, key);
+        }
+        coloridx_buf[i] = last_brick_idx != UINT32_MAX ? brick_color(lookup, last_brick_idx, brick_bit(rel)) : 0;
+    }
+}
+
+size_t vxf_lookup_memory_usage(const VxfLookup *lookup) {
+    return lookup->size;
+}
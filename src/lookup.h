@@ -0,0 +1,11 @@
+#ifndef VOXFLAT_LOOKUP_H
+#define VOXFLAT_LOOKUP_H
+// Point queries on voxels sorted by Morton key, independent of the file structures.
+#include <voxflat.h>
+#include <stddef.h>
+
+// keys: Morton keys relative to origin, sorted; order: read order of each key; colors: color index by read order.
+VxfLookup *lookup_create(const VxfAllocator *allocator, const int32_t origin[3],
+    const uint64_t *keys, const uint32_t *order, const uint8_t *colors, size_t count, VxfError *error);
+
+#endif
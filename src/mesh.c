@@ -0,0 +1,207 @@
+#include "mesh.h"
+#include "util.h"
+#include <string.h>
+#include <assert.h>
+
+#define MAX_MODEL_SIZE 256
+#define MASK_CAPACITY (MAX_MODEL_SIZE * MAX_MODEL_SIZE)
+
+// face keys in the mask of a slice; faces are only merged if their keys are equal
+#define FACE_PRESENT (UINT32_C(1) << 16)
+#define FACE_NO_MERGE (UINT32_C(1) << 17) // ambient occlusion varies over the face
+
+// corners of a face as (u, v) offsets, counter-clockwise seen from the positive and negative side
+static const int FACE_CORNERS[2][4][2] = {
+    {{0, 0}, {0, 1}, {1, 1}, {1, 0}},
+    {{0, 0}, {1, 0}, {1, 1}, {0, 1}},
+};
+
+struct grid {
+    int size[3];
+    const uint64_t *occupancy;
+    const uint8_t *colors;
+};
+
+static size_t grid_index(const struct grid *grid, const int pos[3]) {
+    return ((size_t)pos[2] * grid->size[1] + pos[1]) * grid->size[0] + pos[0];
+}
+
+static bool is_filled(const struct grid *grid, const int pos[3]) {
+    for (int i = 0; i < 3; i++) {
+        if ((unsigned)pos[i] >= (unsigned)grid->size[i])
+            return false;
+    }
+    size_t idx = grid_index(grid, pos);
+    return grid->occupancy[idx / 64] >> (idx % 64) & 1;
+}
+
+bool mesh_scratch_alloc(struct mesh_scratch *scratch, const VxfAllocator *allocator, size_t grid_capacity) {
+    *scratch = (struct mesh_scratch){.grid_capacity = grid_capacity};
+    scratch->occupancy = allocator->alloc(allocator->user_data, (grid_capacity + 63) / 64 * sizeof *scratch->occupancy);
+    scratch->colors = allocator->alloc(allocator->user_data, grid_capacity);
+    scratch->mask = allocator->alloc(allocator->user_data, MASK_CAPACITY * sizeof *scratch->mask);
+    if (scratch->occupancy && scratch->colors && scratch->mask)
+        return true;
+    mesh_scratch_free(scratch, allocator);
+    return false;
+}
+
+void mesh_scratch_free(struct mesh_scratch *scratch, const VxfAllocator *allocator) {
+    if (scratch->occupancy)
+        allocator->free(allocator->user_data, scratch->occupancy, (scratch->grid_capacity + 63) / 64 * sizeof *scratch->occupancy);
+    if (scratch->colors)
+        allocator->free(allocator->user_data, scratch->colors, scratch->grid_capacity);
+    if (scratch->mask)
+        allocator->free(allocator->user_data, scratch->mask, MASK_CAPACITY * sizeof *scratch->mask);
+    *scratch = (struct mesh_scratch){0};
+}
+
+void mesh_output_free(struct mesh_output *out, const VxfAllocator *allocator) {
+    if (out->quads)
+        allocator->free(allocator->user_data, out->quads, out->capacity * sizeof *out->quads);
+    *out = (struct mesh_output){0};
+}
+
+static bool append_quad(struct mesh_output *out, const VxfAllocator *allocator, const struct mesh_quad *quad) {
+    if (out->count == out->capacity) {
+        size_t capacity = MAX(64, out->capacity * 2);
+        struct mesh_quad *quads = allocator->alloc(allocator->user_data, capacity * sizeof *quads);
+        if (!quads)
+            return false;
+        if (out->quads) {
+            memcpy(quads, out->quads, out->count * sizeof *quads);
+            allocator->free(allocator->user_data, out->quads, out->capacity * sizeof *quads);
+        }
+        out->quads = quads;
+        out->capacity = capacity;
+    }
+    out->quads[out->count++] = *quad;
+    return true;
+}
+
+// key of the face of the voxel at pos that points along axis d in direction dir
+static uint32_t face_key(const struct grid *grid, const int pos[3], int d, int dir, bool ambient_occlusion) {
+    uint32_t key = FACE_PRESENT | grid->colors[grid_index(grid, pos)];
+    if (!ambient_occlusion)
+        return key | 0xff << 8; // all corners unoccluded
+    int u = (d + 1) % 3, v = (d + 2) % 3;
+    int layer[3] = {pos[0], pos[1], pos[2]};
+    layer[d] += dir;
+    uint8_t ao[4];
+    for (int i = 0; i < 4; i++) {
+        const int *corner = FACE_CORNERS[dir > 0][i];
+        int du = corner[0] ? 1 : -1, dv = corner[1] ? 1 : -1;
+        int side1[3] = {layer[0], layer[1], layer[2]}, side2[3] = {layer[0], layer[1], layer[2]};
+        side1[u] += du, side2[v] += dv;
+        int diagonal[3] = {side1[0], side1[1], side1[2]};
+        diagonal[v] += dv;
+        bool s1 = is_filled(grid, side1), s2 = is_filled(grid, side2);
+        ao[i] = s1 && s2 ? 0 : (uint8_t)(3 - s1 - s2 - is_filled(grid, diagonal));
+        key |= (uint32_t)ao[i] << (8 + 2 * i);
+    }
+    if (ao[0] != ao[1] || ao[0] != ao[2] || ao[0] != ao[3])
+        key |= FACE_NO_MERGE;
+    return key;
+}
+
+// merges the faces in the mask into rectangles, clearing the mask
+static bool merge_faces(struct mesh_output *out, const VxfAllocator *allocator, uint32_t *mask,
+                        int su, int sv, int d, int dir, int k) {
+    int u = (d + 1) % 3, v = (d + 2) % 3;
+    for (int j = 0; j < sv; j++) {
+        for (int i = 0; i < su; i++) {
+            uint32_t key = mask[j * su + i];
+            if (!key)
+                continue;
+            int w = 1, h = 1;
+            if (!(key & FACE_NO_MERGE)) {
+                while (i + w < su && mask[j * su + i + w] == key)
+                    w++;
+                for (; j + h < sv; h++) {
+                    int n = 0;
+                    while (n < w && mask[(j + h) * su + i + n] == key)
+                        n++;
+                    if (n < w)
+                        break;
+                }
+            }
+            for (int y = 0; y < h; y++)
+                memset(&mask[(j + y) * su + i], 0, w * sizeof *mask);
+
+            struct mesh_quad quad = {
+                .axis = (uint8_t)d, .positive = dir > 0, .coloridx = (uint8_t)key,
+                .size = {(uint16_t)w, (uint16_t)h},
+            };
+            for (int c = 0; c < 4; c++)
+                quad.ao[c] = key >> (8 + 2 * c) & 3;
+            quad.pos[d] = (uint16_t)(dir > 0 ? k + 1 : k);
+            quad.pos[u] = (uint16_t)i;
+            quad.pos[v] = (uint16_t)j;
+            if (!append_quad(out, allocator, &quad))
+                return false;
+            i += w - 1;
+        }
+    }
+    return true;
+}
+
+VxfError mesh_model(struct mesh_output *out, struct mesh_scratch *scratch, const VxfAllocator *allocator,
+                    const uint32_t model_size[3], const uint8_t (*xyzi)[4], size_t count, const uint64_t color_mask[4],
+                    bool ambient_occlusion) {
+    struct grid grid = {.occupancy = scratch->occupancy, .colors = scratch->colors};
+    for (int i = 0; i < 3; i++)
+        grid.size[i] = (int)CLAMP(model_size[i], 1, MAX_MODEL_SIZE);
+    size_t grid_size = (size_t)grid.size[0] * grid.size[1] * grid.size[2];
+    assert(grid_size <= scratch->grid_capacity);
+
+    memset(scratch->occupancy, 0, (grid_size + 63) / 64 * sizeof *scratch->occupancy);
+    for (size_t i = 0; i < count; i++) {
+        int pos[3] = {xyzi[i][0], xyzi[i][1], xyzi[i][2]};
+        if (pos[0] >= grid.size[0] || pos[1] >= grid.size[1] || pos[2] >= grid.size[2])
+            continue;
+        if (color_mask && !(color_mask[xyzi[i][3] / 64] >> (xyzi[i][3] % 64) & 1))
+            continue;
+        size_t idx = grid_index(&grid, pos);
+        scratch->occupancy[idx / 64] |= UINT64_C(1) << (idx % 64);
+        scratch->colors[idx] = xyzi[i][3];
+    }
+
+    for (int d = 0; d < 3; d++) {
+        int u = (d + 1) % 3, v = (d + 2) % 3;
+        int su = grid.size[u], sv = grid.size[v];
+        for (int dir = -1; dir <= 1; dir += 2) {
+            for (int k = 0; k < grid.size[d]; k++) {
+                int pos[3];
+                pos[d] = k;
+                for (int j = 0; j < sv; j++) {
+                    pos[v] = j;
+                    for (int i = 0; i < su; i++) {
+                        pos[u] = i;
+                        uint32_t key = 0;
+                        if (is_filled(&grid, pos)) {
+                            int neighbor[3] = {pos[0], pos[1], pos[2]};
+                            neighbor[d] += dir;
+                            if (!is_filled(&grid, neighbor))
+                                key = face_key(&grid, pos, d, dir, ambient_occlusion);
+                        }
+                        scratch->mask[j * su + i] = key;
+                    }
+                }
+                if (!merge_faces(out, allocator, scratch->mask, su, sv, d, dir, k))
+                    return VXF_ERROR_OUT_OF_MEMORY;
+            }
+        }
+    }
+    return VXF_SUCCESS;
+}
+
+void mesh_quad_corners(const struct mesh_quad *quad, int32_t corners[4][3]) {
+    int d = quad->axis, u = (d + 1) % 3, v = (d + 2) % 3;
+    for (int i = 0; i < 4; i++) {
+        const int *corner = FACE_CORNERS[quad->positive][i];
+        for (int j = 0; j < 3; j++)
+            corners[i][j] = quad->pos[j];
+        corners[i][u] += corner[0] * quad->size[0];
+        corners[i][v] += corner[1] * quad->size[1];
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef VOXFLAT_MESH_H
+#define VOXFLAT_MESH_H
+// Greedy meshing of single models in model space, independent of the file and scene structures.
+#include <voxflat.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// a rectangle of merged voxel faces in model space
+struct mesh_quad {
+    uint8_t axis; // axis of the normal
+    bool positive; // direction of the normal along the axis
+    uint8_t coloridx;
+    uint8_t ao[4]; // per corner, in the order of mesh_quad_corners
+    uint16_t pos[3]; // minimum corner
+    uint16_t size[2]; // extent along the axes (axis + 1) % 3 and (axis + 2) % 3
+};
+
+// quads of a model; allocated with the allocator passed to mesh_model
+struct mesh_output {
+    struct mesh_quad *quads;
+    size_t count, capacity;
+};
+
+// working memory for meshing models of up to grid_capacity voxels (product of the model size)
+struct mesh_scratch {
+    uint64_t *occupancy;
+    uint8_t *colors;
+    uint32_t *mask;
+    size_t grid_capacity;
+};
+
+bool mesh_scratch_alloc(struct mesh_scratch *scratch, const VxfAllocator *allocator, size_t grid_capacity);
+void mesh_scratch_free(struct mesh_scratch *scratch, const VxfAllocator *allocator);
+
+// appends the quads of a model to out; voxels outside of the model size or with a color index not in
+// color_mask (if not NULL) are ignored
+VxfError mesh_model(struct mesh_output *out, struct mesh_scratch *scratch, const VxfAllocator *allocator,
+    const uint32_t model_size[3], const uint8_t (*xyzi)[4], size_t count, const uint64_t color_mask[4],
+    bool ambient_occlusion);
+void mesh_output_free(struct mesh_output *out, const VxfAllocator *allocator);
+
+// model space corners, counter-clockwise when looking against the normal
+void mesh_quad_corners(const struct mesh_quad *quad, int32_t corners[4][3]);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef VOXFLAT_UTIL_H
+#define VOXFLAT_UTIL_H
+// Helpers shared by the source files of the library.
+#include <stdint.h>
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define CLAMP(x, min, max) MIN(MAX((x), (min)), (max))
+
+#define KEY_AXIS_BITS 21 // per axis of the position keys
+#define KEY_AXIS_MASK ((UINT32_C(1) << KEY_AXIS_BITS) - 1)
+
+static inline unsigned popcount64(uint64_t x) {
+    x -= x >> 1 & UINT64_C(0x5555555555555555);
+    x = (x & UINT64_C(0x3333333333333333)) + (x >> 2 & UINT64_C(0x3333333333333333));
+    x = (x + (x >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return (unsigned)(x * UINT64_C(0x0101010101010101) >> 56);
+}
+
+// index of the lowest set bit of a nonzero value
+static inline unsigned lowest_bit(uint64_t x) {
+    return popcount64((x & -x) - 1);
+}
+
+#endif
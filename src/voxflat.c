@@ -1,23 +1,72 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE // for st_mtimespec
+#endif
+#endif
+
 #include <voxflat.h>
+#include "mesh.h"
+#include "lod.h"
+#include "lookup.h"
+#include "columns.h"
+#include "components.h"
+#include "boxes.h"
+#include "util.h"
 #include <string.h>
 #include <setjmp.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdalign.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdnoreturn.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// with GCC and Clang on x86, the AVX2 palette gather is compiled in any case and selected at runtime
+#if !defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define VOXFLAT_AVX2_DISPATCH
+#endif
+
+#if defined(__AVX2__) || defined(__BMI2__) || defined(VOXFLAT_AVX2_DISPATCH)
+#include <immintrin.h>
+#endif
+
+#ifdef VOXFLAT_HAVE_C11_THREADS
+#include <threads.h>
+#endif
 
 #ifndef unreachable
 #define unreachable() do { assert(0 && "Unreachable code"); for (;;); } while (0)
 #endif
 
 #define GET_BYTES_MAX 1024 // enough for palette data
-
-#define MAX(a,b) ((a) > (b) ? (a) : (b))
-#define MIN(a,b) ((a) < (b) ? (a) : (b))
-#define CLAMP(x, min, max) MIN(MAX((x), (min)), (max))
+#define FD_BUFFER_SIZE 65536
+#define MAX_THREADS 64
+#define BUDGET_CHECK_VOXELS 4096 // voxels read between checks of the time budget
+#define ASYNC_READ_SIZE (1 << 16) // minimum size of the requests of asynchronous sources
+#define WALK_LOCAL_FRAMES 32 // scene walks allocate their stack only for subtrees deeper than this
+#define WALK_OUT_OF_MEMORY (SIZE_MAX - 1) // result of scene walks that cannot allocate their stack
+#define MODEL_SAMPLE_VOXELS 64 // voxels at the start of each model that are hashed while opening
+#define READ_POSITION_MASK ((UINT64_C(1) << 48) - 1) // voxel count of read positions, above it the scope hash
 
 #define FOURCC(a,b,c,d) ((uint32_t) (((d) << 24) | ((c) << 16) | ((b) << 8) | (a)))
 
@@ -77,6 +126,22 @@ static uint32_t load_u32(const char bytes[4]) {
     return result;
 }
 
+// 64-bit hash of a byte range, processing 8 bytes at a time
+static uint64_t hash_bytes(const void *data, size_t size, uint64_t seed) {
+    const char *p = data;
+    uint64_t h = seed ^ (size * UINT64_C(0x9e3779b97f4a7c15)), word;
+    for (; size >= 8; p += 8, size -= 8) {
+        memcpy(&word, p, 8);
+        h = (h ^ word) * UINT64_C(0xff51afd7ed558ccd);
+        h ^= h >> 32;
+    }
+    word = 0;
+    if (size > 0)
+        memcpy(&word, p, size);
+    h = (h ^ word) * UINT64_C(0xc4ceb9fe1a85ec53);
+    return h ^ h >> 29;
+}
+
 static int32_t load_i32(const char bytes[4]) {
     int32_t result;
     #if __STDC_ENDIAN_NATIVE__ == __STDC_ENDIAN_LITTLE__
@@ -95,25 +160,48 @@ static noreturn void return_error(struct retjmp *retjmp, VxfError error) {
     longjmp(retjmp->jump, 1);
 }
 
-static void *xcalloc(size_t nmemb, size_t size, struct retjmp *retjmp) {
-    assert(size > 0);
-    void *result = calloc(nmemb, size);
-    if (!result && nmemb > 0) return_error(retjmp, VXF_ERROR_OUT_OF_MEMORY);
-    return result;
+static void *default_alloc(void *user_data, size_t size) {
+    (void)user_data;
+    return malloc(size);
+}
+
+static void default_free(void *user_data, void *ptr, size_t size) {
+    (void)user_data, (void)size;
+    free(ptr);
+}
+
+static const VxfAllocator default_allocator = {.alloc = default_alloc, .free = default_free};
+
+static void *xcalloc(const VxfAllocator *allocator, size_t nmemb, size_t size, struct retjmp *retjmp) {
+    assert(size > 0 && nmemb > 0);
+    if (nmemb > SIZE_MAX / size) return_error(retjmp, VXF_ERROR_OUT_OF_MEMORY);
+    void *result = allocator->alloc(allocator->user_data, nmemb * size);
+    if (!result) return_error(retjmp, VXF_ERROR_OUT_OF_MEMORY);
+    return memset(result, 0, nmemb * size);
 }
 
+// arrays have a fixed capacity determined by scan_chunks before parsing
 #define Array(type) struct { type *items; size_t len, capacity; }
 
 #define ARRAY_APPEND(array, retjmp) \
-    ((array).items = (array).len < (array).capacity ? (array).items : \
-        array_increase_capacity((array).items, sizeof *(array).items, &(array).capacity, &(retjmp)), \
-    &(array).items[(array).len++])
-
-static void *array_increase_capacity(void *items, size_t itemsize, size_t *capacity, struct retjmp *retjmp) {
-    if (*capacity > SIZE_MAX / itemsize / 2) goto fail;
-    size_t newcap = *capacity < 16 ? 16 : *capacity * 2;
-    items = realloc(items, newcap * itemsize);
-    if (items) return *capacity = newcap, items;
+    (array_check_capacity((array).len, (array).capacity, &(retjmp)), &(array).items[(array).len++])
+
+// reserves space for an array within a single allocation; returns the offset of the array
+#define ARRAY_LAYOUT(array, count, total_size, retjmp) \
+    ((array).capacity = (count), layout_array(&(total_size), (count), sizeof *(array).items, &(retjmp)))
+
+static void array_check_capacity(size_t len, size_t capacity, struct retjmp *retjmp) {
+    // can only happen if the file was modified between scanning and parsing
+    if (len >= capacity) return_error(retjmp, VXF_ERROR_INVALID_FILE_STRUCTURE);
+}
+
+static size_t layout_array(size_t *total_size, size_t count, size_t itemsize, struct retjmp *retjmp) {
+    size_t align = alignof(max_align_t);
+    if (*total_size > SIZE_MAX - align) goto fail;
+    size_t offset = (*total_size + align - 1) / align * align;
+    if (count > (SIZE_MAX - offset) / itemsize) goto fail;
+    *total_size = offset + count * itemsize;
+    return offset;
 fail:
     return_error(retjmp, VXF_ERROR_OUT_OF_MEMORY);
 }
@@ -158,26 +246,45 @@ static struct transform get_model_transform(const struct transform *parent, cons
 
 struct model {
     size_t voxel_count;
-    union { size_t memory_offset; fpos_t file_pos; };
+    int64_t offset;
+    uint64_t sample_hash; // of the voxel count and the first MODEL_SAMPLE_VOXELS voxels if sampled, otherwise 0
+    uint64_t fingerprint; // hash of the voxel data if enabled by the open options, otherwise 0
 };
 
+// value of a shape or transform node from an animation frame until the next keyframe of the node
+struct keyframe {
+    uint32_t frame;
+    union {
+        uint32_t model_idx;
+        struct transform transform;
+    };
+};
+
+enum node_type { NODE_GROUP, NODE_SHAPE, NODE_TRANSFORM };
+
+#define NO_LAYER UINT32_MAX
+#define NO_NAME UINT32_MAX
+
+// array sizes are limited to 32 bits (see allocate_data), so that nodes can use 32-bit indices; scenes with
+// generated content can have millions of nodes
 struct node {
     uint32_t id;
-    enum node_type { NODE_GROUP, NODE_SHAPE, NODE_TRANSFORM } type;
-    unsigned height;
+    uint8_t type; // enum node_type
+    bool is_hidden; // only for transform nodes
+    uint32_t height;
+    uint32_t name_offset; // in names, or NO_NAME
+    uint32_t keyframes_start, keyframes_end; // range in keyframes, sorted by frame; empty for groups
     union {
         struct {
-            size_t model_idx;
+            uint32_t model_idx; // at the selected frame
         } shape;
         struct {
-            size_t child_node_idx;
-            size_t layer_idx;
-            bool has_layer;
-            bool is_hidden;
-            struct transform transform;
+            uint32_t child_node_idx;
+            uint32_t layer_idx; // or NO_LAYER
+            struct transform transform; // at the selected frame
         } transform;
         struct {
-            size_t children_start, children_end; // range in group_children
+            uint32_t children_start, children_end; // range in group_children
         } group;
     };
 };
@@ -185,84 +292,339 @@ struct node {
 struct layer {
     uint32_t id;
     bool is_hidden;
+    bool excluded; // by the layer filter
+};
+
+// a visible shape node reached via a particular path through the scene graph
+struct instance {
+    size_t id; // index in scene graph traversal order
+    uint64_t node_path; // hash of the node ids on the path from the selected node
+    size_t model_idx;
+    int64_t offset; // copied from the model, so that reading doesn't need to look it up
+    size_t voxel_count;
+    uint64_t voxel_start; // number of voxels in the preceding instances
+    struct transform transform; // maps model voxel coordinates to global coordinates
+};
+
+// entry of the name index, sorted by name and then by node index
+struct node_name {
+    const char *name;
+    uint32_t node_idx;
+};
+
+struct walk_frame {
+    uint32_t node_idx;
+    uint32_t pos; // next child
+    struct transform transform;
+    uint64_t path; // hash of the node ids from the start node to this one
+};
+
+struct chunk_counts {
+    size_t models, model_sizes, nodes, group_children, keyframes, layers, name_bytes;
+    bool has_palette;
 };
 
 struct VxfFile {
     struct source {
-        enum { SOURCE_MEMORY, SOURCE_FILE } type;
+        enum { SOURCE_MEMORY, SOURCE_STREAM, SOURCE_FD, SOURCE_IO, SOURCE_ASYNC } type;
+        int64_t offset; // logical read position; seeking is deferred until the next read
+        VxfError error; // set when a read fails with an error rather than at eof
         union {
-            struct { const char *buffer; size_t size, offset; } memory;
-            struct { FILE *stream; bool from_filename; } file;
+            struct { const char *buffer; size_t size; } memory;
+            struct { FILE *stream; int64_t stream_offset; } stream;
+            struct { int fd; bool from_filename; char *buffer; int64_t buffer_offset; size_t buffer_len; } fd;
+            struct { VxfIo callbacks; void *ctx; int64_t stream_offset; } io;
+            struct {
+                char *buffer; // bytes fed for the last request
+                size_t capacity, buffer_len;
+                int64_t buffer_offset;
+                int64_t end; // end of the source, INT64_MAX until a feed was short
+                int64_t limit; // end of the chunk being processed, reads beyond it fail
+                int64_t request_offset;
+                size_t request_size; // 0 if no bytes are requested
+            } async;
         };
     } source;
+    struct {
+        enum { OPEN_HEADER, OPEN_SCAN, OPEN_CHUNKS, OPEN_DONE } phase;
+        int64_t offset; // of the next chunk; opening continues there after VXF_ERROR_WOULD_BLOCK
+        int64_t first_chunk;
+        struct chunk_counts counts;
+        VxfError error; // why opening an asynchronous source failed
+        const VxfFile *previous; // see VxfOpenOptions::previous; NULL once opened
+    } open;
     Array(struct model) models;
     Array(struct model_size) model_sizes;
     Array(struct node) nodes;
-    Array(size_t) group_children_node_idx;
+    Array(uint32_t) group_children_node_idx;
+    Array(struct keyframe) keyframes;
     Array(struct layer) layers;
+    Array(char) names; // zero-terminated node names
+    Array(struct node_name) node_names;
     const uint8_t (*palette)[4]; // either palette_buffer or default_palette
     uint8_t (*palette_buffer)[4];
+    VxfAllocator allocator;
+    size_t alloc_size; // size of this struct including the fd read buffer
+    void *data; // single allocation holding the arrays above
+    size_t data_size;
+    void *node_stack; // room for one walk_frame per node; used by the traversals while opening
     size_t readcounter;
     char tmpbuffer[GET_BYTES_MAX];
+    VxfReadOrder read_order;
+    bool fingerprint_models;
+    bool sample_models; // with fingerprints or a previous handle, see parse_model_chunk
+    uint32_t frame; // selected animation frame
+    uint32_t frame_count;
+    struct scope {
+        uint32_t node_idx; // root of the selected subtree
+        bool visible; // false if the node cannot be reached via visible nodes
+        struct transform transform; // accumulated transform of the parents
+    } scope;
     struct {
-        struct readstate_frame {
-            size_t node_idx;
-            size_t pos;
-            struct transform transform;
-        } *stack;
-        size_t depth;
+        bool show_hidden;
+        bool layers_filtered; // by include or exclude lists
+        bool has_color_mask;
+        uint64_t color_mask[4];
+    } filter;
+    struct {
+        VxfColorFormat format;
+        bool valid;
+        union {
+            uint32_t u32[256];
+            uint16_t u16[256];
+            float f32[256][4];
+        };
+    } color_lut; // palette converted to the last requested color format
+    struct {
+        int32_t origin[3];
+        bool valid;
+    } key_origin; // minimum of the bounds, subtracted from positions for keys
+    struct {
+        uint64_t *occupancy; // voxels of the model, in rows along x of row_words words
+        uint64_t *exposed; // voxels with at least one face not covered by another voxel
+        size_t capacity; // words allocated for each bitset
+        size_t model_idx;
+        int size[3];
+        size_t row_words;
+        bool valid;
+    } surface; // bitsets of the model read last in surface mode
+    struct {
+        struct instance *items; // visible instances in read order
+        size_t count;
+        uint64_t scope_hash; // of the instances and the color mask, stored in read positions
+        bool built;
+        bool mapped; // items point into the scene cache mapping instead of being allocated
+    } instances;
+    struct {
+        const char *mapping; // the scene cache file if the scene was loaded from it, or NULL
+        size_t mapping_size;
+        const struct instance *instances; // of the first frame without filters in scene graph order, in the mapping
+        size_t instance_count;
+        uint64_t instances_hash;
+        bool instances_checked; // instances is NULL if the check failed
+        uint64_t voxel_count;
+        int32_t bounds_min[3], bounds_max[3];
+    } cache;
+    struct readstate {
+        size_t instance_pos; // index in instances
+        size_t voxel_pos; // voxels of the current instance already read
         VxfError error;
         bool eof;
     } readstate;
+    struct {
+        size_t next; // next entry of instances to prefetch
+        unsigned distance;
+    } prefetch;
     struct retjmp retjmp;
 };
 
-// return next bytes, either directly from source memory or read into tmpbuffer
+// positional read that does not use the file offset of the descriptor; on Windows, ReadFile moves it, though
+static int64_t read_at(int fd, void *buffer, size_t size, int64_t offset) {
+#ifdef _WIN32
+    HANDLE handle = (HANDLE)_get_osfhandle(fd);
+    OVERLAPPED overlapped = {.Offset = (DWORD)offset, .OffsetHigh = (DWORD)((uint64_t)offset >> 32)};
+    DWORD read;
+    if (!ReadFile(handle, buffer, (DWORD)MIN(size, UINT32_MAX), &read, &overlapped))
+        return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+    return read;
+#else
+    ssize_t read;
+    do read = pread(fd, buffer, size, (off_t)offset);
+    while (read < 0 && errno == EINTR);
+    return read;
+#endif
+}
+
+// records an error of the source, so that try_get_bytes can fail without a longjmp
+static const char *source_error(VxfFile *vf, VxfError error) {
+    vf->source.error = error;
+    return NULL;
+}
+
+static const char *try_get_fd_bytes(VxfFile *vf, size_t count) {
+    struct source *src = &vf->source;
+    int64_t start = src->fd.buffer_offset;
+    if (src->offset < start || src->offset - start + count > src->fd.buffer_len) {
+        // refill the buffer from the current offset; the old contents remain valid otherwise,
+        // so switching between nearby models does not cause additional reads
+        src->fd.buffer_offset = start = src->offset;
+        src->fd.buffer_len = 0;
+        while (src->fd.buffer_len < FD_BUFFER_SIZE) {
+            int64_t read = read_at(src->fd.fd, src->fd.buffer + src->fd.buffer_len,
+                FD_BUFFER_SIZE - src->fd.buffer_len, start + src->fd.buffer_len);
+            if (read < 0)
+                return source_error(vf, VXF_ERROR_FILE_READ);
+            if (read == 0)
+                break;
+            src->fd.buffer_len += (size_t)read;
+        }
+        if (count > src->fd.buffer_len)
+            return NULL;
+    }
+    const char *result = src->fd.buffer + (src->offset - start);
+    src->offset += count;
+    return result;
+}
+
+static const char *try_get_stream_bytes(VxfFile *vf, size_t count) {
+    struct source *src = &vf->source;
+    if (src->offset != src->stream.stream_offset) {
+        if (fseeko(src->stream.stream, src->offset, SEEK_SET) != 0)
+            return source_error(vf, VXF_ERROR_FILE_SEEK);
+        src->stream.stream_offset = src->offset;
+    }
+    size_t read = fread(vf->tmpbuffer, count, 1, src->stream.stream);
+    if (read < 1) {
+        src->stream.stream_offset = -1; // unknown
+        if (ferror(src->stream.stream))
+            return source_error(vf, VXF_ERROR_FILE_READ);
+        return NULL;
+    }
+    src->offset = src->stream.stream_offset += count;
+    return vf->tmpbuffer;
+}
+
+static const char *try_get_io_bytes(VxfFile *vf, size_t count) {
+    struct source *src = &vf->source;
+    const VxfIo *io = &src->io.callbacks;
+    if (src->offset != src->io.stream_offset) {
+        if (io->seek(src->io.ctx, src->offset) != 0)
+            return source_error(vf, VXF_ERROR_FILE_SEEK);
+        src->io.stream_offset = src->offset;
+    }
+    const char *result = io->get_pointer ? io->get_pointer(src->io.ctx, count) : NULL;
+    if (!result) {
+        size_t total = 0;
+        while (total < count) {
+            int64_t read = io->read(src->io.ctx, vf->tmpbuffer + total, count - total);
+            if (read < 0)
+                return source_error(vf, VXF_ERROR_FILE_READ);
+            if (read == 0)
+                break;
+            total += (size_t)read;
+        }
+        src->io.stream_offset += total;
+        if (total < count)
+            return NULL;
+        result = vf->tmpbuffer;
+    } else {
+        src->io.stream_offset += count;
+    }
+    src->offset = src->io.stream_offset;
+    return result;
+}
+
+static size_t async_available(const struct source *src, int64_t offset) {
+    if (offset < src->async.buffer_offset || offset - src->async.buffer_offset >= (int64_t)src->async.buffer_len)
+        return 0;
+    return src->async.buffer_len - (size_t)(offset - src->async.buffer_offset);
+}
+
+// records the bytes needed next, extended to at least ASYNC_READ_SIZE bytes where the source does not end before;
+// returns false if they are beyond the end of the source, so that reading them fails
+static bool async_request(VxfFile *vf, int64_t offset, size_t size) {
+    struct source *src = &vf->source;
+    if (offset > src->async.end || size > (uint64_t)(src->async.end - offset))
+        return false;
+    src->async.request_offset = offset;
+    src->async.request_size = (size_t)MIN((uint64_t)MAX(size, ASYNC_READ_SIZE), (uint64_t)(src->async.end - offset));
+    return true;
+}
+
+static const char *try_get_async_bytes(VxfFile *vf, size_t count) {
+    struct source *src = &vf->source;
+    if (count == 0)
+        return vf->tmpbuffer;
+    if (src->offset > src->async.limit - (int64_t)count)
+        return NULL;
+    if (async_available(src, src->offset) < count)
+        return async_request(vf, src->offset, count) ? source_error(vf, VXF_ERROR_WOULD_BLOCK) : NULL;
+    const char *result = src->async.buffer + (src->offset - src->async.buffer_offset);
+    src->offset += count;
+    return result;
+}
+
+// return next bytes, either directly from source memory or read into a buffer;
+// returns NULL at eof or on error, in which case source.error is set
 static const char *try_get_bytes(VxfFile *vf, size_t count) {
     assert(count <= GET_BYTES_MAX);
     struct source *src = &vf->source;
     vf->readcounter += count;
     switch (src->type) {
         case SOURCE_MEMORY:
-            if (count > src->memory.size - src->memory.offset)
+            if ((uint64_t)src->offset > src->memory.size || count > src->memory.size - (size_t)src->offset)
                 return NULL;
-            const char *result = &src->memory.buffer[src->memory.offset];
-            src->memory.offset += count;
+            const char *result = &src->memory.buffer[src->offset];
+            src->offset += count;
             return result;
-        case SOURCE_FILE: {
-            size_t read = fread(vf->tmpbuffer, count, 1, src->file.stream);
-            if (read < 1 && ferror(src->file.stream))
-                return_error(&vf->retjmp, VXF_ERROR_FILE_READ);
-            if (read < 1)
-                return NULL;
-            return vf->tmpbuffer;
-        }
+        case SOURCE_STREAM:
+            return try_get_stream_bytes(vf, count);
+        case SOURCE_FD:
+            return try_get_fd_bytes(vf, count);
+        case SOURCE_IO:
+            return try_get_io_bytes(vf, count);
+        case SOURCE_ASYNC:
+            return try_get_async_bytes(vf, count);
         default: unreachable();
     }
 }
 
+static void check_source_error(VxfFile *vf) {
+    if (vf->source.error)
+        return_error(&vf->retjmp, vf->source.error);
+}
+
 static const void *get_bytes(VxfFile *vf, size_t count) {
     const char *result = try_get_bytes(vf, count);
     if (result) return result;
+    check_source_error(vf);
     return_error(&vf->retjmp, VXF_ERROR_UNEXPECTED_EOF);
 }
 
 static void skip_bytes(VxfFile *vf, size_t count) {
-    struct source *src = &vf->source;
     vf->readcounter += count;
-    switch (src->type) {
-        case SOURCE_MEMORY:
-            src->memory.offset += MIN(count, src->memory.size - src->memory.offset);
-            break;
-        case SOURCE_FILE:
-            while (count > 0) {
-                long offset = MIN(count, LONG_MAX);
-                int seekerr = fseek(src->file.stream, offset, SEEK_CUR);
-                if (seekerr) return_error(&vf->retjmp, VXF_ERROR_FILE_SEEK);
-                count -= offset;
-            }
-            break;
-    }
+    if (count > (uint64_t)(INT64_MAX - vf->source.offset))
+        return_error(&vf->retjmp, VXF_ERROR_FILE_SEEK);
+    vf->source.offset += count;
+}
+
+// for asynchronous sources, requests the chunk up to the next count bytes unless they are available, so that a chunk
+// is processed completely or not at all; reads beyond them fail until end_chunk
+static void require_bytes(VxfFile *vf, size_t count) {
+    struct source *src = &vf->source;
+    if (src->type != SOURCE_ASYNC)
+        return;
+    if (async_available(src, src->offset) < count && count <= (uint64_t)(INT64_MAX - src->offset)
+            && async_request(vf, vf->open.offset, (size_t)(src->offset - vf->open.offset) + count))
+        return_error(&vf->retjmp, VXF_ERROR_WOULD_BLOCK);
+    src->async.limit = count <= (uint64_t)(INT64_MAX - src->offset) ? src->offset + (int64_t)count : INT64_MAX;
+}
+
+// saves the progress after a chunk
+static void end_chunk(VxfFile *vf) {
+    vf->open.offset = vf->source.offset;
+    if (vf->source.type == SOURCE_ASYNC)
+        vf->source.async.limit = INT64_MAX;
 }
 
 static const char *get_string(VxfFile *vf) {
@@ -281,12 +643,34 @@ static void skip_string(VxfFile *vf) {
     skip_bytes(vf, length);
 }
 
-static void skip_dict(VxfFile *vf) {
-    uint32_t count = load_u32(get_bytes(vf, 4));
-    while (count-- > 0) {
-        skip_string(vf); // key
-        skip_string(vf); // value
+// copies a name into the names array; names longer than GET_BYTES_MAX - 1 bytes are truncated
+static uint32_t store_name(VxfFile *vf, const char *name) {
+    size_t size = strlen(name) + 1;
+    if (size > vf->names.capacity - vf->names.len)
+        return_error(&vf->retjmp, VXF_ERROR_INVALID_FILE_STRUCTURE); // see array_check_capacity
+    uint32_t offset = (uint32_t)vf->names.len;
+    memcpy(vf->names.items + offset, name, size);
+    vf->names.len += size;
+    return offset;
+}
+
+// parses _hidden and, if name_offset is not NULL, _name from a node or layer dict
+static bool parse_attributes_dict(VxfFile *vf, uint32_t *name_offset) {
+    bool is_hidden = false;
+    uint32_t entry_count = load_u32(get_bytes(vf, 4));
+    while (entry_count-- > 0) {
+        const char *key = get_string(vf);
+        if (strcmp(key, "_hidden") == 0) {
+            int value;
+            sscanf(get_string(vf), "%d", &value);
+            is_hidden = value;
+        } else if (name_offset && strcmp(key, "_name") == 0) {
+            *name_offset = store_name(vf, get_string(vf));
+        } else {
+            skip_string(vf);
+        }
     }
+    return is_hidden;
 }
 
 static void parse_size_chunk(VxfFile *vf) {
@@ -296,83 +680,99 @@ static void parse_size_chunk(VxfFile *vf) {
     };
 }
 
+// the model of the previous version with the same offset, voxel count and sample hash, whose fingerprint can be
+// used instead of hashing the voxel data; NULL if there is none
+static const struct model *find_previous_model(const VxfFile *vf, const struct model *model) {
+    const VxfFile *previous = vf->open.previous;
+    if (!previous || !previous->fingerprint_models)
+        return NULL;
+    // models are stored in file order
+    size_t lo = 0, hi = previous->models.len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (previous->models.items[mid].offset < model->offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const struct model *match = lo < previous->models.len ? &previous->models.items[lo] : NULL;
+    return match && match->offset == model->offset && match->voxel_count == model->voxel_count
+        && match->sample_hash == model->sample_hash ? match : NULL;
+}
+
 static void parse_model_chunk(VxfFile *vf) {
     size_t voxel_count = load_u32(get_bytes(vf, 4));
     struct model *model = ARRAY_APPEND(vf->models, vf->retjmp);
-    *model = (struct model){.voxel_count = voxel_count};
-    const struct source *src = &vf->source;
-    switch (src->type) {
-        case SOURCE_MEMORY:
-            model->memory_offset = src->memory.offset;
-            break;
-        case SOURCE_FILE:
-            if (fgetpos(src->file.stream, &model->file_pos) != 0)
-                return_error(&vf->retjmp, VXF_ERROR_FILE_SEEK);
-            break;
+    *model = (struct model){.voxel_count = voxel_count, .offset = vf->source.offset};
+    // the sample is only needed to match models of a previous handle and to compare them without fingerprints
+    size_t sample_size = vf->sample_models ? 4 * MIN(voxel_count, MODEL_SAMPLE_VOXELS) : 0;
+    if (vf->sample_models)
+        model->sample_hash = hash_bytes(sample_size > 0 ? get_bytes(vf, sample_size) : NULL, sample_size, voxel_count);
+    const struct model *previous = vf->fingerprint_models ? find_previous_model(vf, model) : NULL;
+    if (!vf->fingerprint_models || previous) {
+        model->fingerprint = previous ? previous->fingerprint : 0;
+        skip_bytes(vf, 4 * voxel_count - sample_size);
+        return;
+    }
+    model->fingerprint = model->sample_hash;
+    for (size_t left = 4 * voxel_count - sample_size; left > 0;) {
+        size_t count = MIN(left, GET_BYTES_MAX);
+        model->fingerprint = hash_bytes(get_bytes(vf, count), count, model->fingerprint);
+        left -= count;
     }
-    skip_bytes(vf, 4 * voxel_count);
 }
 
-static void seek_to_model(VxfFile *vf, const struct model *model) {
-    switch (vf->source.type) {
-        case SOURCE_MEMORY:
-            vf->source.memory.offset = model->memory_offset;
-            break;
-        case SOURCE_FILE:
-            if (fsetpos(vf->source.file.stream, &model->file_pos) != 0)
-                return_error(&vf->retjmp, VXF_ERROR_FILE_SEEK);
-            break;
+// parses the frame index from a shape frame dict; frames without index are frame 0
+static uint32_t parse_frame_dict(VxfFile *vf) {
+    uint32_t frame = 0;
+    uint32_t entry_count = load_u32(get_bytes(vf, 4));
+    while (entry_count-- > 0) {
+        const char *key = get_string(vf);
+        if (strcmp(key, "_f") == 0)
+            sscanf(get_string(vf), "%"SCNu32"", &frame);
+        else
+            skip_string(vf);
     }
+    return frame;
 }
 
 static void parse_shape_chunk(VxfFile *vf) {
     uint32_t node_id = load_u32(get_bytes(vf, 4));
     struct node *node = ARRAY_APPEND(vf->nodes, vf->retjmp);
-    *node = (struct node){.id = node_id, .type = NODE_SHAPE, .shape = {0}};
-    skip_dict(vf);
+    *node = (struct node){.id = node_id, .type = NODE_SHAPE, .name_offset = NO_NAME, .shape = {0}};
+    parse_attributes_dict(vf, &node->name_offset);
     uint32_t model_count = load_u32(get_bytes(vf, 4));
     if (model_count < 1) return_error(&vf->retjmp, VXF_ERROR_INVALID_FILE_STRUCTURE);
+    node->keyframes_start = (uint32_t)vf->keyframes.len;
     for (uint32_t i = 0; i < model_count; i++) {
-        size_t model_index = load_u32(get_bytes(vf, 4));
-        if (i == 0) node->shape.model_idx = model_index; // other animation frames ignored for now
-        skip_dict(vf);
+        struct keyframe *keyframe = ARRAY_APPEND(vf->keyframes, vf->retjmp);
+        keyframe->model_idx = load_u32(get_bytes(vf, 4));
+        keyframe->frame = parse_frame_dict(vf);
     }
+    node->keyframes_end = (uint32_t)vf->keyframes.len;
 }
 
 static void parse_group_chunk(VxfFile *vf) {
     uint32_t node_id = load_u32(get_bytes(vf, 4));
     struct node *node = ARRAY_APPEND(vf->nodes, vf->retjmp);
-    *node = (struct node){.id = node_id, .type = NODE_GROUP, .group = {0}};
-    skip_dict(vf);
+    *node = (struct node){.id = node_id, .type = NODE_GROUP, .name_offset = NO_NAME, .group = {0}};
+    parse_attributes_dict(vf, &node->name_offset);
     uint32_t child_count = load_u32(get_bytes(vf, 4));
-    node->group.children_start = vf->group_children_node_idx.len;
+    node->group.children_start = (uint32_t)vf->group_children_node_idx.len;
     for (uint32_t i = 0; i < child_count; i++)
         *ARRAY_APPEND(vf->group_children_node_idx, vf->retjmp) = load_u32(get_bytes(vf, 4));
-    node->group.children_end = vf->group_children_node_idx.len;
-}
-
-static bool parse_is_hidden_dict(VxfFile *vf) {
-    bool is_hidden = false;
-    uint32_t entry_count = load_u32(get_bytes(vf, 4));
-    while (entry_count-- > 0) {
-        const char *key = get_string(vf);
-        if (strcmp(key, "_hidden") == 0) {
-            int value;
-            sscanf(get_string(vf), "%d", &value);
-            is_hidden = value;
-        } else {
-            skip_string(vf);
-        }
-    }
-    return is_hidden;
+    node->group.children_end = (uint32_t)vf->group_children_node_idx.len;
 }
 
-static struct transform parse_transform_frame_dict(VxfFile *vf) {
+static struct keyframe parse_transform_frame_dict(VxfFile *vf) {
+    struct keyframe keyframe = {.transform = TRANSFORM_IDENTITY};
     struct transform t = TRANSFORM_IDENTITY;
     uint32_t entry_count = load_u32(get_bytes(vf, 4));
     while (entry_count-- > 0) {
         const char *key = get_string(vf);
-        if (strcmp(key, "_r") == 0) {
+        if (strcmp(key, "_f") == 0) {
+            sscanf(get_string(vf), "%"SCNu32"", &keyframe.frame);
+        } else if (strcmp(key, "_r") == 0) {
             unsigned rotcode;
             sscanf(get_string(vf), "%u", &rotcode);
             t.rotation_cols[0] = MIN(2u, rotcode & 0x3);
@@ -388,54 +788,67 @@ static struct transform parse_transform_frame_dict(VxfFile *vf) {
             skip_string(vf);
         }
     }
-    return t;
+    keyframe.transform = t;
+    return keyframe;
 }
 
 static void parse_transform_chunk(VxfFile *vf) {
     uint32_t node_id = load_u32(get_bytes(vf, 4));
     struct node *node = ARRAY_APPEND(vf->nodes, vf->retjmp);
-    *node = (struct node){.id = node_id, .type = NODE_TRANSFORM, .transform = {0}};
+    *node = (struct node){.id = node_id, .type = NODE_TRANSFORM, .name_offset = NO_NAME, .transform = {0}};
 
-    node->transform.is_hidden = parse_is_hidden_dict(vf);
+    node->is_hidden = parse_attributes_dict(vf, &node->name_offset);
     const char *data = get_bytes(vf, 16);
 
     node->transform.child_node_idx = load_u32(data);
 
     int32_t layervalue = load_i32(data + 8);
-    node->transform.has_layer = layervalue >= 0;
-    node->transform.layer_idx = MAX(layervalue, 0);
+    node->transform.layer_idx = layervalue >= 0 ? (uint32_t)layervalue : NO_LAYER;
 
     uint32_t frame_count = load_u32(data + 12);
     if (frame_count < 1) return_error(&vf->retjmp, VXF_ERROR_INVALID_FILE_STRUCTURE);
-    for (uint32_t i = 0; i < frame_count; i++) {
-        if (i == 0) node->transform.transform = parse_transform_frame_dict(vf);
-        else skip_dict(vf);
-    }
+    node->keyframes_start = (uint32_t)vf->keyframes.len;
+    for (uint32_t i = 0; i < frame_count; i++)
+        *ARRAY_APPEND(vf->keyframes, vf->retjmp) = parse_transform_frame_dict(vf);
+    node->keyframes_end = (uint32_t)vf->keyframes.len;
 }
 
 static void parse_layer_chunk(VxfFile *vf) {
     uint32_t layer_id = load_u32(get_bytes(vf, 4));
     struct layer *layer = ARRAY_APPEND(vf->layers, vf->retjmp);
-    *layer = (struct layer){.id = layer_id, .is_hidden = parse_is_hidden_dict(vf)};
+    *layer = (struct layer){.id = layer_id, .is_hidden = parse_attributes_dict(vf, NULL)};
     skip_bytes(vf, 4);
 }
 
 static void parse_rgba_chunk(VxfFile *vf) {
     const void *data = get_bytes(vf, 256 * 4);
-    assert(!vf->palette_buffer);
-    vf->palette_buffer = xcalloc(256, 4, &vf->retjmp);
+    assert(vf->palette_buffer); // allocated if scan_chunks found an RGBA chunk
     // shift because the palette starts at index 1; leave index 0 as zero
     memcpy(vf->palette_buffer + 1, data, 255 * sizeof *vf->palette_buffer);
     vf->palette = (const uint8_t(*)[4])vf->palette_buffer;
 }
 
+// bytes of a chunk's content that parsing it reads
+static size_t chunk_bytes_needed(const VxfFile *vf, uint32_t fourcc, size_t contentsize) {
+    switch (fourcc) {
+        case FOURCC_XYZI: // voxels after the sample are skipped without fingerprints, all of them without samples
+            if (vf->fingerprint_models)
+                return contentsize;
+            return vf->sample_models ? MIN(contentsize, 4 + 4 * MODEL_SAMPLE_VOXELS) : 4;
+        case FOURCC_SIZE: case FOURCC_RGBA: case FOURCC_nSHP: case FOURCC_nGRP: case FOURCC_nTRN: case FOURCC_LAYR:
+            return contentsize;
+        default: return 0;
+    }
+}
+
 static void parse_main_children(VxfFile *vf) {
     // we ignore the declared size and just read until eof, for better compatibility and avoiding the 2/4 gb limit
-    for (const char *header; (header = try_get_bytes(vf, 12));) {
+    for (const char *header; (header = try_get_bytes(vf, 12)); end_chunk(vf)) {
         uint32_t fourcc = load_u32(header);
         size_t contentsize = load_u32(header + 4);
         size_t childrensize = load_u32(header + 8);
 
+        require_bytes(vf, chunk_bytes_needed(vf, fourcc, contentsize));
         vf->readcounter = 0;
         switch (fourcc) {
             case FOURCC_SIZE: parse_size_chunk(vf); break;
@@ -451,9 +864,10 @@ static void parse_main_children(VxfFile *vf) {
             return_error(&vf->retjmp, VXF_ERROR_INVALID_FILE_STRUCTURE);
         skip_bytes(vf, childrensize);
     }
+    check_source_error(vf);
 }
 
-static void parse_vox(VxfFile *vf) {
+static void parse_vox_header(VxfFile *vf) {
     const char *header = get_bytes(vf, 20);
     uint32_t vox_fourcc = load_u32(header + 0);
     uint32_t main_fourcc = load_u32(header + 8);
@@ -461,6 +875,102 @@ static void parse_vox(VxfFile *vf) {
     if (vox_fourcc != FOURCC_VOX || main_fourcc != FOURCC_MAIN)
         return_error(&vf->retjmp, VXF_ERROR_UNRECOGNIZED_FILE_FORMAT);
     skip_bytes(vf, contentsize);
+}
+
+// returns the size of the _name value of a node chunk including the terminator; reads at most contentsize bytes
+static size_t scan_node_name(VxfFile *vf, size_t contentsize) {
+    size_t name_bytes = 0;
+    vf->readcounter = 0;
+    skip_bytes(vf, 4); // node id
+    uint32_t entry_count = load_u32(get_bytes(vf, 4));
+    while (entry_count-- > 0 && vf->readcounter <= contentsize) {
+        if (strcmp(get_string(vf), "_name") == 0)
+            name_bytes += strlen(get_string(vf)) + 1;
+        else
+            skip_string(vf);
+    }
+    if (vf->readcounter > contentsize)
+        return_error(&vf->retjmp, VXF_ERROR_INVALID_FILE_STRUCTURE);
+    skip_bytes(vf, contentsize - vf->readcounter);
+    return name_bytes;
+}
+
+// reads only the chunk headers to determine upper bounds for the array sizes
+static void scan_chunks(VxfFile *vf, struct chunk_counts *counts) {
+    for (const char *header; (header = try_get_bytes(vf, 12)); end_chunk(vf)) {
+        uint32_t fourcc = load_u32(header);
+        size_t contentsize = load_u32(header + 4);
+        size_t childrensize = load_u32(header + 8);
+        bool is_node = fourcc == FOURCC_nSHP || fourcc == FOURCC_nGRP || fourcc == FOURCC_nTRN;
+        require_bytes(vf, is_node ? contentsize : 0);
+        switch (fourcc) {
+            case FOURCC_SIZE: counts->model_sizes++; break;
+            case FOURCC_XYZI: counts->models++; break;
+            case FOURCC_RGBA: counts->has_palette = true; break;
+            case FOURCC_nSHP: counts->nodes++, counts->keyframes += contentsize / 8; break;
+            case FOURCC_nGRP: counts->nodes++, counts->group_children += contentsize / 4; break;
+            case FOURCC_nTRN: counts->nodes++, counts->keyframes += contentsize / 4; break;
+            case FOURCC_LAYR: counts->layers++; break;
+        }
+        if (is_node)
+            counts->name_bytes += scan_node_name(vf, contentsize);
+        else
+            skip_bytes(vf, contentsize);
+        skip_bytes(vf, childrensize);
+    }
+    check_source_error(vf);
+}
+
+static void allocate_data(VxfFile *vf, const struct chunk_counts *counts) {
+    if (counts->models > UINT32_MAX || counts->nodes > UINT32_MAX || counts->group_children > UINT32_MAX
+            || counts->keyframes > UINT32_MAX || counts->layers > UINT32_MAX || counts->name_bytes > UINT32_MAX)
+        return_error(&vf->retjmp, VXF_ERROR_OUT_OF_MEMORY);
+    size_t size = 0;
+    size_t models_offset = ARRAY_LAYOUT(vf->models, counts->models, size, vf->retjmp);
+    size_t model_sizes_offset = ARRAY_LAYOUT(vf->model_sizes, counts->model_sizes, size, vf->retjmp);
+    size_t nodes_offset = ARRAY_LAYOUT(vf->nodes, counts->nodes, size, vf->retjmp);
+    size_t group_children_offset = ARRAY_LAYOUT(vf->group_children_node_idx, counts->group_children, size, vf->retjmp);
+    size_t keyframes_offset = ARRAY_LAYOUT(vf->keyframes, counts->keyframes, size, vf->retjmp);
+    size_t layers_offset = ARRAY_LAYOUT(vf->layers, counts->layers, size, vf->retjmp);
+    size_t names_offset = ARRAY_LAYOUT(vf->names, counts->name_bytes, size, vf->retjmp);
+    size_t node_names_offset = ARRAY_LAYOUT(vf->node_names, counts->nodes, size, vf->retjmp);
+    size_t node_stack_offset = layout_array(&size, counts->nodes, sizeof(struct walk_frame), &vf->retjmp);
+    size_t palette_offset = layout_array(&size, counts->has_palette ? 256 : 0, 4, &vf->retjmp);
+
+    char *data = xcalloc(&vf->allocator, 1, size, &vf->retjmp);
+    vf->data = data, vf->data_size = size;
+    vf->models.items = (void*)(data + models_offset);
+    vf->model_sizes.items = (void*)(data + model_sizes_offset);
+    vf->nodes.items = (void*)(data + nodes_offset);
+    vf->group_children_node_idx.items = (void*)(data + group_children_offset);
+    vf->keyframes.items = (void*)(data + keyframes_offset);
+    vf->layers.items = (void*)(data + layers_offset);
+    vf->names.items = data + names_offset;
+    vf->node_names.items = (void*)(data + node_names_offset);
+    vf->node_stack = data + node_stack_offset;
+    if (counts->has_palette)
+        vf->palette_buffer = (void*)(data + palette_offset);
+}
+
+// scans the chunks, and then parses them in a second pass; continues after the last completed chunk
+static void parse_vox(VxfFile *vf) {
+    vf->source.offset = vf->open.offset;
+    if (vf->source.type == SOURCE_ASYNC)
+        vf->source.async.limit = INT64_MAX;
+    if (vf->open.phase == OPEN_HEADER) {
+        parse_vox_header(vf);
+        vf->open.first_chunk = vf->source.offset;
+        vf->open.counts = (struct chunk_counts){.nodes = 1}; // extra node for files without scene graph
+        vf->open.phase = OPEN_SCAN;
+        end_chunk(vf);
+    }
+    if (vf->open.phase == OPEN_SCAN) {
+        scan_chunks(vf, &vf->open.counts);
+        allocate_data(vf, &vf->open.counts);
+        vf->source.offset = vf->open.first_chunk;
+        vf->open.phase = OPEN_CHUNKS;
+        end_chunk(vf);
+    }
     parse_main_children(vf);
 }
 
@@ -469,400 +979,3018 @@ static int cmp_u32(const void *p1, const void *p2) {
     return (x1 > x2) - (x1 < x2);
 }
 
-static size_t get_node_index_by_id(VxfFile *vf, uint32_t id) {
+// Node IDs are usually dense, i.e. 0 to n - 1 in some order. Then nodes are sorted by moving each to the rank of
+// its ID, and a table of ranks by ID replaces binary searches. Stores the table in node_stack and returns its size;
+// returns 0 for sparse or duplicate IDs.
+static size_t sort_nodes_dense(VxfFile *vf) {
+    static_assert(sizeof(struct walk_frame) >= 2 * sizeof(uint32_t), "node_stack has room for the table");
+    struct node *nodes = vf->nodes.items;
+    size_t count = vf->nodes.len;
+    uint32_t max_id = 0;
+    for (size_t i = 0; i < count; i++)
+        max_id = MAX(max_id, nodes[i].id);
+    if (count == 0 || max_id / 2 >= count)
+        return 0;
+    uint32_t *index_by_id = vf->node_stack;
+    memset(index_by_id, 0, ((size_t)max_id + 1) * sizeof *index_by_id);
+    for (size_t i = 0; i < count; i++) {
+        if (index_by_id[nodes[i].id])
+            return 0;
+        index_by_id[nodes[i].id] = 1;
+    }
+    uint32_t rank = 0;
+    for (size_t id = 0; id <= max_id; id++)
+        index_by_id[id] = index_by_id[id] ? rank++ : UINT32_MAX;
+    for (size_t i = 0; i < count; i++) {
+        while (index_by_id[nodes[i].id] != i) {
+            struct node tmp = nodes[index_by_id[nodes[i].id]];
+            nodes[index_by_id[nodes[i].id]] = nodes[i];
+            nodes[i] = tmp;
+        }
+    }
+    return (size_t)max_id + 1;
+}
+
+// index_by_id is the table from sort_nodes_dense with table_size entries, or NULL
+static uint32_t get_node_index_by_id(VxfFile *vf, const uint32_t *index_by_id, size_t table_size, uint32_t id) {
+    if (index_by_id) {
+        if (id < table_size && index_by_id[id] != UINT32_MAX)
+            return index_by_id[id];
+        return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
+    }
     static_assert(offsetof(struct node, id) == 0, "node struct starts with id");
     struct node *node = bsearch(&id, vf->nodes.items, vf->nodes.len, sizeof *vf->nodes.items, cmp_u32);
     if (node == NULL) return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
-    return node - vf->nodes.items;
+    return (uint32_t)(node - vf->nodes.items);
 }
 
-static size_t get_layer_index_by_id(VxfFile *vf, uint32_t id) {
+static uint32_t get_layer_index_by_id(VxfFile *vf, uint32_t id) {
     static_assert(offsetof(struct layer, id) == 0, "layer struct starts with id");
     struct layer *layer = bsearch(&id, vf->layers.items, vf->layers.len, sizeof *vf->layers.items, cmp_u32);
     if (layer == NULL) return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
-    return layer - vf->layers.items;
+    return (uint32_t)(layer - vf->layers.items);
 }
 
 // node and layers IDs could theoretically be sparse and unordered in the file; we replace the
 // raw IDs read from the vox file with array indices here.
 static void replace_ids(VxfFile *vf) {
-    if (vf->nodes.len > 1) {
+    size_t table_size = sort_nodes_dense(vf);
+    const uint32_t *index_by_id = table_size > 0 ? vf->node_stack : NULL;
+    if (vf->nodes.len > 1 && !index_by_id) {
         qsort(vf->nodes.items, vf->nodes.len, sizeof *vf->nodes.items, cmp_u32);
     }
     if (vf->layers.len > 1) {
         qsort(vf->layers.items, vf->layers.len, sizeof *vf->layers.items, cmp_u32);
     }
     for (size_t i = 0; i < vf->group_children_node_idx.len; i++) {
-        vf->group_children_node_idx.items[i] = get_node_index_by_id(vf, vf->group_children_node_idx.items[i]);
+        vf->group_children_node_idx.items[i] = get_node_index_by_id(vf, index_by_id, table_size,
+            vf->group_children_node_idx.items[i]);
     }
     for (size_t i = 0; i < vf->nodes.len; i++) {
         struct node *node = &vf->nodes.items[i];
         if (node->type == NODE_TRANSFORM) {
-            node->transform.child_node_idx = get_node_index_by_id(vf, node->transform.child_node_idx);
-            if (node->transform.has_layer) {
+            node->transform.child_node_idx = get_node_index_by_id(vf, index_by_id, table_size,
+                node->transform.child_node_idx);
+            if (node->transform.layer_idx != NO_LAYER) {
                 node->transform.layer_idx = get_layer_index_by_id(vf, node->transform.layer_idx);
             }
         }
     }
 }
 
-// assigns node heights and checks for cycles; assumes heights initialized to 0
-static unsigned check_scene_tree_recursive(VxfFile *vf, uint32_t node_id) {
-    struct node *node = &vf->nodes.items[node_id];
-    if (node->height == UINT_MAX)
-        goto invalid_scene;
-    if (node->height > 0)
-        return node->height; // already processed
-    node->height = UINT_MAX; // set temporarily to detect cycles
+static int cmp_node_name(const void *p1, const void *p2) {
+    const struct node_name *n1 = p1, *n2 = p2;
+    int result = strcmp(n1->name, n2->name);
+    return result ? result : (n1->node_idx > n2->node_idx) - (n1->node_idx < n2->node_idx);
+}
 
-    switch (node->type) {
-        case NODE_SHAPE:
-            if (node->shape.model_idx >= vf->models.len)
-                return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
-            return node->height = 0;
-        case NODE_TRANSFORM: {
-            uint32_t child_height = check_scene_tree_recursive(vf, node->transform.child_node_idx);
-            if (child_height >= UINT_MAX) goto invalid_scene;
-            return node->height = child_height + 1;
-        }
-        case NODE_GROUP: {
-            if (node->group.children_start == node->group.children_end)
-                return node->height = 0;
-
-            uint32_t max_child_height = 0;
-            for (size_t i = node->group.children_start; i < node->group.children_end; i++) {
-                uint32_t child_height = check_scene_tree_recursive(vf, vf->group_children_node_idx.items[i]);
-                max_child_height = MAX(max_child_height, child_height);
-            }
-            if (max_child_height >= UINT_MAX) goto invalid_scene;
-            return node->height = max_child_height + 1;
+// sorts the named nodes by name, for binary searches in vxf_find_nodes
+static void index_names(VxfFile *vf) {
+    for (size_t i = 0; i < vf->nodes.len; i++) {
+        if (vf->nodes.items[i].name_offset != NO_NAME) {
+            *ARRAY_APPEND(vf->node_names, vf->retjmp) = (struct node_name){
+                .name = vf->names.items + vf->nodes.items[i].name_offset, .node_idx = (uint32_t)i
+            };
         }
     }
-invalid_scene:
-    return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
+    if (vf->node_names.len > 1)
+        qsort(vf->node_names.items, vf->node_names.len, sizeof *vf->node_names.items, cmp_node_name);
 }
 
-static bool open_common(VxfFile *vf, VxfError *error) {
-    if (setjmp(vf->retjmp.jump)) { // handle error
-        assert(vf->retjmp.error != VXF_SUCCESS);
-        if (error) *error = vf->retjmp.error;
+// true if the subtree of a transform node is hidden or excluded by the layer filter
+static bool is_transform_hidden(const VxfFile *vf, const struct node *node) {
+    assert(node->type == NODE_TRANSFORM);
+    if (node->is_hidden && !vf->filter.show_hidden)
+        return true;
+    if (node->transform.layer_idx == NO_LAYER)
         return false;
-    }
-
-    vf->palette = default_palette;
-    parse_vox(vf);
+    const struct layer *layer = &vf->layers.items[node->transform.layer_idx];
+    return layer->excluded || (layer->is_hidden && !vf->filter.show_hidden);
+}
 
-    if (vf->models.len == 0 || vf->models.len != vf->model_sizes.len)
+static void check_shape_node(VxfFile *vf, const struct node *node) {
+    if (node->keyframes_end > vf->keyframes.len)
         return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
-
-    // create a root node for single-model files without a scene graph
-    if (vf->nodes.len == 0) {
-        *ARRAY_APPEND(vf->nodes, vf->retjmp) = (struct node){
-            .id = 0, .type = NODE_SHAPE, .shape = {.model_idx = 0}
-        };
+    for (size_t i = node->keyframes_start; i < node->keyframes_end; i++) {
+        if (vf->keyframes.items[i].model_idx >= vf->models.len)
+            return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
     }
-
-    replace_ids(vf);
-    check_scene_tree_recursive(vf, 0);
-    if (error) *error = VXF_SUCCESS;
-    return true;
+    if (node->shape.model_idx >= vf->models.len)
+        return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
 }
 
-VxfFile *vxf_open_file(const char *filename, VxfError *error) {
-    VxfFile *vf = malloc(sizeof *vf);
-    if (!vf) {
-        if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
-        return NULL;
-    }
-    FILE *stream = fopen(filename, "rb");
-    if (!stream) {
-        if (error) *error = VXF_ERROR_FILE_OPEN;
-        free(vf);
-        return NULL;
-    }
-    *vf = (VxfFile){
-        .source = {.type = SOURCE_FILE, .file = {.stream = stream, .from_filename = true}},
-    };
-    if (!open_common(vf, error)) {
-        vxf_close(vf);
-        return NULL;
+// Assigns node heights and checks for cycles; assumes heights initialized to 0. Uses an explicit stack since
+// chains of nodes can be far longer than the call stack allows. While checking, heights are stored plus 1, so
+// that 0 marks unvisited nodes and UINT32_MAX nodes on the stack.
+static void check_scene_tree(VxfFile *vf) {
+    struct check_frame {
+        uint32_t node_idx, pos, max_child_height;
+    } *stack = vf->node_stack;
+    static_assert(sizeof(struct walk_frame) >= sizeof(struct check_frame), "node_stack has room for the stack");
+    struct node *nodes = vf->nodes.items;
+    size_t depth = 1;
+    stack[0] = (struct check_frame){.node_idx = 0};
+    nodes[0].height = UINT32_MAX;
+    while (depth > 0) {
+        struct check_frame *frame = &stack[depth - 1];
+        struct node *node = &nodes[frame->node_idx];
+        uint32_t child_node_idx = UINT32_MAX;
+        switch (node->type) {
+            case NODE_SHAPE:
+                check_shape_node(vf, node);
+                break;
+            case NODE_TRANSFORM:
+                if (frame->pos++ == 0)
+                    child_node_idx = node->transform.child_node_idx;
+                break;
+            case NODE_GROUP:
+                if (node->group.children_end > vf->group_children_node_idx.len)
+                    return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
+                if (node->group.children_start + frame->pos < node->group.children_end)
+                    child_node_idx = vf->group_children_node_idx.items[node->group.children_start + frame->pos++];
+                break;
+        }
+        if (child_node_idx != UINT32_MAX) {
+            if (child_node_idx >= vf->nodes.len)
+                return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
+            struct node *child = &nodes[child_node_idx];
+            if (child->height == UINT32_MAX)
+                return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE); // cycle
+            if (child->height > 0) {
+                frame->max_child_height = MAX(frame->max_child_height, child->height);
+            } else {
+                assert(depth < vf->nodes.len); // nodes on the stack are distinct
+                child->height = UINT32_MAX;
+                stack[depth++] = (struct check_frame){.node_idx = child_node_idx};
+            }
+        } else {
+            node->height = frame->max_child_height + 1;
+            if (--depth > 0)
+                stack[depth - 1].max_child_height = MAX(stack[depth - 1].max_child_height, node->height);
+        }
     }
-    return vf;
+    for (size_t i = 0; i < vf->nodes.len; i++)
+        nodes[i].height -= nodes[i].height > 0;
 }
 
-VxfFile *vxf_open_stream(FILE *stream, VxfError *error) {
-    clearerr(stream);
-    VxfFile *vf = malloc(sizeof *vf);
-    if (!vf) {
-        if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
-        return NULL;
-    }
-    *vf = (VxfFile){.source = {.type = SOURCE_FILE, .file.stream = stream}};
-    if (!open_common(vf, error)) {
-        vxf_close(vf);
-        return NULL;
+// sorts the keyframes of each node by frame, keeping the file order of keyframes with the same frame
+static void sort_keyframes(VxfFile *vf) {
+    vf->frame_count = 1;
+    for (size_t i = 0; i < vf->nodes.len; i++) {
+        const struct node *node = &vf->nodes.items[i];
+        struct keyframe *keyframes = vf->keyframes.items;
+        for (size_t j = node->keyframes_start + 1; j < node->keyframes_end; j++) {
+            struct keyframe keyframe = keyframes[j];
+            size_t k = j;
+            for (; k > node->keyframes_start && keyframes[k - 1].frame > keyframe.frame; k--)
+                keyframes[k] = keyframes[k - 1];
+            keyframes[k] = keyframe;
+        }
+        if (node->keyframes_end > node->keyframes_start) {
+            uint32_t last = keyframes[node->keyframes_end - 1].frame;
+            vf->frame_count = MAX(vf->frame_count, last == UINT32_MAX ? last : last + 1);
+        }
     }
-    return vf;
 }
 
-VxfFile *vxf_open_memory(size_t size, const char buffer[], VxfError *error) {
-    VxfFile *vf = malloc(sizeof *vf);
-    if (!vf) {
-        if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
-        return NULL;
+// last keyframe at or before the frame; the first keyframe also applies to the frames before it
+static const struct keyframe *get_keyframe(const VxfFile *vf, const struct node *node, uint32_t frame) {
+    size_t lo = node->keyframes_start + 1, hi = node->keyframes_end;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (vf->keyframes.items[mid].frame <= frame)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    *vf = (VxfFile){
-        .source = {.type = SOURCE_MEMORY, .memory = {.size = size, .buffer = buffer}}
-    };
-    if (!open_common(vf, error)) {
-        vxf_close(vf);
-        return NULL;
+    return &vf->keyframes.items[lo - 1];
+}
+
+// sets the models and transforms of all nodes to their values at the frame
+static void apply_frame(VxfFile *vf, uint32_t frame) {
+    for (size_t i = 0; i < vf->nodes.len; i++) {
+        struct node *node = &vf->nodes.items[i];
+        if (node->keyframes_start == node->keyframes_end)
+            continue;
+        const struct keyframe *keyframe = get_keyframe(vf, node, frame);
+        if (node->type == NODE_SHAPE)
+            node->shape.model_idx = keyframe->model_idx;
+        else if (node->type == NODE_TRANSFORM)
+            node->transform.transform = keyframe->transform;
     }
-    return vf;
 }
 
-static void extend_bounds(int32_t xyzmin[3], int32_t xyzmax[3], const struct transform *transform, const uint8_t modelpos[3]) {
-    int32_t globalpos[3];
-    apply_transform(transform, modelpos, globalpos);
+// error of an asynchronous source that has not been opened yet
+static VxfError check_opened(const VxfFile *vf) {
+    if (vf->open.phase == OPEN_DONE)
+        return VXF_SUCCESS;
+    return vf->open.error ? vf->open.error : VXF_ERROR_WOULD_BLOCK;
+}
+
+// true if the scene was loaded from a cache, whose instances, count and bounds are those of the first frame without
+// filters and node selection, and that is what is selected
+static bool cache_applies(const VxfFile *vf) {
+    return vf->cache.mapping && vf->frame == 0 && vf->scope.node_idx == 0 && !vf->filter.show_hidden
+        && !vf->filter.layers_filtered;
+}
+
+static void extend_bounds(int32_t xyzmin[3], int32_t xyzmax[3], const struct transform *transform, const uint8_t modelpos[3]) {
+    int32_t globalpos[3];
+    apply_transform(transform, modelpos, globalpos);
     for (size_t i = 0; i < 3; i++) {
         xyzmin[i] = MIN(xyzmin[i], globalpos[i]);
         xyzmax[i] = MAX(xyzmax[i], globalpos[i]);
     }
 }
 
-static void extend_bounds_recursive(const VxfFile *vf, int32_t xyzmin[3], int32_t xyzmax[3], const struct transform *parent, uint32_t node_id) {
-    struct node *node = &vf->nodes.items[node_id];
-    switch (node->type) {
-        case NODE_SHAPE: {
-            const struct model_size *size = &vf->model_sizes.items[node->shape.model_idx];
-            struct transform transform = get_model_transform(parent, size);
-            extend_bounds(xyzmin, xyzmax, &transform, (uint8_t[3]){0, 0, 0});
-            extend_bounds(xyzmin, xyzmax, &transform, (uint8_t[3]){
-                CLAMP(size->size[0], 1, 256) - 1,
-                CLAMP(size->size[1], 1, 256) - 1,
-                CLAMP(size->size[2], 1, 256) - 1,
-            });
+// identifies a path through the scene graph by the ids of its nodes, which editors keep when reordering nodes
+static uint64_t path_hash(uint64_t parent_path, uint32_t node_id) {
+    uint64_t h = (parent_path ^ node_id) * UINT64_C(0x9e3779b97f4a7c15);
+    return h ^ h >> 29;
+}
+
+// Traverses the visible nodes below the start node, calling visit for the shape nodes in traversal order with
+// their index in that order and their stack frame, which holds the transform of their parent and their path.
+// Returns the number of visible shape nodes, or stops when reaching the target node and returns SIZE_MAX with the
+// transform of its parents in target_parent; WALK_OUT_OF_MEMORY if the stack cannot be allocated. Uses an explicit
+// stack since scene graphs can be deep, which is allocated per call for deep subtrees, so that concurrent queries
+// of a handle don't share it.
+static size_t walk_nodes(const VxfFile *vf, uint32_t start_node_idx, const struct transform *start_parent,
+                         uint32_t target_node_idx, struct transform *target_parent,
+                         void (*visit)(void *ctx, size_t index, size_t model_idx, const struct walk_frame *frame),
+                         void *ctx) {
+    const VxfAllocator *allocator = &vf->allocator;
+    struct walk_frame local_stack[WALK_LOCAL_FRAMES];
+    size_t stack_frames = (size_t)vf->nodes.items[start_node_idx].height + 1;
+    struct walk_frame *stack = stack_frames <= WALK_LOCAL_FRAMES ? local_stack
+        : allocator->alloc(allocator->user_data, stack_frames * sizeof *stack);
+    if (!stack)
+        return WALK_OUT_OF_MEMORY;
+    size_t count = 0, depth = 0;
+    stack[0] = (struct walk_frame){
+        .node_idx = start_node_idx, .transform = *start_parent, .path = path_hash(0, vf->nodes.items[start_node_idx].id),
+    };
+    for (;;) {
+        struct walk_frame *frame = &stack[depth];
+        const struct node *node = &vf->nodes.items[frame->node_idx];
+        uint32_t child_node_idx = UINT32_MAX;
+        struct transform child_transform = frame->transform;
+        if (frame->node_idx == target_node_idx && frame->pos == 0) {
+            *target_parent = frame->transform;
+            count = SIZE_MAX;
             break;
         }
-        case NODE_TRANSFORM: {
-            if (node->transform.is_hidden || (node->transform.has_layer && vf->layers.items[node->transform.layer_idx].is_hidden))
+        switch (node->type) {
+            case NODE_SHAPE:
+                if (visit)
+                    visit(ctx, count, node->shape.model_idx, frame);
+                count++;
+                break;
+            case NODE_TRANSFORM:
+                if (frame->pos++ == 0 && !is_transform_hidden(vf, node)) {
+                    child_node_idx = node->transform.child_node_idx;
+                    child_transform = combine_transforms(&frame->transform, &node->transform.transform);
+                }
+                break;
+            case NODE_GROUP:
+                if (node->group.children_start + frame->pos < node->group.children_end)
+                    child_node_idx = vf->group_children_node_idx.items[node->group.children_start + frame->pos++];
                 break;
-            struct transform transform = combine_transforms(parent, &node->transform.transform);
-            extend_bounds_recursive(vf, xyzmin, xyzmax, &transform, node->transform.child_node_idx);
-            break;
         }
-        case NODE_GROUP:
-            for (size_t i = node->group.children_start; i < node->group.children_end; i++)
-                extend_bounds_recursive(vf, xyzmin, xyzmax, parent, vf->group_children_node_idx.items[i]);
+        if (child_node_idx != UINT32_MAX) {
+            stack[++depth] = (struct walk_frame){
+                .node_idx = child_node_idx, .transform = child_transform,
+                .path = path_hash(frame->path, vf->nodes.items[child_node_idx].id),
+            };
+        } else if (depth-- == 0) {
             break;
+        }
     }
+    if (stack != local_stack)
+        allocator->free(allocator->user_data, stack, stack_frames * sizeof *stack);
+    return count;
 }
 
-void vxf_calculate_bounds(const VxfFile* vf, int32_t xyz_min[3], int32_t xyz_max[3]) {
+// walks the selected subtree, see walk_nodes
+static size_t walk_scene(const VxfFile *vf, void (*visit)(void *ctx, size_t index, size_t model_idx,
+                         const struct walk_frame *frame), void *ctx) {
+    if (!vf->scope.visible)
+        return 0;
+    return walk_nodes(vf, vf->scope.node_idx, &vf->scope.transform, UINT32_MAX, NULL, visit, ctx);
+}
+
+// finds the first visible path from the root to the selected node and accumulates its transforms; the scope is
+// empty if there is none, or if the walk runs out of memory
+static void update_scope(VxfFile *vf) {
+    struct scope *scope = &vf->scope;
+    scope->transform = TRANSFORM_IDENTITY;
+    scope->visible = scope->node_idx == 0
+        || walk_nodes(vf, 0, &TRANSFORM_IDENTITY, scope->node_idx, &scope->transform, NULL, NULL) == SIZE_MAX;
+}
+
+struct bounds_ctx {
+    const VxfFile *vf;
+    int32_t *xyz_min, *xyz_max;
+};
+
+static void extend_bounds_visit(void *ctx, size_t index, size_t model_idx, const struct walk_frame *frame) {
+    (void)index;
+    struct bounds_ctx *bounds = ctx;
+    const struct model_size *size = &bounds->vf->model_sizes.items[model_idx];
+    struct transform transform = get_model_transform(&frame->transform, size);
+    extend_bounds(bounds->xyz_min, bounds->xyz_max, &transform, (uint8_t[3]){0, 0, 0});
+    extend_bounds(bounds->xyz_min, bounds->xyz_max, &transform, (uint8_t[3]){
+        CLAMP(size->size[0], 1, 256) - 1,
+        CLAMP(size->size[1], 1, 256) - 1,
+        CLAMP(size->size[2], 1, 256) - 1,
+    });
+}
+
+void vxf_calculate_bounds(const VxfFile *vf, int32_t xyz_min[3], int32_t xyz_max[3]) {
+    if (cache_applies(vf)) {
+        memcpy(xyz_min, vf->cache.bounds_min, sizeof vf->cache.bounds_min);
+        memcpy(xyz_max, vf->cache.bounds_max, sizeof vf->cache.bounds_max);
+        return;
+    }
     for (int i = 0; i < 3; i++) {
         xyz_min[i] = INT32_MAX, xyz_max[i] = INT32_MIN;
     }
-    extend_bounds_recursive(vf, xyz_min, xyz_max, &TRANSFORM_IDENTITY, 0);
+    bool complete = check_opened(vf) == VXF_SUCCESS && walk_scene(vf, extend_bounds_visit, &(struct bounds_ctx){
+        .vf = vf, .xyz_min = xyz_min, .xyz_max = xyz_max,
+    }) != WALK_OUT_OF_MEMORY;
 
     // no voxels found, reset to 0
-    if (xyz_min[0] > xyz_max[0]) {
+    if (!complete || xyz_min[0] > xyz_max[0]) {
         for (int i = 0; i < 3; i++)
             xyz_min[i] = xyz_max[i] = 0;
     }
 }
 
-static uintmax_t count_voxels_recursive(const VxfFile *vf, uint32_t node_id) {
-    struct node *node = &vf->nodes.items[node_id];
-    switch (node->type) {
-        case NODE_SHAPE:
-            return vf->models.items[node->shape.model_idx].voxel_count;
-        case NODE_TRANSFORM:
-            if (node->transform.is_hidden || (node->transform.has_layer && vf->layers.items[node->transform.layer_idx].is_hidden))
-                return 0;
-            return count_voxels_recursive(vf, node->transform.child_node_idx);
-        case NODE_GROUP: {
-            uintmax_t sum = 0;
-            for (size_t i = node->group.children_start; i < node->group.children_end; i++)
-                sum += count_voxels_recursive(vf, vf->group_children_node_idx.items[i]);
-            return sum;
-        }
-        default: unreachable();
-    }
+struct count_ctx {
+    const VxfFile *vf;
+    uintmax_t sum;
+};
+
+static void count_voxels_visit(void *ctx, size_t index, size_t model_idx, const struct walk_frame *frame) {
+    (void)index, (void)frame;
+    struct count_ctx *count = ctx;
+    count->sum += count->vf->models.items[model_idx].voxel_count;
 }
 
-uintmax_t vxf_count_voxels(const VxfFile* vf) {
-    return count_voxels_recursive(vf, 0);
+// number of voxels of the instance table, which must have been built
+static uint64_t instances_voxel_count(const VxfFile *vf) {
+    const struct instance *last = vf->instances.count > 0 ? &vf->instances.items[vf->instances.count - 1] : NULL;
+    return last ? last->voxel_start + last->voxel_count : 0;
 }
 
-void vxf_get_palette(const VxfFile *vf, uint8_t rgba_buf[256][4]) {
-    const uint8_t (*palette)[4] = vf ? vf->palette : default_palette;
-    memcpy(rgba_buf, palette, 256 * sizeof *palette);
+uintmax_t vxf_count_voxels(const VxfFile *vf) {
+    if (check_opened(vf))
+        return 0;
+    if (vf->instances.built)
+        return instances_voxel_count(vf);
+    if (cache_applies(vf))
+        return vf->cache.voxel_count;
+    struct count_ctx count = {.vf = vf};
+    return walk_scene(vf, count_voxels_visit, &count) != WALK_OUT_OF_MEMORY ? count.sum : 0;
 }
 
-static struct readstate_frame start_frame(VxfFile *vf, size_t node_idx, const struct transform *parent_transform) {
-    const struct node *node = &vf->nodes.items[node_idx];
-    switch (node->type) {
-        case NODE_SHAPE: {
-            const struct model *model = &vf->models.items[node->shape.model_idx];
-            const struct model_size *size = &vf->model_sizes.items[node->shape.model_idx];
-            seek_to_model(vf, model);
-            return (struct readstate_frame){
-                .node_idx = node_idx,
-                .transform = get_model_transform(parent_transform, size),
-            };
-        }
-        case NODE_TRANSFORM:
-            return (struct readstate_frame){
-                .node_idx = node_idx,
-                .transform = combine_transforms(parent_transform, &node->transform.transform)
-            };
-        case NODE_GROUP:
-            return (struct readstate_frame){.node_idx = node_idx, .transform = *parent_transform};
-        default: unreachable();
+struct instances_ctx {
+    const VxfFile *vf;
+    struct instance *instances;
+};
+
+static void add_instance_visit(void *ctx, size_t index, size_t model_idx, const struct walk_frame *frame) {
+    struct instances_ctx *c = ctx;
+    const struct model *model = &c->vf->models.items[model_idx];
+    c->instances[index] = (struct instance){
+        .id = index,
+        .node_path = frame->path,
+        .model_idx = model_idx,
+        .offset = model->offset,
+        .voxel_count = model->voxel_count,
+        .transform = get_model_transform(&frame->transform, &c->vf->model_sizes.items[model_idx]),
+    };
+}
+
+// stores the visible shape nodes in traversal order into instances, which must have room for all of them; false if
+// out of memory
+static bool walk_instances(const VxfFile *vf, struct instance *instances) {
+    return walk_scene(vf, add_instance_visit, &(struct instances_ctx){.vf = vf, .instances = instances})
+        != WALK_OUT_OF_MEMORY;
+}
+
+// the instances of the current frame, filter and node selection in scene graph order, or NULL if out of memory
+static struct instance *get_scene_instances(const VxfFile *vf, size_t *count) {
+    *count = walk_scene(vf, NULL, NULL);
+    if (*count == 0 || *count > UINT32_MAX)
+        return NULL;
+    struct instance *instances = vf->allocator.alloc(vf->allocator.user_data, *count * sizeof *instances);
+    if (instances && !walk_instances(vf, instances)) {
+        vf->allocator.free(vf->allocator.user_data, instances, *count * sizeof *instances);
+        return NULL;
     }
+    return instances;
 }
 
-struct readbuffers {
-    int32_t (*xyz)[3];
-    uint8_t (*rgba)[4];
-    uint8_t *coloridx;
-    size_t max_count;
+#define CACHE_MAGIC "VXFSCENE"
+#define CACHE_VERSION 4
+#define CACHE_ARRAY_COUNT 9
+#define CACHE_TAIL_SIZE 65536 // bytes at the end of the source hashed into its identity
+
+// identifies the version of a source file that a scene cache was created from
+struct file_identity {
+    uint64_t size;
+    int64_t mtime_ns;
+    int64_t start; // offset of the vox data
+    uint64_t tail_hash; // of the end of the file, where MagicaVoxel stores the scene chunks
 };
 
-static void read_model_voxels(VxfFile *vf, const struct transform *transform, const struct readbuffers *buffers, size_t offset, size_t count) {
-    assert(count <= buffers->max_count);
-    while (count > 0) {
-        size_t n = MIN(count, GET_BYTES_MAX / 4);
-        const uint8_t (*xyzidata)[4] = (const uint8_t(*)[4])get_bytes(vf, n * 4);
-        for (size_t i = 0; i < n; i++) {
-            const uint8_t *modelpos = xyzidata[i];
-            apply_transform(transform, modelpos, buffers->xyz[offset + i]);
+// header of a scene cache file, followed by the instance table of the first frame without filters and node selection,
+// in scene graph order, and the contents of the arrays as they are after opening. The file is mapped, and the
+// instance table is used from the mapping.
+struct cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t frame_count;
+    uint64_t layout; // hash of structure sizes and options; caches from other builds, platforms or options are rejected
+    struct file_identity source;
+    uint64_t lens[CACHE_ARRAY_COUNT]; // see get_cache_arrays
+    uint64_t instance_count, instances_hash;
+    uint64_t voxel_count; // of the instances
+    int32_t bounds_min[3], bounds_max[3]; // as returned by vxf_calculate_bounds
+    uint64_t data_size; // of the instance table and the array contents
+    uint64_t data_hash; // of the array contents
+    uint64_t header_hash; // of the fields above
+};
+
+static_assert(sizeof(struct cache_header) % alignof(struct instance) == 0, "the instance table is aligned");
+
+struct cache_array {
+    void *items;
+    size_t *len; // NULL for the palette
+    size_t itemsize;
+};
+
+// the arrays stored in a cache file; the palette is stored if it was read from the file
+static void get_cache_arrays(VxfFile *vf, struct cache_array arrays[CACHE_ARRAY_COUNT]) {
+    #define CACHE_ARRAY(array) {(array).items, &(array).len, sizeof *(array).items}
+    const struct cache_array result[CACHE_ARRAY_COUNT] = {
+        CACHE_ARRAY(vf->models), CACHE_ARRAY(vf->model_sizes), CACHE_ARRAY(vf->nodes),
+        CACHE_ARRAY(vf->group_children_node_idx), CACHE_ARRAY(vf->keyframes), CACHE_ARRAY(vf->layers),
+        CACHE_ARRAY(vf->names), CACHE_ARRAY(vf->node_names), {vf->palette_buffer, NULL, 256 * 4},
+    };
+    #undef CACHE_ARRAY
+    memcpy(arrays, result, sizeof result);
+}
+
+static uint64_t cache_layout(const VxfFile *vf) {
+    const uint64_t sizes[] = {
+        vf->fingerprint_models, vf->sample_models,
+        sizeof(size_t), sizeof(void*), sizeof(struct model), sizeof(struct model_size), sizeof(struct node),
+        sizeof(struct keyframe), sizeof(struct layer), sizeof(struct node_name), sizeof(struct instance),
+        0x0102030405060708, // byte order
+    };
+    return hash_bytes(sizes, sizeof sizes, 0);
+}
+
+static bool get_file_identity(const VxfFile *vf, struct file_identity *identity) {
+    if (vf->source.type != SOURCE_FD)
+        return false;
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_fstat64(vf->source.fd.fd, &st) != 0)
+        return false;
+    int64_t mtime_ns = (int64_t)st.st_mtime * 1000000000;
+#elif defined(__APPLE__)
+    struct stat st;
+    if (fstat(vf->source.fd.fd, &st) != 0)
+        return false;
+    int64_t mtime_ns = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    struct stat st;
+    if (fstat(vf->source.fd.fd, &st) != 0)
+        return false;
+    int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    // size and modification time miss changes within the resolution of the time, which is 1 s on Windows
+    uint64_t tail_hash = 0;
+    char buffer[4096];
+    for (int64_t offset = MAX(vf->source.offset, (int64_t)st.st_size - CACHE_TAIL_SIZE); offset < st.st_size;) {
+        int64_t n = read_at(vf->source.fd.fd, buffer, (size_t)MIN((int64_t)sizeof buffer, st.st_size - offset), offset);
+        if (n <= 0)
+            return false;
+        tail_hash = hash_bytes(buffer, (size_t)n, tail_hash);
+        offset += n;
+    }
+    *identity = (struct file_identity){
+        .size = (uint64_t)st.st_size, .mtime_ns = mtime_ns, .start = vf->source.offset, .tail_hash = tail_hash,
+    };
+    return true;
+}
+
+// loading a bool that is neither 0 nor 1 is undefined, so its byte is checked
+static bool is_valid_bool(const bool *value) {
+    unsigned char byte;
+    memcpy(&byte, value, 1);
+    return byte <= 1;
+}
+
+static bool is_valid_transform(const struct transform *t) {
+    for (int i = 0; i < 3; i++) {
+        if (t->rotation_cols[i] > 2 || (t->rotation_signs[i] != 1 && t->rotation_signs[i] != -1))
+            return false;
+    }
+    return true;
+}
+
+// checks the indices and values that parsing validates or produces, since the data hash of a cache file only
+// detects accidental damage; the tree itself is checked by check_scene_tree
+static bool check_cached_scene(const VxfFile *vf) {
+    if (vf->models.len == 0 || vf->models.len != vf->model_sizes.len || vf->nodes.len == 0
+            || (vf->names.len > 0 && vf->names.items[vf->names.len - 1] != '\0'))
+        return false;
+    for (size_t i = 0; i < vf->nodes.len; i++) {
+        const struct node *node = &vf->nodes.items[i];
+        if (!is_valid_bool(&node->is_hidden) || (node->name_offset != NO_NAME && node->name_offset >= vf->names.len)
+                || node->keyframes_start > node->keyframes_end || node->keyframes_end > vf->keyframes.len)
+            return false;
+        for (size_t k = node->keyframes_start; k < node->keyframes_end; k++) {
+            const struct keyframe *keyframe = &vf->keyframes.items[k];
+            if (node->type == NODE_SHAPE ? keyframe->model_idx >= vf->models.len
+                    : node->type == NODE_TRANSFORM && !is_valid_transform(&keyframe->transform))
+                return false;
         }
-        if (buffers->rgba) {
-            for (size_t i = 0; i < n; i++) {
-                uint8_t coloridx = xyzidata[i][3];
-                const uint8_t (*color)[4] = &vf->palette[coloridx];
-                memcpy(&buffers->rgba[offset + i], color, sizeof *color);
-            }
+        switch (node->type) {
+            case NODE_SHAPE:
+                if (node->shape.model_idx >= vf->models.len)
+                    return false;
+                break;
+            case NODE_TRANSFORM:
+                if (node->transform.child_node_idx >= vf->nodes.len || !is_valid_transform(&node->transform.transform)
+                        || (node->transform.layer_idx != NO_LAYER && node->transform.layer_idx >= vf->layers.len))
+                    return false;
+                break;
+            case NODE_GROUP:
+                if (node->group.children_start > node->group.children_end
+                        || node->group.children_end > vf->group_children_node_idx.len)
+                    return false;
+                break;
+            default:
+                return false;
         }
-        if (buffers->coloridx) {
-            for (size_t i = 0; i < n; i++) {
-                uint8_t coloridx = xyzidata[i][3];
-                buffers->coloridx[offset + i] = coloridx;
-            }
+    }
+    for (size_t i = 0; i < vf->group_children_node_idx.len; i++) {
+        if (vf->group_children_node_idx.items[i] >= vf->nodes.len)
+            return false;
+    }
+    for (size_t i = 0; i < vf->layers.len; i++) {
+        if (!is_valid_bool(&vf->layers.items[i].is_hidden) || !is_valid_bool(&vf->layers.items[i].excluded))
+            return false;
+    }
+    for (size_t i = 0; i < vf->node_names.len; i++) {
+        if (vf->node_names.items[i].node_idx >= vf->nodes.len
+                || vf->nodes.items[vf->node_names.items[i].node_idx].name_offset == NO_NAME)
+            return false;
+    }
+    return true;
+}
+
+// maps a whole file read-only; returns NULL if it cannot be mapped or is empty
+static const char *map_file(const char *filename, size_t *size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+    LARGE_INTEGER file_size = {.QuadPart = 0};
+    HANDLE mapping = NULL;
+    const char *result = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && (uint64_t)file_size.QuadPart <= SIZE_MAX
+            && (mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL) {
+        result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    *size = (size_t)file_size.QuadPart;
+    return result;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *result = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX) {
+        *size = (size_t)st.st_size;
+        result = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    return result != MAP_FAILED ? result : NULL;
+#endif
+}
+
+static void unmap_file(const char *data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+// replaces parsing if the cache file is valid for the source; returns false otherwise, leaving no data allocated.
+// The file stays mapped until the handle is closed, for its instance table.
+static bool load_scene_cache(VxfFile *vf, const char *filename, const struct file_identity *identity) {
+    size_t size;
+    const char *mapping = map_file(filename, &size);
+    if (!mapping)
+        return false;
+    struct cache_header header;
+    bool valid = size >= sizeof header;
+    if (valid) {
+        memcpy(&header, mapping, sizeof header);
+        valid = memcmp(header.magic, CACHE_MAGIC, sizeof header.magic) == 0 && header.version == CACHE_VERSION
+            && header.header_hash == hash_bytes(&header, offsetof(struct cache_header, header_hash), 0)
+            && header.layout == cache_layout(vf) && memcmp(&header.source, identity, sizeof *identity) == 0
+            && header.data_size == size - sizeof header && header.frame_count > 0;
+    }
+    // the lengths must add up to the size of the file, which also limits the allocation
+    struct cache_array arrays[CACHE_ARRAY_COUNT];
+    get_cache_arrays(vf, arrays);
+    const uint64_t *lens = header.lens;
+    uint64_t left = valid ? header.data_size : 0;
+    valid = valid && lens[7] <= lens[2] && lens[8] <= 1 && header.instance_count <= left / sizeof(struct instance);
+    left -= valid ? header.instance_count * sizeof(struct instance) : 0;
+    for (size_t i = 0; valid && i < CACHE_ARRAY_COUNT; i++) {
+        valid = lens[i] <= left / arrays[i].itemsize;
+        left -= valid ? lens[i] * arrays[i].itemsize : 0;
+    }
+    if (!valid || left != 0) {
+        unmap_file(mapping, size);
+        return false;
+    }
+
+    // the mapping is released by vxf_close if allocating fails
+    vf->cache.mapping = mapping, vf->cache.mapping_size = size;
+    allocate_data(vf, &(struct chunk_counts){
+        .models = lens[0], .model_sizes = lens[1], .nodes = lens[2], .group_children = lens[3],
+        .keyframes = lens[4], .layers = lens[5], .name_bytes = lens[6], .has_palette = lens[8] != 0,
+    });
+    get_cache_arrays(vf, arrays);
+    const char *data = mapping + sizeof header + header.instance_count * sizeof(struct instance);
+    uint64_t hash = 0;
+    for (size_t i = 0; i < CACHE_ARRAY_COUNT; i++) {
+        size_t array_size = (size_t)lens[i] * arrays[i].itemsize;
+        if (array_size > 0)
+            memcpy(arrays[i].items, data, array_size);
+        hash = hash_bytes(arrays[i].items, array_size, hash);
+        data += array_size;
+        if (arrays[i].len)
+            *arrays[i].len = (size_t)lens[i];
+    }
+    if (hash != header.data_hash || !check_cached_scene(vf)) {
+        for (size_t i = 0; i < CACHE_ARRAY_COUNT; i++) {
+            if (arrays[i].len)
+                *arrays[i].len = 0;
         }
-        offset += n, count -= n;
-    }
-}
-
-static enum { CONTINUE_FRAME_COMPLETE, CONTINUE_FRAME_INCOMPLETE, CONTINUE_FRAME_CHILD }
-continue_frame(VxfFile *vf, struct readstate_frame *frame, const struct readbuffers *buffers, size_t *count_read, size_t *child_node_idx) {
-    const struct node *node = &vf->nodes.items[frame->node_idx];
-    switch (node->type) {
-        case NODE_SHAPE: {
-            const struct model *model = &vf->models.items[node->shape.model_idx];
-            size_t count = MIN(buffers->max_count - *count_read, model->voxel_count - frame->pos);
-            read_model_voxels(vf, &frame->transform, buffers, *count_read, count);
-            frame->pos += count;
-            *count_read += count;
-            return frame->pos < model->voxel_count ?
-                CONTINUE_FRAME_INCOMPLETE : CONTINUE_FRAME_COMPLETE;
-        } case NODE_TRANSFORM:
-            if (frame->pos++ > 0)
-                return CONTINUE_FRAME_COMPLETE;
-            if (node->transform.is_hidden || (node->transform.has_layer && vf->layers.items[node->transform.layer_idx].is_hidden))
-                return CONTINUE_FRAME_COMPLETE;
-            *child_node_idx = node->transform.child_node_idx;
-            return CONTINUE_FRAME_CHILD;
-        case NODE_GROUP:
-            if (node->group.children_start + frame->pos >= node->group.children_end)
-                return CONTINUE_FRAME_COMPLETE;
-            *child_node_idx = vf->group_children_node_idx.items[node->group.children_start + frame->pos++];
-            return CONTINUE_FRAME_CHILD;
-        default: unreachable();
+        vf->allocator.free(vf->allocator.user_data, vf->data, vf->data_size);
+        vf->data = NULL, vf->data_size = 0, vf->palette_buffer = NULL;
+        unmap_file(mapping, size);
+        vf->cache.mapping = NULL;
+        return false;
+    }
+
+    for (size_t i = 0; i < vf->node_names.len; i++) {
+        struct node_name *entry = &vf->node_names.items[i];
+        entry->name = vf->names.items + vf->nodes.items[entry->node_idx].name_offset;
     }
+    if (vf->palette_buffer)
+        vf->palette = (const uint8_t(*)[4])vf->palette_buffer;
+    vf->frame_count = header.frame_count;
+    for (size_t i = 0; i < vf->nodes.len; i++)
+        vf->nodes.items[i].height = 0; // computed again by check_scene_tree
+    vf->cache.instances = (const struct instance*)(mapping + sizeof header);
+    vf->cache.instance_count = (size_t)header.instance_count;
+    vf->cache.instances_hash = header.instances_hash;
+    vf->cache.voxel_count = header.voxel_count;
+    memcpy(vf->cache.bounds_min, header.bounds_min, sizeof header.bounds_min);
+    memcpy(vf->cache.bounds_max, header.bounds_max, sizeof header.bounds_max);
+    return true;
+}
+
+// writes the scene of a handle that has just been opened, so that its instances are those of the first frame
+// without filters and node selection; errors are ignored, the cache is created again on the next open
+static void write_scene_cache(VxfFile *vf, const char *filename, const struct file_identity *identity) {
+    const VxfAllocator *allocator = &vf->allocator;
+    size_t instance_count;
+    struct instance *instances = get_scene_instances(vf, &instance_count);
+    if (instance_count > 0 && !instances)
+        return;
+    struct cache_header header = {
+        .magic = CACHE_MAGIC, .version = CACHE_VERSION, .frame_count = vf->frame_count, .layout = cache_layout(vf),
+        .source = *identity, .instance_count = instance_count,
+        .data_size = instance_count * sizeof *instances,
+    };
+    for (size_t i = 0; i < instance_count; i++) {
+        instances[i].voxel_start = header.voxel_count;
+        header.voxel_count += instances[i].voxel_count;
+    }
+    header.instances_hash = hash_bytes(instances, instance_count * sizeof *instances, 0);
+    vxf_calculate_bounds(vf, header.bounds_min, header.bounds_max);
+    struct cache_array arrays[CACHE_ARRAY_COUNT];
+    get_cache_arrays(vf, arrays);
+    for (size_t i = 0; i < CACHE_ARRAY_COUNT; i++) {
+        header.lens[i] = arrays[i].len ? *arrays[i].len : arrays[i].items != NULL;
+        header.data_size += header.lens[i] * arrays[i].itemsize;
+        header.data_hash = hash_bytes(arrays[i].items, (size_t)header.lens[i] * arrays[i].itemsize, header.data_hash);
+    }
+    header.header_hash = hash_bytes(&header, offsetof(struct cache_header, header_hash), 0);
+
+    // written under a temporary name, so that other processes never see a partial cache, and mappings of the
+    // previous one stay valid
+    size_t len = strlen(filename);
+    char *tmp_filename = allocator->alloc(allocator->user_data, len + 5);
+    FILE *file = NULL;
+    if (tmp_filename) {
+        memcpy(tmp_filename, filename, len);
+        memcpy(tmp_filename + len, ".tmp", 5);
+        file = fopen(tmp_filename, "wb");
+    }
+    if (file) {
+        bool written = fwrite(&header, sizeof header, 1, file) == 1
+            && (instance_count == 0 || fwrite(instances, sizeof *instances, instance_count, file) == instance_count);
+        for (size_t i = 0; written && i < CACHE_ARRAY_COUNT; i++) {
+            size_t size = (size_t)header.lens[i] * arrays[i].itemsize;
+            written = size == 0 || fwrite(arrays[i].items, 1, size, file) == size;
+        }
+        written = fclose(file) == 0 && written;
+        if (!written || (rename(tmp_filename, filename) != 0 && (remove(filename), rename(tmp_filename, filename) != 0)))
+            remove(tmp_filename);
+    }
+    if (tmp_filename)
+        allocator->free(allocator->user_data, tmp_filename, len + 5);
+    if (instances)
+        allocator->free(allocator->user_data, instances, instance_count * sizeof *instances);
+}
+
+// checks the parsed scene and prepares it for reading
+static void finish_scene(VxfFile *vf) {
+    if (vf->models.len == 0 || vf->models.len != vf->model_sizes.len)
+        return_error(&vf->retjmp, VXF_ERROR_INVALID_SCENE);
+
+    // create a root node for single-model files without a scene graph
+    if (vf->nodes.len == 0) {
+        *ARRAY_APPEND(vf->nodes, vf->retjmp) = (struct node){
+            .id = 0, .type = NODE_SHAPE, .name_offset = NO_NAME, .shape = {.model_idx = 0}
+        };
+    }
+
+    replace_ids(vf);
+    index_names(vf);
+    sort_keyframes(vf);
+    apply_frame(vf, 0);
+    check_scene_tree(vf);
+    vf->scope = (struct scope){.node_idx = 0, .visible = true, .transform = TRANSFORM_IDENTITY};
+    vf->open.phase = OPEN_DONE;
+    vf->open.previous = NULL;
 }
 
-static size_t read_common(VxfFile *vf, const struct readbuffers *buffers, VxfError *error) {
-    if (vf->readstate.eof) {
+// cache_filename: scene cache to load instead of parsing if valid, and to write otherwise; or NULL
+static bool open_common(VxfFile *vf, const char *cache_filename, VxfError *error) {
+    if (setjmp(vf->retjmp.jump)) { // handle error
+        assert(vf->retjmp.error != VXF_SUCCESS);
+        if (error) *error = vf->retjmp.error;
+        return false;
+    }
+
+    struct file_identity identity;
+    bool use_cache = cache_filename && get_file_identity(vf, &identity);
+    if (use_cache && load_scene_cache(vf, cache_filename, &identity)) {
+        check_scene_tree(vf); // the cache can be outdated if the file has changed without changing its identity
+        vf->scope = (struct scope){.node_idx = 0, .visible = true, .transform = TRANSFORM_IDENTITY};
+        vf->open.phase = OPEN_DONE;
+        vf->open.previous = NULL;
         if (error) *error = VXF_SUCCESS;
-        return 0;
+        return true;
     }
+    parse_vox(vf);
+    finish_scene(vf);
+    if (use_cache)
+        write_scene_cache(vf, cache_filename, &identity);
+    if (error) *error = VXF_SUCCESS;
+    return true;
+}
+
+// parses as far as the bytes fed so far allow; errors other than VXF_ERROR_WOULD_BLOCK are final
+static VxfError continue_async_open(VxfFile *vf) {
     if (setjmp(vf->retjmp.jump)) {
         assert(vf->retjmp.error != VXF_SUCCESS);
-        vf->readstate.error = vf->retjmp.error;
+        if (vf->retjmp.error != VXF_ERROR_WOULD_BLOCK)
+            vf->open.error = vf->retjmp.error;
+        return vf->retjmp.error;
     }
-    if (vf->readstate.error) {
-        if (error) *error = vf->readstate.error;
-        return 0;
+    parse_vox(vf);
+    finish_scene(vf);
+    return VXF_SUCCESS;
+}
+
+static void close_source(const struct source *source) {
+    if (source->type == SOURCE_FD && source->fd.from_filename) {
+#ifdef _WIN32
+        _close(source->fd.fd);
+#else
+        close(source->fd.fd);
+#endif
+    }
+}
+
+static VxfFile *alloc_file(const struct source *source, const VxfOpenOptions *options, VxfError *error) {
+    const VxfAllocator *allocator = options && options->allocator ? options->allocator : &default_allocator;
+    size_t alloc_size = sizeof(VxfFile) + (source->type == SOURCE_FD ? FD_BUFFER_SIZE : 0);
+    VxfFile *vf = NULL;
+    if (!allocator->alloc || !allocator->free || (options && (unsigned)options->read_order > VXF_READ_ORDER_FILE)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+    } else if (vf = allocator->alloc(allocator->user_data, alloc_size), !vf) {
+        if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
     }
-    if (!vf->readstate.stack) {
-        vf->readstate.stack = xcalloc(vf->nodes.items[0].height + 1, sizeof *vf->readstate.stack, &vf->retjmp);
-        vf->readstate.stack[0] = start_frame(vf, 0, &TRANSFORM_IDENTITY);
+    if (!vf) {
+        close_source(source);
+        return NULL;
     }
+    *vf = (VxfFile){
+        .source = *source, .allocator = *allocator, .alloc_size = alloc_size,
+        .read_order = options ? options->read_order : VXF_READ_ORDER_SCENE,
+        .fingerprint_models = options && options->fingerprint_models,
+        .sample_models = options && (options->fingerprint_models || options->previous),
+        .prefetch.distance = options ? options->prefetch_distance : 0,
+        .palette = default_palette,
+        .open.offset = source->offset,
+        .open.previous = options ? options->previous : NULL,
+    };
+    if (source->type == SOURCE_FD)
+        vf->source.fd.buffer = (char*)(vf + 1);
+    return vf;
+}
 
-    size_t count_read = 0;
-    while (count_read < buffers->max_count) {
-        size_t child_node_idx;
-        switch (continue_frame(vf, &vf->readstate.stack[vf->readstate.depth], buffers, &count_read, &child_node_idx)) {
-            case CONTINUE_FRAME_INCOMPLETE:
-                assert(count_read == buffers->max_count);
-                break;
-            case CONTINUE_FRAME_COMPLETE:
-                if (vf->readstate.depth == 0) {
-                    vf->readstate.eof = true;
-                    goto finish;
-                }
-                vf->readstate.depth--;
-                break;
-            case CONTINUE_FRAME_CHILD: {
-                struct transform *parent_transform = &vf->readstate.stack[vf->readstate.depth].transform;
-                vf->readstate.stack[++vf->readstate.depth] = start_frame(vf, child_node_idx, parent_transform);
-                break;
-            }
-        }
+static VxfFile *create_file(const struct source *source, const VxfOpenOptions *options, VxfError *error) {
+    VxfFile *vf = alloc_file(source, options, error);
+    if (vf && !open_common(vf, options ? options->cache_filename : NULL, error)) {
+        vxf_close(vf);
+        return NULL;
     }
-finish:
-    if (error) *error = VXF_SUCCESS;
-    return count_read;
+    return vf;
 }
 
-size_t vxf_read_xyz_rgba(VxfFile *vf, size_t max_count, int32_t xyz_buf[][3], uint8_t rgba_buf[][4], VxfError *error) {
-    if (!vf || ((!xyz_buf || !rgba_buf)  && max_count > 0)) {
-        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
-        return 0;
+static VxfFile *open_fd(int fd, bool from_filename, const VxfOpenOptions *options, VxfError *error) {
+#ifdef _WIN32
+    int64_t offset = _lseeki64(fd, 0, SEEK_CUR);
+#else
+    int64_t offset = lseek(fd, 0, SEEK_CUR);
+#endif
+    struct source source = {
+        .type = SOURCE_FD, .offset = offset, .fd = {.fd = fd, .from_filename = from_filename}
+    };
+    if (offset < 0) {
+        if (error) *error = VXF_ERROR_FILE_SEEK;
+        close_source(&source);
+        return NULL;
     }
-    return read_common(vf, &(struct readbuffers){
-        .xyz = xyz_buf,
-        .rgba = rgba_buf,
-        .max_count = max_count,
-    }, error);
+    return create_file(&source, options, error);
 }
 
-size_t vxf_read_xyz_coloridx(VxfFile *vf, size_t max_count, int32_t xyz_buf[][3], uint8_t coloridx_buf[], VxfError *error) {
-    if (!vf || ((!xyz_buf || !coloridx_buf)  && max_count > 0)) {
+VxfFile *vxf_open_file_ex(const char *filename, const VxfOpenOptions *options, VxfError *error) {
+#ifdef _WIN32
+    int fd = _open(filename, _O_RDONLY | _O_BINARY);
+#else
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+#endif
+    if (fd < 0) {
+        if (error) *error = VXF_ERROR_FILE_OPEN;
+        return NULL;
+    }
+    return open_fd(fd, true, options, error);
+}
+
+VxfFile *vxf_open_fd(int fd, const VxfOpenOptions *options, VxfError *error) {
+    return open_fd(fd, false, options, error);
+}
+
+VxfFile *vxf_open_stream_ex(FILE *stream, const VxfOpenOptions *options, VxfError *error) {
+    clearerr(stream);
+    int64_t offset = ftello(stream);
+    if (offset < 0) {
+        if (error) *error = VXF_ERROR_FILE_SEEK;
+        return NULL;
+    }
+    return create_file(&(struct source){
+        .type = SOURCE_STREAM, .offset = offset, .stream = {.stream = stream, .stream_offset = offset}
+    }, options, error);
+}
+
+VxfFile *vxf_open_memory_ex(size_t size, const char buffer[], const VxfOpenOptions *options, VxfError *error) {
+    return create_file(&(struct source){
+        .type = SOURCE_MEMORY, .memory = {.size = size, .buffer = buffer}
+    }, options, error);
+}
+
+VxfFile *vxf_open_io(const VxfIo *io, void *ctx, const VxfOpenOptions *options, VxfError *error) {
+    if (!io || !io->read || !io->seek || !io->tell) {
         if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    int64_t offset = io->tell(ctx);
+    if (offset < 0) {
+        if (error) *error = VXF_ERROR_FILE_SEEK;
+        return NULL;
+    }
+    return create_file(&(struct source){
+        .type = SOURCE_IO, .offset = offset, .io = {.callbacks = *io, .ctx = ctx, .stream_offset = offset}
+    }, options, error);
+}
+
+VxfFile *vxf_open_async(const VxfOpenOptions *options, VxfError *error) {
+    VxfOpenOptions async_options = options ? *options : (VxfOpenOptions){0};
+    async_options.cache_filename = NULL;
+    async_options.prefetch_distance = 0;
+    VxfFile *vf = alloc_file(&(struct source){
+        .type = SOURCE_ASYNC, .async = {.end = INT64_MAX, .limit = INT64_MAX}
+    }, &async_options, error);
+    if (vf) {
+        VxfError result = continue_async_open(vf);
+        if (error) *error = result;
+    }
+    return vf;
+}
+
+int vxf_async_get_request(const VxfFile *vf, uint64_t *offset, size_t *size) {
+    if (!vf || vf->source.type != SOURCE_ASYNC || vf->open.error || vf->source.async.request_size == 0)
         return 0;
+    *offset = (uint64_t)vf->source.async.request_offset;
+    *size = vf->source.async.request_size;
+    return 1;
+}
+
+VxfError vxf_async_feed(VxfFile *vf, const void *data, size_t size) {
+    if (!vf || vf->source.type != SOURCE_ASYNC)
+        return VXF_ERROR_INVALID_ARGUMENT;
+    if (vf->open.error)
+        return vf->open.error;
+    struct source *src = &vf->source;
+    if (src->async.request_size == 0 || size > src->async.request_size || (size > 0 && !data))
+        return VXF_ERROR_INVALID_ARGUMENT;
+    const VxfAllocator *allocator = &vf->allocator;
+    if (size > src->async.capacity) {
+        char *buffer = allocator->alloc(allocator->user_data, size);
+        if (!buffer)
+            return VXF_ERROR_OUT_OF_MEMORY;
+        if (src->async.buffer)
+            allocator->free(allocator->user_data, src->async.buffer, src->async.capacity);
+        src->async.buffer = buffer;
+        src->async.capacity = size;
     }
-    return read_common(vf, &(struct readbuffers){
-        .xyz = xyz_buf,
-        .coloridx = coloridx_buf,
-        .max_count = max_count,
-    }, error);
+    if (size > 0)
+        memcpy(src->async.buffer, data, size);
+    src->async.buffer_offset = src->async.request_offset;
+    src->async.buffer_len = size;
+    if (size < src->async.request_size)
+        src->async.end = src->async.request_offset + (int64_t)size;
+    src->async.request_size = 0;
+    src->error = VXF_SUCCESS; // the bytes that were missing may be there now
+    return vf->open.phase == OPEN_DONE ? VXF_SUCCESS : continue_async_open(vf);
+}
+
+VxfFile *vxf_open_file(const char *filename, VxfError *error) {
+    return vxf_open_file_ex(filename, NULL, error);
+}
+
+VxfFile *vxf_open_stream(FILE *stream, VxfError *error) {
+    return vxf_open_stream_ex(stream, NULL, error);
+}
+
+VxfFile *vxf_open_memory(size_t size, const char buffer[], VxfError *error) {
+    return vxf_open_memory_ex(size, buffer, NULL, error);
+}
+
+void vxf_get_palette(const VxfFile *vf, uint8_t rgba_buf[256][4]) {
+    const uint8_t (*palette)[4] = vf ? vf->palette : default_palette;
+    memcpy(rgba_buf, palette, 256 * sizeof *palette);
+}
+
+static bool source_supports_prefetch(const struct source *src) {
+    switch (src->type) {
+        case SOURCE_STREAM:
+        case SOURCE_FD:
+#ifdef POSIX_FADV_WILLNEED
+            return true;
+#else
+            return false;
+#endif
+        case SOURCE_IO:
+            return src->io.callbacks.prefetch != NULL;
+        default:
+            return false;
+    }
+}
+
+static void prefetch_model(VxfFile *vf, const struct model *model) {
+    struct source *src = &vf->source;
+    size_t size = model->voxel_count * 4;
+    if (size == 0) // a length of 0 would mean up to the end of the file for posix_fadvise
+        return;
+    switch (src->type) {
+#ifdef POSIX_FADV_WILLNEED
+        case SOURCE_STREAM:
+            posix_fadvise(fileno(src->stream.stream), model->offset, size, POSIX_FADV_WILLNEED);
+            break;
+        case SOURCE_FD:
+            posix_fadvise(src->fd.fd, model->offset, size, POSIX_FADV_WILLNEED);
+            break;
+#endif
+        case SOURCE_IO:
+            src->io.callbacks.prefetch(src->io.ctx, model->offset, size);
+            break;
+        default:
+            break;
+    }
+}
+
+// issues prefetch hints for the models of the instances following the one the reader starts
+static void advance_prefetch(VxfFile *vf, size_t current) {
+    if (vf->prefetch.distance == 0 || !source_supports_prefetch(&vf->source))
+        return;
+    size_t end = MIN(vf->instances.count, current + 1 + vf->prefetch.distance);
+    for (size_t i = MAX(vf->prefetch.next, current + 1); i < end; i++) {
+        size_t model_idx = vf->instances.items[i].model_idx;
+        if (model_idx != vf->instances.items[i - 1].model_idx)
+            prefetch_model(vf, &vf->models.items[model_idx]);
+    }
+    vf->prefetch.next = MAX(vf->prefetch.next, end);
+}
+
+static int cmp_instance_file_order(const void *p1, const void *p2) {
+    const struct instance *i1 = p1, *i2 = p2;
+    // models are stored in file order
+    if (i1->model_idx != i2->model_idx)
+        return (i1->model_idx > i2->model_idx) - (i1->model_idx < i2->model_idx);
+    return (i1->id > i2->id) - (i1->id < i2->id);
+}
+
+static uint64_t hash_transform(const struct transform *t, uint64_t seed) {
+    const int32_t fields[4] = {
+        t->translation[0], t->translation[1], t->translation[2],
+        t->rotation_cols[0] | t->rotation_cols[1] << 2 | t->rotation_cols[2] << 4
+            | (t->rotation_signs[0] < 0) << 6 | (t->rotation_signs[1] < 0) << 7 | (t->rotation_signs[2] < 0) << 8,
+    };
+    return hash_bytes(fields, sizeof fields, seed);
+}
+
+// identifies the voxels that read positions refer to, so that positions of other files, frames or filters are
+// rejected
+static uint64_t read_scope_hash(const VxfFile *vf) {
+    uint64_t hash = vf->filter.has_color_mask ? hash_bytes(vf->filter.color_mask, sizeof vf->filter.color_mask, 0) : 0;
+    for (size_t i = 0; i < vf->instances.count; i++) {
+        const struct instance *instance = &vf->instances.items[i];
+        const int64_t fields[2] = {instance->offset, (int64_t)instance->voxel_count};
+        hash = hash_transform(&instance->transform, hash_bytes(fields, sizeof fields, hash));
+    }
+    return hash;
+}
+
+// checks the instance table of a scene cache like check_cached_scene checks the arrays
+static bool check_cached_instances(const VxfFile *vf) {
+    const struct instance *instances = vf->cache.instances;
+    if (hash_bytes(instances, vf->cache.instance_count * sizeof *instances, 0) != vf->cache.instances_hash)
+        return false;
+    uint64_t voxel_start = 0;
+    for (size_t i = 0; i < vf->cache.instance_count; i++) {
+        const struct instance *instance = &instances[i];
+        if (instance->id != i || instance->model_idx >= vf->models.len || instance->voxel_start != voxel_start
+                || !is_valid_transform(&instance->transform))
+            return false;
+        const struct model *model = &vf->models.items[instance->model_idx];
+        if (instance->offset != model->offset || instance->voxel_count != model->voxel_count)
+            return false;
+        voxel_start += instance->voxel_count;
+    }
+    return voxel_start == vf->cache.voxel_count;
+}
+
+// the instance table of the scene cache if it applies and is intact, otherwise NULL; checked on first use
+static const struct instance *get_cached_instances(VxfFile *vf) {
+    if (!cache_applies(vf))
+        return NULL;
+    if (!vf->cache.instances_checked) {
+        vf->cache.instances_checked = true;
+        if (!check_cached_instances(vf))
+            vf->cache.instances = NULL;
+    }
+    return vf->cache.instances;
+}
+
+// creates the list of visible instances in read order
+static void build_instances(VxfFile *vf) {
+    const VxfAllocator *allocator = &vf->allocator;
+    const struct instance *cached = get_cached_instances(vf);
+    if (cached && vf->read_order == VXF_READ_ORDER_SCENE) {
+        // read from the mapping, which is never written to
+        vf->instances.items = (struct instance*)cached;
+        vf->instances.count = vf->cache.instance_count;
+        vf->instances.mapped = true;
+        vf->instances.scope_hash = read_scope_hash(vf);
+        vf->instances.built = true;
+        return;
+    }
+    size_t count = cached ? vf->cache.instance_count : walk_scene(vf, NULL, NULL);
+    if (count > UINT32_MAX) // including WALK_OUT_OF_MEMORY
+        return_error(&vf->retjmp, VXF_ERROR_OUT_OF_MEMORY);
+    struct instance *instances = count > 0 ? allocator->alloc(allocator->user_data, count * sizeof *instances) : NULL;
+    if (count > 0 && !instances)
+        return_error(&vf->retjmp, VXF_ERROR_OUT_OF_MEMORY);
+    if (instances && cached) {
+        memcpy(instances, cached, count * sizeof *instances);
+    } else if (instances && !walk_instances(vf, instances)) {
+        allocator->free(allocator->user_data, instances, count * sizeof *instances);
+        return_error(&vf->retjmp, VXF_ERROR_OUT_OF_MEMORY);
+    }
+
+    if (vf->read_order == VXF_READ_ORDER_FILE && count > 1)
+        qsort(instances, count, sizeof *instances, cmp_instance_file_order);
+    uint64_t voxel_start = 0;
+    for (size_t i = 0; i < count; i++) {
+        instances[i].voxel_start = voxel_start;
+        voxel_start += instances[i].voxel_count;
+    }
+    vf->instances.items = instances;
+    vf->instances.count = count;
+    vf->instances.scope_hash = read_scope_hash(vf);
+    vf->instances.built = true;
+}
+
+static float srgb_to_linear(uint8_t value) {
+    float c = value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static size_t color_format_size(VxfColorFormat format) {
+    switch (format) {
+        case VXF_COLOR_FORMAT_RGBA8:
+        case VXF_COLOR_FORMAT_BGRA8:
+        case VXF_COLOR_FORMAT_REMAP_U32:
+            return 4;
+        case VXF_COLOR_FORMAT_RGB565:
+            return 2;
+        case VXF_COLOR_FORMAT_RGBA_F32_LINEAR:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+// returns a table with the color for each color index in the given format
+static const void *get_color_lut(VxfFile *vf, VxfColorFormat format) {
+    if (vf->color_lut.valid && vf->color_lut.format == format)
+        return &vf->color_lut.u32;
+    for (int i = 0; i < 256; i++) {
+        const uint8_t *c = vf->palette[i];
+        switch (format) {
+            case VXF_COLOR_FORMAT_RGBA8:
+                memcpy(&vf->color_lut.u32[i], c, 4);
+                break;
+            case VXF_COLOR_FORMAT_BGRA8:
+                memcpy(&vf->color_lut.u32[i], (uint8_t[4]){c[2], c[1], c[0], c[3]}, 4);
+                break;
+            case VXF_COLOR_FORMAT_RGB565:
+                vf->color_lut.u16[i] = (uint16_t)((c[0] >> 3) << 11 | (c[1] >> 2) << 5 | c[2] >> 3);
+                break;
+            case VXF_COLOR_FORMAT_RGBA_F32_LINEAR:
+                for (int j = 0; j < 3; j++)
+                    vf->color_lut.f32[i][j] = srgb_to_linear(c[j]);
+                vf->color_lut.f32[i][3] = c[3] / 255.0f;
+                break;
+            default: unreachable();
+        }
+    }
+    vf->color_lut.format = format;
+    vf->color_lut.valid = true;
+    return &vf->color_lut.u32;
+}
+
+#if defined(__AVX2__) || defined(VOXFLAT_AVX2_DISPATCH)
+// gathers the entries for groups of 8 voxels and returns the number of voxels handled
+#ifdef VOXFLAT_AVX2_DISPATCH
+__attribute__((target("avx2")))
+#endif
+static size_t gather_u32_avx2(const void *lut, const uint8_t (*xyzidata)[4], size_t count, char *out) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // the color index is the most significant byte of each little-endian xyzi value
+        __m256i indices = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)xyzidata[i]), 24);
+        _mm256_storeu_si256((__m256i*)(out + 4 * i), _mm256_i32gather_epi32((const int*)lut, indices, 4));
+    }
+    return i;
+}
+#endif
+
+// looks up the 4-byte table entries for the color indices of xyzi data
+static void gather_u32(const void *lut, const uint8_t (*xyzidata)[4], size_t count, char *out) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    i = gather_u32_avx2(lut, xyzidata, count, out);
+#elif defined(VOXFLAT_AVX2_DISPATCH)
+    if (count >= 8 && __builtin_cpu_supports("avx2"))
+        i = gather_u32_avx2(lut, xyzidata, count, out);
+#endif
+    for (; i < count; i++)
+        memcpy(out + 4 * i, (const char*)lut + 4 * xyzidata[i][3], 4);
+}
+
+#define MORTON_X_MASK UINT64_C(0x1249249249249249)
+
+// spreads the lower 21 bits of value to every third bit
+static uint64_t morton_spread(uint32_t value) {
+#ifdef __BMI2__
+    return _pdep_u64(value, MORTON_X_MASK);
+#else
+    uint64_t x = value & KEY_AXIS_MASK;
+    x = (x | x << 32) & UINT64_C(0x001f00000000ffff);
+    x = (x | x << 16) & UINT64_C(0x001f0000ff0000ff);
+    x = (x | x << 8) & UINT64_C(0x100f00f00f00f00f);
+    x = (x | x << 4) & UINT64_C(0x10c30c30c30c30c3);
+    x = (x | x << 2) & MORTON_X_MASK;
+    return x;
+#endif
+}
+
+// inverse of morton_spread
+static uint32_t morton_compact(uint64_t bits) {
+#ifdef __BMI2__
+    return (uint32_t)_pext_u64(bits, MORTON_X_MASK);
+#else
+    uint64_t x = bits & MORTON_X_MASK;
+    x = (x | x >> 2) & UINT64_C(0x10c30c30c30c30c3);
+    x = (x | x >> 4) & UINT64_C(0x100f00f00f00f00f);
+    x = (x | x >> 8) & UINT64_C(0x001f0000ff0000ff);
+    x = (x | x >> 16) & UINT64_C(0x001f00000000ffff);
+    x = (x | x >> 32) & KEY_AXIS_MASK;
+    return (uint32_t)x;
+#endif
+}
+
+// returns false if pos does not fit into a key, which happens for voxels outside of the size of their model
+static bool encode_key(VxfKeyFormat format, const int32_t pos[3], uint64_t *key) {
+    uint32_t x = (uint32_t)pos[0], y = (uint32_t)pos[1], z = (uint32_t)pos[2];
+    if ((x | y | z) > KEY_AXIS_MASK)
+        return false;
+    if (format == VXF_KEY_FORMAT_MORTON)
+        *key = morton_spread(x) | morton_spread(y) << 1 | morton_spread(z) << 2;
+    else
+        *key = (uint64_t)x | (uint64_t)y << KEY_AXIS_BITS | (uint64_t)z << (2 * KEY_AXIS_BITS);
+    return true;
+}
+
+void vxf_decode_key(uint64_t key, VxfKeyFormat format, const int32_t origin[3], int32_t xyz[3]) {
+    for (int i = 0; i < 3; i++) {
+        uint32_t value = format == VXF_KEY_FORMAT_MORTON
+            ? morton_compact(key >> i) : (uint32_t)(key >> (i * KEY_AXIS_BITS)) & KEY_AXIS_MASK;
+        xyz[i] = origin[i] + (int32_t)value;
+    }
+}
+
+struct readbuffers {
+    int32_t (*xyz)[3];
+    uint8_t (*rgba)[4];
+    uint8_t *coloridx;
+    void *color;
+    const void *color_lut;
+    size_t color_size;
+    uint64_t *keys;
+    VxfKeyFormat key_format;
+    uint8_t *face_mask;
+    bool surface_only;
+    size_t max_count;
+    uint64_t byte_budget; // or 0
+    uint32_t time_budget_us; // or 0
+};
+
+// monotonic clock in microseconds
+static uint64_t now_us(void) {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    uint64_t ticks = (uint64_t)counter.QuadPart, ticks_per_second = (uint64_t)frequency.QuadPart;
+    return ticks / ticks_per_second * 1000000 + ticks % ticks_per_second * 1000000 / ticks_per_second;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
+static bool surface_bit(const VxfFile *vf, const uint64_t *bitset, int x, int y, int z) {
+    const int *size = vf->surface.size;
+    if ((unsigned)x >= (unsigned)size[0] || (unsigned)y >= (unsigned)size[1] || (unsigned)z >= (unsigned)size[2])
+        return false;
+    size_t row = (size_t)z * size[1] + y;
+    return bitset[row * vf->surface.row_words + x / 64] >> (x % 64) & 1;
+}
+
+// fills the occupancy and exposed bitsets for a model; returns an error code instead of using longjmp
+static VxfError build_surface(VxfFile *vf, size_t model_idx) {
+    const struct model *model = &vf->models.items[model_idx];
+    const struct model_size *model_size = &vf->model_sizes.items[model_idx];
+    int *size = vf->surface.size;
+    for (int i = 0; i < 3; i++)
+        size[i] = (int)CLAMP(model_size->size[i], 1, 256);
+    size_t row_words = ((size_t)size[0] + 63) / 64, rows = (size_t)size[1] * size[2];
+    size_t words = rows * row_words;
+    const VxfAllocator *allocator = &vf->allocator;
+
+    vf->surface.valid = false;
+    if (words > vf->surface.capacity) {
+        if (vf->surface.occupancy) {
+            allocator->free(allocator->user_data, vf->surface.occupancy, 2 * vf->surface.capacity * sizeof(uint64_t));
+            vf->surface.occupancy = vf->surface.exposed = NULL;
+            vf->surface.capacity = 0;
+        }
+        uint64_t *bitsets = allocator->alloc(allocator->user_data, 2 * words * sizeof(uint64_t));
+        if (!bitsets)
+            return VXF_ERROR_OUT_OF_MEMORY;
+        vf->surface.occupancy = bitsets;
+        vf->surface.exposed = bitsets + words;
+        vf->surface.capacity = words;
+    }
+    vf->surface.row_words = row_words;
+    uint64_t *occupancy = vf->surface.occupancy, *exposed = vf->surface.exposed;
+    memset(occupancy, 0, words * sizeof *occupancy);
+
+    vf->source.offset = model->offset;
+    for (size_t remaining = model->voxel_count; remaining > 0;) {
+        size_t n = MIN(remaining, GET_BYTES_MAX / 4);
+        const uint8_t (*xyzidata)[4] = (const uint8_t(*)[4])try_get_bytes(vf, n * 4);
+        if (!xyzidata)
+            return vf->source.error ? vf->source.error : VXF_ERROR_UNEXPECTED_EOF;
+        for (size_t i = 0; i < n; i++) {
+            int x = xyzidata[i][0], y = xyzidata[i][1], z = xyzidata[i][2];
+            if (x < size[0] && y < size[1] && z < size[2])
+                occupancy[((size_t)z * size[1] + y) * row_words + x / 64] |= UINT64_C(1) << (x % 64);
+        }
+        remaining -= n;
+    }
+
+    // a voxel is interior if all six neighbors are set; 64 voxels along x are handled at once
+    for (int z = 0; z < size[2]; z++) {
+        for (int y = 0; y < size[1]; y++) {
+            size_t row = ((size_t)z * size[1] + y) * row_words;
+            for (size_t w = 0; w < row_words; w++) {
+                uint64_t bits = occupancy[row + w];
+                uint64_t xm = bits << 1 | (w > 0 ? occupancy[row + w - 1] >> 63 : 0);
+                uint64_t xp = bits >> 1 | (w + 1 < row_words ? occupancy[row + w + 1] << 63 : 0);
+                uint64_t ym = y > 0 ? occupancy[row + w - row_words] : 0;
+                uint64_t yp = y + 1 < size[1] ? occupancy[row + w + row_words] : 0;
+                uint64_t zm = z > 0 ? occupancy[row + w - size[1] * row_words] : 0;
+                uint64_t zp = z + 1 < size[2] ? occupancy[row + w + size[1] * row_words] : 0;
+                exposed[row + w] = bits & ~(xm & xp & ym & yp & zm & zp);
+            }
+        }
+    }
+    vf->surface.model_idx = model_idx;
+    vf->surface.valid = true;
+    return VXF_SUCCESS;
+}
+
+// exposed faces of a voxel in model space, with bit 2 * axis for the negative and 2 * axis + 1 for the positive side
+static unsigned local_face_mask(const VxfFile *vf, int x, int y, int z) {
+    const uint64_t *occupancy = vf->surface.occupancy;
+    const int offsets[6][3] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+    unsigned mask = 0;
+    for (int i = 0; i < 6; i++) {
+        if (!surface_bit(vf, occupancy, x + offsets[i][0], y + offsets[i][1], z + offsets[i][2]))
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+// bit in the global face mask for each bit of a local face mask
+static void get_face_bits(const struct transform *transform, uint8_t face_bits[6]) {
+    for (int j = 0; j < 3; j++) {
+        int axis = transform->rotation_cols[j];
+        bool flip = transform->rotation_signs[j] < 0;
+        face_bits[2 * axis] = (uint8_t)(1 << (2 * j + flip));
+        face_bits[2 * axis + 1] = (uint8_t)(1 << (2 * j + !flip));
+    }
+}
+
+// copies the voxels that are on the surface of the model, and stores their global face masks; like for meshes,
+// voxels outside of the model size are not part of the model, so they have no exposed faces
+static size_t filter_surface_voxels(const VxfFile *vf, const struct transform *transform, const uint8_t (*xyzidata)[4],
+                                    size_t count, bool surface_only, uint8_t (*filtered)[4], uint8_t *face_masks) {
+    uint8_t face_bits[6];
+    get_face_bits(transform, face_bits);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        int x = xyzidata[i][0], y = xyzidata[i][1], z = xyzidata[i][2];
+        bool inside = x < vf->surface.size[0] && y < vf->surface.size[1] && z < vf->surface.size[2];
+        if (surface_only && (!inside || !surface_bit(vf, vf->surface.exposed, x, y, z)))
+            continue;
+        unsigned local_mask = inside ? local_face_mask(vf, x, y, z) : 0;
+        unsigned mask = 0;
+        for (int b = 0; b < 6; b++) {
+            if (local_mask >> b & 1)
+                mask |= face_bits[b];
+        }
+        memcpy(filtered[n], xyzidata[i], 4);
+        face_masks[n++] = (uint8_t)mask;
+    }
+    return n;
+}
+
+// keeps the voxels with a color index in the mask
+static size_t filter_colors(const uint64_t mask[4], const uint8_t (*xyzidata)[4], size_t count, uint8_t (*filtered)[4]) {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t coloridx = xyzidata[i][3];
+        memcpy(filtered[n], xyzidata[i], 4);
+        n += mask[coloridx / 64] >> (coloridx % 64) & 1;
+    }
+    return n;
+}
+
+// reads count voxels at the current source offset and stores the number of voxels written to the buffers,
+// which is less if voxels are filtered out; returns an error code instead of using longjmp
+static VxfError read_model_voxels(VxfFile *vf, const struct transform *transform, const struct readbuffers *buffers,
+                                  size_t offset, size_t count, size_t *count_written) {
+    assert(count <= buffers->max_count - offset);
+    size_t start = offset;
+    while (count > 0) {
+        size_t n = MIN(count, GET_BYTES_MAX / 4);
+        const uint8_t (*xyzidata)[4] = (const uint8_t(*)[4])try_get_bytes(vf, n * 4);
+        if (!xyzidata)
+            return vf->source.error ? vf->source.error : VXF_ERROR_UNEXPECTED_EOF;
+        count -= n;
+        uint8_t color_filtered[GET_BYTES_MAX / 4][4], filtered[GET_BYTES_MAX / 4][4];
+        if (vf->filter.has_color_mask) {
+            n = filter_colors(vf->filter.color_mask, xyzidata, n, color_filtered);
+            xyzidata = (const uint8_t(*)[4])color_filtered;
+        }
+        if (buffers->surface_only || buffers->face_mask) {
+            uint8_t face_masks[GET_BYTES_MAX / 4];
+            n = filter_surface_voxels(vf, transform, xyzidata, n, buffers->surface_only, filtered, face_masks);
+            xyzidata = (const uint8_t(*)[4])filtered;
+            if (buffers->face_mask)
+                memcpy(buffers->face_mask + offset, face_masks, n);
+        }
+        if (buffers->xyz) {
+            // transform fields in locals, because the compiler must assume that the output aliases them
+            const uint8_t c0 = transform->rotation_cols[0], c1 = transform->rotation_cols[1], c2 = transform->rotation_cols[2];
+            const int32_t s0 = transform->rotation_signs[0], s1 = transform->rotation_signs[1], s2 = transform->rotation_signs[2];
+            const int32_t t0 = transform->translation[0], t1 = transform->translation[1], t2 = transform->translation[2];
+            int32_t (*xyz)[3] = buffers->xyz + offset;
+            for (size_t i = 0; i < n; i++) {
+                const uint8_t *modelpos = xyzidata[i];
+                xyz[i][0] = modelpos[c0] * s0 + t0;
+                xyz[i][1] = modelpos[c1] * s1 + t1;
+                xyz[i][2] = modelpos[c2] * s2 + t2;
+            }
+        }
+        if (buffers->keys) {
+            // positions relative to the key origin, without going through global coordinates
+            struct transform key_transform = *transform;
+            for (int i = 0; i < 3; i++)
+                key_transform.translation[i] -= vf->key_origin.origin[i];
+            for (size_t i = 0; i < n; i++) {
+                int32_t pos[3];
+                apply_transform(&key_transform, xyzidata[i], pos);
+                if (!encode_key(buffers->key_format, pos, &buffers->keys[offset + i]))
+                    return VXF_ERROR_KEY_RANGE;
+            }
+        }
+        if (buffers->rgba)
+            gather_u32(vf->palette, xyzidata, n, (char*)buffers->rgba[offset]);
+        if (buffers->color) {
+            char *out = (char*)buffers->color + offset * buffers->color_size;
+            const char *lut = buffers->color_lut;
+            switch (buffers->color_size) {
+                case 4:
+                    gather_u32(lut, xyzidata, n, out);
+                    break;
+                case 2:
+                    for (size_t i = 0; i < n; i++)
+                        memcpy(out + 2 * i, lut + 2 * xyzidata[i][3], 2);
+                    break;
+                case 16:
+                    for (size_t i = 0; i < n; i++)
+                        memcpy(out + 16 * i, lut + 16 * xyzidata[i][3], 16);
+                    break;
+                default: unreachable();
+            }
+        }
+        if (buffers->coloridx) {
+            for (size_t i = 0; i < n; i++) {
+                uint8_t coloridx = xyzidata[i][3];
+                buffers->coloridx[offset + i] = coloridx;
+            }
+        }
+        offset += n;
+    }
+    *count_written = offset - start;
+    return VXF_SUCCESS;
+}
+
+// the only part of reading that uses longjmp for errors, done once before the first voxels are read
+static VxfError prepare_reading(VxfFile *vf) {
+    VxfError open_error = check_opened(vf);
+    if (open_error)
+        return open_error;
+    if (setjmp(vf->retjmp.jump)) {
+        assert(vf->retjmp.error != VXF_SUCCESS);
+        return vf->retjmp.error;
+    }
+    build_instances(vf);
+    return VXF_SUCCESS;
+}
+
+// number of voxels of the instance from the read position on that have been fed to an asynchronous source, or
+// SIZE_MAX if the source ends before them, so that reading fails; requests more bytes if none are available.
+// whole_model: all voxels of the model are needed, e.g. for its surface
+static size_t async_readable_voxels(VxfFile *vf, const struct instance *instance, bool whole_model) {
+    const struct source *src = &vf->source;
+    size_t left = instance->voxel_count - vf->readstate.voxel_pos;
+    if (whole_model) {
+        if (async_available(src, instance->offset) / 4 >= instance->voxel_count)
+            return left;
+        return async_request(vf, instance->offset, 4 * instance->voxel_count) ? 0 : SIZE_MAX;
+    }
+    int64_t offset = instance->offset + 4 * (int64_t)vf->readstate.voxel_pos;
+    size_t available = async_available(src, offset) / 4;
+    if (available > 0)
+        return available;
+    return async_request(vf, offset, MIN(4 * left, ASYNC_READ_SIZE)) ? 0 : SIZE_MAX;
+}
+
+// if instance_id is not NULL, returns only voxels of a single instance and stores its id
+static size_t read_common(VxfFile *vf, const struct readbuffers *buffers, uint32_t *instance_id, VxfError *error) {
+    VxfError open_error = check_opened(vf);
+    if (open_error) {
+        if (error) *error = open_error;
+        return 0;
+    }
+    if (!vf->instances.built && !vf->readstate.error)
+        vf->readstate.error = prepare_reading(vf);
+    if (vf->readstate.error || vf->readstate.eof) {
+        if (error) *error = vf->readstate.error;
+        return 0;
+    }
+
+    // budgets apply to the voxels consumed, including those skipped by the surface or color filters; they stop
+    // reading after at least one voxel, so that every call makes progress
+    uint64_t bytes_left = buffers->byte_budget ? buffers->byte_budget : UINT64_MAX;
+    uint64_t deadline = buffers->time_budget_us ? now_us() + buffers->time_budget_us : 0;
+    size_t count_read = 0;
+    bool consumed = false, budget_exhausted = false;
+    while (count_read < buffers->max_count) {
+        if (vf->readstate.instance_pos >= vf->instances.count) {
+            vf->readstate.eof = true;
+            break;
+        }
+        if (consumed && (bytes_left < 4 || (deadline && now_us() >= deadline))) {
+            budget_exhausted = true;
+            break;
+        }
+        const struct instance *instance = &vf->instances.items[vf->readstate.instance_pos];
+        if (vf->readstate.voxel_pos == 0)
+            advance_prefetch(vf, vf->readstate.instance_pos);
+
+        // each voxel read results in at most one voxel written
+        size_t count = MIN(buffers->max_count - count_read, instance->voxel_count - vf->readstate.voxel_pos);
+        bool need_surface = buffers->surface_only || buffers->face_mask;
+        if (vf->source.type == SOURCE_ASYNC && count > 0) {
+            // the read position stays, so that the call can be repeated once the bytes have been fed
+            size_t readable = async_readable_voxels(vf, instance, need_surface);
+            if (readable == 0) {
+                if (count_read > 0)
+                    break;
+                if (error) *error = VXF_ERROR_WOULD_BLOCK;
+                return 0;
+            }
+            count = MIN(count, readable);
+        }
+
+        VxfError read_error = VXF_SUCCESS;
+        if (need_surface && (!vf->surface.valid || vf->surface.model_idx != instance->model_idx))
+            read_error = build_surface(vf, instance->model_idx);
+
+        if (deadline)
+            count = MIN(count, BUDGET_CHECK_VOXELS);
+        if (bytes_left / 4 < count)
+            count = MAX(bytes_left / 4, 1);
+        bytes_left -= MIN(bytes_left, 4 * (uint64_t)count);
+        size_t count_written = 0;
+        vf->source.offset = instance->offset + 4 * (int64_t)vf->readstate.voxel_pos;
+        if (!read_error)
+            read_error = read_model_voxels(vf, &instance->transform, buffers, count_read, count, &count_written);
+        if (read_error) {
+            vf->readstate.error = read_error;
+            if (error) *error = read_error;
+            return 0;
+        }
+        vf->readstate.voxel_pos += count;
+        count_read += count_written;
+        consumed = consumed || count > 0;
+        if (instance_id && count_written > 0)
+            *instance_id = (uint32_t)instance->id;
+
+        if (vf->readstate.voxel_pos == instance->voxel_count) {
+            vf->readstate.instance_pos++;
+            vf->readstate.voxel_pos = 0;
+            if (instance_id && count_read > 0)
+                break;
+        }
+    }
+    // 0 with success means the end, so a budget used up by skipped voxels is reported like a blocking read
+    if (error) *error = budget_exhausted && count_read == 0 ? VXF_ERROR_WOULD_BLOCK : VXF_SUCCESS;
+    return count_read;
+}
+
+size_t vxf_read(VxfFile *vf, const VxfReadBuffers *buffers, uint32_t *instance_id, VxfError *error) {
+    if (!vf || !buffers || ((!buffers->xyz && !buffers->rgba && !buffers->coloridx && !buffers->color && !buffers->keys
+            && !buffers->face_mask) && buffers->max_count > 0))
+        goto invalid_argument;
+    VxfError open_error = check_opened(vf);
+    if (open_error) {
+        if (error) *error = open_error;
+        return 0;
+    }
+    if (buffers->keys) {
+        if ((unsigned)buffers->key_format > VXF_KEY_FORMAT_MORTON)
+            goto invalid_argument;
+        if (!vf->key_origin.valid) {
+            int32_t xyz_max[3];
+            vxf_calculate_bounds(vf, vf->key_origin.origin, xyz_max);
+            for (int i = 0; i < 3; i++) {
+                if ((int64_t)xyz_max[i] - vf->key_origin.origin[i] > KEY_AXIS_MASK) {
+                    if (error) *error = VXF_ERROR_KEY_RANGE;
+                    return 0;
+                }
+            }
+            vf->key_origin.valid = true;
+        }
+    }
+    const void *color_lut = NULL;
+    size_t color_size = color_format_size(buffers->color_format);
+    if (buffers->color) {
+        if (color_size == 0)
+            goto invalid_argument;
+        if (buffers->color_format == VXF_COLOR_FORMAT_REMAP_U32) {
+            if (!buffers->color_remap)
+                goto invalid_argument;
+            color_lut = buffers->color_remap;
+        } else {
+            color_lut = get_color_lut(vf, buffers->color_format);
+        }
+    }
+    return read_common(vf, &(struct readbuffers){
+        .xyz = buffers->xyz,
+        .rgba = buffers->rgba,
+        .coloridx = buffers->coloridx,
+        .color = buffers->color,
+        .color_lut = color_lut,
+        .color_size = color_size,
+        .keys = buffers->keys,
+        .key_format = buffers->key_format,
+        .face_mask = buffers->face_mask,
+        .surface_only = buffers->surface_only != 0,
+        .max_count = buffers->max_count,
+        .byte_budget = buffers->byte_budget,
+        .time_budget_us = buffers->time_budget_us,
+    }, instance_id, error);
+invalid_argument:
+    if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+    return 0;
+}
+
+uint64_t vxf_get_read_position(const VxfFile *vf) {
+    if (!vf->instances.built)
+        return 0;
+    uint64_t position = vf->readstate.instance_pos < vf->instances.count
+        ? vf->instances.items[vf->readstate.instance_pos].voxel_start + vf->readstate.voxel_pos
+        : instances_voxel_count(vf);
+    // the start is the same for all scopes
+    return position > 0 ? MIN(position, READ_POSITION_MASK) | (vf->instances.scope_hash & ~READ_POSITION_MASK) : 0;
+}
+
+void vxf_set_read_position(VxfFile *vf, uint64_t position, VxfError *error) {
+    VxfError result = VXF_SUCCESS;
+    if (!vf->instances.built && (result = prepare_reading(vf)) != VXF_SUCCESS) {
+        if (error) *error = result;
+        return;
+    }
+    if (position != 0 && (position & ~READ_POSITION_MASK) != (vf->instances.scope_hash & ~READ_POSITION_MASK)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return;
+    }
+    position &= READ_POSITION_MASK;
+    if (position > vxf_count_voxels(vf)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return;
+    }
+    // first instance that ends after the position; instances.count if the position is the end
+    size_t lo = 0, hi = vf->instances.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const struct instance *instance = &vf->instances.items[mid];
+        if (instance->voxel_start + instance->voxel_count <= position)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    vf->readstate = (struct readstate){
+        .instance_pos = lo,
+        .voxel_pos = lo < vf->instances.count ? (size_t)(position - vf->instances.items[lo].voxel_start) : 0,
+    };
+    vf->prefetch.next = 0;
+    if (error) *error = VXF_SUCCESS;
+}
+
+uint32_t vxf_get_frame_count(const VxfFile *vf) {
+    return vf->frame_count;
+}
+
+// discards the instances after changes to the scene, so that reading restarts
+static void reset_reading(VxfFile *vf) {
+    update_scope(vf);
+    if (vf->instances.items && !vf->instances.mapped)
+        vf->allocator.free(vf->allocator.user_data, vf->instances.items, vf->instances.count * sizeof *vf->instances.items);
+    vf->instances.items = NULL;
+    vf->instances.count = 0;
+    vf->instances.built = false;
+    vf->instances.mapped = false;
+    vf->readstate = (struct readstate){0};
+    vf->prefetch.next = 0;
+    vf->key_origin.valid = false;
+}
+
+void vxf_select_frame(VxfFile *vf, uint32_t frame) {
+    if (check_opened(vf))
+        return;
+    apply_frame(vf, frame);
+    vf->frame = frame;
+    reset_reading(vf);
+}
+
+static struct layer *find_layer(VxfFile *vf, uint32_t id) {
+    return vf->layers.len > 0 ? bsearch(&id, vf->layers.items, vf->layers.len, sizeof *vf->layers.items, cmp_u32) : NULL;
+}
+
+void vxf_set_filter(VxfFile *vf, const VxfFilter *filter) {
+    if (check_opened(vf))
+        return;
+    const VxfFilter defaults = {0};
+    if (!filter)
+        filter = &defaults;
+    for (size_t i = 0; i < vf->layers.len; i++)
+        vf->layers.items[i].excluded = filter->include_layers != NULL;
+    for (size_t i = 0; filter->include_layers && i < filter->include_layer_count; i++) {
+        struct layer *layer = find_layer(vf, filter->include_layers[i]);
+        if (layer)
+            layer->excluded = false;
+    }
+    for (size_t i = 0; filter->exclude_layers && i < filter->exclude_layer_count; i++) {
+        struct layer *layer = find_layer(vf, filter->exclude_layers[i]);
+        if (layer)
+            layer->excluded = true;
+    }
+    vf->filter.show_hidden = filter->show_hidden != 0;
+    vf->filter.layers_filtered = filter->include_layers || (filter->exclude_layers && filter->exclude_layer_count > 0);
+    vf->filter.has_color_mask = filter->color_mask != NULL;
+    if (filter->color_mask)
+        memcpy(vf->filter.color_mask, filter->color_mask, sizeof vf->filter.color_mask);
+    reset_reading(vf);
+}
+
+size_t vxf_find_nodes(const VxfFile *vf, const char *name, size_t max_count, uint32_t node_ids[]) {
+    if (check_opened(vf))
+        return 0;
+    const struct node_name *entries = vf->node_names.items;
+    size_t lo = 0, hi = vf->node_names.len;
+    while (lo < hi) { // first entry not less than name
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(entries[mid].name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    size_t count = 0;
+    for (size_t i = lo; i < vf->node_names.len && strcmp(entries[i].name, name) == 0; i++, count++) {
+        if (count < max_count)
+            node_ids[count] = vf->nodes.items[entries[i].node_idx].id;
+    }
+    return count;
+}
+
+static const struct node *find_node(const VxfFile *vf, uint32_t node_id) {
+    return bsearch(&node_id, vf->nodes.items, vf->nodes.len, sizeof *vf->nodes.items, cmp_u32);
+}
+
+const char *vxf_get_node_name(const VxfFile *vf, uint32_t node_id) {
+    const struct node *node = check_opened(vf) ? NULL : find_node(vf, node_id);
+    return node && node->name_offset != NO_NAME ? vf->names.items + node->name_offset : NULL;
+}
+
+void vxf_select_node(VxfFile *vf, uint32_t node_id, VxfError *error) {
+    VxfError open_error = check_opened(vf);
+    if (open_error) {
+        if (error) *error = open_error;
+        return;
+    }
+    const struct node *node = find_node(vf, node_id);
+    if (!node) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return;
+    }
+    vf->scope.node_idx = (uint32_t)(node - vf->nodes.items);
+    reset_reading(vf);
+    if (error) *error = VXF_SUCCESS;
+}
+
+static bool transforms_equal(const struct transform *a, const struct transform *b) {
+    for (int i = 0; i < 3; i++) {
+        if (a->rotation_cols[i] != b->rotation_cols[i] || a->rotation_signs[i] != b->rotation_signs[i]
+                || a->translation[i] != b->translation[i])
+            return false;
+    }
+    return true;
+}
+
+size_t vxf_diff_frames(VxfFile *vf, uint32_t frame_a, uint32_t frame_b, size_t max_count, uint32_t instance_ids[],
+                       VxfError *error) {
+    if (!vf || (!instance_ids && max_count > 0)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+    VxfError open_error = check_opened(vf);
+    if (open_error) {
+        if (error) *error = open_error;
+        return 0;
+    }
+    // visibility is not animated, so both frames have the same instances in scene order
+    const VxfAllocator *allocator = &vf->allocator;
+    size_t count = walk_scene(vf, NULL, NULL);
+    size_t size = count <= UINT32_MAX && count <= SIZE_MAX / 2 / sizeof(struct instance)
+        ? 2 * count * sizeof(struct instance) : 0;
+    struct instance *instances = size > 0 ? allocator->alloc(allocator->user_data, size) : NULL;
+    if (count > 0 && !instances) {
+        if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
+        return 0;
+    }
+    size_t changed = 0;
+    if (count > 0) {
+        // the scope was visible before, so it only becomes empty if the walk runs out of memory
+        apply_frame(vf, frame_a);
+        update_scope(vf);
+        bool complete = vf->scope.visible && walk_instances(vf, instances);
+        apply_frame(vf, frame_b);
+        update_scope(vf);
+        complete = complete && vf->scope.visible && walk_instances(vf, instances + count);
+        apply_frame(vf, vf->frame);
+        update_scope(vf);
+        if (!complete) {
+            allocator->free(allocator->user_data, instances, size);
+            if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
+            return 0;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const struct instance *a = &instances[i], *b = &instances[count + i];
+            if (a->model_idx == b->model_idx && transforms_equal(&a->transform, &b->transform))
+                continue;
+            if (changed < max_count)
+                instance_ids[changed] = (uint32_t)a->id;
+            changed++;
+        }
+        allocator->free(allocator->user_data, instances, size);
+    }
+    if (error) *error = VXF_SUCCESS;
+    return changed;
+}
+
+// models are compared by their fingerprints if both versions have them, otherwise by offset and, if both versions
+// have them, sample hash
+static bool models_equal(const VxfFile *vf_a, size_t model_a, const VxfFile *vf_b, size_t model_b) {
+    const struct model *a = &vf_a->models.items[model_a], *b = &vf_b->models.items[model_b];
+    if (a->voxel_count != b->voxel_count || memcmp(vf_a->model_sizes.items[model_a].size,
+                                                   vf_b->model_sizes.items[model_b].size, sizeof(uint32_t[3])) != 0)
+        return false;
+    if (vf_a->fingerprint_models && vf_b->fingerprint_models)
+        return a->fingerprint == b->fingerprint;
+    return a->offset == b->offset && (!vf_a->sample_models || !vf_b->sample_models || a->sample_hash == b->sample_hash);
+}
+
+static bool instances_equal(const VxfFile *vf_a, const struct instance *a, const VxfFile *vf_b, const struct instance *b) {
+    return models_equal(vf_a, a->model_idx, vf_b, b->model_idx) && transforms_equal(&a->transform, &b->transform);
+}
+
+// equal for equal instances in the sense of instances_equal, given whether both versions have fingerprints and
+// samples
+static uint64_t instance_content_key(const VxfFile *vf, const struct instance *instance, bool fingerprints,
+                                     bool samples) {
+    const struct model *model = &vf->models.items[instance->model_idx];
+    const uint64_t fields[3] = {
+        model->voxel_count, fingerprints ? model->fingerprint : samples ? model->sample_hash : 0,
+        fingerprints ? 0 : (uint64_t)model->offset,
+    };
+    return hash_transform(&instance->transform, hash_bytes(fields, sizeof fields, 0));
+}
+
+struct diff_key {
+    uint64_t key;
+    uint32_t old_idx;
+};
+
+static int cmp_diff_key(const void *p1, const void *p2) {
+    const struct diff_key *k1 = p1, *k2 = p2;
+    if (k1->key != k2->key)
+        return (k1->key > k2->key) - (k1->key < k2->key);
+    return (k1->old_idx > k2->old_idx) - (k1->old_idx < k2->old_idx);
+}
+
+// the first unmatched old instance with the key that is equal to the new instance, or any unmatched one if
+// require_equal is false; UINT32_MAX if there is none
+static uint32_t find_diff_match(const struct diff_key keys[], size_t count, uint64_t key, const uint32_t old_match[],
+                                const VxfFile *old_vf, const struct instance old_instances[], const VxfFile *new_vf,
+                                const struct instance *new_instance, bool require_equal) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (size_t i = lo; i < count && keys[i].key == key; i++) {
+        uint32_t old_idx = keys[i].old_idx;
+        if (old_match[old_idx] == UINT32_MAX
+                && (!require_equal || instances_equal(old_vf, &old_instances[old_idx], new_vf, new_instance)))
+            return old_idx;
+    }
+    return UINT32_MAX;
+}
+
+static void add_change(VxfInstanceChange changes[], size_t max_count, size_t *count, VxfInstanceChangeType type,
+                       size_t old_id, size_t new_id) {
+    if (*count < max_count)
+        changes[*count] = (VxfInstanceChange){type, (uint32_t)old_id, (uint32_t)new_id};
+    (*count)++;
+}
+
+size_t vxf_diff_scenes(const VxfFile *old_vf, const VxfFile *new_vf, size_t max_count, VxfInstanceChange changes[],
+                       VxfError *error) {
+    if (!old_vf || !new_vf || (!changes && max_count > 0)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+    VxfError open_error = check_opened(old_vf);
+    if (open_error || (open_error = check_opened(new_vf))) {
+        if (error) *error = open_error;
+        return 0;
+    }
+    const VxfAllocator *allocator = &new_vf->allocator;
+    size_t old_count, new_count;
+    struct instance *old_instances = get_scene_instances(old_vf, &old_count);
+    struct instance *new_instances = get_scene_instances(new_vf, &new_count);
+    // keys by node path and by content, followed by the matched new index of each old instance and vice versa
+    size_t size = old_count <= SIZE_MAX / 64 && new_count <= SIZE_MAX / 64
+        ? old_count * (2 * sizeof(struct diff_key) + sizeof(uint32_t)) + new_count * sizeof(uint32_t) : 0;
+    char *data = size > 0 ? allocator->alloc(allocator->user_data, size) : NULL;
+    size_t count = 0;
+    VxfError result = VXF_SUCCESS;
+    if ((old_count > 0 && !old_instances) || (new_count > 0 && !new_instances) || (size > 0 && !data)) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    struct diff_key *by_path = (struct diff_key*)data, *by_content = by_path + old_count;
+    uint32_t *old_match = (uint32_t*)(by_content + old_count), *new_match = old_match + old_count;
+    bool fingerprints = old_vf->fingerprint_models && new_vf->fingerprint_models;
+    bool samples = old_vf->sample_models && new_vf->sample_models;
+    for (size_t i = 0; i < old_count; i++) {
+        by_path[i] = (struct diff_key){old_instances[i].node_path, (uint32_t)i};
+        by_content[i] = (struct diff_key){
+            instance_content_key(old_vf, &old_instances[i], fingerprints, samples), (uint32_t)i,
+        };
+        old_match[i] = UINT32_MAX;
+    }
+    if (old_count > 1) {
+        qsort(by_path, old_count, sizeof *by_path, cmp_diff_key);
+        qsort(by_content, old_count, sizeof *by_content, cmp_diff_key);
+    }
+
+    // instances are matched by the ids of the nodes on their path, so that reordered nodes are still recognized;
+    // unchanged instances are then matched by content, since editors may assign new node ids on saving, and the
+    // remaining ones with the same path are modified
+    for (int pass = 0; pass < 3; pass++) {
+        for (size_t i = 0; i < new_count; i++) {
+            if (pass == 0)
+                new_match[i] = UINT32_MAX;
+            else if (new_match[i] != UINT32_MAX)
+                continue;
+            const struct instance *instance = &new_instances[i];
+            uint32_t old_idx = pass == 1
+                ? find_diff_match(by_content, old_count, instance_content_key(new_vf, instance, fingerprints, samples),
+                                  old_match, old_vf, old_instances, new_vf, instance, true)
+                : find_diff_match(by_path, old_count, instance->node_path, old_match, old_vf, old_instances, new_vf,
+                                  instance, pass == 0);
+            if (old_idx != UINT32_MAX) {
+                new_match[i] = old_idx;
+                old_match[old_idx] = (uint32_t)i;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < new_count; i++) {
+        if (new_match[i] == UINT32_MAX)
+            add_change(changes, max_count, &count, VXF_INSTANCE_ADDED, UINT32_MAX, i);
+        else if (!instances_equal(old_vf, &old_instances[new_match[i]], new_vf, &new_instances[i]))
+            add_change(changes, max_count, &count, VXF_INSTANCE_MODIFIED, new_match[i], i);
+    }
+    for (size_t i = 0; i < old_count; i++) {
+        if (old_match[i] == UINT32_MAX)
+            add_change(changes, max_count, &count, VXF_INSTANCE_REMOVED, i, UINT32_MAX);
+    }
+    for (size_t i = 0; i < new_count; i++) {
+        if (new_match[i] != UINT32_MAX && new_match[i] != i
+                && instances_equal(old_vf, &old_instances[new_match[i]], new_vf, &new_instances[i]))
+            add_change(changes, max_count, &count, VXF_INSTANCE_RENUMBERED, new_match[i], i);
+    }
+
+cleanup:
+    if (data)
+        allocator->free(allocator->user_data, data, size);
+    if (old_instances)
+        old_vf->allocator.free(old_vf->allocator.user_data, old_instances, old_count * sizeof *old_instances);
+    if (new_instances)
+        new_vf->allocator.free(new_vf->allocator.user_data, new_instances, new_count * sizeof *new_instances);
+    if (error) *error = result;
+    return result ? 0 : count;
+}
+
+size_t vxf_read_xyz_rgba(VxfFile *vf, size_t max_count, int32_t xyz_buf[][3], uint8_t rgba_buf[][4], VxfError *error) {
+    if (!vf || ((!xyz_buf || !rgba_buf)  && max_count > 0)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+    return read_common(vf, &(struct readbuffers){
+        .xyz = xyz_buf,
+        .rgba = rgba_buf,
+        .max_count = max_count,
+    }, NULL, error);
+}
+
+size_t vxf_read_xyz_coloridx(VxfFile *vf, size_t max_count, int32_t xyz_buf[][3], uint8_t coloridx_buf[], VxfError *error) {
+    if (!vf || ((!xyz_buf || !coloridx_buf)  && max_count > 0)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+    return read_common(vf, &(struct readbuffers){
+        .xyz = xyz_buf,
+        .coloridx = coloridx_buf,
+        .max_count = max_count,
+    }, NULL, error);
+}
+
+// calls fn for each task, in separate threads if supported; runs a task in the calling thread
+// if its thread can't be created
+static void run_tasks(int (*fn)(void *task), void *tasks, size_t task_size, unsigned count) {
+    assert(count <= MAX_THREADS);
+    char *base = tasks;
+#ifdef VOXFLAT_HAVE_C11_THREADS
+    thrd_t handles[MAX_THREADS];
+    bool started[MAX_THREADS] = {false};
+    for (unsigned i = 1; i < count; i++)
+        started[i] = thrd_create(&handles[i], fn, base + i * task_size) == thrd_success;
+    if (count > 0)
+        fn(base);
+    for (unsigned i = 1; i < count; i++) {
+        if (started[i])
+            thrd_join(handles[i], NULL);
+        else
+            fn(base + i * task_size);
+    }
+#else
+    for (unsigned i = 0; i < count; i++)
+        fn(base + i * task_size);
+#endif
+}
+
+// LSD radix sort with 8-bit digits; each thread handles a contiguous part of the input in every pass
+
+#define RADIX_MIN_ITEMS_PER_THREAD 65536
+
+enum radix_phase { RADIX_REDUCE, RADIX_HISTOGRAM, RADIX_SCATTER };
+
+struct radix_sort {
+    uint64_t *keys[2];
+    uint32_t *values[2];
+    size_t count;
+    unsigned thread_count;
+    unsigned shift;
+    int src;
+    enum radix_phase phase;
+    struct radix_thread {
+        struct radix_sort *sort;
+        size_t begin, end;
+        uint64_t bits_or, bits_and;
+        size_t histogram[256]; // digit counts, then scatter positions
+    } threads[MAX_THREADS];
+};
+
+static int radix_run_thread(void *arg) {
+    struct radix_thread *t = arg;
+    const struct radix_sort *s = t->sort;
+    const uint64_t *keys = s->keys[s->src];
+    unsigned shift = s->shift;
+    switch (s->phase) {
+        case RADIX_REDUCE:
+            t->bits_or = 0, t->bits_and = UINT64_MAX;
+            for (size_t i = t->begin; i < t->end; i++)
+                t->bits_or |= keys[i], t->bits_and &= keys[i];
+            break;
+        case RADIX_HISTOGRAM:
+            memset(t->histogram, 0, sizeof t->histogram);
+            for (size_t i = t->begin; i < t->end; i++)
+                t->histogram[(keys[i] >> shift) & 0xff]++;
+            break;
+        case RADIX_SCATTER: {
+            uint64_t *dst_keys = s->keys[!s->src];
+            const uint32_t *values = s->values[s->src];
+            uint32_t *dst_values = s->values[!s->src];
+            for (size_t i = t->begin; i < t->end; i++) {
+                size_t pos = t->histogram[(keys[i] >> shift) & 0xff]++;
+                dst_keys[pos] = keys[i];
+                if (values) dst_values[pos] = values[i];
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+static void radix_run_phase(struct radix_sort *s, enum radix_phase phase) {
+    s->phase = phase;
+    run_tasks(radix_run_thread, s->threads, sizeof *s->threads, s->thread_count);
+}
+
+void vxf_sort_keys(uint64_t keys[], uint32_t values[], size_t count, unsigned thread_count, const VxfAllocator *allocator, VxfError *error) {
+    if (!allocator)
+        allocator = &default_allocator;
+    if ((!keys && count > 0) || !allocator->alloc || !allocator->free) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return;
+    }
+    if (count < 2) {
+        if (error) *error = VXF_SUCCESS;
+        return;
+    }
+
+#ifdef VOXFLAT_HAVE_C11_THREADS
+    thread_count = CLAMP(thread_count, 1, MAX_THREADS);
+    thread_count = (unsigned)MIN(thread_count, (count - 1) / RADIX_MIN_ITEMS_PER_THREAD + 1);
+#else
+    thread_count = 1;
+#endif
+    struct radix_sort *s = allocator->alloc(allocator->user_data, sizeof *s);
+    uint64_t *tmp_keys = count <= SIZE_MAX / sizeof *keys ? allocator->alloc(allocator->user_data, count * sizeof *keys) : NULL;
+    uint32_t *tmp_values = values && tmp_keys ? allocator->alloc(allocator->user_data, count * sizeof *values) : NULL;
+    if (!s || !tmp_keys || (values && !tmp_values)) {
+        if (error) *error = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    s->keys[0] = keys, s->keys[1] = tmp_keys;
+    s->values[0] = values, s->values[1] = tmp_values;
+    s->count = count, s->thread_count = thread_count, s->src = 0, s->shift = 0;
+    for (unsigned i = 0; i < thread_count; i++) {
+        s->threads[i].sort = s;
+        s->threads[i].begin = count / thread_count * i;
+        s->threads[i].end = i + 1 == thread_count ? count : count / thread_count * (i + 1);
+    }
+
+    // digits that are the same in all keys don't need a pass
+    radix_run_phase(s, RADIX_REDUCE);
+    uint64_t bits_or = 0, bits_and = UINT64_MAX;
+    for (unsigned i = 0; i < thread_count; i++)
+        bits_or |= s->threads[i].bits_or, bits_and &= s->threads[i].bits_and;
+    uint64_t varying = bits_or ^ bits_and;
+
+    for (s->shift = 0; s->shift < 64; s->shift += 8) {
+        if (!((varying >> s->shift) & 0xff))
+            continue;
+        radix_run_phase(s, RADIX_HISTOGRAM);
+        size_t pos = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            for (unsigned i = 0; i < thread_count; i++) {
+                size_t n = s->threads[i].histogram[digit];
+                s->threads[i].histogram[digit] = pos;
+                pos += n;
+            }
+        }
+        radix_run_phase(s, RADIX_SCATTER);
+        s->src = !s->src;
+    }
+    if (s->src) {
+        memcpy(keys, tmp_keys, count * sizeof *keys);
+        if (values) memcpy(values, tmp_values, count * sizeof *values);
+    }
+    if (error) *error = VXF_SUCCESS;
+
+cleanup:
+    if (tmp_values) allocator->free(allocator->user_data, tmp_values, count * sizeof *values);
+    if (tmp_keys) allocator->free(allocator->user_data, tmp_keys, count * sizeof *keys);
+    if (s) allocator->free(allocator->user_data, s, sizeof *s);
+}
+
+// meshing: models are read serially, meshed in model space (possibly in parallel), and then instanced
+
+struct mesh_task {
+    const VxfFile *vf;
+    const uint8_t (*const *xyzi)[4]; // voxel data by model, NULL if the model is not used by a visible instance
+    struct mesh_output *outputs;
+    size_t index, stride; // handles the models index, index + stride, ...
+    bool ambient_occlusion;
+    VxfError error;
+};
+
+static size_t model_grid_size(const struct model_size *size) {
+    return (size_t)CLAMP(size->size[0], 1, 256) * CLAMP(size->size[1], 1, 256) * CLAMP(size->size[2], 1, 256);
+}
+
+static int run_mesh_task(void *arg) {
+    struct mesh_task *task = arg;
+    const VxfFile *vf = task->vf;
+    size_t grid_capacity = 0;
+    for (size_t i = task->index; i < vf->models.len; i += task->stride) {
+        if (task->xyzi[i])
+            grid_capacity = MAX(grid_capacity, model_grid_size(&vf->model_sizes.items[i]));
+    }
+    if (grid_capacity == 0)
+        return 0;
+    struct mesh_scratch scratch;
+    if (!mesh_scratch_alloc(&scratch, &vf->allocator, grid_capacity)) {
+        task->error = VXF_ERROR_OUT_OF_MEMORY;
+        return 0;
+    }
+    for (size_t i = task->index; i < vf->models.len && !task->error; i += task->stride) {
+        if (task->xyzi[i]) {
+            task->error = mesh_model(&task->outputs[i], &scratch, &vf->allocator, vf->model_sizes.items[i].size,
+                task->xyzi[i], vf->models.items[i].voxel_count, vf->filter.has_color_mask ? vf->filter.color_mask : NULL,
+                task->ambient_occlusion);
+        }
+    }
+    mesh_scratch_free(&scratch, &vf->allocator);
+    return 0;
+}
+
+// voxel data of the models used by visible instances, for the builders that work on models in model space
+struct model_input {
+    size_t model_count;
+    const uint8_t (**xyzi)[4]; // voxel data by model, NULL if the model is not used by a visible instance
+    bool *used;
+    size_t used_count;
+    char *data; // copy of the voxel data, unless the source is in memory
+    size_t data_size;
+};
+
+static void free_model_input(const VxfAllocator *allocator, struct model_input *input) {
+    if (input->data)
+        allocator->free(allocator->user_data, input->data, input->data_size);
+    if (input->xyzi)
+        allocator->free(allocator->user_data, input->xyzi, input->model_count * sizeof *input->xyzi);
+    if (input->used)
+        allocator->free(allocator->user_data, input->used, input->model_count * sizeof *input->used);
+    *input = (struct model_input){0};
+}
+
+// marks the models used by visible instances and sets their voxel data pointers, pointing into the source memory
+// or into a copy; to be freed with free_model_input also on failure
+static VxfError read_model_input(VxfFile *vf, struct model_input *input) {
+    const VxfAllocator *allocator = &vf->allocator;
+    const struct source *src = &vf->source;
+    size_t model_count = vf->models.len;
+    *input = (struct model_input){
+        .model_count = model_count,
+        .xyzi = allocator->alloc(allocator->user_data, model_count * sizeof *input->xyzi),
+        .used = allocator->alloc(allocator->user_data, model_count * sizeof *input->used),
+    };
+    if (!input->xyzi || !input->used)
+        return VXF_ERROR_OUT_OF_MEMORY;
+    for (size_t i = 0; i < model_count; i++)
+        input->xyzi[i] = NULL, input->used[i] = false;
+    for (size_t i = 0; i < vf->instances.count; i++) {
+        size_t model_idx = vf->instances.items[i].model_idx;
+        input->used_count += !input->used[model_idx];
+        input->used[model_idx] = true;
+    }
+
+    for (size_t i = 0; i < model_count; i++) {
+        size_t size = vf->models.items[i].voxel_count * 4;
+        if (!input->used[i] || src->type == SOURCE_MEMORY)
+            continue;
+        if (size > SIZE_MAX - input->data_size)
+            return VXF_ERROR_OUT_OF_MEMORY;
+        input->data_size += size;
+    }
+    if (input->data_size > 0 && !(input->data = allocator->alloc(allocator->user_data, input->data_size)))
+        return VXF_ERROR_OUT_OF_MEMORY;
+
+    size_t pos = 0;
+    for (size_t i = 0; i < model_count; i++) {
+        const struct model *model = &vf->models.items[i];
+        size_t size = model->voxel_count * 4;
+        if (!input->used[i]) {
+            continue;
+        } else if (src->type == SOURCE_MEMORY) {
+            if ((uint64_t)model->offset > src->memory.size || size > src->memory.size - (size_t)model->offset)
+                return VXF_ERROR_UNEXPECTED_EOF;
+            input->xyzi[i] = (const uint8_t(*)[4])(src->memory.buffer + model->offset);
+            continue;
+        }
+        input->xyzi[i] = (const uint8_t(*)[4])(input->data + pos);
+        vf->source.offset = model->offset;
+        for (size_t end = pos + size; pos < end;) {
+            size_t n = MIN(end - pos, GET_BYTES_MAX);
+            const char *bytes = try_get_bytes(vf, n);
+            if (!bytes)
+                return vf->source.error ? vf->source.error : VXF_ERROR_UNEXPECTED_EOF;
+            memcpy(input->data + pos, bytes, n);
+            pos += n;
+        }
+    }
+    return VXF_SUCCESS;
+}
+
+// true if the transform changes the handedness, which reverses the winding order of faces
+static bool is_transform_mirrored(const struct transform *t) {
+    int inversions = (t->rotation_cols[0] > t->rotation_cols[1]) + (t->rotation_cols[0] > t->rotation_cols[2])
+        + (t->rotation_cols[1] > t->rotation_cols[2]);
+    int sign = t->rotation_signs[0] * t->rotation_signs[1] * t->rotation_signs[2];
+    return (inversions % 2 == 1) != (sign < 0);
+}
+
+static void transform_quad(const VxfFile *vf, const struct instance *instance, const struct mesh_quad *local, VxfQuad *quad) {
+    const struct transform *t = &instance->transform;
+    int32_t corners[4][3];
+    mesh_quad_corners(local, corners);
+    int32_t normal[3] = {0};
+    normal[local->axis] = local->positive ? 1 : -1;
+
+    *quad = (VxfQuad){.coloridx = local->coloridx, .instance_id = (uint32_t)instance->id};
+    memcpy(quad->rgba, vf->palette[local->coloridx], sizeof quad->rgba);
+    bool mirrored = is_transform_mirrored(t);
+    for (int i = 0; i < 4; i++) {
+        int src = mirrored ? (4 - i) % 4 : i;
+        for (int j = 0; j < 3; j++) {
+            // a voxel maps to a cell starting at the transformed position, so mirrored corners are offset by 1
+            int32_t sign = t->rotation_signs[j];
+            quad->xyz[i][j] = corners[src][t->rotation_cols[j]] * sign + t->translation[j] + (sign < 0);
+        }
+        quad->ao[i] = local->ao[src];
+    }
+    for (int j = 0; j < 3; j++)
+        quad->normal[j] = (int8_t)(normal[t->rotation_cols[j]] * t->rotation_signs[j]);
+}
+
+// the mesh and its quads are a single allocation
+struct mesh_allocation {
+    VxfMesh mesh;
+    VxfAllocator allocator;
+    size_t size;
+};
+
+VxfMesh *vxf_build_mesh(VxfFile *vf, const VxfMeshOptions *options, VxfError *error) {
+    if (!vf) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    VxfError result = VXF_SUCCESS;
+    if (!vf->instances.built && (result = prepare_reading(vf)) != VXF_SUCCESS) {
+        if (error) *error = result;
+        return NULL;
+    }
+
+    const VxfAllocator *allocator = &vf->allocator;
+    size_t model_count = vf->models.len;
+    struct mesh_output *outputs = allocator->alloc(allocator->user_data, model_count * sizeof *outputs);
+    struct model_input input;
+    struct mesh_allocation *allocation = NULL;
+    for (size_t i = 0; outputs && i < model_count; i++)
+        outputs[i] = (struct mesh_output){0};
+    if ((result = read_model_input(vf, &input)) != VXF_SUCCESS)
+        goto cleanup;
+    if (!outputs) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+
+    unsigned thread_count = options ? CLAMP(options->thread_count, 1, MAX_THREADS) : 1;
+#ifndef VOXFLAT_HAVE_C11_THREADS
+    thread_count = 1;
+#endif
+    thread_count = (unsigned)MIN(thread_count, MAX(input.used_count, 1));
+    struct mesh_task tasks[MAX_THREADS];
+    for (unsigned i = 0; i < thread_count; i++) {
+        tasks[i] = (struct mesh_task){
+            .vf = vf, .xyzi = input.xyzi, .outputs = outputs, .index = i, .stride = thread_count,
+            .ambient_occlusion = options && options->ambient_occlusion,
+        };
+    }
+    run_tasks(run_mesh_task, tasks, sizeof *tasks, thread_count);
+    for (unsigned i = 0; i < thread_count && !result; i++)
+        result = tasks[i].error;
+    if (result)
+        goto cleanup;
+
+    size_t quad_count = 0;
+    for (size_t i = 0; i < vf->instances.count; i++) {
+        size_t count = outputs[vf->instances.items[i].model_idx].count;
+        if (count > (SIZE_MAX - sizeof *allocation) / sizeof(VxfQuad) - quad_count) {
+            result = VXF_ERROR_OUT_OF_MEMORY;
+            goto cleanup;
+        }
+        quad_count += count;
+    }
+    size_t size = sizeof *allocation + quad_count * sizeof(VxfQuad);
+    if (!(allocation = allocator->alloc(allocator->user_data, size))) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    *allocation = (struct mesh_allocation){
+        .mesh = {.quad_count = quad_count, .quads = (VxfQuad*)(allocation + 1)},
+        .allocator = *allocator, .size = size,
+    };
+    VxfQuad *quad = allocation->mesh.quads;
+    for (size_t i = 0; i < vf->instances.count; i++) {
+        const struct instance *instance = &vf->instances.items[i];
+        const struct mesh_output *output = &outputs[instance->model_idx];
+        for (size_t j = 0; j < output->count; j++)
+            transform_quad(vf, instance, &output->quads[j], quad++);
+    }
+
+cleanup:
+    free_model_input(allocator, &input);
+    if (outputs) {
+        for (size_t i = 0; i < model_count; i++)
+            mesh_output_free(&outputs[i], allocator);
+        allocator->free(allocator->user_data, outputs, model_count * sizeof *outputs);
+    }
+    if (error) *error = result;
+    return result ? NULL : &allocation->mesh;
+}
+
+void vxf_free_mesh(VxfMesh *mesh) {
+    if (!mesh) return;
+    struct mesh_allocation *allocation = (struct mesh_allocation*)mesh;
+    VxfAllocator allocator = allocation->allocator;
+    allocator.free(allocator.user_data, allocation, allocation->size);
+}
+
+// boxes: like meshing, models are decomposed in model space and instanced, but the instances keep their transform
+
+struct boxes_task {
+    const VxfFile *vf;
+    const uint8_t (*const *xyzi)[4]; // voxel data by model, NULL if the model is not used by a visible instance
+    struct boxes_output *outputs;
+    size_t index, stride; // handles the models index, index + stride, ...
+    bool ignore_colors;
+    VxfError error;
+};
+
+static int run_boxes_task(void *arg) {
+    struct boxes_task *task = arg;
+    const VxfFile *vf = task->vf;
+    struct boxes_scratch scratch = {0};
+    for (size_t i = task->index; i < vf->models.len && !task->error; i += task->stride) {
+        if (task->xyzi[i]) {
+            task->error = boxes_model(&task->outputs[i], &scratch, &vf->allocator, vf->model_sizes.items[i].size,
+                task->xyzi[i], vf->models.items[i].voxel_count, vf->filter.has_color_mask ? vf->filter.color_mask : NULL,
+                task->ignore_colors);
+        }
+    }
+    boxes_scratch_free(&scratch, &vf->allocator);
+    return 0;
+}
+
+// the boxes and their models and instances are a single allocation
+struct boxes_allocation {
+    VxfBoxes boxes;
+    VxfAllocator allocator;
+    size_t size;
+};
+
+VxfBoxes *vxf_build_boxes(VxfFile *vf, const VxfBoxesOptions *options, VxfError *error) {
+    if (!vf) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    VxfError result = VXF_SUCCESS;
+    if (!vf->instances.built && (result = prepare_reading(vf)) != VXF_SUCCESS) {
+        if (error) *error = result;
+        return NULL;
+    }
+
+    const VxfAllocator *allocator = &vf->allocator;
+    size_t model_count = vf->models.len;
+    struct boxes_output *outputs = allocator->alloc(allocator->user_data, model_count * sizeof *outputs);
+    struct model_input input;
+    struct boxes_allocation *allocation = NULL;
+    for (size_t i = 0; outputs && i < model_count; i++)
+        outputs[i] = (struct boxes_output){0};
+    if ((result = read_model_input(vf, &input)) != VXF_SUCCESS)
+        goto cleanup;
+    if (!outputs) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+
+    unsigned thread_count = options ? CLAMP(options->thread_count, 1, MAX_THREADS) : 1;
+#ifndef VOXFLAT_HAVE_C11_THREADS
+    thread_count = 1;
+#endif
+    thread_count = (unsigned)MIN(thread_count, MAX(input.used_count, 1));
+    struct boxes_task tasks[MAX_THREADS];
+    for (unsigned i = 0; i < thread_count; i++) {
+        tasks[i] = (struct boxes_task){
+            .vf = vf, .xyzi = input.xyzi, .outputs = outputs, .index = i, .stride = thread_count,
+            .ignore_colors = options && options->ignore_colors,
+        };
+    }
+    run_tasks(run_boxes_task, tasks, sizeof *tasks, thread_count);
+    for (unsigned i = 0; i < thread_count && !result; i++)
+        result = tasks[i].error;
+    if (result)
+        goto cleanup;
+
+    // box indices are 32-bit, which leaves room for the headers in the allocation
+    size_t box_count = 0;
+    for (size_t i = 0; i < model_count; i++)
+        box_count += outputs[i].count;
+    size_t instance_count = vf->instances.count;
+    if (box_count > UINT32_MAX || model_count > UINT32_MAX || instance_count > UINT32_MAX) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    size_t size = sizeof *allocation + model_count * sizeof(VxfBoxModel) + box_count * sizeof(VxfBox)
+        + instance_count * sizeof(VxfBoxInstance);
+    if (!(allocation = allocator->alloc(allocator->user_data, size))) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    VxfBoxModel *models = (VxfBoxModel*)(allocation + 1);
+    VxfBox *boxes = (VxfBox*)(models + model_count);
+    VxfBoxInstance *instances = (VxfBoxInstance*)(boxes + box_count);
+    *allocation = (struct boxes_allocation){
+        .boxes = {
+            .model_count = model_count, .models = models, .box_count = box_count, .boxes = boxes,
+            .instance_count = instance_count, .instances = instances,
+        },
+        .allocator = *allocator, .size = size,
+    };
+    for (size_t i = 0, first = 0; i < model_count; i++) {
+        models[i] = (VxfBoxModel){.first_box = (uint32_t)first, .box_count = (uint32_t)outputs[i].count};
+        if (outputs[i].count > 0)
+            memcpy(boxes + first, outputs[i].boxes, outputs[i].count * sizeof *boxes);
+        first += outputs[i].count;
+    }
+    for (size_t i = 0; i < instance_count; i++) {
+        const struct instance *instance = &vf->instances.items[i];
+        const struct transform *t = &instance->transform;
+        instances[i] = (VxfBoxInstance){.instance_id = (uint32_t)instance->id, .model = (uint32_t)instance->model_idx};
+        for (int j = 0; j < 3; j++) {
+            instances[i].rotation[j][t->rotation_cols[j]] = t->rotation_signs[j];
+            instances[i].translation[j] = t->translation[j];
+        }
+    }
+
+cleanup:
+    free_model_input(allocator, &input);
+    if (outputs) {
+        for (size_t i = 0; i < model_count; i++)
+            boxes_output_free(&outputs[i], allocator);
+        allocator->free(allocator->user_data, outputs, model_count * sizeof *outputs);
+    }
+    if (error) *error = result;
+    return result ? NULL : &allocation->boxes;
+}
+
+void vxf_transform_box(const VxfBoxInstance *instance, const VxfBox *box, VxfBox *result) {
+    VxfBox local = *box;
+    for (int j = 0; j < 3; j++) {
+        int c = instance->rotation[j][0] ? 0 : instance->rotation[j][1] ? 1 : 2;
+        int32_t sign = instance->rotation[j][c];
+        int32_t a = local.min[c] * sign + instance->translation[j], b = local.max[c] * sign + instance->translation[j];
+        result->min[j] = MIN(a, b);
+        result->max[j] = MAX(a, b);
+    }
+    result->coloridx = local.coloridx;
+}
+
+void vxf_free_boxes(VxfBoxes *boxes) {
+    if (!boxes) return;
+    struct boxes_allocation *allocation = (struct boxes_allocation*)boxes;
+    VxfAllocator allocator = allocation->allocator;
+    allocator.free(allocator.user_data, allocation, allocation->size);
+}
+
+// Chooses the coarsest level and an origin aligned to its voxel size. Preferably all voxels lie in a single voxel
+// of the coarsest level; if the bounds contain a plane through 0, the coarsest level has 2 voxels along each axis.
+static bool lod_origin(const VxfFile *vf, int32_t origin[3], unsigned *top_level) {
+    int32_t xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    for (int cells = 1; cells <= 2; cells++) {
+        for (unsigned n = 0; n + cells <= LOD_MAX_LEVELS; n++) {
+            int64_t size = INT64_C(1) << n;
+            bool fits = true;
+            for (int i = 0; i < 3; i++) {
+                int64_t aligned = xyz_min[i] >= 0 ? xyz_min[i] / size * size : -((size - 1 - xyz_min[i]) / size * size);
+                origin[i] = (int32_t)aligned;
+                fits = fits && xyz_max[i] - aligned < cells * size;
+            }
+            if (fits) {
+                *top_level = n;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// all voxels read into memory and sorted by Morton key relative to an origin
+struct sorted_voxels {
+    uint64_t *keys;
+    uint32_t *order; // read order of each key
+    uint8_t *colors; // color index by read order
+    size_t count, capacity;
+};
+
+static void free_sorted_voxels(const VxfAllocator *allocator, struct sorted_voxels *voxels) {
+    if (voxels->keys)
+        allocator->free(allocator->user_data, voxels->keys, voxels->capacity * sizeof *voxels->keys);
+    if (voxels->order)
+        allocator->free(allocator->user_data, voxels->order, voxels->capacity * sizeof *voxels->order);
+    if (voxels->colors)
+        allocator->free(allocator->user_data, voxels->colors, voxels->capacity);
+    *voxels = (struct sorted_voxels){0};
+}
+
+// reads all voxels with a separate read state, so that vxf_read continues where it was; the positions relative to
+// origin must fit into keys
+static VxfError read_sorted_voxels(VxfFile *vf, const int32_t origin[3], unsigned thread_count,
+                                   struct sorted_voxels *voxels) {
+    *voxels = (struct sorted_voxels){0};
+    uintmax_t total = vxf_count_voxels(vf);
+    if (total > UINT32_MAX || total > SIZE_MAX / sizeof(uint64_t))
+        return VXF_ERROR_OUT_OF_MEMORY;
+
+    const VxfAllocator *allocator = &vf->allocator;
+    size_t count = (size_t)total;
+    voxels->capacity = count;
+    voxels->keys = allocator->alloc(allocator->user_data, count * sizeof *voxels->keys);
+    voxels->order = allocator->alloc(allocator->user_data, count * sizeof *voxels->order);
+    voxels->colors = allocator->alloc(allocator->user_data, count);
+    if (count > 0 && (!voxels->keys || !voxels->order || !voxels->colors)) {
+        free_sorted_voxels(allocator, voxels);
+        return VXF_ERROR_OUT_OF_MEMORY;
+    }
+
+    VxfError result = VXF_SUCCESS;
+    struct readstate readstate = vf->readstate;
+    vf->readstate = (struct readstate){0};
+    size_t pos = 0;
+    while (pos < count) {
+        int32_t xyz[256][3];
+        size_t n = read_common(vf, &(struct readbuffers){
+            .xyz = xyz, .coloridx = voxels->colors + pos, .max_count = MIN(256, count - pos),
+        }, NULL, &result);
+        if (n == 0)
+            break;
+        for (size_t i = 0; i < n && !result; i++) {
+            int32_t rel[3] = {xyz[i][0] - origin[0], xyz[i][1] - origin[1], xyz[i][2] - origin[2]};
+            if (!encode_key(VXF_KEY_FORMAT_MORTON, rel, &voxels->keys[pos + i]))
+                result = VXF_ERROR_KEY_RANGE;
+            voxels->order[pos + i] = (uint32_t)(pos + i);
+        }
+        if (result)
+            break;
+        pos += n;
+    }
+    vf->readstate = readstate;
+    voxels->count = pos; // the number actually read, less than counted if the filter has a color mask
+    if (!result)
+        vxf_sort_keys(voxels->keys, voxels->order, pos, thread_count, allocator, &result);
+    if (result)
+        free_sorted_voxels(allocator, voxels);
+    return result;
+}
+
+VxfLod *vxf_build_lod(VxfFile *vf, const VxfLodOptions *options, VxfError *error) {
+    int32_t origin[3];
+    unsigned top_level;
+    if (!vf || (options && (unsigned)options->mode > VXF_LOD_MODE_LAST)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    VxfError result = VXF_SUCCESS;
+    if (!vf->instances.built && (result = prepare_reading(vf)) != VXF_SUCCESS) {
+        if (error) *error = result;
+        return NULL;
+    }
+    if (!lod_origin(vf, origin, &top_level)) {
+        if (error) *error = VXF_ERROR_KEY_RANGE;
+        return NULL;
+    }
+    struct sorted_voxels voxels;
+    VxfLod *lod = NULL;
+    result = read_sorted_voxels(vf, origin, options ? options->thread_count : 1, &voxels);
+    if (!result) {
+        lod = lod_create(&vf->allocator, origin, top_level, voxels.keys, voxels.order, voxels.colors, voxels.count,
+            options, &result);
+    }
+    free_sorted_voxels(&vf->allocator, &voxels);
+    if (error) *error = result;
+    return lod;
+}
+
+VxfLookup *vxf_build_lookup(VxfFile *vf, const VxfLookupOptions *options, VxfError *error) {
+    if (!vf) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    VxfError result = VXF_SUCCESS;
+    if (!vf->instances.built && (result = prepare_reading(vf)) != VXF_SUCCESS) {
+        if (error) *error = result;
+        return NULL;
+    }
+    int32_t xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    for (int i = 0; i < 3; i++) {
+        if ((int64_t)xyz_max[i] - xyz_min[i] > KEY_AXIS_MASK) {
+            if (error) *error = VXF_ERROR_KEY_RANGE;
+            return NULL;
+        }
+    }
+    struct sorted_voxels voxels;
+    VxfLookup *lookup = NULL;
+    result = read_sorted_voxels(vf, xyz_min, options ? options->thread_count : 1, &voxels);
+    if (!result)
+        lookup = lookup_create(&vf->allocator, xyz_min, voxels.keys, voxels.order, voxels.colors, voxels.count, &result);
+    free_sorted_voxels(&vf->allocator, &voxels);
+    if (error) *error = result;
+    return lookup;
+}
+
+// column runs of a model along the model axes that visible instances map to z
+struct model_columns {
+    struct model_runs runs[3];
+    int size[3];
+    unsigned axis_mask;
+};
+
+// finds the runs of the used models, and places them for each instance
+static VxfError build_column_runs(VxfFile *vf, struct model_columns *models, const uint8_t (*const *xyzi)[4]) {
+    struct columns_scratch scratch = {0};
+    VxfError result = VXF_SUCCESS;
+    for (size_t i = 0; i < vf->models.len && !result; i++) {
+        if (xyzi[i]) {
+            result = columns_model_runs(models[i].runs, &scratch, &vf->allocator, xyzi[i],
+                vf->models.items[i].voxel_count, vf->filter.has_color_mask ? vf->filter.color_mask : NULL,
+                models[i].axis_mask, models[i].size);
+        }
+    }
+    columns_scratch_free(&scratch, &vf->allocator);
+    return result;
+}
+
+VxfColumns *vxf_build_columns(VxfFile *vf, const VxfColumnsOptions *options, VxfError *error) {
+    if (!vf) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    VxfError result = VXF_SUCCESS;
+    if (!vf->instances.built && (result = prepare_reading(vf)) != VXF_SUCCESS) {
+        if (error) *error = result;
+        return NULL;
+    }
+
+    const VxfAllocator *allocator = &vf->allocator;
+    size_t model_count = vf->models.len, count = 0;
+    struct model_columns *models = allocator->alloc(allocator->user_data, model_count * sizeof *models);
+    struct model_input input;
+    uint64_t *keys = NULL;
+    uint32_t *order = NULL;
+    uint16_t *lengths = NULL;
+    uint8_t *colors = NULL;
+    VxfColumns *columns = NULL;
+    for (size_t i = 0; models && i < model_count; i++)
+        models[i] = (struct model_columns){0};
+    if ((result = read_model_input(vf, &input)) != VXF_SUCCESS)
+        goto cleanup;
+    if (!models) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    for (size_t i = 0; i < vf->instances.count; i++) {
+        const struct instance *instance = &vf->instances.items[i];
+        models[instance->model_idx].axis_mask |= 1u << instance->transform.rotation_cols[2];
+    }
+    if ((result = build_column_runs(vf, models, input.xyzi)) != VXF_SUCCESS)
+        goto cleanup;
+
+    // the bounds of the placed models, which cover all voxels
+    int32_t xyz_min[3] = {INT32_MAX, INT32_MAX, INT32_MAX}, xyz_max[3] = {INT32_MIN, INT32_MIN, INT32_MIN};
+    uintmax_t total = 0;
+    for (size_t i = 0; i < vf->instances.count; i++) {
+        const struct instance *instance = &vf->instances.items[i];
+        const struct model_columns *model = &models[instance->model_idx];
+        extend_bounds(xyz_min, xyz_max, &instance->transform, (uint8_t[3]){0, 0, 0});
+        extend_bounds(xyz_min, xyz_max, &instance->transform, (uint8_t[3]){
+            (uint8_t)(model->size[0] - 1), (uint8_t)(model->size[1] - 1), (uint8_t)(model->size[2] - 1),
+        });
+        total += model->runs[instance->transform.rotation_cols[2]].count;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (vf->instances.count == 0)
+            xyz_min[i] = xyz_max[i] = 0;
+        if ((int64_t)xyz_max[i] - xyz_min[i] > KEY_AXIS_MASK) {
+            result = VXF_ERROR_KEY_RANGE;
+            goto cleanup;
+        }
+    }
+    if (total > UINT32_MAX || total > SIZE_MAX / sizeof *keys) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    count = (size_t)total;
+    keys = allocator->alloc(allocator->user_data, count * sizeof *keys);
+    order = allocator->alloc(allocator->user_data, count * sizeof *order);
+    lengths = allocator->alloc(allocator->user_data, count * sizeof *lengths);
+    colors = allocator->alloc(allocator->user_data, count);
+    if (count > 0 && (!keys || !order || !lengths || !colors)) {
+        result = VXF_ERROR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+
+    // runs of later instances replace those of earlier ones, so the order is the position in the scene
+    size_t n = 0;
+    for (size_t i = 0; i < vf->instances.count; i++) {
+        const struct transform *t = &vf->instances.items[i].transform;
+        int d = t->rotation_cols[2], u = (d + 1) % 3, v = (d + 2) % 3;
+        const struct model_runs *runs = &models[vf->instances.items[i].model_idx].runs[d];
+        for (size_t j = 0; j < runs->count; j++, n++) {
+            const struct model_run *run = &runs->runs[j];
+            uint8_t modelpos[3];
+            int32_t xyz[3];
+            modelpos[u] = run->uv[0], modelpos[v] = run->uv[1], modelpos[d] = run->start;
+            apply_transform(t, modelpos, xyz);
+            if (t->rotation_signs[2] < 0)
+                xyz[2] -= run->length - 1;
+            keys[n] = (uint64_t)(xyz[1] - xyz_min[1]) << 2 * COLUMNS_AXIS_BITS
+                | (uint64_t)(xyz[0] - xyz_min[0]) << COLUMNS_AXIS_BITS | (uint64_t)(xyz[2] - xyz_min[2]);
+            order[n] = (uint32_t)n;
+            lengths[n] = run->length;
+            colors[n] = run->coloridx;
+        }
+    }
+    vxf_sort_keys(keys, order, count, options ? options->thread_count : 1, allocator, &result);
+    if (!result)
+        columns = columns_create(allocator, xyz_min, keys, order, lengths, colors, count, &result);
+
+cleanup:
+    if (keys) allocator->free(allocator->user_data, keys, count * sizeof *keys);
+    if (order) allocator->free(allocator->user_data, order, count * sizeof *order);
+    if (lengths) allocator->free(allocator->user_data, lengths, count * sizeof *lengths);
+    if (colors) allocator->free(allocator->user_data, colors, count);
+    free_model_input(allocator, &input);
+    if (models) {
+        for (size_t i = 0; i < model_count; i++) {
+            for (int d = 0; d < 3; d++)
+                model_runs_free(&models[i].runs[d], allocator);
+        }
+        allocator->free(allocator->user_data, models, model_count * sizeof *models);
+    }
+    if (error) *error = result;
+    return columns;
+}
+
+// labels a region of the voxels; pairs across regions are joined once all regions are done
+struct components_task {
+    struct components_grid *grid;
+    const VxfAllocator *allocator;
+    size_t begin, end;
+    unsigned connectivity;
+    bool separate_colors;
+    struct component_edges edges;
+    VxfError error;
+};
+
+static int run_components_task(void *arg) {
+    struct components_task *task = arg;
+    task->error = components_label_region(task->grid, task->allocator, task->begin, task->end, task->connectivity,
+                                          task->separate_colors, &task->edges);
+    return 0;
+}
+
+VxfComponents *vxf_build_components(VxfFile *vf, const VxfComponentsOptions *options, VxfError *error) {
+    unsigned connectivity = options && options->connectivity ? options->connectivity : 6;
+    if (!vf || (connectivity != 6 && connectivity != 26)) {
+        if (error) *error = VXF_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    VxfError result = VXF_SUCCESS;
+    if (!vf->instances.built && (result = prepare_reading(vf)) != VXF_SUCCESS) {
+        if (error) *error = result;
+        return NULL;
+    }
+    int32_t xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    for (int i = 0; i < 3; i++) {
+        if ((int64_t)xyz_max[i] - xyz_min[i] > KEY_AXIS_MASK) {
+            if (error) *error = VXF_ERROR_KEY_RANGE;
+            return NULL;
+        }
+    }
+    const VxfAllocator *allocator = &vf->allocator;
+    struct sorted_voxels voxels;
+    struct components_grid grid = {0};
+    result = read_sorted_voxels(vf, xyz_min, options ? options->thread_count : 1, &voxels);
+    if (!result) {
+        result = components_grid_init(&grid, allocator, voxels.keys, voxels.order, voxels.colors, voxels.count);
+        free_sorted_voxels(allocator, &voxels);
+    }
+    if (result) {
+        if (error) *error = result;
+        return NULL;
+    }
+
+    unsigned thread_count = options ? CLAMP(options->thread_count, 1, MAX_THREADS) : 1;
+#ifndef VOXFLAT_HAVE_C11_THREADS
+    thread_count = 1;
+#endif
+    thread_count = (unsigned)MIN(thread_count, MAX(grid.brick_count, 1));
+    struct components_task tasks[MAX_THREADS];
+    for (unsigned i = 0; i < thread_count; i++) {
+        tasks[i] = (struct components_task){
+            .grid = &grid, .allocator = allocator,
+            .begin = components_region_start(&grid, i, thread_count),
+            .end = components_region_start(&grid, i + 1, thread_count),
+            .connectivity = connectivity, .separate_colors = options && options->separate_colors,
+        };
+    }
+    run_tasks(run_components_task, tasks, sizeof *tasks, thread_count);
+    for (unsigned i = 0; i < thread_count && !result; i++)
+        result = tasks[i].error;
+    VxfComponents *components = NULL;
+    if (!result) {
+        for (unsigned i = 0; i < thread_count; i++)
+            components_join(&grid, &tasks[i].edges);
+        components = components_create(allocator, xyz_min, &grid, &result);
+    }
+    for (unsigned i = 0; i < thread_count; i++)
+        component_edges_free(&tasks[i].edges, allocator);
+    components_grid_free(&grid, allocator);
+    if (error) *error = result;
+    return components;
 }
 
 void vxf_close(VxfFile *vf) {
     if (!vf) return;
-    if (vf->source.type == SOURCE_FILE && vf->source.file.from_filename)
-        fclose(vf->source.file.stream);
-    free(vf->nodes.items);
-    free(vf->models.items);
-    free(vf->model_sizes.items);
-    free(vf->group_children_node_idx.items);
-    free(vf->layers.items);
-    free(vf->readstate.stack);
-    free(vf->palette_buffer);
-    free(vf);
+    close_source(&vf->source);
+    const VxfAllocator *allocator = &vf->allocator;
+    if (vf->instances.items && !vf->instances.mapped)
+        allocator->free(allocator->user_data, vf->instances.items, vf->instances.count * sizeof *vf->instances.items);
+    if (vf->cache.mapping)
+        unmap_file(vf->cache.mapping, vf->cache.mapping_size);
+    if (vf->surface.occupancy)
+        allocator->free(allocator->user_data, vf->surface.occupancy, 2 * vf->surface.capacity * sizeof(uint64_t));
+    if (vf->data)
+        allocator->free(allocator->user_data, vf->data, vf->data_size);
+    if (vf->source.type == SOURCE_ASYNC && vf->source.async.buffer)
+        allocator->free(allocator->user_data, vf->source.async.buffer, vf->source.async.capacity);
+    allocator->free(allocator->user_data, vf, vf->alloc_size);
 }
 
 const char *vxf_error_string(VxfError error) {
@@ -877,6 +4005,8 @@ const char *vxf_error_string(VxfError error) {
         case VXF_ERROR_INVALID_SCENE: return "Invalid scene graph";
         case VXF_ERROR_OUT_OF_MEMORY: return "Out of memory or size overflow";
         case VXF_ERROR_INVALID_ARGUMENT: return "Invalid argument provided";
+        case VXF_ERROR_WOULD_BLOCK: return "More input is needed";
+        case VXF_ERROR_KEY_RANGE: return "Voxel positions exceed the range of keys";
         default: return "Unmapped error";
     }
 }
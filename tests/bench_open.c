@@ -0,0 +1,71 @@
+// Measures opening scenes with many nodes, which should take time linear in the number of nodes.
+#include "voxbuilder.h"
+#include <time.h>
+
+#define SMALL_SHAPE_COUNT 50000
+#define SCALE 4 // the large scene has this many times the nodes of the small one
+#define REPEAT 3
+#define MAX_RATIO 8.0 // linear time gives a ratio of about SCALE, quadratic time SCALE * SCALE
+
+// shape_count instances of a single voxel, each with a transform node, and a chain of as many pairs of transform
+// and group nodes above one more instance; id_scale > 1 creates sparse IDs
+static void build_scene(struct voxbuilder *vb, uint32_t shape_count, uint32_t id_scale) {
+    vb_begin(vb);
+    vb_model(vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 1}});
+    uint32_t chain_start = 2 + 2 * shape_count, chain_end = chain_start + 2 * shape_count;
+    vb_shape(vb, chain_end * id_scale, 0);
+    for (uint32_t id = chain_end; id > chain_start; id -= 2) {
+        vb_group(vb, (id - 1) * id_scale, 1, (const uint32_t[]){id * id_scale});
+        vb_transform(vb, (id - 2) * id_scale, (id - 1) * id_scale, -1, "0 0 1", NULL);
+    }
+    uint32_t *children = malloc(((size_t)shape_count + 1) * sizeof *children);
+    ASSERT(children);
+    for (uint32_t i = shape_count; i-- > 0;) {
+        char translation[32];
+        snprintf(translation, sizeof translation, "%u 0 0", (unsigned)i);
+        vb_shape(vb, (3 + 2 * i) * id_scale, 0);
+        vb_transform(vb, (2 + 2 * i) * id_scale, (3 + 2 * i) * id_scale, -1, translation, NULL);
+    }
+    for (uint32_t i = 0; i <= shape_count; i++)
+        children[i] = (2 + 2 * i) * id_scale;
+    vb_group(vb, id_scale, shape_count + 1, children);
+    free(children);
+    vb_transform(vb, 0, id_scale, -1, NULL, NULL);
+    vb_end(vb);
+}
+
+// processor time, which is less affected by other processes than wall time
+static double now(void) {
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// the fastest of several opens, in seconds
+static double time_open(uint32_t shape_count, uint32_t id_scale) {
+    struct voxbuilder vb;
+    build_scene(&vb, shape_count, id_scale);
+    double best = 0;
+    for (int r = 0; r < REPEAT; r++) {
+        double start = now();
+        VxfError error;
+        VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        ASSERT_EQ(shape_count + 1, vxf_count_voxels(vf));
+        double elapsed = now() - start;
+        vxf_close(vf);
+        best = r == 0 || elapsed < best ? elapsed : best;
+    }
+    free(vb.data);
+    return best;
+}
+
+int main(void) {
+    for (uint32_t id_scale = 1; id_scale <= 3; id_scale += 2) {
+        double small = time_open(SMALL_SHAPE_COUNT, id_scale);
+        double large = time_open(SCALE * SMALL_SHAPE_COUNT, id_scale);
+        double ratio = large / (small > 1e-6 ? small : 1e-6);
+        printf("id scale %u: %u nodes in %.3f s, %u nodes in %.3f s, ratio %.1f\n", (unsigned)id_scale,
+               4 * SMALL_SHAPE_COUNT + 3, small, 4 * SCALE * SMALL_SHAPE_COUNT + 3, large, ratio);
+        ASSERT(ratio < MAX_RATIO);
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Measures reading a scene with many instances in small batches.
+#include "voxbuilder.h"
+#include <time.h>
+
+#define MODEL_COUNT 8
+#define MODEL_VOXELS 1000
+#define INSTANCE_COUNT 512
+#define BATCH_SIZE 64
+#define REPEAT 50
+
+static void build_scene(struct voxbuilder *vb) {
+    static uint8_t xyzi[MODEL_VOXELS][4];
+    vb_begin(vb);
+    for (uint32_t m = 0; m < MODEL_COUNT; m++) {
+        for (size_t i = 0; i < MODEL_VOXELS; i++) {
+            xyzi[i][0] = i % 10, xyzi[i][1] = i / 10 % 10, xyzi[i][2] = (uint8_t)(i / 100);
+            xyzi[i][3] = (uint8_t)(m + 1);
+        }
+        vb_model(vb, 10, 10, 10, MODEL_VOXELS, (const uint8_t(*)[4])xyzi);
+    }
+    static uint32_t children[INSTANCE_COUNT];
+    vb_transform(vb, 0, 1, -1, NULL, NULL);
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++)
+        children[i] = 2 + 2 * i;
+    vb_group(vb, 1, INSTANCE_COUNT, children);
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+        char translation[32];
+        snprintf(translation, sizeof translation, "%u %u 0", i % 32 * 10, i / 32 * 10);
+        vb_transform(vb, 2 + 2 * i, 3 + 2 * i, -1, translation, i % 2 ? "17" : NULL);
+        vb_shape(vb, 3 + 2 * i, i % MODEL_COUNT);
+    }
+    vb_end(vb);
+}
+
+// processor time, which is less affected by other processes than wall time
+static double now(void) {
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+int main(void) {
+    struct voxbuilder vb;
+    build_scene(&vb);
+    int32_t xyz[BATCH_SIZE][3];
+    uint8_t rgba[BATCH_SIZE][4];
+    size_t total = 0;
+    double elapsed = 0;
+    for (int r = 0; r < REPEAT; r++) {
+        VxfError error;
+        VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        double start = now();
+        size_t count;
+        while ((count = vxf_read_xyz_rgba(vf, BATCH_SIZE, xyz, rgba, &error)) > 0)
+            total += count;
+        elapsed += now() - start;
+        ASSERT_EQ(VXF_SUCCESS, error);
+        vxf_close(vf);
+    }
+    ASSERT_EQ((size_t)REPEAT * INSTANCE_COUNT * MODEL_VOXELS, total);
+    printf("%zu voxels in batches of %d: %.3f s, %.1f Mvoxels/s\n", total, BATCH_SIZE, elapsed, total / elapsed * 1e-6);
+    free(vb.data);
+    return 0;
+}
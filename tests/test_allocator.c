@@ -0,0 +1,82 @@
+#include "common.h"
+#include <stddef.h>
+
+struct counting_allocator {
+    size_t allocations, frees, bytes_in_use;
+};
+
+static void *counting_alloc(void *user_data, size_t size) {
+    struct counting_allocator *counter = user_data;
+    counter->allocations++;
+    counter->bytes_in_use += size;
+    return malloc(size);
+}
+
+static void counting_free(void *user_data, void *ptr, size_t size) {
+    struct counting_allocator *counter = user_data;
+    counter->frees++;
+    counter->bytes_in_use -= size;
+    free(ptr);
+}
+
+struct arena {
+    _Alignas(max_align_t) char buffer[1 << 18];
+    size_t used;
+};
+
+static void *arena_alloc(void *user_data, size_t size) {
+    struct arena *arena = user_data;
+    size_t offset = (arena->used + _Alignof(max_align_t) - 1) / _Alignof(max_align_t) * _Alignof(max_align_t);
+    if (size > sizeof arena->buffer - offset) return NULL;
+    arena->used = offset + size;
+    return arena->buffer + offset;
+}
+
+static void arena_free(void *user_data, void *ptr, size_t size) {
+    (void)user_data, (void)ptr, (void)size; // memory is released by resetting the arena
+}
+
+static uintmax_t read_all(VxfFile *vf) {
+    int32_t xyz[64][3];
+    uint8_t coloridx[64];
+    uintmax_t total = 0;
+    size_t count;
+    VxfError error;
+    while ((count = vxf_read_xyz_coloridx(vf, 64, xyz, coloridx, &error)) > 0)
+        total += count;
+    ASSERT_EQ(VXF_SUCCESS, error);
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    ASSERT_EQ(3, argc);
+    const char *filename = argv[1];
+    unsigned long expected_count = strtoul(argv[2], NULL, 10);
+    VxfError error;
+
+    struct counting_allocator counter = {0};
+    VxfFile *vf = vxf_open_file_ex(filename, &(VxfOpenOptions){
+        .allocator = &(VxfAllocator){.alloc = counting_alloc, .free = counting_free, .user_data = &counter}
+    }, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(counter.allocations <= 2);
+    ASSERT_EQ(expected_count, read_all(vf));
+    vxf_close(vf);
+    ASSERT_EQ(counter.allocations, counter.frees);
+    ASSERT_EQ(0, counter.bytes_in_use);
+
+    static struct arena arena;
+    for (int i = 0; i < 2; i++) {
+        arena.used = 0;
+        vf = vxf_open_file_ex(filename, &(VxfOpenOptions){
+            .allocator = &(VxfAllocator){.alloc = arena_alloc, .free = arena_free, .user_data = &arena}
+        }, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        ASSERT_EQ(expected_count, read_all(vf));
+        vxf_close(vf);
+    }
+
+    vf = vxf_open_file_ex(filename, &(VxfOpenOptions){.allocator = &(VxfAllocator){0}}, &error);
+    ASSERT(vf == NULL);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+}
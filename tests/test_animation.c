@@ -0,0 +1,87 @@
+#include "voxbuilder.h"
+
+// instance 0 moves at frame 2, instance 1 changes its model at frame 1; keyframes of the shape are out of order
+static void build_scene(struct voxbuilder *vb) {
+    vb_begin(vb);
+    vb_model(vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 1}});
+    vb_model(vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 2}});
+    vb_transform(vb, 0, 1, -1, NULL, NULL);
+    vb_group(vb, 1, 2, (const uint32_t[]){2, 4});
+    vb_transform_frames(vb, 2, 3, 2, (const char *const[]){"0", "2"}, (const char *const[]){"0 0 0", "10 0 0"});
+    vb_shape(vb, 3, 0);
+    vb_transform(vb, 4, 5, -1, "20 0 0", NULL);
+    vb_shape_frames(vb, 5, 2, (const uint32_t[]){1, 0}, (const char *const[]){"1", NULL});
+    vb_end(vb);
+}
+
+static void check_voxels(VxfFile *vf, int32_t x0, int32_t x1, uint8_t color1) {
+    int32_t xyz[3][3];
+    uint8_t coloridx[3];
+    VxfError error;
+    ASSERT_EQ(2, vxf_read_xyz_coloridx(vf, 3, xyz, coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(x0, xyz[0][0]);
+    ASSERT_EQ(1, coloridx[0]);
+    ASSERT_EQ(x1, xyz[1][0]);
+    ASSERT_EQ(color1, coloridx[1]);
+}
+
+static void check_diff(VxfFile *vf, uint32_t frame_a, uint32_t frame_b, size_t count, const uint32_t expected[]) {
+    uint32_t ids[2];
+    VxfError error;
+    ASSERT_EQ(count, vxf_diff_frames(vf, frame_a, frame_b, 2, ids, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (size_t i = 0; i < count; i++)
+        ASSERT_EQ(expected[i], ids[i]);
+    ASSERT_EQ(count, vxf_diff_frames(vf, frame_a, frame_b, 0, NULL, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+}
+
+int main(void) {
+    struct voxbuilder vb;
+    build_scene(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(3, vxf_get_frame_count(vf));
+
+    check_voxels(vf, 0, 20, 1);
+
+    // selecting a frame restarts reading and updates the bounds
+    int32_t xyz[1][3];
+    uint8_t coloridx[1];
+    vxf_select_frame(vf, 1);
+    ASSERT_EQ(1, vxf_read_xyz_coloridx(vf, 1, xyz, coloridx, &error));
+    vxf_select_frame(vf, 1);
+    check_voxels(vf, 0, 20, 2);
+    vxf_select_frame(vf, 2);
+    check_voxels(vf, 10, 20, 2);
+    int32_t xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    ASSERT_EQ(10, xyz_min[0]);
+    ASSERT_EQ(20, xyz_max[0]);
+    vxf_select_frame(vf, 100);
+    check_voxels(vf, 10, 20, 2);
+
+    // diffs do not change the selected frame
+    check_diff(vf, 0, 1, 1, (const uint32_t[]){1});
+    check_diff(vf, 1, 2, 1, (const uint32_t[]){0});
+    check_diff(vf, 2, 0, 2, (const uint32_t[]){0, 1});
+    check_diff(vf, 2, 7, 0, NULL);
+    vxf_select_frame(vf, 0);
+    check_voxels(vf, 0, 20, 1);
+    vxf_close(vf);
+    free(vb.data);
+
+    // files without animation have a single frame
+    vb_begin(&vb);
+    vb_model(&vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 1}});
+    vb_end(&vb);
+    vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(1, vxf_get_frame_count(vf));
+    check_diff(vf, 0, 1, 0, NULL);
+    vxf_close(vf);
+    free(vb.data);
+    return 0;
+}
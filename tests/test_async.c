@@ -0,0 +1,186 @@
+#include "voxbuilder.h"
+
+#define MAX_COUNT 30000
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// feeds the requested ranges from a file in memory until the instance needs no more bytes or has failed;
+// returns the result of the last feed
+static VxfError feed_requests(VxfFile *vf, const char *data, size_t size, size_t *feed_count) {
+    VxfError result = VXF_ERROR_WOULD_BLOCK;
+    uint64_t offset;
+    size_t request_size;
+    while (result == VXF_ERROR_WOULD_BLOCK && vxf_async_get_request(vf, &offset, &request_size)) {
+        ASSERT(request_size > 0);
+        size_t n = offset < size ? (size_t)MIN(request_size, size - offset) : 0;
+        result = vxf_async_feed(vf, data + MIN(offset, size), n);
+        if (feed_count) ++*feed_count;
+    }
+    return result;
+}
+
+static VxfFile *open_async(const char *data, size_t size, int fingerprint_models) {
+    VxfError error;
+    VxfFile *vf = vxf_open_async(&(VxfOpenOptions){.fingerprint_models = fingerprint_models}, &error);
+    ASSERT(vf);
+    ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+    ASSERT_EQ(VXF_SUCCESS, feed_requests(vf, data, size, NULL));
+    ASSERT(!vxf_async_get_request(vf, &(uint64_t){0}, &(size_t){0}));
+    return vf;
+}
+
+// reads all voxels, feeding the requested bytes whenever a read would block
+static size_t read_all(VxfFile *vf, const char *data, size_t size, bool surface_only, int32_t xyz[][3],
+                       uint8_t coloridx[], size_t *feed_count) {
+    size_t total = 0;
+    for (;;) {
+        VxfError error;
+        size_t count = vxf_read(vf, &(VxfReadBuffers){
+            .max_count = MAX_COUNT - total, .xyz = xyz + total, .coloridx = coloridx + total,
+            .surface_only = surface_only,
+        }, NULL, &error);
+        total += count;
+        if (error == VXF_ERROR_WOULD_BLOCK) {
+            ASSERT_EQ(0, count);
+            ASSERT_EQ(VXF_SUCCESS, feed_requests(vf, data, size, feed_count));
+            continue;
+        }
+        ASSERT_EQ(VXF_SUCCESS, error);
+        if (count == 0)
+            return total;
+    }
+}
+
+// the results match those of vxf_open_memory, for all voxels and for the surface only
+static void check_file(const char *data, size_t size, size_t min_feed_count) {
+    static int32_t expected_xyz[MAX_COUNT][3], xyz[MAX_COUNT][3];
+    static uint8_t expected_coloridx[MAX_COUNT], coloridx[MAX_COUNT];
+    VxfError error;
+    VxfFile *expected_vf = vxf_open_memory(size, data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (int fingerprint_models = 0; fingerprint_models < 2; fingerprint_models++) {
+        for (int surface_only = 0; surface_only < 2; surface_only++) {
+            vxf_set_read_position(expected_vf, 0, &error);
+            size_t expected_count = read_all(expected_vf, NULL, 0, surface_only, expected_xyz, expected_coloridx, NULL);
+            VxfFile *vf = open_async(data, size, fingerprint_models);
+            int32_t min[3], max[3], expected_min[3], expected_max[3];
+            vxf_calculate_bounds(vf, min, max);
+            vxf_calculate_bounds(expected_vf, expected_min, expected_max);
+            ASSERT(memcmp(min, expected_min, sizeof min) == 0 && memcmp(max, expected_max, sizeof max) == 0);
+            uint8_t palette[256][4], expected_palette[256][4];
+            vxf_get_palette(vf, palette);
+            vxf_get_palette(expected_vf, expected_palette);
+            ASSERT(memcmp(palette, expected_palette, sizeof palette) == 0);
+
+            size_t feed_count = 0;
+            ASSERT_EQ(expected_count, read_all(vf, data, size, surface_only, xyz, coloridx, &feed_count));
+            ASSERT(memcmp(expected_xyz, xyz, expected_count * sizeof *xyz) == 0);
+            ASSERT(memcmp(expected_coloridx, coloridx, expected_count) == 0);
+            ASSERT(surface_only || feed_count >= min_feed_count); // the surface needs the whole model at once
+            vxf_close(vf);
+        }
+    }
+    vxf_close(expected_vf);
+}
+
+// a model larger than a single request is read in several parts, except for its surface
+static void test_large_model(void) {
+    enum { SIDE = 32, HEIGHT = 24 };
+    static uint8_t voxels[SIDE * SIDE * HEIGHT][4];
+    size_t n = 0;
+    for (int z = 0; z < HEIGHT; z++) {
+        for (int y = 0; y < SIDE; y++) {
+            for (int x = 0; x < SIDE; x++, n++)
+                memcpy(voxels[n], (const uint8_t[4]){(uint8_t)x, (uint8_t)y, (uint8_t)z, (uint8_t)(1 + (x ^ y) % 8)}, 4);
+        }
+    }
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, SIDE, SIDE, HEIGHT, n, (const uint8_t(*)[4])voxels);
+    vb_transform(&vb, 0, 1, -1, NULL, NULL);
+    vb_group(&vb, 1, 2, (const uint32_t[]){2, 4});
+    vb_transform(&vb, 2, 3, -1, NULL, NULL);
+    vb_shape(&vb, 3, 0);
+    vb_transform(&vb, 4, 5, -1, "40 0 0", "17");
+    vb_shape(&vb, 5, 0);
+    vb_end(&vb);
+    check_file(vb.data, vb.size, 2);
+    free(vb.data);
+}
+
+static void test_errors(const char *data, size_t size) {
+    // truncated files fail like with vxf_open_memory, after feeding the available bytes
+    for (size_t truncated = 0; truncated < size; truncated += 1 + truncated / 2) {
+        VxfError expected_error;
+        VxfFile *expected_vf = vxf_open_memory(truncated, data, &expected_error);
+        VxfError error;
+        VxfFile *vf = vxf_open_async(NULL, &error);
+        ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+        error = feed_requests(vf, data, truncated, NULL);
+        if (expected_vf) {
+            ASSERT_EQ(VXF_SUCCESS, error);
+            vxf_close(expected_vf);
+        } else {
+            ASSERT_EQ(expected_error, error);
+            ASSERT(!vxf_async_get_request(vf, &(uint64_t){0}, &(size_t){0}));
+            ASSERT_EQ(expected_error, vxf_async_feed(vf, data, 0));
+            int32_t xyz[1][3];
+            uint8_t coloridx[1];
+            ASSERT_EQ(0, vxf_read_xyz_coloridx(vf, 1, xyz, coloridx, &error));
+            ASSERT_EQ(expected_error, error);
+        }
+        vxf_close(vf);
+    }
+
+    // reading before the file has been opened, feeding more than requested, and other sources
+    VxfError error;
+    VxfFile *vf = vxf_open_async(NULL, &error);
+    int32_t xyz[1][3];
+    uint8_t coloridx[1];
+    ASSERT_EQ(0, vxf_read_xyz_coloridx(vf, 1, xyz, coloridx, &error));
+    ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+    uint64_t offset;
+    size_t request_size;
+    ASSERT(vxf_async_get_request(vf, &offset, &request_size));
+    ASSERT_EQ(0, offset);
+    // the scene functions return empty results in the meantime
+    int32_t min[3], max[3];
+    vxf_calculate_bounds(vf, min, max);
+    ASSERT(min[0] == 0 && min[1] == 0 && min[2] == 0 && max[0] == 0 && max[1] == 0 && max[2] == 0);
+    ASSERT_EQ(0, vxf_count_voxels(vf));
+    vxf_set_filter(vf, &(VxfFilter){.show_hidden = 1});
+    vxf_select_frame(vf, 1);
+    ASSERT_EQ(0, vxf_find_nodes(vf, "", 0, NULL));
+    ASSERT(!vxf_get_node_name(vf, 0));
+    vxf_select_node(vf, 0, &error);
+    ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+    ASSERT_EQ(0, vxf_diff_frames(vf, 0, 1, 0, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+    ASSERT_EQ(0, vxf_diff_scenes(vf, vf, 0, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+    vxf_set_read_position(vf, 0, &error);
+    ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+    ASSERT(!vxf_build_mesh(vf, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, vxf_async_feed(vf, data, request_size + 1));
+    ASSERT_EQ(VXF_SUCCESS, feed_requests(vf, data, size, NULL));
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, vxf_async_feed(vf, data, 1));
+    vxf_close(vf);
+    vf = vxf_open_memory(size, data, &error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, vxf_async_feed(vf, data, 1));
+    ASSERT(!vxf_async_get_request(vf, &offset, &request_size));
+    vxf_close(vf);
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    FILE *file = fopen(argv[1], "rb");
+    ASSERT(file);
+    static char buffer[1 << 16];
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    ASSERT(size > 0 && size < sizeof(buffer));
+    fclose(file);
+    check_file(buffer, size, 0);
+    test_errors(buffer, size);
+    test_large_model();
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 30000
+
+static VxfBoxes *build_boxes(VxfFile *vf, int ignore_colors, unsigned thread_count) {
+    VxfError error;
+    VxfBoxes *boxes = vxf_build_boxes(vf, &(VxfBoxesOptions){
+        .ignore_colors = ignore_colors, .thread_count = thread_count,
+    }, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(boxes);
+    return boxes;
+}
+
+static bool box_contains(const VxfBox *box, const int32_t pos[3]) {
+    for (int i = 0; i < 3; i++) {
+        if (pos[i] < box->min[i] || pos[i] > box->max[i])
+            return false;
+    }
+    return true;
+}
+
+static bool same_box(const VxfBox *a, const VxfBox *b) {
+    return memcmp(a->min, b->min, sizeof a->min) == 0 && memcmp(a->max, b->max, sizeof a->max) == 0
+        && a->coloridx == b->coloridx;
+}
+
+// index of the last voxel read at pos for an instance, or -1
+static long find_voxel(size_t count, int32_t xyz[][3], const uint32_t instance_ids[], uint32_t instance_id,
+                       const int32_t pos[3]) {
+    for (size_t i = count; i-- > 0;) {
+        if (instance_ids[i] == instance_id && xyz[i][0] == pos[0] && xyz[i][1] == pos[1] && xyz[i][2] == pos[2])
+            return (long)i;
+    }
+    return -1;
+}
+
+// checks that the boxes of each instance cover exactly its voxels: every position in a box is a voxel with the
+// color of the box, every voxel is in a box, and the volumes add up to the number of distinct voxels
+static void check_boxes(const VxfBoxes *boxes, size_t count, int32_t xyz[][3], const uint8_t coloridx[],
+                        const uint32_t instance_ids[], int ignore_colors) {
+    for (size_t m = 0, first = 0; m < boxes->model_count; m++) {
+        ASSERT_EQ(first, boxes->models[m].first_box);
+        first += boxes->models[m].box_count;
+        ASSERT(first <= boxes->box_count);
+    }
+    for (size_t n = 0; n < boxes->instance_count; n++) {
+        const VxfBoxInstance *instance = &boxes->instances[n];
+        ASSERT(instance->model < boxes->model_count);
+        const VxfBoxModel *model = &boxes->models[instance->model];
+        size_t volume = 0;
+        for (uint32_t b = model->first_box; b < model->first_box + model->box_count; b++) {
+            VxfBox box;
+            vxf_transform_box(instance, &boxes->boxes[b], &box);
+            for (int32_t z = box.min[2]; z <= box.max[2]; z++) {
+                for (int32_t y = box.min[1]; y <= box.max[1]; y++) {
+                    for (int32_t x = box.min[0]; x <= box.max[0]; x++) {
+                        const int32_t pos[3] = {x, y, z};
+                        long i = find_voxel(count, xyz, instance_ids, instance->instance_id, pos);
+                        ASSERT(i >= 0);
+                        ASSERT(ignore_colors || coloridx[i] == box.coloridx);
+                        volume++;
+                    }
+                }
+            }
+        }
+        size_t distinct = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (instance_ids[i] != instance->instance_id
+                    || find_voxel(count, xyz, instance_ids, instance->instance_id, xyz[i]) != (long)i)
+                continue;
+            distinct++;
+            bool covered = false;
+            for (uint32_t b = model->first_box; b < model->first_box + model->box_count && !covered; b++) {
+                VxfBox box;
+                vxf_transform_box(instance, &boxes->boxes[b], &box);
+                covered = box_contains(&box, xyz[i]);
+            }
+            ASSERT(covered);
+        }
+        ASSERT_EQ(distinct, volume);
+    }
+}
+
+static void test_vf(VxfFile *vf) {
+    static int32_t xyz[MAX_VOXELS][3];
+    static uint8_t coloridx[MAX_VOXELS];
+    static uint32_t instance_ids[MAX_VOXELS];
+    VxfError error;
+    size_t count = 0, n;
+    uint32_t instance_id;
+    while ((n = vxf_read(vf, &(VxfReadBuffers){
+        .max_count = MAX_VOXELS - count, .xyz = xyz + count, .coloridx = coloridx + count,
+    }, &instance_id, &error)) > 0) {
+        for (size_t i = count; i < count + n; i++)
+            instance_ids[i] = instance_id;
+        count += n;
+    }
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(count > 0 && count < MAX_VOXELS);
+    size_t instance_count = instance_ids[count - 1] + 1;
+
+    for (int ignore_colors = 0; ignore_colors < 2; ignore_colors++) {
+        VxfBoxes *boxes = build_boxes(vf, ignore_colors, 1);
+        VxfBoxes *parallel_boxes = build_boxes(vf, ignore_colors, 4);
+        ASSERT_EQ(instance_count, boxes->instance_count);
+        ASSERT_EQ(boxes->box_count, parallel_boxes->box_count);
+        ASSERT(memcmp(boxes->models, parallel_boxes->models, boxes->model_count * sizeof *boxes->models) == 0);
+        for (size_t i = 0; i < boxes->box_count; i++)
+            ASSERT(same_box(&boxes->boxes[i], &parallel_boxes->boxes[i]));
+        ASSERT(memcmp(boxes->instances, parallel_boxes->instances,
+                      boxes->instance_count * sizeof *boxes->instances) == 0);
+        vxf_free_boxes(parallel_boxes);
+        check_boxes(boxes, count, xyz, coloridx, instance_ids, ignore_colors);
+        vxf_free_boxes(boxes);
+    }
+    // the read position is unchanged
+    ASSERT_EQ(0, vxf_read_xyz_coloridx(vf, 1, xyz, coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+}
+
+static void test_file(const char *filename) {
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    test_vf(vf);
+    vxf_close(vf);
+}
+
+// a solid block of 70x3x2 voxels, spanning two words per row, with the upper layer in another color past x = 40,
+// and a rotated instance of it
+static void test_block(void) {
+    enum { SX = 70, SY = 3, SZ = 2 };
+    static uint8_t voxels[SX * SY * SZ][4];
+    size_t n = 0;
+    for (int z = 0; z < SZ; z++) {
+        for (int y = 0; y < SY; y++) {
+            for (int x = 0; x < SX; x++, n++)
+                memcpy(voxels[n], (const uint8_t[4]){(uint8_t)x, (uint8_t)y, (uint8_t)z, z == 1 && x >= 40 ? 2 : 1}, 4);
+        }
+    }
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, SX, SY, SZ, n, (const uint8_t(*)[4])voxels);
+    vb_transform(&vb, 0, 1, -1, NULL, NULL);
+    vb_group(&vb, 1, 2, (const uint32_t[]){2, 4});
+    vb_transform(&vb, 2, 3, -1, NULL, NULL);
+    vb_shape(&vb, 3, 0);
+    vb_transform(&vb, 4, 5, -1, "0 0 100", "73");
+    vb_shape(&vb, 5, 0);
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    test_vf(vf);
+
+    VxfBoxes *boxes = build_boxes(vf, 1, 1);
+    ASSERT_EQ(1, boxes->box_count);
+    ASSERT_EQ(2, boxes->instance_count);
+    ASSERT_EQ(0, boxes->instances[1].model);
+    VxfBox box;
+    vxf_transform_box(&boxes->instances[1], &boxes->boxes[0], &box);
+    ASSERT_EQ(SX - 1, box.max[2] - box.min[2]);
+    vxf_free_boxes(boxes);
+    boxes = build_boxes(vf, 0, 1);
+    ASSERT_EQ(3, boxes->box_count); // the lower layer, and the upper layer in two parts
+    vxf_free_boxes(boxes);
+
+    ASSERT(!vxf_build_boxes(NULL, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_close(vf);
+    free(vb.data);
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    test_file(argv[1]);
+    test_block();
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "common.h"
+#include <math.h>
+#include <string.h>
+
+#define MAX_VOXELS 1000
+
+static VxfFile *open_file(const char *filename) {
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    return vf;
+}
+
+static size_t read_colors(const char *filename, VxfColorFormat format, const uint32_t *remap, void *color) {
+    VxfFile *vf = open_file(filename);
+    VxfError error;
+    size_t count = vxf_read(vf, &(VxfReadBuffers){
+        .max_count = MAX_VOXELS,
+        .color = color,
+        .color_format = format,
+        .color_remap = remap,
+    }, NULL, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    vxf_close(vf);
+    return count;
+}
+
+static float srgb_to_linear(uint8_t value) {
+    float c = value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+int main(int argc, char* argv[]) {
+    ASSERT_EQ(2, argc);
+    static uint8_t rgba[MAX_VOXELS][4], coloridx[MAX_VOXELS];
+    VxfFile *vf = open_file(argv[1]);
+    VxfError error;
+    size_t count = vxf_read(vf, &(VxfReadBuffers){.max_count = MAX_VOXELS, .rgba = rgba, .coloridx = coloridx}, NULL, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(count > 0 && count < MAX_VOXELS);
+
+    // a color buffer without a valid format or remap table is rejected
+    uint32_t dummy;
+    vxf_read(vf, &(VxfReadBuffers){.max_count = 1, .color = &dummy, .color_format = 99}, NULL, &error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_read(vf, &(VxfReadBuffers){.max_count = 1, .color = &dummy, .color_format = VXF_COLOR_FORMAT_REMAP_U32}, NULL, &error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_close(vf);
+
+    static uint8_t bytes[MAX_VOXELS][4];
+    ASSERT_EQ(count, read_colors(argv[1], VXF_COLOR_FORMAT_RGBA8, NULL, bytes));
+    ASSERT(memcmp(bytes, rgba, count * 4) == 0);
+
+    ASSERT_EQ(count, read_colors(argv[1], VXF_COLOR_FORMAT_BGRA8, NULL, bytes));
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(rgba[i][0], bytes[i][2]);
+        ASSERT_EQ(rgba[i][1], bytes[i][1]);
+        ASSERT_EQ(rgba[i][2], bytes[i][0]);
+        ASSERT_EQ(rgba[i][3], bytes[i][3]);
+    }
+
+    static uint16_t rgb565[MAX_VOXELS];
+    ASSERT_EQ(count, read_colors(argv[1], VXF_COLOR_FORMAT_RGB565, NULL, rgb565));
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(rgba[i][0] >> 3, rgb565[i] >> 11);
+        ASSERT_EQ(rgba[i][1] >> 2, (rgb565[i] >> 5) & 0x3f);
+        ASSERT_EQ(rgba[i][2] >> 3, rgb565[i] & 0x1f);
+    }
+
+    static float linear[MAX_VOXELS][4];
+    ASSERT_EQ(count, read_colors(argv[1], VXF_COLOR_FORMAT_RGBA_F32_LINEAR, NULL, linear));
+    for (size_t i = 0; i < count; i++) {
+        for (int j = 0; j < 3; j++)
+            ASSERT(fabsf(srgb_to_linear(rgba[i][j]) - linear[i][j]) < 1e-6f);
+        ASSERT(fabsf(rgba[i][3] / 255.0f - linear[i][3]) < 1e-6f);
+    }
+
+    uint32_t remap[256];
+    for (uint32_t i = 0; i < 256; i++)
+        remap[i] = i * 1000 + 7;
+    static uint32_t remapped[MAX_VOXELS];
+    ASSERT_EQ(count, read_colors(argv[1], VXF_COLOR_FORMAT_REMAP_U32, remap, remapped));
+    for (size_t i = 0; i < count; i++)
+        ASSERT_EQ(remap[coloridx[i]], remapped[i]);
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 1000
+
+static VxfColumns *build_columns(VxfFile *vf, unsigned thread_count) {
+    VxfError error;
+    VxfColumns *columns = vxf_build_columns(vf, &(VxfColumnsOptions){.thread_count = thread_count}, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(columns);
+    return columns;
+}
+
+// expected color index at pos: the last voxel read there, or 0
+static uint8_t expected_color(size_t count, int32_t xyz[][3], const uint8_t coloridx[], const int32_t pos[3]) {
+    for (size_t i = count; i-- > 0;) {
+        if (xyz[i][0] == pos[0] && xyz[i][1] == pos[1] && xyz[i][2] == pos[2])
+            return coloridx[i];
+    }
+    return 0;
+}
+
+// checks the layout, and that the runs cover exactly the voxels read, with the color of the one read last
+static void check_columns(const VxfColumns *columns, size_t count, int32_t xyz[][3], const uint8_t coloridx[]) {
+    size_t distinct = 0, covered = 0;
+    for (size_t i = 0; i < count; i++)
+        distinct += expected_color(count - i - 1, xyz + i + 1, coloridx + i + 1, xyz[i]) == 0;
+    for (size_t i = 0; i < columns->column_count; i++) {
+        const VxfColumn *column = &columns->columns[i];
+        if (i > 0) {
+            const VxfColumn *prev = &columns->columns[i - 1];
+            ASSERT(prev->xy[1] < column->xy[1] || (prev->xy[1] == column->xy[1] && prev->xy[0] < column->xy[0]));
+            ASSERT_EQ(prev->first_run + prev->run_count, column->first_run);
+        }
+        ASSERT(column->run_count > 0);
+        for (uint32_t j = column->first_run; j < column->first_run + column->run_count; j++) {
+            const VxfColumnRun *run = &columns->runs[j];
+            ASSERT(run->length > 0);
+            if (j > column->first_run) {
+                // adjacent runs are only split if their colors differ or the length is at its limit
+                const VxfColumnRun *prev = &columns->runs[j - 1];
+                ASSERT(prev->z + prev->length <= run->z);
+                ASSERT(prev->z + prev->length < run->z || prev->coloridx != run->coloridx || prev->length == UINT16_MAX);
+            }
+            for (int32_t z = run->z; z < run->z + run->length; z++) {
+                int32_t pos[3] = {column->xy[0], column->xy[1], z};
+                if (count > 0)
+                    ASSERT_EQ(expected_color(count, xyz, coloridx, pos), run->coloridx);
+                covered++;
+            }
+        }
+    }
+    ASSERT_EQ(columns->run_count, columns->column_count > 0 ? columns->columns[columns->column_count - 1].first_run
+                                  + columns->columns[columns->column_count - 1].run_count : 0);
+    if (count > 0)
+        ASSERT_EQ(distinct, covered);
+}
+
+static void test_vf(VxfFile *vf) {
+    static int32_t xyz[MAX_VOXELS][3];
+    static uint8_t coloridx[MAX_VOXELS];
+    VxfError error;
+    size_t count = vxf_read_xyz_coloridx(vf, 5, xyz, coloridx, &error);
+    VxfColumns *columns = build_columns(vf, 1);
+    VxfColumns *parallel_columns = build_columns(vf, 4);
+    count += vxf_read_xyz_coloridx(vf, MAX_VOXELS - count, xyz + count, coloridx + count, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(count > 0 && count < MAX_VOXELS);
+    check_columns(columns, count, xyz, coloridx);
+    ASSERT_EQ(columns->run_count, parallel_columns->run_count);
+    ASSERT(memcmp(columns->runs, parallel_columns->runs, columns->run_count * sizeof *columns->runs) == 0);
+    vxf_free_columns(columns);
+    vxf_free_columns(parallel_columns);
+}
+
+static void test_file(const char *filename) {
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    test_vf(vf);
+    vxf_close(vf);
+}
+
+// overlapping and stacked instances, one of them rotated so that model x maps to -z
+static void test_overlap(void) {
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 3, 1, 4, 6, (const uint8_t[][4]){
+        {0, 0, 0, 1}, {0, 0, 1, 1}, {0, 0, 2, 2}, {0, 0, 3, 1}, {2, 0, 0, 5}, {0, 0, 3, 4},
+    });
+    vb_transform(&vb, 0, 1, -1, NULL, NULL);
+    vb_group(&vb, 1, 4, (const uint32_t[]){2, 4, 6, 8});
+    vb_transform(&vb, 2, 3, -1, NULL, NULL);
+    vb_shape(&vb, 3, 0);
+    vb_transform(&vb, 4, 5, -1, "0 0 4", NULL);
+    vb_shape(&vb, 5, 0);
+    vb_transform(&vb, 6, 7, -1, "0 0 2", NULL);
+    vb_shape(&vb, 7, 0);
+    vb_transform(&vb, 8, 9, -1, "1 0 1", "73");
+    vb_shape(&vb, 9, 0);
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    test_vf(vf);
+
+    // voxels filtered by color leave gaps
+    vxf_set_filter(vf, &(VxfFilter){.color_mask = (const uint64_t[4]){1 << 1 | 1 << 4 | 1 << 5}});
+    test_vf(vf);
+    vxf_close(vf);
+    free(vb.data);
+}
+
+// columns of more than 65535 voxels are split into several runs
+static void test_long_column(void) {
+    enum { HEIGHT = 256, INSTANCES = 257 };
+    static uint8_t voxels[HEIGHT][4];
+    static uint32_t children[INSTANCES];
+    for (int i = 0; i < HEIGHT; i++)
+        memcpy(voxels[i], (const uint8_t[4]){0, 0, (uint8_t)i, 7}, 4);
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 1, 1, HEIGHT, HEIGHT, (const uint8_t(*)[4])voxels);
+    vb_transform(&vb, 0, 1, -1, NULL, NULL);
+    for (uint32_t i = 0; i < INSTANCES; i++)
+        children[i] = 2 + 2 * i;
+    vb_group(&vb, 1, INSTANCES, children);
+    for (uint32_t i = 0; i < INSTANCES; i++) {
+        char translation[32];
+        snprintf(translation, sizeof translation, "0 0 %u", i * HEIGHT);
+        vb_transform(&vb, children[i], children[i] + 1, -1, translation, NULL);
+        vb_shape(&vb, children[i] + 1, 0);
+    }
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    VxfColumns *columns = build_columns(vf, 1);
+    ASSERT_EQ(1, columns->column_count);
+    ASSERT_EQ(2, columns->run_count);
+    ASSERT_EQ(UINT16_MAX, columns->runs[0].length);
+    ASSERT_EQ(HEIGHT * INSTANCES - UINT16_MAX, columns->runs[1].length);
+    ASSERT_EQ(columns->runs[0].z + UINT16_MAX, columns->runs[1].z);
+    check_columns(columns, 0, NULL, NULL);
+    vxf_free_columns(columns);
+    vxf_close(vf);
+    free(vb.data);
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    test_file(argv[1]);
+    test_overlap();
+    test_long_column();
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 1000
+
+static VxfComponents *build_components(VxfFile *vf, unsigned connectivity, int separate_colors,
+                                       unsigned thread_count) {
+    VxfError error;
+    VxfComponents *components = vxf_build_components(vf, &(VxfComponentsOptions){
+        .connectivity = connectivity, .separate_colors = separate_colors, .thread_count = thread_count,
+    }, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(components);
+    return components;
+}
+
+static bool adjacent(const int32_t a[3], const int32_t b[3], unsigned connectivity) {
+    int distance = 0, max_distance = 0;
+    for (int i = 0; i < 3; i++) {
+        int d = abs(a[i] - b[i]);
+        distance += d;
+        max_distance = d > max_distance ? d : max_distance;
+    }
+    return connectivity == 26 ? max_distance == 1 : distance == 1;
+}
+
+// expected color index at pos: the last voxel read there, or 0
+static uint8_t expected_color(size_t count, int32_t xyz[][3], const uint8_t coloridx[], const int32_t pos[3]) {
+    for (size_t i = count; i-- > 0;) {
+        if (xyz[i][0] == pos[0] && xyz[i][1] == pos[1] && xyz[i][2] == pos[2])
+            return coloridx[i];
+    }
+    return 0;
+}
+
+// checks that the components cover exactly the voxels read, and that voxels are in the same component if and only
+// if they are connected, by comparing all pairs
+static void check_components(const VxfComponents *components, size_t count, int32_t xyz[][3],
+                             const uint8_t coloridx[], unsigned connectivity, int separate_colors) {
+    static uint32_t label[MAX_VOXELS], queue[MAX_VOXELS];
+    static bool reached[MAX_VOXELS];
+    size_t distinct = 0;
+    for (size_t i = 0; i < count; i++)
+        distinct += expected_color(count - i - 1, xyz + i + 1, coloridx + i + 1, xyz[i]) == 0;
+    ASSERT_EQ(distinct, components->voxel_count);
+    size_t n = components->voxel_count;
+    for (size_t c = 0, first = 0; c < components->component_count; c++) {
+        const VxfComponent *component = &components->components[c];
+        ASSERT_EQ(first, component->first_voxel);
+        ASSERT(component->voxel_count > 0);
+        first += component->voxel_count;
+        int32_t min[3] = {INT32_MAX, INT32_MAX, INT32_MAX}, max[3] = {INT32_MIN, INT32_MIN, INT32_MIN};
+        for (uint32_t i = component->first_voxel; i < first; i++) {
+            label[i] = (uint32_t)c;
+            ASSERT_EQ(expected_color(count, xyz, coloridx, components->xyz[i]), components->coloridx[i]);
+            for (int j = 0; j < 3; j++) {
+                min[j] = components->xyz[i][j] < min[j] ? components->xyz[i][j] : min[j];
+                max[j] = components->xyz[i][j] > max[j] ? components->xyz[i][j] : max[j];
+            }
+        }
+        ASSERT(memcmp(min, component->min, sizeof min) == 0 && memcmp(max, component->max, sizeof max) == 0);
+    }
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            bool connected = adjacent(components->xyz[i], components->xyz[j], connectivity)
+                && (!separate_colors || components->coloridx[i] == components->coloridx[j]);
+            ASSERT(!connected || label[i] == label[j]);
+        }
+    }
+    // each component is connected: a breadth-first search from its first voxel reaches all of its voxels
+    memset(reached, 0, n * sizeof *reached);
+    for (size_t c = 0; c < components->component_count; c++) {
+        const VxfComponent *component = &components->components[c];
+        size_t head = 0, tail = 0;
+        queue[tail++] = component->first_voxel;
+        reached[component->first_voxel] = true;
+        while (head < tail) {
+            uint32_t i = queue[head++];
+            for (uint32_t j = component->first_voxel; j < component->first_voxel + component->voxel_count; j++) {
+                if (!reached[j] && adjacent(components->xyz[i], components->xyz[j], connectivity)
+                        && (!separate_colors || components->coloridx[i] == components->coloridx[j])) {
+                    reached[j] = true;
+                    queue[tail++] = j;
+                }
+            }
+        }
+        ASSERT_EQ(component->voxel_count, tail);
+    }
+}
+
+static void test_vf(VxfFile *vf) {
+    static int32_t xyz[MAX_VOXELS][3];
+    static uint8_t coloridx[MAX_VOXELS];
+    VxfError error;
+    size_t count = vxf_read_xyz_coloridx(vf, 5, xyz, coloridx, &error);
+    for (unsigned connectivity = 6; connectivity <= 26; connectivity += 20) {
+        for (int separate_colors = 0; separate_colors < 2; separate_colors++) {
+            VxfComponents *components = build_components(vf, connectivity, separate_colors, 1);
+            VxfComponents *parallel_components = build_components(vf, connectivity, separate_colors, 4);
+            ASSERT_EQ(components->component_count, parallel_components->component_count);
+            ASSERT(memcmp(components->components, parallel_components->components,
+                          components->component_count * sizeof *components->components) == 0);
+            ASSERT(memcmp(components->xyz, parallel_components->xyz,
+                          components->voxel_count * sizeof *components->xyz) == 0);
+            vxf_free_components(parallel_components);
+            if (separate_colors == 0 && connectivity == 6) {
+                // the read position is unchanged
+                count += vxf_read_xyz_coloridx(vf, MAX_VOXELS - count, xyz + count, coloridx + count, &error);
+                ASSERT_EQ(VXF_SUCCESS, error);
+                ASSERT(count > 0 && count < MAX_VOXELS);
+            }
+            check_components(components, count, xyz, coloridx, connectivity, separate_colors);
+            vxf_free_components(components);
+        }
+    }
+}
+
+static void test_file(const char *filename) {
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    test_vf(vf);
+    vxf_close(vf);
+}
+
+// bars of 12 voxels: A and C next to each other, D replacing half of C with the color of A, and B touching D at
+// an edge only; they span several bricks
+static void test_pieces(void) {
+    uint8_t bars[2][12][4];
+    for (int i = 0; i < 12; i++) {
+        memcpy(bars[0][i], (const uint8_t[4]){(uint8_t)i, 0, 0, 1}, 4);
+        memcpy(bars[1][i], (const uint8_t[4]){(uint8_t)i, 0, 0, 2}, 4);
+    }
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 12, 1, 1, 12, (const uint8_t(*)[4])bars[0]);
+    vb_model(&vb, 12, 1, 1, 12, (const uint8_t(*)[4])bars[1]);
+    vb_transform(&vb, 0, 1, -1, NULL, NULL);
+    vb_group(&vb, 1, 4, (const uint32_t[]){2, 4, 6, 8});
+    vb_transform(&vb, 2, 3, -1, "0 0 0", NULL); // A
+    vb_shape(&vb, 3, 0);
+    vb_transform(&vb, 4, 5, -1, "12 2 1", NULL); // B
+    vb_shape(&vb, 5, 1);
+    vb_transform(&vb, 6, 7, -1, "0 1 0", NULL); // C
+    vb_shape(&vb, 7, 1);
+    vb_transform(&vb, 8, 9, -1, "6 1 0", NULL); // D
+    vb_shape(&vb, 9, 0);
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    test_vf(vf);
+
+    VxfComponents *components = build_components(vf, 6, 0, 4);
+    ASSERT_EQ(42, components->voxel_count);
+    ASSERT_EQ(2, components->component_count);
+    ASSERT_EQ(30, components->components[0].voxel_count); // A, C and D, which contain the lowest voxel
+    vxf_free_components(components);
+    components = build_components(vf, 26, 0, 4);
+    ASSERT_EQ(1, components->component_count);
+    vxf_free_components(components);
+    components = build_components(vf, 26, 1, 4);
+    ASSERT_EQ(3, components->component_count);
+    ASSERT_EQ(24, components->components[0].voxel_count); // A and D
+    vxf_free_components(components);
+
+    ASSERT(!vxf_build_components(vf, &(VxfComponentsOptions){.connectivity = 18}, &error));
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_close(vf);
+    free(vb.data);
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    test_file(argv[1]);
+    test_pieces();
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include <voxflat.hpp>
+#include "common.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+using voxflat::ColorOutput;
+
+static_assert(!std::is_copy_constructible_v<voxflat::File> && std::is_nothrow_move_constructible_v<voxflat::File>);
+static_assert(std::input_iterator<voxflat::BatchRange<voxflat::Aos<ColorOutput::none>>::iterator>);
+
+// reference data read with the C API
+struct Reference {
+    std::vector<std::array<int32_t, 3>> xyz;
+    std::vector<std::array<uint8_t, 4>> rgba;
+    std::vector<uint8_t> coloridx;
+};
+
+static Reference read_reference(const char *filename) {
+    Reference ref;
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    size_t count = (size_t)vxf_count_voxels(vf);
+    ref.xyz.resize(count), ref.rgba.resize(count), ref.coloridx.resize(count);
+    VxfReadBuffers buffers{};
+    buffers.max_count = count;
+    buffers.xyz = reinterpret_cast<int32_t(*)[3]>(ref.xyz.data());
+    buffers.rgba = reinterpret_cast<uint8_t(*)[4]>(ref.rgba.data());
+    buffers.coloridx = ref.coloridx.data();
+    ASSERT_EQ(count, vxf_read(vf, &buffers, nullptr, &error));
+    vxf_close(vf);
+    return ref;
+}
+
+template <ColorOutput C>
+static void check_voxel(const Reference &ref, size_t i, const int32_t xyz[3], const uint8_t rgba[4], uint8_t coloridx) {
+    ASSERT(i < ref.xyz.size());
+    ASSERT(std::memcmp(ref.xyz[i].data(), xyz, sizeof ref.xyz[i]) == 0);
+    if constexpr (C == ColorOutput::rgba)
+        ASSERT(std::memcmp(ref.rgba[i].data(), rgba, 4) == 0);
+    if constexpr (C == ColorOutput::index)
+        ASSERT_EQ(ref.coloridx[i], coloridx);
+}
+
+// batches of 7 voxels, so that the last batch is partial
+template <ColorOutput C>
+static void test_aos(const char *filename, const Reference &ref) {
+    VxfError error;
+    voxflat::File file = voxflat::File::open(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    std::array<voxflat::Voxel<C>, 7> storage;
+    size_t count = 0;
+    auto batches = file.batches(voxflat::Aos<C>{storage});
+    for (voxflat::Aos<C> batch : batches) {
+        ASSERT(batch.voxels.size() > 0 && batch.voxels.size() <= storage.size());
+        for (const voxflat::Voxel<C> &voxel : batch.voxels) {
+            if constexpr (C == ColorOutput::rgba)
+                check_voxel<C>(ref, count++, voxel.xyz.data(), voxel.rgba.data(), 0);
+            else if constexpr (C == ColorOutput::index)
+                check_voxel<C>(ref, count++, voxel.xyz.data(), nullptr, voxel.coloridx);
+            else
+                check_voxel<C>(ref, count++, voxel.xyz.data(), nullptr, 0);
+        }
+    }
+    ASSERT_EQ(VXF_SUCCESS, batches.error());
+    ASSERT_EQ(ref.xyz.size(), count);
+}
+
+template <ColorOutput C>
+static void test_soa(const char *filename, const Reference &ref) {
+    voxflat::File file = voxflat::File::open(filename);
+    ASSERT(file);
+    int32_t xyz[5][3];
+    uint8_t rgba[5][4];
+    uint8_t coloridx[5];
+    size_t count = 0;
+    for (voxflat::Soa<C> batch : file.batches(voxflat::Soa<C>{xyz, rgba, coloridx})) {
+        for (size_t i = 0; i < batch.xyz.size(); i++, count++)
+            check_voxel<C>(ref, count, batch.xyz[i], C == ColorOutput::rgba ? batch.rgba[i] : nullptr,
+                C == ColorOutput::index ? batch.coloridx[i] : 0);
+    }
+    ASSERT_EQ(ref.xyz.size(), count);
+}
+
+static void test_handle(const char *filename, const Reference &ref) {
+    voxflat::File file = voxflat::File::open(filename);
+    ASSERT(file);
+    ASSERT_EQ(ref.xyz.size(), file.count_voxels());
+    voxflat::File moved = std::move(file);
+    ASSERT(!file && moved);
+    file = std::move(moved);
+    ASSERT(file && !moved);
+
+    // single reads larger than the internal chunk of AoS reads
+    std::vector<voxflat::Voxel<ColorOutput::index>> voxels(ref.xyz.size() + 300);
+    VxfError error;
+    ASSERT_EQ(ref.xyz.size(), file.read(voxflat::Aos<ColorOutput::index>{voxels}, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(0, file.read(voxflat::Aos<ColorOutput::index>{voxels}, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+
+    VxfFile *vf = file.release();
+    ASSERT(!file);
+    file.reset(vf);
+    ASSERT(file.get() == vf);
+
+    VxfError open_error;
+    ASSERT(!voxflat::File::open("does/not/exist.vox", &open_error));
+    ASSERT_EQ(VXF_ERROR_FILE_OPEN, open_error);
+}
+
+// feeds the requested ranges until the handle needs no more bytes
+static VxfError feed_requests(VxfFile *vf, const std::vector<char> &data) {
+    VxfError result = VXF_ERROR_WOULD_BLOCK;
+    uint64_t offset;
+    size_t size;
+    while (result == VXF_ERROR_WOULD_BLOCK && vxf_async_get_request(vf, &offset, &size)) {
+        size_t n = offset < data.size() ? std::min<size_t>(size, data.size() - offset) : 0;
+        result = vxf_async_feed(vf, data.data() + std::min<size_t>(offset, data.size()), n);
+    }
+    return result;
+}
+
+static void append_u32(std::vector<char> &data, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        data.push_back(static_cast<char>(value >> 8 * i & 0xff));
+}
+
+// an AoS read that fails after some voxels have been consumed still returns them
+static void test_partial_aos() {
+    // a solid model with more voxel data than an asynchronous request
+    constexpr uint32_t size = 64, count = size * size * 16;
+    std::vector<char> data{'V', 'O', 'X', ' '};
+    append_u32(data, 150);
+    data.insert(data.end(), {'M', 'A', 'I', 'N'});
+    append_u32(data, 0);
+    append_u32(data, 24 + 16 + 4 * count);
+    data.insert(data.end(), {'S', 'I', 'Z', 'E'});
+    append_u32(data, 12), append_u32(data, 0);
+    append_u32(data, size), append_u32(data, size), append_u32(data, 16);
+    data.insert(data.end(), {'X', 'Y', 'Z', 'I'});
+    append_u32(data, 4 + 4 * count), append_u32(data, 0);
+    append_u32(data, count);
+    for (uint32_t i = 0; i < count; i++)
+        append_u32(data, i % size | i / size % size << 8 | i / (size * size) << 16 | (1 + i % 255) << 24);
+
+    VxfError error;
+    voxflat::File expected = voxflat::File::open_memory(data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    std::vector<voxflat::Voxel<ColorOutput::index>> expected_voxels(count);
+    ASSERT_EQ(count, expected.read(voxflat::Aos<ColorOutput::index>{expected_voxels}, &error));
+
+    voxflat::File async(vxf_open_async(nullptr, &error));
+    ASSERT_EQ(VXF_SUCCESS, feed_requests(async.get(), data));
+    std::vector<voxflat::Voxel<ColorOutput::index>> voxels(count);
+    size_t total = async.read(voxflat::Aos<ColorOutput::index>{voxels}, &error);
+    ASSERT_EQ(VXF_ERROR_WOULD_BLOCK, error);
+    ASSERT(total > 0 && total < count);
+    while (total < count) {
+        ASSERT_EQ(VXF_SUCCESS, feed_requests(async.get(), data));
+        size_t n = async.read(voxflat::Aos<ColorOutput::index>{std::span(voxels).subspan(total)}, &error);
+        ASSERT(n > 0 && (error == VXF_SUCCESS || error == VXF_ERROR_WOULD_BLOCK));
+        total += n;
+    }
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (size_t i = 0; i < count; i++) {
+        ASSERT(voxels[i].xyz == expected_voxels[i].xyz);
+        ASSERT_EQ(expected_voxels[i].coloridx, voxels[i].coloridx);
+    }
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    const Reference ref = read_reference(argv[1]);
+    test_aos<ColorOutput::none>(argv[1], ref);
+    test_aos<ColorOutput::rgba>(argv[1], ref);
+    test_aos<ColorOutput::index>(argv[1], ref);
+    test_soa<ColorOutput::none>(argv[1], ref);
+    test_soa<ColorOutput::rgba>(argv[1], ref);
+    test_soa<ColorOutput::index>(argv[1], ref);
+    test_handle(argv[1], ref);
+    test_partial_aos();
+    return 0;
+}
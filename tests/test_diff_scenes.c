@@ -0,0 +1,207 @@
+#include "voxbuilder.h"
+
+#define MAX_INSTANCES 8
+#define NONE UINT32_MAX
+
+// version of a scene with models 0 and 1, and instances with a model and an x translation each; the transform nodes
+// of the instances have the given even ids, or are numbered in order if ids[0] is 0
+struct version {
+    uint8_t model1_color;
+    size_t count;
+    uint32_t models[MAX_INSTANCES];
+    int x[MAX_INSTANCES];
+    uint32_t ids[MAX_INSTANCES];
+};
+
+struct memory_io {
+    const char *data;
+    int64_t size, pos;
+    size_t bytes_read;
+};
+
+static int64_t io_read(void *ctx, void *buffer, size_t size) {
+    struct memory_io *m = ctx;
+    size_t n = m->pos >= m->size ? 0 : (size_t)(m->size - m->pos);
+    if (n > size) n = size;
+    memcpy(buffer, m->data + m->pos, n);
+    m->pos += n;
+    m->bytes_read += n;
+    return (int64_t)n;
+}
+
+static int io_seek(void *ctx, int64_t offset) {
+    struct memory_io *m = ctx;
+    if (offset < 0) return -1;
+    m->pos = offset;
+    return 0;
+}
+
+static int64_t io_tell(void *ctx) {
+    return ((struct memory_io*)ctx)->pos;
+}
+
+static VxfFile *open_version(const struct version *v, struct voxbuilder *vb, int fingerprint_models) {
+    vb_begin(vb);
+    vb_model(vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 1}});
+    vb_model(vb, 2, 1, 1, 2, (const uint8_t[][4]){{0, 0, 0, 2}, {1, 0, 0, v->model1_color}});
+    vb_transform(vb, 0, 1, -1, NULL, NULL);
+    uint32_t children[MAX_INSTANCES];
+    for (size_t i = 0; i < v->count; i++)
+        children[i] = v->ids[0] ? v->ids[i] : 2 + 2 * (uint32_t)i;
+    vb_group(vb, 1, v->count, children);
+    for (size_t i = 0; i < v->count; i++) {
+        char translation[32];
+        snprintf(translation, sizeof translation, "%d 0 0", v->x[i]);
+        vb_transform(vb, children[i], children[i] + 1, -1, translation, NULL);
+        vb_shape(vb, children[i] + 1, v->models[i]);
+    }
+    vb_end(vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory_ex(vb->size, vb->data,
+                                     &(VxfOpenOptions){.fingerprint_models = fingerprint_models}, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    return vf;
+}
+
+static void check_diff_fingerprints(const struct version *old_version, const struct version *new_version,
+                                    int fingerprint_models, size_t expected_count, const VxfInstanceChange expected[]) {
+    struct voxbuilder old_vb, new_vb;
+    VxfFile *old_vf = open_version(old_version, &old_vb, fingerprint_models);
+    VxfFile *new_vf = open_version(new_version, &new_vb, fingerprint_models);
+    VxfInstanceChange changes[MAX_INSTANCES * 2];
+    VxfError error;
+    ASSERT_EQ(expected_count, vxf_diff_scenes(old_vf, new_vf, MAX_INSTANCES * 2, changes, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (size_t i = 0; i < expected_count; i++) {
+        ASSERT_EQ(expected[i].type, changes[i].type);
+        ASSERT_EQ(expected[i].old_instance_id, changes[i].old_instance_id);
+        ASSERT_EQ(expected[i].new_instance_id, changes[i].new_instance_id);
+    }
+    // the total is returned also if the buffer is too small
+    ASSERT_EQ(expected_count, vxf_diff_scenes(old_vf, new_vf, 0, NULL, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    vxf_close(old_vf);
+    vxf_close(new_vf);
+    free(old_vb.data);
+    free(new_vb.data);
+}
+
+static void check_diff(const struct version *old_version, const struct version *new_version, size_t expected_count,
+                       const VxfInstanceChange expected[]) {
+    check_diff_fingerprints(old_version, new_version, 1, expected_count, expected);
+}
+
+// a scene with a single instance of a model of 200 voxels, of which one has the given color
+static void build_large_model(struct voxbuilder *vb, uint8_t color) {
+    enum { COUNT = 200 };
+    uint8_t voxels[COUNT][4];
+    for (int i = 0; i < COUNT; i++)
+        memcpy(voxels[i], (const uint8_t[4]){(uint8_t)i, 0, 0, i == 10 ? color : 1}, 4);
+    vb_begin(vb);
+    vb_model(vb, COUNT, 1, 1, COUNT, (const uint8_t(*)[4])voxels);
+    vb_transform(vb, 0, 1, -1, NULL, NULL);
+    vb_shape(vb, 1, 0);
+    vb_end(vb);
+}
+
+static VxfFile *open_io(const struct voxbuilder *vb, const VxfFile *previous, size_t *bytes_read) {
+    struct memory_io m = {.data = vb->data, .size = (int64_t)vb->size};
+    VxfError error;
+    VxfFile *vf = vxf_open_io(&(VxfIo){.read = io_read, .seek = io_seek, .tell = io_tell}, &m,
+                              &(VxfOpenOptions){.fingerprint_models = 1, .previous = previous}, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    *bytes_read = m.bytes_read;
+    return vf;
+}
+
+// models that are unchanged from the previous version are not hashed again
+static void test_previous(void) {
+    struct voxbuilder vb1, vb2;
+    build_large_model(&vb1, 1);
+    build_large_model(&vb2, 2);
+    size_t full, reused, changed;
+    VxfFile *vf = open_io(&vb1, NULL, &full);
+    VxfFile *same_vf = open_io(&vb1, vf, &reused);
+    VxfFile *changed_vf = open_io(&vb2, vf, &changed);
+    ASSERT(reused < full);
+    ASSERT_EQ(full, changed);
+    VxfInstanceChange change;
+    VxfError error;
+    ASSERT_EQ(0, vxf_diff_scenes(vf, same_vf, 1, &change, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(1, vxf_diff_scenes(same_vf, changed_vf, 1, &change, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(VXF_INSTANCE_MODIFIED, change.type);
+    vxf_close(vf);
+    vxf_close(same_vf);
+    vxf_close(changed_vf);
+    free(vb1.data);
+    free(vb2.data);
+}
+
+static const struct version base = {
+    .model1_color = 3, .count = 4, .models = {0, 1, 0, 1}, .x = {0, 10, 20, 30},
+};
+
+int main(void) {
+    check_diff(&base, &base, 0, NULL);
+
+    // the voxels of model 1 change, which affects instances 1 and 3
+    struct version v = base;
+    v.model1_color = 4;
+    check_diff(&base, &v, 2, (const VxfInstanceChange[]){
+        {VXF_INSTANCE_MODIFIED, 1, 1}, {VXF_INSTANCE_MODIFIED, 3, 3},
+    });
+
+    // instance 2 moves
+    v = base;
+    v.x[2] = 25;
+    check_diff(&base, &v, 1, (const VxfInstanceChange[]){{VXF_INSTANCE_MODIFIED, 2, 2}});
+
+    // an instance is inserted after the first one
+    v = (struct version){.model1_color = 3, .count = 5, .models = {0, 1, 1, 0, 1}, .x = {0, 5, 10, 20, 30}};
+    check_diff(&base, &v, 4, (const VxfInstanceChange[]){
+        {VXF_INSTANCE_ADDED, NONE, 1},
+        {VXF_INSTANCE_RENUMBERED, 1, 2}, {VXF_INSTANCE_RENUMBERED, 2, 3}, {VXF_INSTANCE_RENUMBERED, 3, 4},
+    });
+    check_diff(&v, &base, 4, (const VxfInstanceChange[]){
+        {VXF_INSTANCE_REMOVED, 1, NONE},
+        {VXF_INSTANCE_RENUMBERED, 2, 1}, {VXF_INSTANCE_RENUMBERED, 3, 2}, {VXF_INSTANCE_RENUMBERED, 4, 3},
+    });
+
+    // instances 1 and 2 swap places, keeping their node ids
+    struct version ids = base;
+    memcpy(ids.ids, (const uint32_t[]){2, 4, 6, 8}, sizeof(uint32_t[4]));
+    v = (struct version){
+        .model1_color = 3, .count = 4, .models = {0, 0, 1, 1}, .x = {0, 20, 10, 30}, .ids = {2, 6, 4, 8},
+    };
+    check_diff(&ids, &v, 2, (const VxfInstanceChange[]){
+        {VXF_INSTANCE_RENUMBERED, 2, 1}, {VXF_INSTANCE_RENUMBERED, 1, 2},
+    });
+    check_diff(&v, &ids, 2, (const VxfInstanceChange[]){
+        {VXF_INSTANCE_RENUMBERED, 2, 1}, {VXF_INSTANCE_RENUMBERED, 1, 2},
+    });
+
+    // the last instance is removed and the first one changes its model
+    v = (struct version){.model1_color = 3, .count = 3, .models = {1, 1, 0}, .x = {0, 10, 20}};
+    check_diff(&base, &v, 2, (const VxfInstanceChange[]){
+        {VXF_INSTANCE_MODIFIED, 0, 0}, {VXF_INSTANCE_REMOVED, 3, NONE},
+    });
+
+    // without fingerprints, models are compared by offset, size and voxel count, which misses edits of the voxels
+    v = base;
+    v.model1_color = 4;
+    check_diff_fingerprints(&base, &v, 0, 0, NULL);
+    struct voxbuilder vb1, vb2;
+    VxfFile *vf1 = open_version(&base, &vb1, 1), *vf2 = open_version(&base, &vb2, 0);
+    VxfError error;
+    ASSERT_EQ(0, vxf_diff_scenes(vf1, vf2, 0, NULL, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    vxf_close(vf1);
+    vxf_close(vf2);
+    free(vb1.data);
+    free(vb2.data);
+
+    test_previous();
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 16
+
+// instances from x = 0, 10, 20 and 30 on layers 0, 1, 2 (hidden) and none; each with voxels of colors 1 and 2
+static void build_scene(struct voxbuilder *vb) {
+    vb_begin(vb);
+    vb_model(vb, 2, 1, 1, 2, (const uint8_t[][4]){{0, 0, 0, 1}, {1, 0, 0, 2}});
+    vb_transform(vb, 0, 1, -1, NULL, NULL);
+    vb_group(vb, 1, 4, (const uint32_t[]){2, 4, 6, 8});
+    vb_transform(vb, 2, 3, 0, "1 0 0", NULL); // model from 0 to 1
+    vb_shape(vb, 3, 0);
+    vb_transform(vb, 4, 5, 1, "11 0 0", NULL);
+    vb_shape(vb, 5, 0);
+    vb_transform(vb, 6, 7, 2, "21 0 0", NULL);
+    vb_shape(vb, 7, 0);
+    vb_transform(vb, 8, 9, -1, "31 0 0", NULL);
+    vb_shape(vb, 9, 0);
+    vb_layer(vb, 2, "1");
+    vb_layer(vb, 0, NULL);
+    vb_layer(vb, 1, "0");
+    vb_end(vb);
+}
+
+// reads all voxels and compares their x coordinates
+static void check_voxels(VxfFile *vf, const VxfFilter *filter, size_t count, const int32_t expected_x[]) {
+    int32_t xyz[MAX_VOXELS][3];
+    uint8_t coloridx[MAX_VOXELS];
+    VxfError error;
+    vxf_set_filter(vf, filter);
+    ASSERT_EQ(count, vxf_read_xyz_coloridx(vf, MAX_VOXELS, xyz, coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(expected_x[i], xyz[i][0]);
+        ASSERT_EQ(1 + (expected_x[i] & 1), coloridx[i]);
+    }
+}
+
+int main(void) {
+    struct voxbuilder vb;
+    build_scene(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+
+    check_voxels(vf, NULL, 6, (const int32_t[]){0, 1, 10, 11, 30, 31});
+    check_voxels(vf, &(VxfFilter){.include_layers = (const uint32_t[]){1, 7}, .include_layer_count = 2},
+        4, (const int32_t[]){10, 11, 30, 31});
+    check_voxels(vf, &(VxfFilter){.exclude_layers = (const uint32_t[]){0, 1}, .exclude_layer_count = 2},
+        2, (const int32_t[]){30, 31});
+    check_voxels(vf, &(VxfFilter){.show_hidden = 1}, 8, (const int32_t[]){0, 1, 10, 11, 20, 21, 30, 31});
+    check_voxels(vf, &(VxfFilter){.include_layers = (const uint32_t[]){2}, .include_layer_count = 1, .show_hidden = 1},
+        4, (const int32_t[]){20, 21, 30, 31});
+    const uint64_t color_2[4] = {UINT64_C(1) << 2};
+    check_voxels(vf, &(VxfFilter){.color_mask = color_2}, 3, (const int32_t[]){1, 11, 31});
+
+    // setting a filter restarts reading
+    int32_t xyz[1][3];
+    uint8_t coloridx[1];
+    vxf_set_filter(vf, NULL);
+    ASSERT_EQ(1, vxf_read_xyz_coloridx(vf, 1, xyz, coloridx, &error));
+    check_voxels(vf, &(VxfFilter){.color_mask = color_2}, 3, (const int32_t[]){1, 11, 31});
+
+    // layer filters apply to counts and bounds, the color mask only to voxels
+    ASSERT_EQ(6, vxf_count_voxels(vf));
+    vxf_set_filter(vf, &(VxfFilter){.exclude_layers = (const uint32_t[]){0}, .exclude_layer_count = 1});
+    ASSERT_EQ(4, vxf_count_voxels(vf));
+    int32_t xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    ASSERT_EQ(10, xyz_min[0]);
+    ASSERT_EQ(31, xyz_max[0]);
+
+    // meshes only contain the faces of voxels passing the color mask
+    vxf_set_filter(vf, &(VxfFilter){.color_mask = (const uint64_t[4]){UINT64_C(1) << 1}});
+    VxfMesh *mesh = vxf_build_mesh(vf, NULL, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(3 * 6, mesh->quad_count);
+    for (size_t i = 0; i < mesh->quad_count; i++)
+        ASSERT_EQ(1, mesh->quads[i].coloridx);
+    vxf_free_mesh(mesh);
+
+    // so do level of detail hierarchies, which hold fewer voxels than counted
+    vxf_set_filter(vf, &(VxfFilter){.color_mask = color_2});
+    ASSERT_EQ(6, vxf_count_voxels(vf));
+    VxfLod *lod = vxf_build_lod(vf, NULL, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(3, vxf_lod_count_voxels(lod, 0));
+    int32_t lod_xyz[MAX_VOXELS][3];
+    uint8_t lod_coloridx[MAX_VOXELS];
+    ASSERT_EQ(3, vxf_lod_read_xyz_coloridx(lod, 0, MAX_VOXELS, lod_xyz, lod_coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (size_t i = 0; i < 3; i++)
+        ASSERT_EQ(2, lod_coloridx[i]);
+    vxf_free_lod(lod);
+
+    check_voxels(vf, NULL, 6, (const int32_t[]){0, 1, 10, 11, 30, 31});
+    vxf_close(vf);
+    free(vb.data);
+    return 0;
+}
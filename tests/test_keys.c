@@ -0,0 +1,142 @@
+#include "voxbuilder.h"
+#include <stdlib.h>
+
+#define MAX_VOXELS 1000
+#define SORT_COUNT 300000
+
+static uint64_t naive_morton(const int32_t pos[3]) {
+    uint64_t key = 0;
+    for (int bit = 0; bit < 21; bit++) {
+        for (int axis = 0; axis < 3; axis++)
+            key |= (uint64_t)((pos[axis] >> bit) & 1) << (bit * 3 + axis);
+    }
+    return key;
+}
+
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13, *state ^= *state >> 7, *state ^= *state << 17;
+    return *state;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void test_file(const char *filename) {
+    static int32_t xyz[MAX_VOXELS][3];
+    static uint64_t packed[MAX_VOXELS], morton[MAX_VOXELS];
+    static uint32_t rgba[MAX_VOXELS];
+    int32_t origin[3], xyz_max[3];
+    VxfError error;
+    size_t count = 0;
+    for (int format = VXF_KEY_FORMAT_PACKED; format <= VXF_KEY_FORMAT_MORTON; format++) {
+        VxfFile *vf = vxf_open_file(filename, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        vxf_calculate_bounds(vf, origin, xyz_max);
+        count = vxf_read(vf, &(VxfReadBuffers){
+            .max_count = MAX_VOXELS,
+            .xyz = xyz,
+            .keys = format == VXF_KEY_FORMAT_MORTON ? morton : packed,
+            .key_format = format,
+            .color = format == VXF_KEY_FORMAT_MORTON ? rgba : NULL,
+        }, NULL, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        ASSERT(count > 0 && count < MAX_VOXELS);
+        vxf_close(vf);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t decoded[3], relative[3];
+        vxf_decode_key(packed[i], VXF_KEY_FORMAT_PACKED, origin, decoded);
+        for (int j = 0; j < 3; j++) {
+            ASSERT_EQ(xyz[i][j], decoded[j]);
+            relative[j] = xyz[i][j] - origin[j];
+        }
+        vxf_decode_key(morton[i], VXF_KEY_FORMAT_MORTON, origin, decoded);
+        for (int j = 0; j < 3; j++)
+            ASSERT_EQ(xyz[i][j], decoded[j]);
+        ASSERT_EQ(naive_morton(relative), morton[i]);
+    }
+
+    // colors stay with their keys
+    static uint64_t sorted[MAX_VOXELS];
+    static uint32_t sorted_rgba[MAX_VOXELS];
+    for (size_t i = 0; i < count; i++)
+        sorted[i] = morton[i], sorted_rgba[i] = (uint32_t)i;
+    vxf_sort_keys(sorted, sorted_rgba, count, 1, NULL, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (size_t i = 0; i < count; i++) {
+        ASSERT(i == 0 || sorted[i - 1] < sorted[i] || (sorted[i - 1] == sorted[i] && sorted_rgba[i - 1] < sorted_rgba[i]));
+        ASSERT_EQ(morton[sorted_rgba[i]], sorted[i]);
+    }
+}
+
+static void test_sort(unsigned thread_count) {
+    uint64_t *keys = malloc(SORT_COUNT * sizeof *keys), *expected = malloc(SORT_COUNT * sizeof *keys);
+    uint32_t *values = malloc(SORT_COUNT * sizeof *values);
+    ASSERT(keys && expected && values);
+    uint64_t state = 88172645463325252u;
+    for (size_t i = 0; i < SORT_COUNT; i++) {
+        keys[i] = expected[i] = next_random(&state) >> 1;
+        values[i] = (uint32_t)keys[i];
+    }
+    qsort(expected, SORT_COUNT, sizeof *expected, compare_u64);
+
+    VxfError error;
+    vxf_sort_keys(keys, values, SORT_COUNT, thread_count, NULL, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (size_t i = 0; i < SORT_COUNT; i++) {
+        ASSERT_EQ(expected[i], keys[i]);
+        ASSERT_EQ((uint32_t)keys[i], values[i]);
+    }
+    free(keys), free(expected), free(values);
+}
+
+// a voxel outside of the size of its model that a mirroring transform places below the bounds has no key
+static void test_out_of_bounds(void) {
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 1, 1, 1, 2, (const uint8_t[][4]){{0, 0, 0, 1}, {3, 0, 0, 2}});
+    vb_transform(&vb, 0, 1, -1, NULL, "20"); // x mirrored
+    vb_shape(&vb, 1, 0);
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    int32_t xyz[2][3], xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    ASSERT_EQ(2, vxf_read(vf, &(VxfReadBuffers){.max_count = 2, .xyz = xyz}, NULL, &error));
+    ASSERT(xyz[1][0] < xyz_min[0]);
+    vxf_close(vf);
+
+    vf = vxf_open_memory(vb.size, vb.data, &error);
+    uint64_t keys[2];
+    ASSERT_EQ(0, vxf_read(vf, &(VxfReadBuffers){.max_count = 2, .keys = keys}, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_KEY_RANGE, error);
+    ASSERT_EQ(0, vxf_read(vf, &(VxfReadBuffers){.max_count = 2, .keys = keys}, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_KEY_RANGE, error);
+
+    // the structures built from keys fail the same way
+    ASSERT(!vxf_build_lod(vf, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_KEY_RANGE, error);
+    ASSERT(!vxf_build_lookup(vf, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_KEY_RANGE, error);
+    ASSERT(!vxf_build_components(vf, NULL, &error));
+    ASSERT_EQ(VXF_ERROR_KEY_RANGE, error);
+    vxf_close(vf);
+    free(vb.data);
+}
+
+int main(int argc, char* argv[]) {
+    ASSERT_EQ(2, argc);
+    test_file(argv[1]);
+    test_sort(1);
+    test_sort(4);
+    test_out_of_bounds();
+
+    VxfError error;
+    vxf_sort_keys(NULL, NULL, 1, 1, NULL, &error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "voxbuilder.h"
+#include <stdio.h>
+
+#define SHAPE_COUNT 250000 // instances of a single voxel, each with a transform node
+#define CHAIN_LENGTH 250000 // pairs of transform and group nodes above one more instance
+
+// Scene with SHAPE_COUNT + 1 instances and about 1M nodes, half of them in a single chain. Chunks are written in
+// reverse order of their IDs; id_scale > 1 creates sparse IDs.
+static void build_scene(struct voxbuilder *vb, uint32_t id_scale) {
+    vb_begin(vb);
+    vb_model(vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 1}});
+    uint32_t chain_start = 2 + 2 * SHAPE_COUNT, chain_end = chain_start + 2 * CHAIN_LENGTH;
+    vb_shape(vb, chain_end * id_scale, 0);
+    for (uint32_t id = chain_end; id > chain_start; id -= 2) {
+        vb_group(vb, (id - 1) * id_scale, 1, (const uint32_t[]){id * id_scale});
+        vb_transform(vb, (id - 2) * id_scale, (id - 1) * id_scale, -1, "0 0 1", NULL);
+    }
+    for (uint32_t i = SHAPE_COUNT; i-- > 0;) {
+        char translation[32];
+        snprintf(translation, sizeof translation, "%u 0 0", (unsigned)i);
+        vb_shape(vb, (3 + 2 * i) * id_scale, 0);
+        vb_transform(vb, (2 + 2 * i) * id_scale, (3 + 2 * i) * id_scale, -1, translation, NULL);
+    }
+    uint32_t *children = malloc((SHAPE_COUNT + 1) * sizeof *children);
+    for (uint32_t i = 0; i <= SHAPE_COUNT; i++)
+        children[i] = (2 + 2 * i) * id_scale;
+    vb_group(vb, id_scale, SHAPE_COUNT + 1, children);
+    free(children);
+    vb_transform(vb, 0, id_scale, -1, NULL, NULL);
+    vb_end(vb);
+}
+
+static void test_scene(uint32_t id_scale) {
+    struct voxbuilder vb;
+    build_scene(&vb, id_scale);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+
+    // the queries walk the deep chain with a stack of their own, so they only need a const handle
+    const VxfFile *scene = vf;
+    ASSERT_EQ(SHAPE_COUNT + 1, vxf_count_voxels(scene));
+    int32_t xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(scene, xyz_min, xyz_max);
+    ASSERT_EQ(0, xyz_min[0]);
+    ASSERT_EQ(SHAPE_COUNT - 1, xyz_max[0]);
+    ASSERT_EQ(0, xyz_min[2]);
+    ASSERT_EQ(CHAIN_LENGTH, xyz_max[2]);
+
+    static int32_t xyz[SHAPE_COUNT + 1][3];
+    static uint8_t coloridx[SHAPE_COUNT + 1];
+    ASSERT_EQ(SHAPE_COUNT + 1, vxf_read_xyz_coloridx(vf, SHAPE_COUNT + 1, xyz, coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (int32_t i = 0; i < SHAPE_COUNT; i++) {
+        ASSERT_EQ(i, xyz[i][0]);
+        ASSERT_EQ(0, xyz[i][2]);
+    }
+    ASSERT_EQ(CHAIN_LENGTH, xyz[SHAPE_COUNT][2]);
+    vxf_close(vf);
+    free(vb.data);
+}
+
+int main(void) {
+    test_scene(1);
+    test_scene(3);
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 1000
+
+static VxfLod *build_lod(VxfFile *vf, VxfLodMode mode, unsigned thread_count) {
+    VxfError error;
+    VxfLod *lod = vxf_build_lod(vf, &(VxfLodOptions){.mode = mode, .thread_count = thread_count}, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(lod);
+    return lod;
+}
+
+static size_t read_level(VxfLod *lod, unsigned level, int32_t xyz[][3], uint8_t coloridx[]) {
+    VxfError error;
+    size_t count = 0, n;
+    while ((n = vxf_lod_read_xyz_coloridx(lod, level, 7, xyz + count, coloridx + count, &error)) > 0) {
+        count += n;
+        ASSERT(count <= MAX_VOXELS);
+    }
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(vxf_lod_count_voxels(lod, level), count);
+    return count;
+}
+
+static int32_t floor_shift(int32_t value, unsigned shift) {
+    int32_t size = INT32_C(1) << shift;
+    return value >= 0 ? value / size : -((-value + size - 1) / size);
+}
+
+static bool covers(const int32_t parent[3], unsigned level, const int32_t pos[3]) {
+    for (int i = 0; i < 3; i++) {
+        if (floor_shift(pos[i], level) != parent[i])
+            return false;
+    }
+    return true;
+}
+
+// each level must contain exactly the cells covering a voxel, colored like one of the voxels they cover
+static void test_file(const char *filename) {
+    static int32_t xyz[MAX_VOXELS][3], lod_xyz[MAX_VOXELS][3], last_xyz[MAX_VOXELS][3], prev_xyz[MAX_VOXELS][3];
+    static uint8_t coloridx[MAX_VOXELS], lod_coloridx[MAX_VOXELS], last_coloridx[MAX_VOXELS];
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+
+    // building the pyramid between reads does not change the read position
+    size_t count = vxf_read_xyz_coloridx(vf, 3, xyz, coloridx, &error);
+    ASSERT_EQ(3, count);
+    VxfLod *lod = build_lod(vf, VXF_LOD_MODE_MAJORITY, 1);
+    VxfLod *last_lod = build_lod(vf, VXF_LOD_MODE_LAST, 4);
+    count += vxf_read_xyz_coloridx(vf, MAX_VOXELS - count, xyz + count, coloridx + count, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(count > 0 && count < MAX_VOXELS);
+    ASSERT_EQ(vxf_count_voxels(vf), count);
+    vxf_close(vf);
+
+    // level 0: voxels at the same position are replaced by later ones
+    unsigned level_count = vxf_lod_level_count(lod);
+    ASSERT(level_count >= 1);
+    ASSERT_EQ(level_count, vxf_lod_level_count(last_lod));
+    size_t lod_count = read_level(lod, 0, lod_xyz, lod_coloridx);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool replaced = false;
+        for (size_t j = i + 1; j < count && !replaced; j++)
+            replaced = covers(xyz[j], 0, xyz[i]);
+        if (replaced)
+            continue;
+        unique++;
+        size_t j = 0;
+        while (j < lod_count && !covers(lod_xyz[j], 0, xyz[i]))
+            j++;
+        ASSERT(j < lod_count);
+        ASSERT_EQ(coloridx[i], lod_coloridx[j]);
+    }
+    ASSERT_EQ(unique, lod_count);
+    ASSERT_EQ(0, vxf_lod_read_xyz_coloridx(lod, 0, MAX_VOXELS, lod_xyz, lod_coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+
+    for (unsigned level = 1; level < level_count; level++) {
+        size_t prev_count = lod_count;
+        memcpy(prev_xyz, lod_xyz, prev_count * sizeof *prev_xyz);
+        lod_count = read_level(lod, level, lod_xyz, lod_coloridx);
+        ASSERT_EQ(lod_count, read_level(last_lod, level, last_xyz, last_coloridx));
+        ASSERT_EQ(0, memcmp(lod_xyz, last_xyz, lod_count * sizeof *lod_xyz));
+        ASSERT(lod_count < prev_count);
+        for (size_t j = 0; j < lod_count; j++) {
+            size_t covered = 0;
+            bool color_found = false;
+            for (size_t i = 0; i < count; i++) {
+                if (covers(lod_xyz[j], level, xyz[i])) {
+                    covered++;
+                    color_found = color_found || coloridx[i] == lod_coloridx[j];
+                }
+            }
+            ASSERT(covered > 0 && color_found);
+        }
+        size_t children = 0;
+        for (size_t i = 0; i < prev_count; i++) {
+            for (size_t j = 0; j < lod_count; j++)
+                children += covers(lod_xyz[j], 1, prev_xyz[i]);
+        }
+        ASSERT_EQ(prev_count, children);
+    }
+    // a single voxel, or up to 2 along each axis if the scene extends to both sides of a plane through 0
+    uintmax_t top_count = vxf_lod_count_voxels(lod, level_count - 1);
+    ASSERT(top_count >= 1 && top_count <= 8);
+    ASSERT_EQ(0, vxf_lod_count_voxels(lod, level_count));
+    ASSERT_EQ(0, vxf_lod_read_xyz_coloridx(lod, level_count, 1, lod_xyz, lod_coloridx, &error));
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_free_lod(lod);
+    vxf_free_lod(last_lod);
+}
+
+static uint8_t top_color(size_t count, const uint8_t xyzi[][4], VxfLodMode mode) {
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 2, 2, 2, count, xyzi);
+    vb_transform(&vb, 0, 1, -1, "1 1 1", NULL); // model from 0 to 1
+    vb_shape(&vb, 1, 0);
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    VxfLod *lod = build_lod(vf, mode, 1);
+    vxf_close(vf);
+    free(vb.data);
+
+    ASSERT_EQ(2, vxf_lod_level_count(lod));
+    int32_t xyz[1][3];
+    uint8_t coloridx[1];
+    ASSERT_EQ(1, vxf_lod_read_xyz_coloridx(lod, 1, 1, xyz, coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(0, xyz[0][0]);
+    ASSERT_EQ(0, xyz[0][1]);
+    ASSERT_EQ(0, xyz[0][2]);
+    vxf_free_lod(lod);
+    return coloridx[0];
+}
+
+static void test_colors(void) {
+    static const uint8_t majority[][4] = {
+        {0, 0, 0, 1}, {1, 0, 0, 2}, {0, 1, 0, 1}, {1, 1, 0, 3}, {0, 0, 1, 1}, {1, 0, 1, 2},
+    };
+    ASSERT_EQ(1, top_color(6, majority, VXF_LOD_MODE_MAJORITY));
+    ASSERT_EQ(2, top_color(6, majority, VXF_LOD_MODE_LAST));
+
+    // ties go to the color read last
+    static const uint8_t tie[][4] = {{0, 0, 0, 1}, {1, 0, 0, 2}, {0, 1, 0, 2}, {1, 1, 0, 1}};
+    ASSERT_EQ(1, top_color(4, tie, VXF_LOD_MODE_MAJORITY));
+    ASSERT_EQ(2, top_color(3, tie, VXF_LOD_MODE_MAJORITY));
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    test_file(argv[1]);
+    test_colors();
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 1000
+
+static VxfLookup *build_lookup(VxfFile *vf, unsigned thread_count) {
+    VxfError error;
+    VxfLookup *lookup = vxf_build_lookup(vf, &(VxfLookupOptions){.thread_count = thread_count}, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(lookup);
+    ASSERT(vxf_lookup_memory_usage(lookup) > 0);
+    return lookup;
+}
+
+// expected color index at pos: the last voxel read there, or 0
+static uint8_t expected_color(size_t count, int32_t xyz[][3], const uint8_t coloridx[], const int32_t pos[3]) {
+    for (size_t i = count; i-- > 0;) {
+        if (xyz[i][0] == pos[0] && xyz[i][1] == pos[1] && xyz[i][2] == pos[2])
+            return coloridx[i];
+    }
+    return 0;
+}
+
+// queries every position within the bounds and a margin around them
+static void test_file(const char *filename) {
+    static int32_t xyz[MAX_VOXELS][3], queries[MAX_VOXELS][3];
+    static uint8_t coloridx[MAX_VOXELS], batch_coloridx[MAX_VOXELS];
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    size_t count = vxf_read_xyz_coloridx(vf, 5, xyz, coloridx, &error);
+    VxfLookup *lookup = build_lookup(vf, 1);
+    VxfLookup *parallel_lookup = build_lookup(vf, 4);
+    count += vxf_read_xyz_coloridx(vf, MAX_VOXELS - count, xyz + count, coloridx + count, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(count > 0 && count < MAX_VOXELS);
+    ASSERT_EQ(vxf_count_voxels(vf), count);
+    int32_t xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    vxf_close(vf);
+
+    size_t batch_count = 0;
+    int32_t pos[3];
+    for (pos[2] = xyz_min[2] - 9; pos[2] <= xyz_max[2] + 9; pos[2]++) {
+        for (pos[1] = xyz_min[1] - 9; pos[1] <= xyz_max[1] + 9; pos[1]++) {
+            for (pos[0] = xyz_min[0] - 9; pos[0] <= xyz_max[0] + 9; pos[0]++) {
+                uint8_t expected = expected_color(count, xyz, coloridx, pos);
+                ASSERT_EQ(expected, vxf_lookup_coloridx(lookup, pos));
+                ASSERT_EQ(expected, vxf_lookup_coloridx(parallel_lookup, pos));
+                memcpy(queries[batch_count++], pos, sizeof pos);
+                if (batch_count < MAX_VOXELS && pos[0] < xyz_max[0] + 9)
+                    continue;
+                vxf_lookup_coloridx_batch(lookup, batch_count, (const int32_t(*)[3])queries, batch_coloridx);
+                for (size_t i = 0; i < batch_count; i++)
+                    ASSERT_EQ(vxf_lookup_coloridx(lookup, queries[i]), batch_coloridx[i]);
+                batch_count = 0;
+            }
+        }
+    }
+    ASSERT_EQ(0, vxf_lookup_coloridx(lookup, (const int32_t[3]){INT32_MIN, 0, INT32_MAX}));
+    vxf_free_lookup(lookup);
+    vxf_free_lookup(parallel_lookup);
+}
+
+// instances far apart, one overlapping another with a different color
+static void test_sparse(void) {
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 1}});
+    vb_model(&vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 2}});
+    vb_transform(&vb, 0, 1, -1, NULL, NULL);
+    vb_group(&vb, 1, 3, (const uint32_t[]){2, 4, 6});
+    vb_transform(&vb, 2, 3, -1, "-100000 5 -7", NULL);
+    vb_shape(&vb, 3, 0);
+    vb_transform(&vb, 4, 5, -1, "100000 -3 1000", NULL);
+    vb_shape(&vb, 5, 0);
+    vb_transform(&vb, 6, 7, -1, "-100000 5 -7", NULL);
+    vb_shape(&vb, 7, 1);
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    VxfLookup *lookup = build_lookup(vf, 1);
+    vxf_close(vf);
+    free(vb.data);
+
+    static const int32_t queries[][3] = {{-100000, 5, -7}, {100000, -3, 1000}, {100000, -3, 999}, {0, 0, 0}};
+    uint8_t coloridx[4];
+    vxf_lookup_coloridx_batch(lookup, 4, queries, coloridx);
+    ASSERT_EQ(2, coloridx[0]);
+    ASSERT_EQ(1, coloridx[1]);
+    ASSERT_EQ(0, coloridx[2]);
+    ASSERT_EQ(0, coloridx[3]);
+    ASSERT(vxf_lookup_memory_usage(lookup) < 4096); // two bricks, not the bounding box
+    vxf_free_lookup(lookup);
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    test_file(argv[1]);
+    test_sparse();
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 1000
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+static VxfMesh *build_mesh(VxfFile *vf, int ambient_occlusion, unsigned thread_count) {
+    VxfError error;
+    VxfMesh *mesh = vxf_build_mesh(vf, &(VxfMeshOptions){
+        .ambient_occlusion = ambient_occlusion, .thread_count = thread_count
+    }, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(mesh);
+    return mesh;
+}
+
+static VxfMesh *build_model_mesh(size_t count, const uint8_t xyzi[][4], int ambient_occlusion) {
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 4, 4, 4, count, xyzi);
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    VxfMesh *mesh = build_mesh(vf, ambient_occlusion, 1);
+    vxf_close(vf);
+    free(vb.data);
+    return mesh;
+}
+
+static int32_t quad_area(const VxfQuad *quad) {
+    int32_t area = 1;
+    for (int j = 0; j < 3; j++) {
+        int32_t extent = abs(quad->xyz[2][j] - quad->xyz[0][j]);
+        if (quad->normal[j] == 0)
+            area *= extent;
+        else
+            ASSERT_EQ(0, extent);
+    }
+    return area;
+}
+
+// checks that the corners are counter-clockwise when looking against the normal
+static void check_winding(const VxfQuad *quad) {
+    int32_t a[3], b[3];
+    for (int j = 0; j < 3; j++) {
+        a[j] = quad->xyz[1][j] - quad->xyz[0][j];
+        b[j] = quad->xyz[3][j] - quad->xyz[0][j];
+    }
+    int32_t cross[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+    for (int j = 0; j < 3; j++)
+        ASSERT(cross[j] * quad->normal[j] > 0 || (cross[j] == 0 && quad->normal[j] == 0));
+}
+
+static bool contains_voxel(int32_t xyz[][3], uint8_t coloridx[], size_t count, const int32_t pos[3], uint8_t color) {
+    for (size_t i = 0; i < count; i++) {
+        if (xyz[i][0] == pos[0] && xyz[i][1] == pos[1] && xyz[i][2] == pos[2] && coloridx[i] == color)
+            return true;
+    }
+    return false;
+}
+
+// every unit face of every quad must belong to a voxel of the same color
+static void test_file(const char *filename) {
+    static int32_t xyz[MAX_VOXELS][3];
+    static uint8_t coloridx[MAX_VOXELS];
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    VxfMesh *mesh = build_mesh(vf, 1, 1);
+    VxfMesh *parallel_mesh = build_mesh(vf, 1, 4);
+    size_t count = vxf_read_xyz_coloridx(vf, MAX_VOXELS, xyz, coloridx, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(count > 0 && count < MAX_VOXELS);
+    uint8_t palette[256][4];
+    vxf_get_palette(vf, palette);
+    vxf_close(vf);
+
+    ASSERT(mesh->quad_count > 0);
+    ASSERT_EQ(mesh->quad_count, parallel_mesh->quad_count);
+    ASSERT(memcmp(mesh->quads, parallel_mesh->quads, mesh->quad_count * sizeof *mesh->quads) == 0);
+    vxf_free_mesh(parallel_mesh);
+
+    for (size_t i = 0; i < mesh->quad_count; i++) {
+        const VxfQuad *quad = &mesh->quads[i];
+        check_winding(quad);
+        ASSERT(memcmp(quad->rgba, palette[quad->coloridx], 4) == 0);
+        int32_t min[3], max[3];
+        for (int j = 0; j < 3; j++) {
+            min[j] = MIN(quad->xyz[0][j], quad->xyz[2][j]);
+            max[j] = MAX(quad->xyz[0][j], quad->xyz[2][j]);
+            if (quad->normal[j] != 0)
+                max[j] = min[j] + 1; // a single voxel layer behind the face
+            if (quad->normal[j] > 0)
+                min[j]--, max[j]--;
+        }
+        for (int32_t x = min[0]; x < max[0]; x++)
+            for (int32_t y = min[1]; y < max[1]; y++)
+                for (int32_t z = min[2]; z < max[2]; z++)
+                    ASSERT(contains_voxel(xyz, coloridx, count, (int32_t[3]){x, y, z}, quad->coloridx));
+    }
+    vxf_free_mesh(mesh);
+}
+
+int main(int argc, char* argv[]) {
+    ASSERT_EQ(2, argc);
+
+    // single voxel: 6 unit faces
+    VxfMesh *mesh = build_model_mesh(1, (const uint8_t[][4]){{1, 1, 1, 5}}, 0);
+    ASSERT_EQ(6, mesh->quad_count);
+    int normal_sum[3] = {0};
+    for (size_t i = 0; i < mesh->quad_count; i++) {
+        ASSERT_EQ(1, quad_area(&mesh->quads[i]));
+        ASSERT_EQ(5, mesh->quads[i].coloridx);
+        for (int j = 0; j < 4; j++)
+            ASSERT_EQ(3, mesh->quads[i].ao[j]);
+        for (int j = 0; j < 3; j++)
+            normal_sum[j] += mesh->quads[i].normal[j];
+        check_winding(&mesh->quads[i]);
+    }
+    ASSERT(normal_sum[0] == 0 && normal_sum[1] == 0 && normal_sum[2] == 0);
+    vxf_free_mesh(mesh);
+
+    // 2x2x2 cube of one color: faces are merged
+    uint8_t cube[8][4];
+    for (int i = 0; i < 8; i++)
+        cube[i][0] = i & 1, cube[i][1] = i >> 1 & 1, cube[i][2] = i >> 2 & 1, cube[i][3] = 7;
+    mesh = build_model_mesh(8, (const uint8_t(*)[4])cube, 1);
+    ASSERT_EQ(6, mesh->quad_count);
+    for (size_t i = 0; i < mesh->quad_count; i++)
+        ASSERT_EQ(4, quad_area(&mesh->quads[i]));
+    vxf_free_mesh(mesh);
+
+    // a different color prevents merging: the three faces touching it are split into three quads each
+    cube[0][3] = 8;
+    mesh = build_model_mesh(8, (const uint8_t(*)[4])cube, 0);
+    ASSERT_EQ(12, mesh->quad_count);
+    vxf_free_mesh(mesh);
+
+    // the top face of the lower voxel is occluded on the +x side by the upper voxel
+    mesh = build_model_mesh(2, (const uint8_t[][4]){{0, 0, 0, 1}, {1, 0, 1, 1}}, 1);
+    const VxfQuad *lower_top = NULL;
+    for (size_t i = 0; i < mesh->quad_count; i++) {
+        const VxfQuad *quad = &mesh->quads[i];
+        if (quad->normal[2] == 1 && (!lower_top || quad->xyz[0][2] < lower_top->xyz[0][2]))
+            lower_top = quad;
+    }
+    ASSERT(lower_top);
+    int32_t x0 = MIN(lower_top->xyz[0][0], lower_top->xyz[2][0]);
+    for (int j = 0; j < 4; j++)
+        ASSERT_EQ(lower_top->xyz[j][0] == x0 ? 3 : 2, lower_top->ao[j]);
+    vxf_free_mesh(mesh);
+
+    test_file(argv[1]);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "common.h"
+#include <string.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#define open_readonly(filename) _open(filename, _O_RDONLY | _O_BINARY)
+#define close _close
+#else
+#include <unistd.h>
+#define open_readonly(filename) open(filename, O_RDONLY)
+#endif
+
+#define MAX_COUNT 1000
+
+int main(int argc, char* argv[]) {
+    ASSERT_EQ(2, argc);
+    VxfError error;
+    static int32_t expected_xyz[MAX_COUNT][3], xyz[2][MAX_COUNT][3];
+    static uint8_t expected_coloridx[MAX_COUNT], coloridx[2][MAX_COUNT];
+
+    VxfFile *vf = vxf_open_file(argv[1], &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    size_t expected_count = vxf_read_xyz_coloridx(vf, MAX_COUNT, expected_xyz, expected_coloridx, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(expected_count > 0 && expected_count < MAX_COUNT);
+    vxf_close(vf);
+
+    // two instances sharing a descriptor, read alternately in small steps
+    int fd = open_readonly(argv[1]);
+    ASSERT(fd >= 0);
+    VxfFile *vfs[2];
+    for (int i = 0; i < 2; i++) {
+        vfs[i] = vxf_open_fd(fd, NULL, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+    }
+    size_t counts[2] = {0, 0};
+    for (bool done = false; !done;) {
+        done = true;
+        for (int i = 0; i < 2; i++) {
+            size_t count = vxf_read_xyz_coloridx(vfs[i], 2 + i, xyz[i] + counts[i], coloridx[i] + counts[i], &error);
+            ASSERT_EQ(VXF_SUCCESS, error);
+            counts[i] += count;
+            done = done && count == 0;
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(expected_count, counts[i]);
+        ASSERT(memcmp(expected_xyz, xyz[i], expected_count * sizeof *expected_xyz) == 0);
+        ASSERT(memcmp(expected_coloridx, coloridx[i], expected_count) == 0);
+        vxf_close(vfs[i]);
+    }
+    close(fd);
+}
@@ -0,0 +1,82 @@
+#include "common.h"
+#include <string.h>
+
+struct memory_io {
+    const char *data;
+    int64_t size, pos;
+    size_t bytes_read;
+};
+
+static int64_t io_read(void *ctx, void *buffer, size_t size) {
+    struct memory_io *m = ctx;
+    size_t n = m->pos >= m->size ? 0 : (size_t)(m->size - m->pos);
+    if (n > size) n = size;
+    if (n > 7) n = 7; // deliver partial reads to test that they are handled
+    memcpy(buffer, m->data + m->pos, n);
+    m->pos += n;
+    m->bytes_read += n;
+    return (int64_t)n;
+}
+
+static int io_seek(void *ctx, int64_t offset) {
+    struct memory_io *m = ctx;
+    if (offset < 0) return -1;
+    m->pos = offset;
+    return 0;
+}
+
+static int64_t io_tell(void *ctx) {
+    return ((struct memory_io*)ctx)->pos;
+}
+
+static const void *io_get_pointer(void *ctx, size_t size) {
+    struct memory_io *m = ctx;
+    if (m->pos > m->size || (int64_t)size > m->size - m->pos) return NULL;
+    const char *result = m->data + m->pos;
+    m->pos += size;
+    return result;
+}
+
+static size_t read_all(VxfFile *vf, size_t max_count, int32_t xyz[][3], uint8_t coloridx[]) {
+    size_t total = 0, count;
+    VxfError error;
+    while ((count = vxf_read_xyz_coloridx(vf, max_count - total, xyz + total, coloridx + total, &error)) > 0)
+        total += count;
+    ASSERT_EQ(VXF_SUCCESS, error);
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    ASSERT_EQ(2, argc);
+    FILE *file = fopen(argv[1], "rb");
+    ASSERT(file);
+    static char buffer[1 << 16];
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    ASSERT(size > 0 && size < sizeof(buffer));
+    fclose(file);
+
+    VxfError error;
+    #define MAX_COUNT 1000
+    static int32_t expected_xyz[MAX_COUNT][3], xyz[MAX_COUNT][3];
+    static uint8_t expected_coloridx[MAX_COUNT], coloridx[MAX_COUNT];
+    VxfFile *vf = vxf_open_memory(size, buffer, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    size_t expected_count = read_all(vf, MAX_COUNT, expected_xyz, expected_coloridx);
+    vxf_close(vf);
+
+    for (int use_pointer = 0; use_pointer < 2; use_pointer++) {
+        struct memory_io m = {.data = buffer, .size = size};
+        VxfIo io = {.read = io_read, .seek = io_seek, .tell = io_tell, .get_pointer = use_pointer ? io_get_pointer : NULL};
+        vf = vxf_open_io(&io, &m, NULL, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        ASSERT_EQ(expected_count, read_all(vf, MAX_COUNT, xyz, coloridx));
+        ASSERT(memcmp(expected_xyz, xyz, expected_count * sizeof *xyz) == 0);
+        ASSERT(memcmp(expected_coloridx, coloridx, expected_count) == 0);
+        ASSERT(use_pointer ? m.bytes_read == 0 : m.bytes_read > 0);
+        vxf_close(vf);
+    }
+
+    vf = vxf_open_io(&(VxfIo){.read = io_read}, NULL, NULL, &error);
+    ASSERT(vf == NULL);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+}
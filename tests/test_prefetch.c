@@ -0,0 +1,116 @@
+#include "voxbuilder.h"
+
+#define MAX_PREFETCH 100
+
+struct memory_io {
+    const char *data;
+    int64_t size, pos;
+    int64_t prefetched[MAX_PREFETCH];
+    bool consumed[MAX_PREFETCH];
+    size_t prefetch_count;
+};
+
+static int64_t io_read(void *ctx, void *buffer, size_t size) {
+    struct memory_io *m = ctx;
+    for (size_t i = 0; i < m->prefetch_count; i++) {
+        if (m->prefetched[i] == m->pos) m->consumed[i] = true;
+    }
+    size_t n = m->pos >= m->size ? 0 : (size_t)(m->size - m->pos);
+    if (n > size) n = size;
+    memcpy(buffer, m->data + m->pos, n);
+    m->pos += n;
+    return (int64_t)n;
+}
+
+static int io_seek(void *ctx, int64_t offset) {
+    ((struct memory_io*)ctx)->pos = offset;
+    return 0;
+}
+
+static int64_t io_tell(void *ctx) {
+    return ((struct memory_io*)ctx)->pos;
+}
+
+static void io_prefetch(void *ctx, int64_t offset, size_t size) {
+    struct memory_io *m = ctx;
+    ASSERT(offset >= 0 && size > 0 && (int64_t)size <= m->size - offset);
+    ASSERT(m->prefetch_count < MAX_PREFETCH);
+    m->prefetched[m->prefetch_count++] = offset;
+}
+
+// reads all voxels with prefetching through I/O callbacks and returns the number of prefetch hints
+static size_t read_with_prefetch(const char *buffer, size_t size) {
+    VxfError error;
+    struct memory_io m = {.data = buffer, .size = size};
+    VxfIo io = {.read = io_read, .seek = io_seek, .tell = io_tell, .prefetch = io_prefetch};
+    VxfFile *vf = vxf_open_io(&io, &m, &(VxfOpenOptions){.prefetch_distance = 2}, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(0, m.prefetch_count);
+
+    int32_t xyz[4][3];
+    uint8_t coloridx[4];
+    uintmax_t total = 0;
+    size_t count;
+    while ((count = vxf_read_xyz_coloridx(vf, 4, xyz, coloridx, &error)) > 0)
+        total += count;
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(vxf_count_voxels(vf), total);
+    vxf_close(vf);
+
+    // every prefetched model must have been read afterwards
+    for (size_t i = 0; i < m.prefetch_count; i++)
+        ASSERT(m.consumed[i]);
+    return m.prefetch_count;
+}
+
+// an empty model between others gets no hint, and files are read correctly with hints via posix_fadvise
+static void test_empty_model(void) {
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 2, 1, 1, 2, (const uint8_t[][4]){{0, 0, 0, 1}, {1, 0, 0, 2}});
+    vb_model(&vb, 1, 1, 1, 0, NULL);
+    vb_model(&vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 3}});
+    vb_transform(&vb, 0, 1, -1, NULL, NULL);
+    vb_group(&vb, 1, 4, (const uint32_t[]){2, 4, 6, 8});
+    vb_transform(&vb, 2, 3, -1, NULL, NULL);
+    vb_shape(&vb, 3, 0);
+    vb_transform(&vb, 4, 5, -1, "0 1 0", NULL);
+    vb_shape(&vb, 5, 1);
+    vb_transform(&vb, 6, 7, -1, "0 2 0", NULL);
+    vb_shape(&vb, 7, 2);
+    vb_transform(&vb, 8, 9, -1, "0 3 0", NULL);
+    vb_shape(&vb, 9, 0);
+    vb_end(&vb);
+    ASSERT_EQ(2, read_with_prefetch(vb.data, vb.size));
+
+    const char *filename = "prefetch_test.vox";
+    FILE *file = fopen(filename, "wb");
+    ASSERT(file);
+    ASSERT_EQ(vb.size, fwrite(vb.data, 1, vb.size, file));
+    ASSERT(fclose(file) == 0);
+    VxfError error;
+    VxfFile *vf = vxf_open_file_ex(filename, &(VxfOpenOptions){.prefetch_distance = 2}, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    int32_t xyz[8][3];
+    uint8_t coloridx[8];
+    ASSERT_EQ(5, vxf_read_xyz_coloridx(vf, 8, xyz, coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(xyz[4][1] == 3 && coloridx[2] == 3);
+    vxf_close(vf);
+    ASSERT(remove(filename) == 0);
+    free(vb.data);
+}
+
+int main(int argc, char* argv[]) {
+    ASSERT_EQ(3, argc);
+    FILE *file = fopen(argv[1], "rb");
+    ASSERT(file);
+    unsigned long expected_prefetch_count = strtoul(argv[2], NULL, 10);
+    static char buffer[1 << 16];
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    ASSERT(size > 0 && size < sizeof(buffer));
+    fclose(file);
+    ASSERT_EQ(expected_prefetch_count, read_with_prefetch(buffer, size));
+    test_empty_model();
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "voxbuilder.h"
+
+// creates a scene where the scene graph order of the shapes differs from the order of the models
+static void build_scene(struct voxbuilder *vb) {
+    vb_begin(vb);
+    vb_model(vb, 2, 2, 2, 2, (const uint8_t[][4]){{0, 0, 0, 1}, {1, 1, 1, 2}});
+    vb_model(vb, 1, 1, 3, 3, (const uint8_t[][4]){{0, 0, 0, 3}, {0, 0, 1, 4}, {0, 0, 2, 5}});
+    vb_transform(vb, 0, 1, -1, NULL, NULL);
+    vb_group(vb, 1, 3, (const uint32_t[]){2, 4, 6});
+    vb_transform(vb, 2, 3, -1, "10 0 0", NULL);
+    vb_shape(vb, 3, 1);
+    vb_transform(vb, 4, 5, -1, "20 0 0", "17");
+    vb_shape(vb, 5, 0);
+    vb_transform(vb, 6, 7, -1, "30 0 0", NULL);
+    vb_shape(vb, 7, 1);
+    vb_end(vb);
+}
+
+struct voxels {
+    size_t count[3];
+    int32_t xyz[3][8][3];
+    uint8_t coloridx[3][8];
+};
+
+static void read_by_instance(VxfFile *vf, struct voxels *v, uint32_t instance_order[3]) {
+    *v = (struct voxels){0};
+    int32_t xyz[2][3];
+    uint8_t coloridx[2];
+    VxfReadBuffers buffers = {.max_count = 2, .xyz = xyz, .coloridx = coloridx};
+    uint32_t instance, previous = UINT32_MAX;
+    size_t count, instances_seen = 0;
+    VxfError error;
+    while ((count = vxf_read(vf, &buffers, &instance, &error)) > 0) {
+        ASSERT(instance < 3);
+        if (instance != previous) {
+            ASSERT(instances_seen < 3);
+            instance_order[instances_seen++] = instance;
+            previous = instance;
+        }
+        memcpy(v->xyz[instance] + v->count[instance], xyz, count * sizeof *xyz);
+        memcpy(v->coloridx[instance] + v->count[instance], coloridx, count);
+        v->count[instance] += count;
+    }
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(3, instances_seen);
+}
+
+int main(void) {
+    struct voxbuilder vb;
+    build_scene(&vb);
+    VxfError error;
+
+    struct voxels scene_voxels, file_voxels;
+    uint32_t scene_order[3], file_order[3];
+
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    read_by_instance(vf, &scene_voxels, scene_order);
+    vxf_close(vf);
+    ASSERT_EQ(0, scene_order[0]);
+    ASSERT_EQ(1, scene_order[1]);
+    ASSERT_EQ(2, scene_order[2]);
+
+    vf = vxf_open_memory_ex(vb.size, vb.data, &(VxfOpenOptions){.read_order = VXF_READ_ORDER_FILE}, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    read_by_instance(vf, &file_voxels, file_order);
+    vxf_close(vf);
+    ASSERT_EQ(1, file_order[0]); // instance of model 0
+    ASSERT_EQ(0, file_order[1]); // instances of model 1
+    ASSERT_EQ(2, file_order[2]);
+
+    // same voxels per instance, regardless of order
+    ASSERT(memcmp(&scene_voxels, &file_voxels, sizeof scene_voxels) == 0);
+    ASSERT_EQ(3, scene_voxels.count[0]);
+    ASSERT_EQ(2, scene_voxels.count[1]);
+
+    vf = vxf_open_memory_ex(vb.size, vb.data, &(VxfOpenOptions){.read_order = (VxfReadOrder)7}, &error);
+    ASSERT(vf == NULL);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    free(vb.data);
+}
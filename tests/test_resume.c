@@ -0,0 +1,212 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 1000
+#define POSITION_MASK ((UINT64_C(1) << 48) - 1) // voxels consumed, below the hash
+
+struct voxels {
+    size_t count;
+    int32_t xyz[MAX_VOXELS][3];
+    uint8_t coloridx[MAX_VOXELS];
+};
+
+static VxfFile *open_file(const char *filename) {
+    VxfError error;
+    VxfFile *vf = vxf_open_file(filename, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    return vf;
+}
+
+// voxels per read with a byte budget, at least one
+static uint64_t budget_voxels(uint64_t byte_budget) {
+    return byte_budget >= 4 ? byte_budget / 4 : 1;
+}
+
+// reads until the end or until max_calls reads, with the given budgets; returns the number of reads
+static size_t read_budgeted(VxfFile *vf, struct voxels *v, uint64_t byte_budget, uint32_t time_budget_us,
+                            size_t max_calls) {
+    size_t calls = 0, count;
+    VxfError error;
+    while (calls < max_calls) {
+        VxfReadBuffers buffers = {
+            .max_count = MAX_VOXELS - v->count, .xyz = v->xyz + v->count, .coloridx = v->coloridx + v->count,
+            .byte_budget = byte_budget, .time_budget_us = time_budget_us,
+        };
+        count = vxf_read(vf, &buffers, NULL, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        if (count == 0)
+            break;
+        if (byte_budget)
+            ASSERT(count <= budget_voxels(byte_budget));
+        v->count += count;
+        calls++;
+        ASSERT_EQ(v->count, vxf_get_read_position(vf) & POSITION_MASK);
+    }
+    return calls;
+}
+
+static void assert_same(const struct voxels *expected, const struct voxels *actual) {
+    ASSERT_EQ(expected->count, actual->count);
+    ASSERT(memcmp(expected->xyz, actual->xyz, actual->count * sizeof *actual->xyz) == 0);
+    ASSERT(memcmp(expected->coloridx, actual->coloridx, actual->count) == 0);
+}
+
+static void test_budgets(const char *filename, const struct voxels *ref) {
+    static struct voxels v;
+    const uint64_t byte_budgets[] = {1, 40, 4 * 64 + 3};
+    for (size_t i = 0; i < sizeof byte_budgets / sizeof *byte_budgets; i++) {
+        VxfFile *vf = open_file(filename);
+        v.count = 0;
+        size_t calls = read_budgeted(vf, &v, byte_budgets[i], 0, SIZE_MAX);
+        ASSERT_EQ((ref->count + budget_voxels(byte_budgets[i]) - 1) / budget_voxels(byte_budgets[i]), calls);
+        assert_same(ref, &v);
+        vxf_close(vf);
+    }
+
+    // every read returns at least one voxel, also if the time budget is exhausted immediately
+    VxfFile *vf = open_file(filename);
+    v.count = 0;
+    read_budgeted(vf, &v, 0, 1, SIZE_MAX);
+    assert_same(ref, &v);
+    vxf_close(vf);
+}
+
+// the position read from one instance is applied to a new one
+static void test_resume(const char *filename, const struct voxels *ref) {
+    static struct voxels v;
+    VxfError error;
+    for (uint64_t stop = 0; stop <= ref->count; stop += 7) {
+        VxfFile *vf = open_file(filename);
+        ASSERT_EQ(0, vxf_get_read_position(vf));
+        v.count = 0;
+        read_budgeted(vf, &v, 4, 0, (size_t)stop);
+        uint64_t position = vxf_get_read_position(vf);
+        ASSERT_EQ(stop, position & POSITION_MASK);
+        vxf_close(vf);
+
+        vf = open_file(filename);
+        vxf_set_read_position(vf, position, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        ASSERT_EQ(position, vxf_get_read_position(vf));
+        read_budgeted(vf, &v, 0, 0, SIZE_MAX);
+        assert_same(ref, &v);
+        ASSERT_EQ(ref->count, vxf_get_read_position(vf) & POSITION_MASK);
+
+        // rewinding clears the end of data
+        vxf_set_read_position(vf, 0, &error);
+        ASSERT_EQ(VXF_SUCCESS, error);
+        v.count = 0;
+        read_budgeted(vf, &v, 0, 0, SIZE_MAX);
+        assert_same(ref, &v);
+        vxf_close(vf);
+    }
+
+    VxfFile *vf = open_file(filename);
+    vxf_read_xyz_coloridx(vf, MAX_VOXELS, v.xyz, v.coloridx, &error);
+    uint64_t end = vxf_get_read_position(vf);
+    vxf_set_read_position(vf, end + 1, &error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_set_read_position(vf, end & POSITION_MASK, &error); // without the hash
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_set_read_position(vf, end, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    int32_t xyz[1][3];
+    ASSERT_EQ(0, vxf_read(vf, &(VxfReadBuffers){.max_count = 1, .xyz = xyz}, NULL, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    vxf_close(vf);
+}
+
+// positions are rejected by files with other instances and after changing the color filter
+static void test_other_scope(const char *filename) {
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 2, 1, 1, 2, (const uint8_t[][4]){{0, 0, 0, 1}, {1, 0, 0, 2}});
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *other = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    int32_t xyz[1][3];
+    uint8_t coloridx[1];
+    ASSERT_EQ(1, vxf_read_xyz_coloridx(other, 1, xyz, coloridx, &error));
+    uint64_t position = vxf_get_read_position(other);
+    vxf_set_read_position(other, position, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+
+    VxfFile *vf = open_file(filename);
+    vxf_set_read_position(vf, position, &error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_close(vf);
+
+    vxf_set_filter(other, &(VxfFilter){.color_mask = (const uint64_t[4]){UINT64_C(1) << 2}});
+    vxf_set_read_position(other, position, &error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    vxf_set_read_position(other, 0, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    vxf_close(other);
+    free(vb.data);
+}
+
+// budgets count voxels skipped by the filters, so that reads of mostly filtered data still stop early
+static void test_filtered_budget(void) {
+    enum { N = 8 };
+    static uint8_t voxels[N * N * N][4];
+    size_t n = 0;
+    for (int z = 0; z < N; z++) {
+        for (int y = 0; y < N; y++) {
+            for (int x = 0; x < N; x++, n++)
+                memcpy(voxels[n], (const uint8_t[4]){(uint8_t)x, (uint8_t)y, (uint8_t)z, x == 1 ? 2 : 1}, 4);
+        }
+    }
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, N, N, N, n, (const uint8_t(*)[4])voxels);
+    vb_end(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (int surface_only = 0; surface_only < 2; surface_only++) {
+        // only the voxels at x = 1 pass the color mask; of the surface, those at y or z = 0 or N - 1
+        vxf_set_filter(vf, &(VxfFilter){.color_mask = (const uint64_t[4]){UINT64_C(1) << 2}});
+        size_t total = 0, blocked = 0;
+        for (;;) {
+            int32_t xyz[N * N][3];
+            uint64_t before = vxf_get_read_position(vf) & POSITION_MASK;
+            size_t count = vxf_read(vf, &(VxfReadBuffers){
+                .max_count = N * N, .xyz = xyz, .surface_only = surface_only, .byte_budget = 4 * 3,
+            }, NULL, &error);
+            ASSERT((vxf_get_read_position(vf) & POSITION_MASK) - before <= 3);
+            total += count;
+            if (error == VXF_ERROR_WOULD_BLOCK) {
+                ASSERT_EQ(0, count);
+                blocked++;
+                continue;
+            }
+            ASSERT_EQ(VXF_SUCCESS, error);
+            if (count == 0)
+                break;
+            for (size_t i = 0; i < count; i++)
+                ASSERT_EQ(1 - N / 2, xyz[i][0]);
+        }
+        ASSERT_EQ(surface_only ? 4 * N - 4 : N * N, total);
+        ASSERT(blocked > 0);
+        ASSERT_EQ(N * N * N, vxf_get_read_position(vf) & POSITION_MASK);
+    }
+    vxf_close(vf);
+    free(vb.data);
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    static struct voxels ref;
+    VxfError error;
+    VxfFile *vf = open_file(argv[1]);
+    ref.count = vxf_read_xyz_coloridx(vf, MAX_VOXELS, ref.xyz, ref.coloridx, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT(ref.count > 0 && ref.count < MAX_VOXELS);
+    vxf_close(vf);
+
+    test_budgets(argv[1], &ref);
+    test_resume(argv[1], &ref);
+    test_other_scope(argv[1]);
+    test_filtered_budget();
+    return 0;
+}
@@ -0,0 +1,172 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "voxbuilder.h"
+#include <time.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#define utimbuf _utimbuf
+#define utime _utime
+#else
+#include <utime.h>
+#endif
+
+#define MAX_VOXELS 1000
+#define SOURCE_FILENAME "scene_cache_test.vox"
+#define CACHE_FILENAME "scene_cache_test.vxfc"
+#define MTIME 1700000000
+
+struct snapshot {
+    size_t count;
+    int32_t xyz[MAX_VOXELS][3];
+    uint8_t coloridx[MAX_VOXELS];
+    int32_t xyz_min[3], xyz_max[3];
+    uintmax_t voxel_count;
+    // with hidden nodes, which the cached instance table does not cover
+    int32_t hidden_min[3], hidden_max[3];
+    uintmax_t hidden_count;
+    // in file order, which reorders the cached instance table
+    size_t file_order_count;
+    int32_t file_order_xyz[MAX_VOXELS][3];
+    uint8_t file_order_coloridx[MAX_VOXELS];
+    uint8_t palette[256][4];
+    uint32_t frame_count;
+    size_t named_count;
+};
+
+// returns false if the file cannot be opened
+static bool take_snapshot(const char *cache_filename, const char *name, struct snapshot *s) {
+    VxfError error;
+    VxfFile *vf = vxf_open_file_ex(SOURCE_FILENAME, &(VxfOpenOptions){.cache_filename = cache_filename}, &error);
+    if (!vf)
+        return false;
+    memset(s, 0, sizeof *s);
+    s->count = vxf_read_xyz_coloridx(vf, MAX_VOXELS, s->xyz, s->coloridx, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    vxf_calculate_bounds(vf, s->xyz_min, s->xyz_max);
+    s->voxel_count = vxf_count_voxels(vf);
+    vxf_set_filter(vf, &(VxfFilter){.show_hidden = 1});
+    vxf_calculate_bounds(vf, s->hidden_min, s->hidden_max);
+    s->hidden_count = vxf_count_voxels(vf);
+    vxf_set_filter(vf, NULL);
+    vxf_get_palette(vf, s->palette);
+    s->frame_count = vxf_get_frame_count(vf);
+    uint32_t node_ids[4];
+    s->named_count = vxf_find_nodes(vf, name, 4, node_ids);
+    vxf_close(vf);
+
+    vf = vxf_open_file_ex(SOURCE_FILENAME,
+                          &(VxfOpenOptions){.cache_filename = cache_filename, .read_order = VXF_READ_ORDER_FILE},
+                          &error);
+    ASSERT(vf);
+    s->file_order_count = vxf_read_xyz_coloridx(vf, MAX_VOXELS, s->file_order_xyz, s->file_order_coloridx, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    vxf_close(vf);
+    return true;
+}
+
+static bool matches(const char *cache_filename, const char *name, const struct snapshot *expected) {
+    static struct snapshot s;
+    return take_snapshot(cache_filename, name, &s) && memcmp(&s, expected, sizeof s) == 0;
+}
+
+static void write_source(size_t size, const char *data, long mtime) {
+    FILE *file = fopen(SOURCE_FILENAME, "wb");
+    ASSERT(file);
+    ASSERT_EQ(size, fwrite(data, 1, size, file));
+    ASSERT(fclose(file) == 0);
+    struct utimbuf times = {.actime = mtime, .modtime = mtime};
+    ASSERT(utime(SOURCE_FILENAME, &times) == 0);
+}
+
+// the source with the same size, but without shape nodes
+static char *corrupt(size_t size, const char *data) {
+    char *result = malloc(size);
+    ASSERT(result);
+    memcpy(result, data, size);
+    for (size_t i = 0; i + 4 <= size; i++) {
+        if (memcmp(result + i, "nSHP", 4) == 0)
+            memcpy(result + i, "nXXX", 4);
+    }
+    return result;
+}
+
+static void test_source(size_t size, const char *data, const char *name) {
+    static struct snapshot ref;
+    char *corrupted = corrupt(size, data);
+    remove(CACHE_FILENAME);
+    write_source(size, data, MTIME);
+    ASSERT(take_snapshot(NULL, name, &ref));
+    ASSERT(ref.count > 0 && ref.file_order_count == ref.count && ref.voxel_count == ref.count);
+    ASSERT(!matches(NULL, name, &(struct snapshot){0}));
+
+    // the first open writes the cache, the second one uses it
+    ASSERT(matches(CACHE_FILENAME, name, &ref));
+    FILE *file = fopen(CACHE_FILENAME, "rb");
+    ASSERT(file);
+    fclose(file);
+    ASSERT(matches(CACHE_FILENAME, name, &ref));
+
+    // a changed file with the same size and modification time is detected by the hash of its end
+    write_source(size, corrupted, MTIME);
+    ASSERT(!matches(NULL, name, &ref));
+    ASSERT(!matches(CACHE_FILENAME, name, &ref));
+    write_source(size, data, MTIME);
+    ASSERT(matches(CACHE_FILENAME, name, &ref));
+
+    // a different modification time invalidates the cache
+    write_source(size, corrupted, MTIME + 10);
+    ASSERT(!matches(CACHE_FILENAME, name, &ref));
+
+    // a damaged cache is ignored
+    write_source(size, data, MTIME);
+    ASSERT(matches(CACHE_FILENAME, name, &ref));
+    file = fopen(CACHE_FILENAME, "r+b");
+    ASSERT(file && fseek(file, -1, SEEK_END) == 0);
+    int c = fgetc(file);
+    ASSERT(c != EOF && fseek(file, -1, SEEK_END) == 0 && fputc(c ^ 1, file) != EOF && fclose(file) == 0);
+    write_source(size, corrupted, MTIME);
+    ASSERT(!matches(CACHE_FILENAME, name, &ref));
+
+    free(corrupted);
+    ASSERT(remove(SOURCE_FILENAME) == 0);
+    ASSERT(remove(CACHE_FILENAME) == 0);
+}
+
+static char *read_file(const char *filename, size_t *size) {
+    FILE *file = fopen(filename, "rb");
+    ASSERT(file);
+    ASSERT(fseek(file, 0, SEEK_END) == 0);
+    long len = ftell(file);
+    ASSERT(len > 0);
+    rewind(file);
+    char *data = malloc((size_t)len);
+    ASSERT(data);
+    ASSERT_EQ((size_t)len, fread(data, 1, (size_t)len, file));
+    fclose(file);
+    *size = (size_t)len;
+    return data;
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    size_t size;
+    char *data = read_file(argv[1], &size);
+    test_source(size, data, "");
+    free(data);
+
+    // named nodes
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 2, 1, 1, 2, (const uint8_t[][4]){{0, 0, 0, 7}, {1, 0, 0, 8}});
+    vb_transform(&vb, 0, 1, -1, NULL, NULL);
+    vb_group(&vb, 1, 2, (const uint32_t[]){2, 4});
+    vb_named_transform(&vb, 2, 3, -1, "wheel", "5 0 0", NULL);
+    vb_shape(&vb, 3, 0);
+    vb_named_transform(&vb, 4, 5, -1, "wheel", "-5 0 0", NULL);
+    vb_shape(&vb, 5, 0);
+    vb_end(&vb);
+    test_source(vb.size, vb.data, "wheel");
+    free(vb.data);
+    return 0;
+}
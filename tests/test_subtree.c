@@ -0,0 +1,97 @@
+#include "voxbuilder.h"
+
+// a car with two wheels and a house on a hidden layer, all offset by the root transform
+static void build_scene(struct voxbuilder *vb) {
+    vb_begin(vb);
+    vb_model(vb, 1, 1, 1, 1, (const uint8_t[][4]){{0, 0, 0, 1}});
+    vb_transform(vb, 0, 1, -1, "100 0 0", NULL);
+    vb_group(vb, 1, 2, (const uint32_t[]){2, 8});
+    vb_named_transform(vb, 2, 3, -1, "car", "0 10 0", NULL);
+    vb_group(vb, 3, 2, (const uint32_t[]){4, 6});
+    vb_named_transform(vb, 4, 5, -1, "wheel", "1 0 0", NULL);
+    vb_shape(vb, 5, 0);
+    vb_named_transform(vb, 6, 7, -1, "wheel", "3 0 0", NULL);
+    vb_shape(vb, 7, 0);
+    vb_named_transform(vb, 8, 9, 0, "house", "0 0 50", NULL);
+    vb_shape(vb, 9, 0);
+    vb_layer(vb, 0, "1");
+    vb_end(vb);
+}
+
+static void check_voxels(VxfFile *vf, size_t count, const int32_t expected_x[]) {
+    int32_t xyz[4][3];
+    uint8_t coloridx[4];
+    VxfError error;
+    ASSERT_EQ(count, vxf_count_voxels(vf));
+    ASSERT_EQ(count, vxf_read_xyz_coloridx(vf, 4, xyz, coloridx, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(expected_x[i], xyz[i][0]);
+        ASSERT_EQ(10, xyz[i][1]);
+        ASSERT_EQ(0, xyz[i][2]);
+    }
+}
+
+static void select_node(VxfFile *vf, uint32_t node_id) {
+    VxfError error;
+    vxf_select_node(vf, node_id, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+}
+
+int main(void) {
+    struct voxbuilder vb;
+    build_scene(&vb);
+    VxfError error;
+    VxfFile *vf = vxf_open_memory(vb.size, vb.data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+
+    uint32_t ids[2];
+    ASSERT_EQ(2, vxf_find_nodes(vf, "wheel", 2, ids));
+    ASSERT_EQ(4, ids[0]);
+    ASSERT_EQ(6, ids[1]);
+    ASSERT_EQ(2, vxf_find_nodes(vf, "wheel", 0, NULL));
+    ASSERT_EQ(1, vxf_find_nodes(vf, "car", 2, ids));
+    ASSERT_EQ(2, ids[0]);
+    ASSERT_EQ(0, vxf_find_nodes(vf, "Car", 2, ids));
+    ASSERT_EQ(0, vxf_find_nodes(vf, "", 2, ids));
+    ASSERT_EQ(0, strcmp("house", vxf_get_node_name(vf, 8)));
+    ASSERT(vxf_get_node_name(vf, 1) == NULL);
+    ASSERT(vxf_get_node_name(vf, 10) == NULL);
+
+    // subtrees keep the transforms of their parents
+    check_voxels(vf, 2, (const int32_t[]){101, 103});
+    select_node(vf, 2);
+    check_voxels(vf, 2, (const int32_t[]){101, 103});
+    select_node(vf, 3);
+    check_voxels(vf, 2, (const int32_t[]){101, 103});
+    select_node(vf, 6);
+    check_voxels(vf, 1, (const int32_t[]){103});
+    int32_t xyz_min[3], xyz_max[3];
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    ASSERT_EQ(103, xyz_min[0]);
+    ASSERT_EQ(103, xyz_max[0]);
+    VxfMesh *mesh = vxf_build_mesh(vf, NULL, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(6, mesh->quad_count);
+    vxf_free_mesh(mesh);
+
+    // unknown nodes keep the selection
+    vxf_select_node(vf, 10, &error);
+    ASSERT_EQ(VXF_ERROR_INVALID_ARGUMENT, error);
+    ASSERT_EQ(1, vxf_count_voxels(vf));
+
+    // hidden subtrees are empty unless the filter shows them
+    select_node(vf, 9);
+    ASSERT_EQ(0, vxf_count_voxels(vf));
+    vxf_set_filter(vf, &(VxfFilter){.show_hidden = 1});
+    ASSERT_EQ(1, vxf_count_voxels(vf));
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    ASSERT_EQ(100, xyz_min[0]);
+    ASSERT_EQ(50, xyz_min[2]);
+
+    select_node(vf, 0);
+    ASSERT_EQ(3, vxf_count_voxels(vf));
+    vxf_close(vf);
+    free(vb.data);
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "voxbuilder.h"
+
+#define MAX_VOXELS 4000
+
+struct voxels {
+    size_t count;
+    int32_t xyz[MAX_VOXELS][3];
+    uint32_t instance[MAX_VOXELS];
+    uint8_t face_mask[MAX_VOXELS];
+};
+
+static void read_voxels(VxfFile *vf, int surface_only, struct voxels *v) {
+    VxfReadBuffers buffers = {
+        .max_count = 100, .surface_only = surface_only,
+        .xyz = v->xyz, .face_mask = v->face_mask,
+    };
+    v->count = 0;
+    size_t count;
+    uint32_t instance;
+    VxfError error;
+    while ((count = vxf_read(vf, &buffers, &instance, &error)) > 0) {
+        for (size_t i = 0; i < count; i++)
+            v->instance[v->count + i] = instance;
+        v->count += count;
+        ASSERT(v->count + 100 <= MAX_VOXELS);
+        buffers.xyz = v->xyz + v->count, buffers.face_mask = v->face_mask + v->count;
+    }
+    ASSERT_EQ(VXF_SUCCESS, error);
+}
+
+static bool has_voxel(const struct voxels *v, uint32_t instance, int32_t x, int32_t y, int32_t z) {
+    for (size_t i = 0; i < v->count; i++) {
+        if (v->instance[i] == instance && v->xyz[i][0] == x && v->xyz[i][1] == y && v->xyz[i][2] == z)
+            return true;
+    }
+    return false;
+}
+
+static unsigned expected_mask(const struct voxels *all, uint32_t instance, const int32_t xyz[3]) {
+    unsigned mask = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        for (int positive = 0; positive < 2; positive++) {
+            int32_t pos[3] = {xyz[0], xyz[1], xyz[2]};
+            pos[axis] += positive ? 1 : -1;
+            if (!has_voxel(all, instance, pos[0], pos[1], pos[2]))
+                mask |= 1u << (2 * axis + positive);
+        }
+    }
+    return mask;
+}
+
+struct source {
+    const char *filename; // or NULL for memory
+    const char *data;
+    size_t size;
+};
+
+static VxfFile *open_source(const struct source *source) {
+    VxfError error;
+    VxfFile *vf = source->filename ? vxf_open_file(source->filename, &error) : vxf_open_memory(source->size, source->data, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    return vf;
+}
+
+// checks face masks against the neighbors of each voxel and that surface mode returns the voxels with exposed faces
+static void check_surface(const struct source *source, size_t expected_total, size_t expected_surface) {
+    static struct voxels all, surface;
+    VxfFile *vf = open_source(source);
+    read_voxels(vf, 0, &all);
+    vxf_close(vf);
+    vf = open_source(source);
+    read_voxels(vf, 1, &surface);
+    vxf_close(vf);
+
+    size_t j = 0;
+    for (size_t i = 0; i < all.count; i++) {
+        ASSERT_EQ(expected_mask(&all, all.instance[i], all.xyz[i]), all.face_mask[i]);
+        if (all.face_mask[i] == 0)
+            continue;
+        ASSERT(j < surface.count);
+        ASSERT(memcmp(surface.xyz[j], all.xyz[i], sizeof all.xyz[i]) == 0);
+        ASSERT_EQ(all.face_mask[i], surface.face_mask[j]);
+        ASSERT_EQ(all.instance[i], surface.instance[j]);
+        j++;
+    }
+    ASSERT_EQ(j, surface.count);
+    if (expected_total) {
+        ASSERT_EQ(expected_total, all.count);
+        ASSERT_EQ(expected_surface, surface.count);
+    }
+}
+
+// solid box with an optional hole in the center, placed as two instances with different rotations
+static void build_box(struct voxbuilder *vb, int sx, int sy, int sz, bool hole) {
+    static uint8_t xyzi[MAX_VOXELS][4];
+    size_t count = 0;
+    for (int z = 0; z < sz; z++) {
+        for (int y = 0; y < sy; y++) {
+            for (int x = 0; x < sx; x++) {
+                if (hole && x == sx / 2 && y == sy / 2 && z == sz / 2)
+                    continue;
+                ASSERT(count < MAX_VOXELS);
+                xyzi[count][0] = (uint8_t)x, xyzi[count][1] = (uint8_t)y, xyzi[count][2] = (uint8_t)z;
+                xyzi[count++][3] = 1;
+            }
+        }
+    }
+    vb_begin(vb);
+    vb_model(vb, (uint32_t)sx, (uint32_t)sy, (uint32_t)sz, count, (const uint8_t(*)[4])xyzi);
+    vb_transform(vb, 0, 1, -1, NULL, NULL);
+    vb_group(vb, 1, 2, (const uint32_t[]){2, 4});
+    vb_transform(vb, 2, 3, -1, NULL, "17"); // swaps x and y
+    vb_shape(vb, 3, 0);
+    vb_transform(vb, 4, 5, -1, "300 0 0", "84"); // negates x and z
+    vb_shape(vb, 5, 0);
+    vb_end(vb);
+}
+
+// a voxel outside of the model size is not part of the model, as for meshes: it has no exposed faces, is skipped
+// in surface mode and does not cover faces of other voxels
+static void test_outside_model(void) {
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, 2, 1, 1, 3, (const uint8_t[][4]){{0, 0, 0, 1}, {1, 0, 0, 1}, {2, 0, 0, 1}});
+    vb_end(&vb);
+    static struct voxels all, surface;
+    VxfFile *vf = open_source(&(struct source){.data = vb.data, .size = vb.size});
+    read_voxels(vf, 0, &all);
+    vxf_close(vf);
+    ASSERT_EQ(3, all.count);
+    ASSERT_EQ(0x3f & ~VXF_FACE_NEG_X, all.face_mask[1]);
+    ASSERT_EQ(0, all.face_mask[2]);
+    vf = open_source(&(struct source){.data = vb.data, .size = vb.size});
+    read_voxels(vf, 1, &surface);
+    vxf_close(vf);
+    ASSERT_EQ(2, surface.count);
+
+    VxfError error;
+    vf = open_source(&(struct source){.data = vb.data, .size = vb.size});
+    VxfMesh *mesh = vxf_build_mesh(vf, NULL, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(6, mesh->quad_count);
+    vxf_free_mesh(mesh);
+    vxf_close(vf);
+    free(vb.data);
+}
+
+int main(int argc, char* argv[]) {
+    ASSERT_EQ(2, argc);
+    check_surface(&(struct source){.filename = argv[1]}, 0, 0);
+
+    struct voxbuilder vb;
+    build_box(&vb, 5, 5, 5, true);
+    // 124 voxels, of which 27 - 1 are inside and 6 of them are next to the hole
+    check_surface(&(struct source){.data = vb.data, .size = vb.size}, 2 * 124, 2 * (124 - 20));
+    free(vb.data);
+
+    // rows of more than 64 voxels
+    build_box(&vb, 100, 3, 3, false);
+    check_surface(&(struct source){.data = vb.data, .size = vb.size}, 2 * 900, 2 * (900 - 98));
+    free(vb.data);
+
+    test_outside_model();
+    return 0;
+}
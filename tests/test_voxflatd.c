@@ -0,0 +1,138 @@
+#define _XOPEN_SOURCE 700
+#include "voxbuilder.h"
+#include "../tools/voxflatd.h"
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define MAX_VOXELS 16
+
+static char dir[] = "/tmp/test_voxflatd_XXXXXX";
+static char socket_path[64], path_a[64], path_b[64], path_invalid[64];
+
+// writes a scene with count voxels in a row, colors starting at first_color
+static void write_scene(const char *path, uint8_t count, uint8_t first_color) {
+    uint8_t voxels[MAX_VOXELS][4];
+    for (uint8_t i = 0; i < count; i++)
+        memcpy(voxels[i], (const uint8_t[4]){i, 0, 0, (uint8_t)(first_color + i)}, 4);
+    struct voxbuilder vb;
+    vb_begin(&vb);
+    vb_model(&vb, MAX_VOXELS, 1, 1, count, (const uint8_t(*)[4])voxels);
+    vb_end(&vb);
+    FILE *file = fopen(path, "wb");
+    ASSERT(file);
+    ASSERT_EQ(vb.size, fwrite(vb.data, 1, vb.size, file));
+    ASSERT(fclose(file) == 0);
+    free(vb.data);
+}
+
+// compares a shared scene with the file read directly
+static void check_scene(const struct vxfd_scene *scene, const char *path) {
+    int32_t xyz[MAX_VOXELS][3], xyz_min[3], xyz_max[3];
+    uint8_t coloridx[MAX_VOXELS], palette[256][4];
+    VxfError error;
+    VxfFile *vf = vxf_open_file(path, &error);
+    ASSERT_EQ(VXF_SUCCESS, error);
+    size_t count = vxf_read_xyz_coloridx(vf, MAX_VOXELS, xyz, coloridx, &error);
+    vxf_calculate_bounds(vf, xyz_min, xyz_max);
+    vxf_get_palette(vf, palette);
+    vxf_close(vf);
+    ASSERT_EQ(count, scene->voxel_count);
+    ASSERT(memcmp(xyz, scene->xyz, count * sizeof *xyz) == 0);
+    ASSERT(memcmp(coloridx, scene->coloridx, count) == 0);
+    ASSERT(memcmp(xyz_min, scene->header->xyz_min, sizeof xyz_min) == 0);
+    ASSERT(memcmp(xyz_max, scene->header->xyz_max, sizeof xyz_max) == 0);
+    ASSERT(memcmp(palette, scene->header->palette, sizeof palette) == 0);
+}
+
+static void open_scene(const char *path, struct vxfd_scene *scene, uint32_t expected_flags) {
+    VxfError error;
+    ASSERT(vxfd_open_scene(socket_path, path, scene, &error));
+    ASSERT_EQ(VXF_SUCCESS, error);
+    ASSERT_EQ(expected_flags, scene->flags);
+    check_scene(scene, path);
+}
+
+static pid_t start_daemon(const char *daemon, const char *budget) {
+    pid_t pid = fork();
+    ASSERT(pid >= 0);
+    if (pid == 0) {
+        execl(daemon, daemon, "-s", socket_path, "-m", budget, (char*)NULL);
+        _exit(127);
+    }
+    // wait until the socket accepts connections
+    struct vxfd_scene scene;
+    VxfError error = VXF_ERROR_FILE_OPEN;
+    for (int i = 0; i < 500 && error == VXF_ERROR_FILE_OPEN; i++) {
+        if (!vxfd_open_scene(socket_path, path_invalid, &scene, &error) && error == VXF_ERROR_FILE_OPEN)
+            nanosleep(&(struct timespec){.tv_nsec = 10000000}, NULL);
+    }
+    ASSERT_EQ(VXF_ERROR_UNRECOGNIZED_FILE_FORMAT, error);
+    return pid;
+}
+
+static void stop_daemon(pid_t pid) {
+    int status;
+    ASSERT(kill(pid, SIGTERM) == 0);
+    ASSERT(waitpid(pid, &status, 0) == pid);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ASSERT(access(socket_path, F_OK) != 0);
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc == 2);
+    ASSERT(mkdtemp(dir));
+    snprintf(socket_path, sizeof socket_path, "%s/sock", dir);
+    snprintf(path_a, sizeof path_a, "%s/a.vox", dir);
+    snprintf(path_b, sizeof path_b, "%s/b.vox", dir);
+    snprintf(path_invalid, sizeof path_invalid, "%s/invalid.vox", dir);
+    write_scene(path_a, 3, 10);
+    write_scene(path_b, 3, 20);
+    FILE *file = fopen(path_invalid, "wb");
+    ASSERT(file && fputs("This is a text file and not a MagicaVoxel scene.\n", file) >= 0 && fclose(file) == 0);
+
+    // the budget has room for one scene of 3 voxels
+    size_t scene_size = sizeof(struct vxfd_scene_header) + 3 * 13;
+    char budget[32];
+    snprintf(budget, sizeof budget, "%zu", scene_size + scene_size / 2);
+    pid_t pid = start_daemon(argv[1], budget);
+
+    struct vxfd_scene first_a, scene;
+    open_scene(path_a, &first_a, 0);
+    open_scene(path_a, &scene, VXFD_FROM_CACHE);
+    ASSERT(scene.size == scene_size);
+    vxfd_close_scene(&scene);
+
+    // evicting a scene does not invalidate existing mappings
+    open_scene(path_b, &scene, 0);
+    vxfd_close_scene(&scene);
+    open_scene(path_a, &scene, 0);
+    vxfd_close_scene(&scene);
+    check_scene(&first_a, path_a);
+
+    // a changed file is decoded again
+    write_scene(path_a, 5, 30);
+    open_scene(path_a, &scene, 0);
+    ASSERT_EQ(5, scene.voxel_count);
+    vxfd_close_scene(&scene);
+    ASSERT_EQ(3, first_a.voxel_count);
+    ASSERT_EQ(10, first_a.coloridx[0]);
+    vxfd_close_scene(&first_a);
+
+    VxfError error;
+    char missing[64];
+    snprintf(missing, sizeof missing, "%s/missing.vox", dir);
+    ASSERT(!vxfd_open_scene(socket_path, missing, &scene, &error));
+    ASSERT_EQ(VXF_ERROR_FILE_OPEN, error);
+
+    stop_daemon(pid);
+    ASSERT(!vxfd_open_scene(socket_path, path_a, &scene, &error));
+    ASSERT_EQ(VXF_ERROR_FILE_OPEN, error);
+
+    remove(path_a);
+    remove(path_b);
+    remove(path_invalid);
+    ASSERT(rmdir(dir) == 0);
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Helpers for creating vox files in memory for tests.
+#include "common.h"
+#include <string.h>
+
+struct voxbuilder {
+    char *data;
+    size_t size, capacity;
+};
+
+static inline void vb_bytes(struct voxbuilder *vb, const void *bytes, size_t count) {
+    if (vb->size + count > vb->capacity) {
+        vb->capacity = (vb->size + count) * 2;
+        vb->data = realloc(vb->data, vb->capacity);
+        ASSERT(vb->data);
+    }
+    if (count > 0)
+        memcpy(vb->data + vb->size, bytes, count);
+    vb->size += count;
+}
+
+static inline void vb_u32(struct voxbuilder *vb, uint32_t value) {
+    uint8_t bytes[4] = {value & 0xff, value >> 8 & 0xff, value >> 16 & 0xff, value >> 24};
+    vb_bytes(vb, bytes, 4);
+}
+
+static inline void vb_patch_u32(struct voxbuilder *vb, size_t offset, uint32_t value) {
+    uint8_t bytes[4] = {value & 0xff, value >> 8 & 0xff, value >> 16 & 0xff, value >> 24};
+    memcpy(vb->data + offset, bytes, 4);
+}
+
+static inline void vb_string(struct voxbuilder *vb, const char *string) {
+    vb_u32(vb, (uint32_t)strlen(string));
+    vb_bytes(vb, string, strlen(string));
+}
+
+// writes a dict from NULL-terminated key/value pairs; entries with NULL value are left out
+static inline void vb_dict(struct voxbuilder *vb, const char *const *keyvalues) {
+    uint32_t count = 0;
+    for (size_t i = 0; keyvalues && keyvalues[i]; i += 2)
+        count += keyvalues[i + 1] != NULL;
+    vb_u32(vb, count);
+    for (size_t i = 0; keyvalues && keyvalues[i]; i += 2) {
+        if (!keyvalues[i + 1]) continue;
+        vb_string(vb, keyvalues[i]);
+        vb_string(vb, keyvalues[i + 1]);
+    }
+}
+
+static inline size_t vb_chunk_begin(struct voxbuilder *vb, const char fourcc[4]) {
+    size_t start = vb->size;
+    vb_bytes(vb, fourcc, 4);
+    vb_u32(vb, 0); // content size, patched in vb_chunk_end
+    vb_u32(vb, 0);
+    return start;
+}
+
+static inline void vb_chunk_end(struct voxbuilder *vb, size_t start) {
+    vb_patch_u32(vb, start + 4, (uint32_t)(vb->size - start - 12));
+}
+
+static inline void vb_begin(struct voxbuilder *vb) {
+    *vb = (struct voxbuilder){0};
+    vb_bytes(vb, "VOX ", 4);
+    vb_u32(vb, 150);
+    vb_bytes(vb, "MAIN", 4);
+    vb_u32(vb, 0);
+    vb_u32(vb, 0); // children size, patched in vb_end
+}
+
+static inline void vb_end(struct voxbuilder *vb) {
+    vb_patch_u32(vb, 16, (uint32_t)(vb->size - 20));
+}
+
+static inline void vb_model(struct voxbuilder *vb, uint32_t sx, uint32_t sy, uint32_t sz, size_t count, const uint8_t xyzi[][4]) {
+    size_t chunk = vb_chunk_begin(vb, "SIZE");
+    vb_u32(vb, sx), vb_u32(vb, sy), vb_u32(vb, sz);
+    vb_chunk_end(vb, chunk);
+    chunk = vb_chunk_begin(vb, "XYZI");
+    vb_u32(vb, (uint32_t)count);
+    vb_bytes(vb, xyzi, 4 * count);
+    vb_chunk_end(vb, chunk);
+}
+
+static inline void vb_named_transform(struct voxbuilder *vb, uint32_t id, uint32_t child, int32_t layer, const char *name,
+                                      const char *translation, const char *rotation) {
+    size_t chunk = vb_chunk_begin(vb, "nTRN");
+    vb_u32(vb, id);
+    vb_dict(vb, (const char *const[]){"_name", name, NULL});
+    vb_u32(vb, child);
+    vb_u32(vb, UINT32_MAX);
+    vb_u32(vb, (uint32_t)layer);
+    vb_u32(vb, 1);
+    vb_dict(vb, (const char *const[]){"_t", translation, "_r", rotation, NULL});
+    vb_chunk_end(vb, chunk);
+}
+
+static inline void vb_transform(struct voxbuilder *vb, uint32_t id, uint32_t child, int32_t layer, const char *translation, const char *rotation) {
+    vb_named_transform(vb, id, child, layer, NULL, translation, rotation);
+}
+
+// transform node with one frame per translation, at the frame indices given as strings
+static inline void vb_transform_frames(struct voxbuilder *vb, uint32_t id, uint32_t child, size_t count,
+                                       const char *const frames[], const char *const translations[]) {
+    size_t chunk = vb_chunk_begin(vb, "nTRN");
+    vb_u32(vb, id);
+    vb_dict(vb, NULL);
+    vb_u32(vb, child);
+    vb_u32(vb, UINT32_MAX);
+    vb_u32(vb, UINT32_MAX);
+    vb_u32(vb, (uint32_t)count);
+    for (size_t i = 0; i < count; i++)
+        vb_dict(vb, (const char *const[]){"_f", frames[i], "_t", translations[i], NULL});
+    vb_chunk_end(vb, chunk);
+}
+
+static inline void vb_group(struct voxbuilder *vb, uint32_t id, size_t count, const uint32_t children[]) {
+    size_t chunk = vb_chunk_begin(vb, "nGRP");
+    vb_u32(vb, id);
+    vb_dict(vb, NULL);
+    vb_u32(vb, (uint32_t)count);
+    for (size_t i = 0; i < count; i++)
+        vb_u32(vb, children[i]);
+    vb_chunk_end(vb, chunk);
+}
+
+static inline void vb_shape(struct voxbuilder *vb, uint32_t id, uint32_t model) {
+    size_t chunk = vb_chunk_begin(vb, "nSHP");
+    vb_u32(vb, id);
+    vb_dict(vb, NULL);
+    vb_u32(vb, 1);
+    vb_u32(vb, model);
+    vb_dict(vb, NULL);
+    vb_chunk_end(vb, chunk);
+}
+
+// shape node with one model per frame, at the frame indices given as strings
+static inline void vb_shape_frames(struct voxbuilder *vb, uint32_t id, size_t count, const uint32_t models[],
+                                   const char *const frames[]) {
+    size_t chunk = vb_chunk_begin(vb, "nSHP");
+    vb_u32(vb, id);
+    vb_dict(vb, NULL);
+    vb_u32(vb, (uint32_t)count);
+    for (size_t i = 0; i < count; i++) {
+        vb_u32(vb, models[i]);
+        vb_dict(vb, (const char *const[]){"_f", frames[i], NULL});
+    }
+    vb_chunk_end(vb, chunk);
+}
+
+static inline void vb_layer(struct voxbuilder *vb, uint32_t id, const char *hidden) {
+    size_t chunk = vb_chunk_begin(vb, "LAYR");
+    vb_u32(vb, id);
+    vb_dict(vb, (const char *const[]){"_hidden", hidden, NULL});
+    vb_u32(vb, UINT32_MAX);
+    vb_chunk_end(vb, chunk);
+}
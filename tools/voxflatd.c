@@ -0,0 +1,297 @@
+#define _XOPEN_SOURCE 700
+#include "voxflatd.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define DEFAULT_BUDGET ((uint64_t)1 << 30)
+#define CLIENT_TIMEOUT_SECONDS 5
+
+static const char *progname;
+static volatile sig_atomic_t stop_requested;
+
+// decoded scene, identified by the path and the modification time and size of the file when it was decoded
+struct scene {
+    char *path;
+    struct timespec mtime;
+    off_t file_size;
+    int fd; // read-only descriptor of the segment, whose name is already unlinked
+    uint64_t size; // of the segment
+    uint64_t last_use;
+};
+
+static struct {
+    struct scene *items;
+    size_t count, capacity;
+    uint64_t total_size, budget, use_counter;
+} cache;
+
+static void on_signal(int signum) {
+    (void)signum;
+    stop_requested = 1;
+}
+
+static void evict(size_t index) {
+    struct scene *scene = &cache.items[index];
+    close(scene->fd);
+    free(scene->path);
+    cache.total_size -= scene->size;
+    *scene = cache.items[--cache.count];
+}
+
+static struct scene *find_scene(const char *path) {
+    for (size_t i = 0; i < cache.count; i++) {
+        if (strcmp(cache.items[i].path, path) == 0)
+            return &cache.items[i];
+    }
+    return NULL;
+}
+
+// evicts least recently used scenes until the new one fits; returns false if it is not cached
+static bool add_scene(const char *path, const struct stat *st, int fd, uint64_t size) {
+    if (size > cache.budget)
+        return false;
+    while (cache.count > 0 && cache.total_size + size > cache.budget) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < cache.count; i++)
+            oldest = cache.items[i].last_use < cache.items[oldest].last_use ? i : oldest;
+        evict(oldest);
+    }
+    if (cache.count == cache.capacity) {
+        size_t capacity = cache.capacity ? cache.capacity * 2 : 16;
+        struct scene *items = realloc(cache.items, capacity * sizeof *items);
+        if (!items)
+            return false;
+        cache.items = items, cache.capacity = capacity;
+    }
+    char *path_copy = malloc(strlen(path) + 1);
+    if (!path_copy)
+        return false;
+    cache.items[cache.count++] = (struct scene){
+        .path = strcpy(path_copy, path), .mtime = st->st_mtim, .file_size = st->st_size,
+        .fd = fd, .size = size, .last_use = ++cache.use_counter,
+    };
+    cache.total_size += size;
+    return true;
+}
+
+// decodes a file into a new segment; returns its read-only descriptor, or -1 on failure
+static int decode_scene(const char *path, uint64_t *size, VxfError *error) {
+    static unsigned long segment_counter;
+    VxfFile *vf = vxf_open_file(path, error);
+    if (!vf)
+        return -1;
+    uint64_t count = vxf_count_voxels(vf);
+    uint64_t xyz_offset = sizeof(struct vxfd_scene_header), coloridx_offset = xyz_offset + count * 12;
+    *size = coloridx_offset + count;
+    int fd = -1, rw_fd = -1;
+    void *mapping = MAP_FAILED;
+    *error = VXF_ERROR_OUT_OF_MEMORY;
+    if (count > (SIZE_MAX / 2 - xyz_offset) / 13)
+        goto end;
+
+    // the segment is shared read-only: clients get a descriptor that was opened without write access
+    char name[64];
+    snprintf(name, sizeof name, "/voxflatd-%ld-%lu", (long)getpid(), ++segment_counter);
+    rw_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (rw_fd < 0)
+        goto end;
+    fd = shm_open(name, O_RDONLY, 0);
+    shm_unlink(name);
+    if (fd < 0 || ftruncate(rw_fd, (off_t)*size) != 0)
+        goto end;
+    if ((mapping = mmap(NULL, (size_t)*size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0)) == MAP_FAILED)
+        goto end;
+
+    struct vxfd_scene_header *header = mapping;
+    memcpy(header->magic, VXFD_SCENE_MAGIC, sizeof header->magic);
+    header->voxel_count = count;
+    header->xyz_offset = xyz_offset;
+    header->coloridx_offset = coloridx_offset;
+    vxf_calculate_bounds(vf, header->xyz_min, header->xyz_max);
+    vxf_get_palette(vf, header->palette);
+    int32_t (*xyz)[3] = (void*)((char*)mapping + xyz_offset);
+    uint8_t *coloridx = (uint8_t*)mapping + coloridx_offset;
+    size_t count_read = 0, n;
+    while (count_read < count && (n = vxf_read_xyz_coloridx(vf, (size_t)count - count_read,
+                                                            xyz + count_read, coloridx + count_read, error)) > 0)
+        count_read += n;
+    if (count_read == count)
+        *error = VXF_SUCCESS;
+    else if (*error == VXF_SUCCESS)
+        *error = VXF_ERROR_INVALID_FILE_STRUCTURE;
+
+end:
+    if (mapping != MAP_FAILED) munmap(mapping, (size_t)*size);
+    if (rw_fd >= 0) close(rw_fd);
+    if (*error != VXF_SUCCESS && fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    vxf_close(vf);
+    return fd;
+}
+
+static bool recv_all(int sock, void *data, size_t size) {
+    for (char *p = data; size > 0;) {
+        ssize_t n = recv(sock, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n, size -= (size_t)n;
+    }
+    return true;
+}
+
+static void send_response(int sock, const struct vxfd_response *response, int fd) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = {.iov_base = (void*)response, .iov_len = sizeof *response};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1};
+    if (fd >= 0) {
+        memset(&control, 0, sizeof control);
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof control.buf;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    while (sendmsg(sock, &msg, 0) < 0 && errno == EINTR) {}
+}
+
+static void handle_client(int sock) {
+    struct vxfd_request request;
+    char path[PATH_MAX];
+    struct vxfd_response response = {.error = VXF_ERROR_INVALID_ARGUMENT};
+    if (!recv_all(sock, &request, sizeof request))
+        return;
+    if (request.version != VXFD_PROTOCOL_VERSION || request.path_length == 0 || request.path_length >= sizeof path) {
+        send_response(sock, &response, -1);
+        return;
+    }
+    if (!recv_all(sock, path, request.path_length))
+        return;
+    path[request.path_length] = '\0';
+
+    struct stat st;
+    int fd = -1;
+    bool cached = false;
+    if (path[0] != '/' || strlen(path) != request.path_length) {
+        response.error = VXF_ERROR_INVALID_ARGUMENT;
+    } else if (stat(path, &st) != 0) {
+        response.error = VXF_ERROR_FILE_OPEN;
+    } else {
+        struct scene *scene = find_scene(path);
+        if (scene && (scene->mtime.tv_sec != st.st_mtim.tv_sec || scene->mtime.tv_nsec != st.st_mtim.tv_nsec
+                      || scene->file_size != st.st_size)) {
+            evict((size_t)(scene - cache.items));
+            scene = NULL;
+        }
+        VxfError error = VXF_SUCCESS;
+        if (scene) {
+            scene->last_use = ++cache.use_counter;
+            fd = scene->fd;
+            response = (struct vxfd_response){.flags = VXFD_FROM_CACHE, .size = scene->size};
+            cached = true;
+        } else if ((fd = decode_scene(path, &response.size, &error)) >= 0) {
+            cached = add_scene(path, &st, fd, response.size);
+        }
+        response.error = error;
+    }
+    send_response(sock, &response, fd);
+    if (fd >= 0 && !cached)
+        close(fd);
+}
+
+// parses a size in bytes with an optional K, M or G suffix
+static bool parse_size(const char *s, uint64_t *size) {
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(s, &end, 10);
+    unsigned shift = *end == 'K' ? 10 : *end == 'M' ? 20 : *end == 'G' ? 30 : 0;
+    if (shift) end++;
+    if (errno || end == s || *end || s[0] == '-' || value > UINT64_MAX >> shift)
+        return false;
+    *size = (uint64_t)value << shift;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    progname = *argv && **argv ? *argv : "voxflatd";
+    const char *socket_path = NULL;
+    cache.budget = DEFAULT_BUDGET;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:m:")) != -1) {
+        if (opt == 's') {
+            socket_path = optarg;
+        } else if (opt != 'm' || !parse_size(optarg, &cache.budget)) {
+            fprintf(stderr,
+                "Usage: %s [-s <socket path>] [-m <memory budget>]\n"
+                "  Decodes vox files on request and shares the voxels with local client processes.\n"
+                "  The memory budget for cached scenes is in bytes, with an optional K, M or G suffix (default 1G).\n",
+                progname
+            );
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct sockaddr_un addr;
+    if (!vxfd_socket_address(socket_path, &addr)) {
+        fprintf(stderr, "%s: Socket path too long\n", progname);
+        return EXIT_FAILURE;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        fprintf(stderr, "%s: %s\n", progname, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    // a socket left behind by a daemon that did not exit cleanly is replaced, a running daemon is not
+    if (connect(listener, (struct sockaddr*)&addr, sizeof addr) == 0) {
+        fprintf(stderr, "%s: %s: Already in use\n", progname, addr.sun_path);
+        close(listener);
+        return EXIT_FAILURE;
+    }
+    close(listener);
+    unlink(addr.sun_path);
+    mode_t old_umask = umask(0077);
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&addr, sizeof addr) != 0 || listen(listener, 16) != 0) {
+        fprintf(stderr, "%s: %s: %s\n", progname, addr.sun_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    umask(old_umask);
+
+    struct sigaction action = {.sa_handler = on_signal};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // one request per connection, handled in turn; clients that stall are dropped after a timeout
+    while (!stop_requested) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fprintf(stderr, "%s: %s\n", progname, strerror(errno));
+            break;
+        }
+        struct timeval timeout = {.tv_sec = CLIENT_TIMEOUT_SECONDS};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+        handle_client(client);
+        close(client);
+    }
+
+    close(listener);
+    unlink(addr.sun_path);
+    while (cache.count > 0)
+        evict(cache.count - 1);
+    free(cache.items);
+    return stop_requested ? EXIT_SUCCESS : EXIT_FAILURE;
+}
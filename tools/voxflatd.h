@@ -0,0 +1,181 @@
+#ifndef VOXFLATD_H
+#define VOXFLATD_H
+/*
+ * Client side of voxflatd, a local daemon that decodes vox files once and shares the voxels of each scene with all
+ * client processes as a read-only shared memory segment. Header-only; POSIX systems only, to be included with
+ * _XOPEN_SOURCE 700 or an equivalent feature test macro defined.
+ *
+ * Usage:
+ *     struct vxfd_scene scene;
+ *     if (vxfd_open_scene(NULL, "scene.vox", &scene, &error)) {
+ *         // scene.voxel_count voxels in scene.xyz and scene.coloridx, colors in scene.header->palette
+ *         vxfd_close_scene(&scene);
+ *     }
+ *
+ * The mapping stays valid until vxfd_close_scene, also if the daemon evicts the scene or exits in the meantime.
+ */
+#include <voxflat.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define VXFD_PROTOCOL_VERSION 1
+#define VXFD_SCENE_MAGIC "VXFDSCN1"
+
+// request: header followed by path_length bytes of an absolute path without terminating zero
+struct vxfd_request {
+    uint32_t version;
+    uint32_t path_length;
+};
+
+enum {
+    VXFD_FROM_CACHE = 1, // the scene was already decoded for an earlier request
+};
+
+// response; on success accompanied by the descriptor of the segment
+struct vxfd_response {
+    int32_t error; // VxfError
+    uint32_t flags; // VXFD_FROM_CACHE
+    uint64_t size; // of the segment
+};
+
+// start of a segment, followed by the arrays at the given offsets
+struct vxfd_scene_header {
+    char magic[8];
+    uint64_t voxel_count;
+    uint64_t xyz_offset; // int32_t[voxel_count][3]
+    uint64_t coloridx_offset; // uint8_t[voxel_count]
+    int32_t xyz_min[3], xyz_max[3];
+    uint8_t palette[256][4];
+};
+
+struct vxfd_scene {
+    const struct vxfd_scene_header *header;
+    size_t size; // of the mapping
+    uint32_t flags; // of the response
+    size_t voxel_count;
+    const int32_t (*xyz)[3];
+    const uint8_t *coloridx;
+};
+
+// default socket path, per user so that scenes are not shared between users; returns false if too long
+static inline bool vxfd_default_socket_path(char *buf, size_t size) {
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    int n = runtime_dir && *runtime_dir ? snprintf(buf, size, "%s/voxflatd.sock", runtime_dir)
+                                        : snprintf(buf, size, "/tmp/voxflatd-%lu.sock", (unsigned long)getuid());
+    return n > 0 && (size_t)n < size;
+}
+
+static inline bool vxfd_socket_address(const char *socket_path, struct sockaddr_un *addr) {
+    *addr = (struct sockaddr_un){.sun_family = AF_UNIX};
+    if (!socket_path)
+        return vxfd_default_socket_path(addr->sun_path, sizeof addr->sun_path);
+    if (strlen(socket_path) >= sizeof addr->sun_path)
+        return false;
+    strcpy(addr->sun_path, socket_path);
+    return true;
+}
+
+// sends all bytes, retrying after signals
+static inline bool vxfd_send_all(int fd, const void *data, size_t size) {
+    for (const char *p = data; size > 0;) {
+        ssize_t n = send(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n, size -= (size_t)n;
+    }
+    return true;
+}
+
+// receives a message of exactly the given size and the descriptor sent with it, if any
+static inline bool vxfd_recv_with_fd(int sock, void *data, size_t size, int *fd) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = {.iov_base = data, .iov_len = size};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf, .msg_controllen = sizeof control.buf};
+    ssize_t n;
+    while ((n = recvmsg(sock, &msg, 0)) < 0 && errno == EINTR) {}
+    *fd = -1;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); n >= 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    if (n != (ssize_t)size && *fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+    return n == (ssize_t)size;
+}
+
+/*
+ * Maps the voxels of a vox file decoded by the daemon listening at socket_path, or at the default path if NULL.
+ * Returns false on failure with VXF_ERROR_FILE_OPEN if the daemon is not reachable, VXF_ERROR_FILE_READ for
+ * protocol errors, or the error of the daemon decoding the file.
+ */
+static inline bool vxfd_open_scene(const char *socket_path, const char *filename, struct vxfd_scene *scene,
+                                   VxfError *error) {
+    VxfError result = VXF_ERROR_FILE_OPEN;
+    struct sockaddr_un addr;
+    char path[PATH_MAX];
+    int sock = -1, fd = -1;
+    void *mapping = MAP_FAILED;
+    struct vxfd_response response = {0};
+    *scene = (struct vxfd_scene){0};
+    // the daemon can have a different working directory, and scenes are cached by path
+    if (!vxfd_socket_address(socket_path, &addr) || !realpath(filename, path))
+        goto end;
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 || connect(sock, (struct sockaddr*)&addr, sizeof addr) != 0)
+        goto end;
+
+    result = VXF_ERROR_FILE_READ;
+    struct vxfd_request request = {.version = VXFD_PROTOCOL_VERSION, .path_length = (uint32_t)strlen(path)};
+    if (!vxfd_send_all(sock, &request, sizeof request) || !vxfd_send_all(sock, path, request.path_length)
+            || !vxfd_recv_with_fd(sock, &response, sizeof response, &fd))
+        goto end;
+    if (response.error != VXF_SUCCESS) {
+        result = (VxfError)response.error;
+        goto end;
+    }
+    if (fd < 0 || response.size < sizeof(struct vxfd_scene_header) || response.size > SIZE_MAX)
+        goto end;
+    if ((mapping = mmap(NULL, (size_t)response.size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        goto end;
+
+    const struct vxfd_scene_header *header = mapping;
+    uint64_t count = header->voxel_count;
+    if (memcmp(header->magic, VXFD_SCENE_MAGIC, sizeof header->magic) != 0 || count > response.size / 13
+            || header->xyz_offset > response.size - count * 12 || header->coloridx_offset > response.size - count
+            || header->xyz_offset % sizeof(int32_t) != 0)
+        goto end;
+    *scene = (struct vxfd_scene){
+        .header = header, .size = (size_t)response.size, .flags = response.flags, .voxel_count = (size_t)count,
+        .xyz = (const int32_t(*)[3])((const char*)mapping + header->xyz_offset),
+        .coloridx = (const uint8_t*)mapping + header->coloridx_offset,
+    };
+    mapping = MAP_FAILED;
+    result = VXF_SUCCESS;
+
+end:
+    if (mapping != MAP_FAILED) munmap(mapping, (size_t)response.size);
+    if (fd >= 0) close(fd);
+    if (sock >= 0) close(sock);
+    if (error) *error = result;
+    return result == VXF_SUCCESS;
+}
+
+static inline void vxfd_close_scene(struct vxfd_scene *scene) {
+    if (scene->header)
+        munmap((void*)scene->header, scene->size);
+    *scene = (struct vxfd_scene){0};
+}
+
+#endif